@@ -0,0 +1,174 @@
+// Inside the app messages go through WebKit's message handler. In a
+// browser (LOOKINGGLASS_HTTP_PORT) they go over a websocket instead, and
+// native calls come back as { name, content } meaning name(...content).
+const socketBacklog = [];
+const socket = window.webkit?.messageHandlers?.local ? null : openBridgeSocket();
+const shapes = [];
+
+function openBridgeSocket() {
+    const ws = new WebSocket(`ws://${location.host}/__bridge`);
+
+    ws.onopen = () => socketBacklog.splice(0).forEach((text) => ws.send(text));
+    ws.onmessage = (event) => {
+        const { name, content } = JSON.parse(event.data);
+        window[name]?.(...content);
+    };
+
+    return ws;
+}
+
+function post(message) {
+    if (!socket) {
+        window.webkit.messageHandlers.local.postMessage(message);
+        return;
+    }
+
+    const text = JSON.stringify(message);
+
+    if (socket.readyState === WebSocket.OPEN) socket.send(text);
+    else socketBacklog.push(text);
+}
+
+// Registers an object shape once, later messages of that shape are sent
+// as [id, ...values] so keys never cross the bridge again.
+function registerShape(...keys) {
+    const id = shapes.length;
+    shapes.push(keys);
+
+    post({
+        name: "__shape",
+        content: [id, keys],
+    });
+
+    return id;
+}
+
+function pack(id, object) {
+    return [id, ...shapes[id].map((key) => object[key])];
+}
+
+const callShape = registerShape("name", "content");
+const invokeShape = registerShape("name", "content", "id");
+const pendingCalls = new Map();
+let nextCallId = 1;
+
+function call(name, ...arguments) {
+    post([callShape, name, arguments]);
+}
+
+// Like call() but resolves with the endpoint's return value
+function invoke(name, ...arguments) {
+    const id = nextCallId++;
+
+    return new Promise((resolve, reject) => {
+        pendingCalls.set(id, { resolve, reject });
+        post([invokeShape, name, arguments, id]);
+    });
+}
+
+function __reply(id, value) {
+    const pending = pendingCalls.get(id);
+    pendingCalls.delete(id);
+    pending?.resolve(value);
+}
+
+function __reject(id, error) {
+    const pending = pendingCalls.get(id);
+    pendingCalls.delete(id);
+    pending?.reject(new Error(error));
+}
+
+const jobs = new Map();
+let nextJobId = 1;
+
+// Starts a native job, onProgress receives throttled (progress, detail) updates
+function startJob(name, args, onProgress) {
+    const id = nextJobId++;
+    const result = new Promise((resolve, reject) => {
+        jobs.set(id, { resolve, reject, onProgress });
+    });
+
+    call("__jobStart", id, name, args);
+
+    return {
+        id,
+        result,
+        cancel: () => call("__jobCancel", id),
+    };
+}
+
+function __jobEvent(id, type, payload) {
+    const job = jobs.get(id);
+
+    if (!job) return;
+
+    if (type === "progress") {
+        job.onProgress?.(payload.progress, payload.detail);
+        return;
+    }
+
+    jobs.delete(id);
+
+    if (type === "finished") job.resolve(payload);
+    else if (type === "cancelled") job.reject(new Error("cancelled"));
+    else job.reject(new Error(payload));
+}
+
+const channelHandlers = new Map();
+
+// Receives flow controlled state batches pushed by native code
+function onChannel(name, handler) {
+    channelHandlers.set(name, handler);
+}
+
+function __channelBatch(name, sequence, batch) {
+    const start = performance.now();
+
+    channelHandlers.get(name)?.(batch);
+
+    // Ack once the batch has made it to the screen
+    requestAnimationFrame(() => {
+        call("__channelAck", name, sequence, performance.now() - start);
+    });
+}
+
+// Lets native coroutines await page functions, see callScript()
+async function __callFromNative(id, name, args) {
+    try {
+        const value = await window[name](...args);
+        call("__scriptResult", id, value ?? null);
+    } catch (error) {
+        call("__scriptResult", id, null, String(error));
+    }
+}
+
+// A new document, native gives up on calls still waiting on the last one
+call("__bridgeStart");
+
+function print(string) {
+    call("print", string);
+}
+
+// Ends the launch timeline native keeps, see startuptrace.h
+addEventListener("load", () => call("__startupMark", "pageLoad"));
+
+// Relaunch snapshots (opt-in, "snapshot": true in config.json). Native
+// defines __snapshot when they're on; __snapshot.hydrated means the body
+// already holds the last run's DOM and only needs its behaviour attached.
+let snapshotState = null;
+
+function snapshotReady(state) {
+    snapshotState = state ?? null;
+    sendSnapshot();
+}
+
+function sendSnapshot() {
+    if (typeof __snapshot === "undefined") return;
+
+    const body = document.body.cloneNode(true);
+    body.querySelectorAll("script").forEach((script) => script.remove());
+
+    call("__snapshot", location.href, body.innerHTML, snapshotState);
+}
+
+addEventListener("pagehide", sendSnapshot);
@@ -1,23 +1,17 @@
-function call(name, ...arguments) {
-    const v = {
-        name: "print",
-        content: arguments,
-    };
-
-    window.webkit.messageHandlers.local.postMessage(v);
-}
-
-function print(string) {
-    call("print", string);
-}
+// call(), invoke(), print() etc. come from bridge.js
 
 //call("print", "My string");
 
 onload = function () {
     print("onload");
-    var list = this.document.getElementById("side-bar-list");
 
-    var item = document.createElement("li");
-    item.innerText = "custom generated baby";
-    list.appendChild(item);
+    if (!window.__snapshot?.hydrated) {
+        var list = this.document.getElementById("side-bar-list");
+
+        var item = document.createElement("li");
+        item.innerText = "custom generated baby";
+        list.appendChild(item);
+    }
+
+    snapshotReady();
 };
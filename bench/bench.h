@@ -0,0 +1,45 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Per-benchmark state handed to setup. bytesPerOp turns ns/op into MB/s,
+// anything put in metrics is copied into the benchmark's JSON.
+struct BenchContext
+{
+    size_t bytesPerOp = 0;
+    nlohmann::json metrics = nlohmann::json::object();
+};
+
+// setup runs once and returns the body, which runs the measured operation
+// iterations times. Whatever the body captures is released after the run.
+using bench_body_t  = std::function<void(size_t iterations)>;
+using bench_setup_t = std::function<bench_body_t(BenchContext& context)>;
+
+struct Benchmark
+{
+    std::string name;
+    bench_setup_t setup;
+};
+
+auto benchmarks() -> std::vector<Benchmark>&;
+
+// static BenchRegistrar name("group/case", [] (BenchContext&) { ... });
+struct BenchRegistrar
+{
+    BenchRegistrar(std::string name, bench_setup_t&& setup)
+    {
+        benchmarks().push_back({ std::move(name), std::move(setup) });
+    }
+};
+
+// Keeps the compiler from dropping a result nobody reads
+template <typename T>
+inline auto bench_keep(T&& value) -> void
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
@@ -0,0 +1,376 @@
+#include "bench.h"
+#include "webappinterface.h"
+#include "fileutils.h"
+#include "fileio.h"
+#include "messageshapes.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+// A scratch file removed when the benchmark body that holds it goes away
+struct TempFile
+{
+    explicit TempFile(size_t size, const std::string& tag = {})
+    {
+        path = (std::filesystem::temp_directory_path() / ("lookingglass_bench_" + tag + std::to_string(size))).string();
+        std::ofstream(path, std::ios::binary) << std::string(size, 'x');
+    }
+
+    ~TempFile()
+    {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    std::string path;
+};
+
+// One app for all of them, serving the source tree's app folder unless
+// LOOKINGGLASS_APP_ROOT says otherwise
+static auto bench_app() -> WebAppInterface&
+{
+    static auto app = []
+    {
+        setenv("LOOKINGGLASS_APP_ROOT", LOOKINGGLASS_APP_DIR, 0);
+
+        auto app = std::make_unique<WebAppInterface>();
+        app->logRequests = false;
+
+        app->registerScriptEndpoint("bench", [] (const nlohmann::json& json) -> nlohmann::json
+            {
+                return json.at(0).get<int>() + json.at(1).get<int>();
+            }, std::nullopt);
+
+        app->registerScriptEndpoint("benchMemo", [] (const nlohmann::json& json) -> nlohmann::json
+            {
+                return json.at(0).get<int>() + json.at(1).get<int>();
+            }, MemoOptions{});
+
+        app->onScriptMessage({ { "name", "__shape" }, { "content", { 1, { "name", "content", "id" } } } });
+        return app;
+    }();
+
+    return *app;
+}
+
+static auto sample_message() -> nlohmann::json
+{
+    return {
+        { "name", "pushState" },
+        { "id", 42 },
+        { "content", {
+            { "title", "LookingGlass" },
+            { "items", { 1, 2, 3, 4, 5, 6, 7, 8 } },
+            { "selection", { { "start", 10 }, { "end", 20 } } },
+            { "visible", true },
+            { "scale", 1.5 }
+        } }
+    };
+}
+
+// file_read_binary as it was before fileio.h, kept as the baseline
+static auto ifstream_read_binary(const std::string& filepath) -> std::optional<std::vector<uint8_t>>
+{
+    if (auto file = std::ifstream(filepath, std::ios::binary); file.is_open())
+    {
+        std::vector<uint8_t> vec;
+
+        vec.resize(file_get_size(filepath));
+        file.read((char*) vec.data(), vec.size());
+
+        return std::make_optional(vec);
+    }
+
+    return std::nullopt;
+}
+
+template <typename Read>
+static auto file_bench(size_t size, Read read) -> bench_setup_t
+{
+    return [size, read] (BenchContext& context) -> bench_body_t
+    {
+        context.bytesPerOp = size;
+
+        return [file = std::make_shared<TempFile>(size), read] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(read(file->path));
+        };
+    };
+}
+
+static auto read_binary = [] (const std::string& path) { return file_read_binary(path); };
+static auto read_string = [] (const std::string& path) { return file_read_string(path); };
+
+// Touches a byte per page so mapped files are paid for like read ones
+static auto read_contents = [] (const std::string& path)
+{
+    auto contents = file_read_contents(path);
+    uint8_t sum   = 0;
+
+    for (size_t i = 0; contents && i < contents->size(); i += 4096)
+        sum += contents->data()[i];
+
+    return sum;
+};
+
+static BenchRegistrar fileIfstreamSmall("file/ifstream_binary/4K", file_bench(4 * 1024, ifstream_read_binary));
+static BenchRegistrar fileIfstreamLarge("file/ifstream_binary/1M", file_bench(1024 * 1024, ifstream_read_binary));
+static BenchRegistrar fileBinarySmall("file/read_binary/4K", file_bench(4 * 1024, read_binary));
+static BenchRegistrar fileBinaryLarge("file/read_binary/1M", file_bench(1024 * 1024, read_binary));
+static BenchRegistrar fileStringSmall("file/read_string/4K", file_bench(4 * 1024, read_string));
+static BenchRegistrar fileStringLarge("file/read_string/1M", file_bench(1024 * 1024, read_string));
+static BenchRegistrar fileContentsLarge("file/read_contents_mapped/1M", file_bench(1024 * 1024, read_contents));
+
+// 64 small files per iteration, through io_uring where available and through
+// one pread loop after another
+static auto batch_bench(bool sync) -> bench_setup_t
+{
+    return [sync] (BenchContext& context) -> bench_body_t
+    {
+        constexpr size_t fileCount = 64;
+        constexpr size_t fileSize  = 4 * 1024;
+
+        auto files = std::make_shared<std::vector<std::unique_ptr<TempFile>>>();
+        std::vector<std::string> paths;
+
+        for (size_t i = 0; i < fileCount; i++)
+        {
+            files->push_back(std::make_unique<TempFile>(fileSize, "batch" + std::to_string(i) + "_"));
+            paths.push_back(files->back()->path);
+        }
+
+        context.bytesPerOp         = fileCount * fileSize;
+        context.metrics["backend"] = sync ? "pread" : file_batch_backend();
+
+        return [files, paths, sync] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(sync ? file_read_batch_sync(paths) : file_read_batch(paths));
+        };
+    };
+}
+
+static BenchRegistrar fileBatch("file/read_batch/64x4K", batch_bench(false));
+static BenchRegistrar fileBatchSync("file/read_batch_sync/64x4K", batch_bench(true));
+
+static auto dispatch_bench(nlohmann::json message) -> bench_setup_t
+{
+    return [message = std::move(message)] (BenchContext& context) -> bench_body_t
+    {
+        auto& app = bench_app();
+        auto replies = std::make_shared<size_t>(0);
+
+        app.onSendMessage = [replies] (const std::string&, const std::string&) { (*replies)++; };
+
+        return [&app, &context, message, replies] (size_t iterations)
+        {
+            *replies = 0;
+
+            for (size_t i = 0; i < iterations; i++)
+                app.onScriptMessage(message);
+
+            context.metrics["repliesPerCall"] = (double) *replies / (double) iterations;
+        };
+    };
+}
+
+static BenchRegistrar dispatchObject("dispatch/object", dispatch_bench({ { "name", "bench" }, { "content", { 1, 2 } }, { "id", 1 } }));
+static BenchRegistrar dispatchPacked("dispatch/packed", dispatch_bench({ 1, "bench", { 1, 2 }, 1 }));
+static BenchRegistrar dispatchMemo("dispatch/memoized", dispatch_bench({ { "name", "benchMemo" }, { "content", { 1, 2 } }, { "id", 1 } }));
+
+static BenchRegistrar jsonParse("json/parse", [] (BenchContext& context) -> bench_body_t
+    {
+        auto text = sample_message().dump();
+        context.bytesPerOp = text.size();
+
+        return [text] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(nlohmann::json::parse(text));
+        };
+    });
+
+static BenchRegistrar jsonDump("json/dump", [] (BenchContext&) -> bench_body_t
+    {
+        return [message = sample_message()] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(message.dump());
+        };
+    });
+
+static BenchRegistrar shapePack("json/shape_pack", [] (BenchContext&) -> bench_body_t
+    {
+        auto shapes = std::make_shared<ShapeRegistry>();
+        shapes->add(1, { "name", "id", "content" });
+
+        return [shapes, message = sample_message()] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(shapes->pack(1, message));
+        };
+    });
+
+static BenchRegistrar shapeUnpack("json/shape_unpack", [] (BenchContext&) -> bench_body_t
+    {
+        auto shapes = std::make_shared<ShapeRegistry>();
+        shapes->add(1, { "name", "id", "content" });
+
+        return [shapes, packed = shapes->pack(1, sample_message())] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(shapes->unpack(packed));
+        };
+    });
+
+static auto url_bench(std::string path) -> bench_setup_t
+{
+    return [path = std::move(path)] (BenchContext& context) -> bench_body_t
+    {
+        auto& app = bench_app();
+
+        return [&app, &context, request = UrlRequest{ path }] (size_t iterations)
+        {
+            size_t bytes = 0;
+
+            for (size_t i = 0; i < iterations; i++)
+                if (auto response = app.onUrlRequest(request))
+                    bytes = response->data.size();
+
+            context.metrics["responseBytes"] = bytes;
+        };
+    };
+}
+
+// A page with linked scripts, a stylesheet and images, too big to inline
+struct TempPage
+{
+    TempPage()
+    {
+        dir = (std::filesystem::temp_directory_path() / "lookingglass_bench_page").string();
+        std::filesystem::create_directories(dir);
+
+        std::string html = "<!doctype html>\n<html><head>\n<link rel=\"stylesheet\" href=\"style.css\">\n";
+
+        write("style.css", 40 * 1024);
+
+        for (int i = 0; i < 6; i++)
+        {
+            html += "<script src=\"local://script" + std::to_string(i) + ".js\"></script>\n";
+            write("script" + std::to_string(i) + ".js", 48 * 1024);
+        }
+
+        html += "</head><body>\n<img src=\"a.png\">\n<img src=\"b.png\">\n</body></html>\n";
+
+        write("a.png", 100 * 1024);
+        write("b.png", 100 * 1024);
+
+        std::ofstream(dir + "/index.html") << html;
+        std::ofstream(dir + "/noprefetch.json") << R"({ "prefetch": false })";
+    }
+
+    ~TempPage()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+
+    auto write(const std::string& name, size_t size) -> void
+    {
+        std::ofstream(dir + "/" + name, std::ios::binary) << std::string(size, 'x');
+        subresources.push_back(name);
+    }
+
+    std::string dir;
+    std::vector<std::string> subresources;
+};
+
+// Serves the page, waits a moment as if the page were being parsed, then
+// serves its subresources the way the backends do, reading file-backed
+// responses. Per page load.
+static auto page_bench(bool prefetch) -> bench_setup_t
+{
+    return [prefetch] (BenchContext& context) -> bench_body_t
+    {
+        auto page = std::make_shared<TempPage>();
+        auto app  = std::make_shared<WebAppInterface>();
+
+        app->logRequests = false;
+        app->mountAppFolder(page->dir + "/");
+
+        if (! prefetch)
+            app->prewarm.startConfig("noprefetch.json");
+
+        return [page, app, &context] (size_t iterations)
+        {
+            auto serve = [&app] (const std::string& path)
+            {
+                auto response = app->onUrlRequest({ "local://" + path });
+
+                if (response && ! response->filepath.empty())
+                    bench_keep(file_read_binary(response->filepath));
+
+                bench_keep(response);
+            };
+
+            std::chrono::nanoseconds subresourceTime{};
+
+            for (size_t i = 0; i < iterations; i++)
+            {
+                serve("index.html");
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+                const auto start = std::chrono::steady_clock::now();
+
+                for (const auto& path : page->subresources)
+                    serve(path);
+
+                subresourceTime += std::chrono::steady_clock::now() - start;
+            }
+
+            // What the page waits for once it's parsed, the part prefetch cuts
+            context.metrics["subresourceUsPerPage"] = (double) subresourceTime.count() / 1000.0 / (double) iterations;
+            context.metrics["prefetch"]             = app->prefetch.getStats();
+        };
+    };
+}
+
+static BenchRegistrar urlPagePrefetch("url/page_load_prefetch", page_bench(true));
+static BenchRegistrar urlPageNoPrefetch("url/page_load_no_prefetch", page_bench(false));
+
+// 8 threads requesting the same page at once, per request
+static BenchRegistrar urlConcurrent("url/concurrent_same_page_8", [] (BenchContext& context) -> bench_body_t
+    {
+        auto& app = bench_app();
+
+        return [&app, &context] (size_t iterations)
+        {
+            constexpr size_t threadCount = 8;
+
+            const auto before = app.urlFlights.getStats();
+            std::vector<std::thread> threads;
+
+            for (size_t t = 0; t < threadCount; t++)
+                threads.emplace_back([&app, iterations, t]
+                    {
+                        for (size_t i = t; i < iterations; i += threadCount)
+                            bench_keep(app.onUrlRequest({ "local://index.html" }));
+                    });
+
+            for (auto& thread : threads)
+                thread.join();
+
+            const auto after = app.urlFlights.getStats();
+
+            context.metrics["flights"]   = after.flights - before.flights;
+            context.metrics["coalesced"] = after.coalesced - before.coalesced;
+        };
+    });
+
+static BenchRegistrar urlHtml("url/html_inlined", url_bench("local://index.html"));
+static BenchRegistrar urlAsset("url/asset_file", url_bench("local://test.js"));
+static BenchRegistrar urlMissing("url/missing", url_bench("local://missing.txt"));
@@ -0,0 +1,283 @@
+#include "bench.h"
+#include "eventloop_linux.h"
+#include "httpserver.h"
+#include "websocketserver.h"
+#include "websocketcodec.h"
+#include "histogram.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+// The embedded servers on their own loop thread, as linux_app.cpp wires them
+struct NetFixture
+{
+    NetFixture()
+        : http(loop, [this] (const HttpRequest&)
+            {
+                auto response = std::make_unique<UrlResponse>();
+
+                response->data     = body;
+                response->mimetype = "application/json";
+
+                return response;
+            })
+        , sockets(loop, [] (WebSocketServer::client_t, std::string_view) { })
+    {
+        http.onUpgrade = [this] (int fd, const HttpRequest& request, std::string leftover)
+        {
+            return sockets.adopt(fd, request, std::move(leftover));
+        };
+
+        sockets.onOpen = [this] (WebSocketServer::client_t) { opened++; };
+
+        if (! http.listen(0))
+            printf("Error: can't listen for the net benchmarks\n");
+
+        thread = std::thread([this] { loop.run(); });
+    }
+
+    ~NetFixture()
+    {
+        loop.post([this] { loop.quit(); });
+        thread.join();
+
+        sockets.close();
+        http.close();
+    }
+
+    std::vector<uint8_t> body = std::vector<uint8_t>(256, 'x');
+    EpollEventLoop loop;
+    HttpServer http;
+    WebSocketServer sockets;
+    std::atomic<size_t> opened = 0;
+    std::thread thread;
+};
+
+static auto connect_local(uint16_t port) -> int
+{
+    auto fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0)
+    {
+        if (fd >= 0)
+            ::close(fd);
+
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return fd;
+}
+
+static auto send_all(int fd, std::string_view data) -> bool
+{
+    while (! data.empty())
+    {
+        auto n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+
+        if (n <= 0)
+            return false;
+
+        data.remove_prefix((size_t) n);
+    }
+
+    return true;
+}
+
+// Reads one response with a Content-Length body into buffer, keeping any extra
+static auto read_response(int fd, std::string& buffer) -> bool
+{
+    char chunk[16 * 1024];
+
+    for (;;)
+    {
+        if (auto end = buffer.find("\r\n\r\n"); end != std::string::npos)
+        {
+            auto length = buffer.find("Content-Length: ");
+            auto size   = length < end ? std::strtoul(buffer.c_str() + length + 16, nullptr, 10) : 0;
+
+            if (buffer.size() >= end + 4 + size)
+            {
+                buffer.erase(0, end + 4 + size);
+                return true;
+            }
+        }
+
+        auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+
+        if (n <= 0)
+            return false;
+
+        buffer.append(chunk, (size_t) n);
+    }
+}
+
+// Keep-alive GETs from 4 clients, one request in flight each. Per request,
+// with per-request latency percentiles in the metrics.
+static BenchRegistrar httpRequests("net/http_keepalive_4", [] (BenchContext& context) -> bench_body_t
+    {
+        auto fixture = std::make_shared<NetFixture>();
+
+        return [fixture, &context] (size_t iterations)
+        {
+            constexpr size_t clients = 4;
+            std::vector<LatencyHistogram> histograms(clients);
+            std::vector<std::thread> threads;
+            std::atomic<size_t> failed = 0;
+
+            for (size_t c = 0; c < clients; c++)
+                threads.emplace_back([&, c]
+                    {
+                        auto fd = connect_local(fixture->http.getPort());
+                        std::string buffer;
+
+                        for (size_t i = c; i < iterations; i += clients)
+                        {
+                            const auto start = std::chrono::steady_clock::now();
+
+                            if (fd < 0 || ! send_all(fd, "GET /bench HTTP/1.1\r\nHost: localhost\r\n\r\n") || ! read_response(fd, buffer))
+                            {
+                                failed++;
+                                break;
+                            }
+
+                            histograms[c].record((uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+                        }
+
+                        if (fd >= 0)
+                            ::close(fd);
+                    });
+
+            for (auto& thread : threads)
+                thread.join();
+
+            for (size_t c = 1; c < clients; c++)
+                histograms[0].merge(histograms[c]);
+
+            context.metrics["latency"] = histograms[0];
+            context.metrics["failed"]  = failed.load();
+        };
+    });
+
+// One 256 byte message broadcast to 16 websocket clients, per broadcast
+static BenchRegistrar websocketFanOut("net/websocket_fanout_16", [] (BenchContext& context) -> bench_body_t
+    {
+        constexpr size_t clients = 16;
+
+        auto fixture = std::make_shared<NetFixture>();
+        auto fds     = std::shared_ptr<std::vector<int>>(new std::vector<int>, [] (std::vector<int>* fds)
+            {
+                for (auto fd : *fds)
+                    ::close(fd);
+
+                delete fds;
+            });
+
+        for (size_t c = 0; c < clients; c++)
+        {
+            auto fd = connect_local(fixture->http.getPort());
+            std::string response;
+            char chunk[1024];
+
+            send_all(fd, "GET /__bridge HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                         "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+
+            while (response.find("\r\n\r\n") == std::string::npos)
+            {
+                auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+
+                if (n <= 0)
+                    break;
+
+                response.append(chunk, (size_t) n);
+            }
+
+            fds->push_back(fd);
+        }
+
+        while (fixture->opened < clients)
+            std::this_thread::yield();
+
+        context.bytesPerOp = clients * 256;
+
+        return [fixture, fds, &context] (size_t iterations)
+        {
+            std::vector<std::thread> threads;
+            std::atomic<size_t> failed = 0;
+
+            for (auto fd : *fds)
+                threads.emplace_back([&, fd]
+                    {
+                        std::string buffer;
+                        WebSocketFrame frame;
+                        char chunk[64 * 1024];
+                        size_t received = 0;
+
+                        while (received < iterations)
+                        {
+                            auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+
+                            if (n <= 0)
+                            {
+                                failed++;
+                                return;
+                            }
+
+                            buffer.append(chunk, (size_t) n);
+
+                            size_t offset = 0;
+
+                            while (auto size = parse_websocket_frame(buffer, offset, frame, false))
+                            {
+                                if (size < 0)
+                                {
+                                    failed++;
+                                    return;
+                                }
+
+                                offset += (size_t) size;
+                                received++;
+                            }
+
+                            buffer.erase(0, offset);
+                        }
+                    });
+
+            const std::string message(256, 'x');
+
+            // Posted in batches so the loop isn't woken once per message
+            for (size_t sent = 0; sent < iterations;)
+            {
+                const auto batch = std::min<size_t>(64, iterations - sent);
+
+                fixture->loop.post([fixture, message, batch]
+                    {
+                        for (size_t i = 0; i < batch; i++)
+                            fixture->sockets.broadcast(message);
+                    });
+
+                sent += batch;
+            }
+
+            for (auto& thread : threads)
+                thread.join();
+
+            context.metrics["failed"]  = failed.load();
+            context.metrics["dropped"] = fixture->sockets.getStats().dropped;
+        };
+    });
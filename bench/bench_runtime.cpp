@@ -0,0 +1,282 @@
+#include "bench.h"
+#include "memocache.h"
+#include "task.h"
+#include "executor.h"
+#include "mpscqueue.h"
+#include "messagequeue.h"
+#include "timingwheel.h"
+#include "workerpool.h"
+#include "framescheduler.h"
+#include "htmlinliner.h"
+#include "histogram.h"
+#include "websocketcodec.h"
+#include "fileutils.h"
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+
+static BenchRegistrar memoHit("runtime/memo_hit", [] (BenchContext&) -> bench_body_t
+    {
+        auto cache = std::make_shared<MemoCache>();
+        const nlohmann::json args = { 1, "two", 3.0 };
+
+        cache->insert("endpoint", args, std::make_shared<const std::string>("42"), {});
+
+        return [cache, args] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(cache->find("endpoint", args));
+        };
+    });
+
+// One hop through an executor, as a coroutine and as a plain callback
+static auto hop(Executor& executor, int value) -> Task<int>
+{
+    co_await resumeOn(executor);
+    co_return value;
+}
+
+static BenchRegistrar taskHop("runtime/task_hop", [] (BenchContext&) -> bench_body_t
+    {
+        return [executor = std::make_shared<ManualExecutor>()] (size_t iterations)
+        {
+            int64_t sum = 0;
+
+            for (size_t i = 0; i < iterations; i++)
+            {
+                spawn(hop(*executor, 1), [&sum] (int value) { sum += value; }, [] (std::exception_ptr) { });
+                executor->poll();
+            }
+
+            bench_keep(sum);
+        };
+    });
+
+static BenchRegistrar callbackHop("runtime/callback_hop", [] (BenchContext&) -> bench_body_t
+    {
+        return [executor = std::make_shared<ManualExecutor>()] (size_t iterations)
+        {
+            int64_t sum = 0;
+
+            for (size_t i = 0; i < iterations; i++)
+            {
+                executor->post([&sum] { sum += 1; });
+                executor->poll();
+            }
+
+            bench_keep(sum);
+        };
+    });
+
+static BenchRegistrar mpscSingle("runtime/mpsc_push_pop", [] (BenchContext&) -> bench_body_t
+    {
+        return [queue = std::make_shared<MpscQueue<int>>()] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+            {
+                queue->push((int) i);
+                bench_keep(queue->pop());
+            }
+        };
+    });
+
+// Four producers against one consumer, per message
+static BenchRegistrar mpscContended("runtime/mpsc_4_producers", [] (BenchContext&) -> bench_body_t
+    {
+        return [] (size_t iterations)
+        {
+            constexpr size_t producers = 4;
+            MpscQueue<size_t> queue;
+            std::vector<std::thread> threads;
+
+            for (size_t p = 0; p < producers; p++)
+                threads.emplace_back([&queue, iterations, p]
+                    {
+                        for (size_t i = p; i < iterations; i += producers)
+                            queue.push(i);
+                    });
+
+            for (size_t received = 0; received < iterations;)
+                if (queue.pop())
+                    received++;
+
+            for (auto& thread : threads)
+                thread.join();
+        };
+    });
+
+static BenchRegistrar messageQueue("runtime/message_queue", [] (BenchContext& context) -> bench_body_t
+    {
+        auto queue = std::make_shared<MessageQueue>([] { });
+
+        return [queue, &context] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                queue->post([] { });
+
+            while (queue->drain()) { }
+
+            context.metrics["wakeups"] = queue->getStats().wakeups;
+        };
+    });
+
+// Schedule 100k timers spread over a minute of ticks, then expire them all.
+// Per timer.
+static BenchRegistrar timingWheel("runtime/timing_wheel_100k", [] (BenchContext&) -> bench_body_t
+    {
+        return [] (size_t iterations)
+        {
+            constexpr size_t timerCount = 100000;
+
+            std::mt19937 random(1);
+            std::uniform_int_distribution<uint64_t> deadlines(1, 60000);
+
+            for (size_t done = 0; done < iterations; done += timerCount)
+            {
+                const auto count = std::min(timerCount, iterations - done);
+
+                TimingWheel wheel;
+                std::vector<TimingWheel::Entry> entries(count);
+                size_t fired = 0;
+
+                for (auto& entry : entries)
+                {
+                    entry.callback = [&fired] { fired++; };
+                    wheel.schedule(entry, deadlines(random));
+                }
+
+                wheel.advance(60000);
+                bench_keep(fired);
+            }
+        };
+    });
+
+static BenchRegistrar poolPost("runtime/pool_post", [] (BenchContext&) -> bench_body_t
+    {
+        return [pool = std::make_shared<WorkerPool>()] (size_t iterations)
+        {
+            std::atomic<size_t> done = 0;
+
+            for (size_t i = 0; i < iterations; i++)
+                pool->post([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+
+            while (done.load(std::memory_order_acquire) < iterations)
+                if (! pool->tryRunOne())
+                    std::this_thread::yield();
+        };
+    });
+
+// Sums 1M floats per iteration in 16K chunks
+static BenchRegistrar poolParallelFor("runtime/pool_parallel_for_1M", [] (BenchContext& context) -> bench_body_t
+    {
+        auto pool = std::make_shared<WorkerPool>();
+        auto data = std::make_shared<std::vector<float>>(1024 * 1024, 1.0f);
+
+        context.bytesPerOp = data->size() * sizeof(float);
+
+        return [pool, data] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+            {
+                std::atomic<double> total = 0;
+
+                pool->parallelFor(0, data->size(), 16 * 1024, [&] (size_t begin, size_t end)
+                    {
+                        float sum = 0;
+
+                        for (auto j = begin; j < end; j++)
+                            sum += (*data)[j];
+
+                        total.fetch_add(sum, std::memory_order_relaxed);
+                    });
+
+                bench_keep(total);
+            }
+        };
+    });
+
+// Post and run a frame's worth of small tasks with a fake clock, per task
+static BenchRegistrar frameScheduler("runtime/frame_scheduler", [] (BenchContext&) -> bench_body_t
+    {
+        return [] (size_t iterations)
+        {
+            std::chrono::microseconds time{};
+            FrameScheduler frames([&time] { return time; }, [] (auto) { });
+
+            for (size_t i = 0; i < iterations; i++)
+                frames.post(TaskPriority((int) (i % 3)), [&time] { time += std::chrono::microseconds(1); });
+
+            while (frames.pending())
+            {
+                frames.runFrame();
+                time += frames.frameInterval;
+            }
+        };
+    });
+
+static BenchRegistrar inliner("runtime/inline_index_html", [] (BenchContext& context) -> bench_body_t
+    {
+        const std::string root = LOOKINGGLASS_APP_DIR "/";
+        auto html = file_read_string(root + "index.html").value_or("");
+
+        context.bytesPerOp = html.size();
+
+        return [html, root] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(inline_critical_assets(html, [&root] (const std::string& path) { return file_read_string(root + path); }));
+        };
+    });
+
+static BenchRegistrar histogramRecord("runtime/histogram_record", [] (BenchContext&) -> bench_body_t
+    {
+        return [histogram = std::make_shared<LatencyHistogram>()] (size_t iterations)
+        {
+            uint64_t value = 12345;
+
+            for (size_t i = 0; i < iterations; i++)
+            {
+                value = value * 6364136223846793005ull + 1442695040888963407ull;
+                histogram->record(value >> 40);
+            }
+        };
+    });
+
+static BenchRegistrar websocketMask("runtime/websocket_mask_64K", [] (BenchContext& context) -> bench_body_t
+    {
+        auto data = std::make_shared<std::vector<uint8_t>>(64 * 1024, 0x5a);
+        context.bytesPerOp = data->size();
+
+        return [data] (size_t iterations)
+        {
+            const uint8_t key[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+            for (size_t i = 0; i < iterations; i++)
+                websocket_mask(data->data(), data->size(), key);
+
+            bench_keep(*data);
+        };
+    });
+
+// A masked 1K client frame, parsed and unmasked
+static BenchRegistrar websocketParse("runtime/websocket_parse_1K", [] (BenchContext& context) -> bench_body_t
+    {
+        const uint8_t key[4] = { 1, 2, 3, 4 };
+        auto frame = encode_websocket_frame(WebSocketOpcode::text, std::string(1024, 'x'), key);
+
+        context.bytesPerOp = frame.size();
+
+        return [frame] (size_t iterations)
+        {
+            std::string buffer;
+            WebSocketFrame parsed;
+
+            for (size_t i = 0; i < iterations; i++)
+            {
+                buffer = frame;
+                bench_keep(parse_websocket_frame(buffer, 0, parsed));
+            }
+        };
+    });
@@ -0,0 +1,290 @@
+#include "bench.h"
+#include "vfs.h"
+#include "zipmount.h"
+#include "fileio.h"
+
+#include <zlib.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+// Two folders over the embedded bundle, the way the app stacks an override
+// folder on its assets. Files live in every layer so hits resolve at each depth.
+struct TempLayers
+{
+    TempLayers()
+    {
+        const auto base = std::filesystem::temp_directory_path() / "lookingglass_bench_vfs";
+
+        for (auto layer : { "top", "bottom" })
+        {
+            auto dir = (base / layer).string();
+            std::filesystem::create_directories(dir + "/js");
+            dirs.push_back(dir);
+        }
+
+        std::ofstream(dirs[0] + "/js/top.js") << "top";
+        std::ofstream(dirs[1] + "/js/bottom.js") << "bottom";
+    }
+
+    ~TempLayers()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(std::filesystem::path(dirs[0]).parent_path(), ec);
+    }
+
+    auto mount(Vfs& vfs) const -> void
+    {
+        auto embedded = std::make_unique<EmbeddedMount>();
+        embedded->add("js/embedded.js", "embedded");
+
+        vfs.mount(std::make_unique<DirectoryMount>(dirs[0]));
+        vfs.mount(std::make_unique<DirectoryMount>(dirs[1]));
+        vfs.mount(std::move(embedded));
+    }
+
+    std::vector<std::string> dirs;
+};
+
+// Resolving one path per op. A zero ttl turns the cache off for the folder
+// layers, which is the cost of probing every mount in turn.
+static auto lookup_bench(std::string path, bool cached) -> bench_setup_t
+{
+    return [path = std::move(path), cached] (BenchContext& context) -> bench_body_t
+    {
+        auto layers = std::make_shared<TempLayers>();
+        auto vfs    = std::make_shared<Vfs>(VfsOptions{ cached ? std::chrono::milliseconds(60'000) : std::chrono::milliseconds(0) });
+
+        layers->mount(*vfs);
+
+        return [layers, vfs, path, &context] (size_t iterations)
+        {
+            const auto before = vfs->getStats();
+
+            for (size_t i = 0; i < iterations; i++)
+                bench_keep(vfs->stat(path));
+
+            const auto after = vfs->getStats();
+
+            context.metrics["probesPerOp"] = (double) (after.probes - before.probes) / (double) iterations;
+            context.metrics["hitRate"]     = (double) (after.hits - before.hits) / (double) iterations;
+        };
+    };
+}
+
+static BenchRegistrar vfsHitTop("vfs/lookup_cached/top", lookup_bench("js/top.js", true));
+static BenchRegistrar vfsHitEmbedded("vfs/lookup_cached/embedded", lookup_bench("js/embedded.js", true));
+static BenchRegistrar vfsMiss("vfs/lookup_cached/missing", lookup_bench("js/missing.js", true));
+static BenchRegistrar vfsHitTopUncached("vfs/lookup_uncached/top", lookup_bench("js/top.js", false));
+static BenchRegistrar vfsHitEmbeddedUncached("vfs/lookup_uncached/embedded", lookup_bench("js/embedded.js", false));
+static BenchRegistrar vfsMissUncached("vfs/lookup_uncached/missing", lookup_bench("js/missing.js", false));
+
+// Filling the cache for a folder of files up front
+static BenchRegistrar vfsPrecompute("vfs/precompute/256", [] (BenchContext&) -> bench_body_t
+    {
+        auto layers = std::make_shared<TempLayers>();
+
+        for (int i = 0; i < 256; i++)
+            std::ofstream(layers->dirs[1] + "/js/file" + std::to_string(i) + ".js") << i;
+
+        return [layers] (size_t iterations)
+        {
+            for (size_t i = 0; i < iterations; i++)
+            {
+                Vfs vfs;
+                layers->mount(vfs);
+                vfs.precompute();
+                bench_keep(vfs.getStats());
+            }
+        };
+    });
+
+// Enough of a zip writer for the benchmarks: no timestamps, no zip64
+static auto write_zip(const std::string& path, const std::vector<std::pair<std::string, std::string>>& files, bool deflated) -> void
+{
+    std::string archive, directory;
+
+    auto put16 = [] (std::string& out, uint16_t value) { out += (char) value; out += (char) (value >> 8); };
+    auto put32 = [&put16] (std::string& out, uint32_t value) { put16(out, (uint16_t) value); put16(out, (uint16_t) (value >> 16)); };
+
+    for (const auto& [name, data] : files)
+    {
+        auto body = data;
+
+        if (deflated)
+        {
+            z_stream stream{};
+            deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+            body.resize(deflateBound(&stream, (uLong) data.size()));
+            stream.next_in   = (Bytef*) data.data();
+            stream.avail_in  = (uInt) data.size();
+            stream.next_out  = (Bytef*) body.data();
+            stream.avail_out = (uInt) body.size();
+
+            deflate(&stream, Z_FINISH);
+            body.resize(stream.total_out);
+            deflateEnd(&stream);
+        }
+
+        const auto crc    = (uint32_t) crc32(0, (const Bytef*) data.data(), (uInt) data.size());
+        const auto offset = (uint32_t) archive.size();
+
+        for (auto* out : { &archive, &directory })
+        {
+            put32(*out, out == &archive ? 0x04034b50 : 0x02014b50);
+
+            if (out == &directory)
+                put16(*out, 20);
+
+            put16(*out, 20);
+            put16(*out, 0);
+            put16(*out, deflated ? 8 : 0);
+            put16(*out, 0);
+            put16(*out, 0x21);
+            put32(*out, crc);
+            put32(*out, (uint32_t) body.size());
+            put32(*out, (uint32_t) data.size());
+            put16(*out, (uint16_t) name.size());
+            put16(*out, 0);
+
+            if (out == &directory)
+            {
+                put16(*out, 0);
+                put16(*out, 0);
+                put16(*out, 0);
+                put32(*out, 0);
+                put32(*out, offset);
+            }
+
+            *out += name;
+        }
+
+        archive += body;
+    }
+
+    const auto directoryOffset = (uint32_t) archive.size();
+    archive += directory;
+
+    put32(archive, 0x06054b50);
+    put16(archive, 0);
+    put16(archive, 0);
+    put16(archive, (uint16_t) files.size());
+    put16(archive, (uint16_t) files.size());
+    put32(archive, (uint32_t) directory.size());
+    put32(archive, directoryOffset);
+    put16(archive, 0);
+
+    std::ofstream(path, std::ios::binary) << archive;
+}
+
+// An app's worth of small scripts and stylesheets, as loose files and as
+// stored and deflated zips of the same files
+struct TempAssets
+{
+    static constexpr size_t count = 256;
+
+    TempAssets()
+    {
+        const auto base = std::filesystem::temp_directory_path() / "lookingglass_bench_assets";
+        std::filesystem::create_directories(base / "app/js");
+
+        dir = (base / "app").string();
+        std::vector<std::pair<std::string, std::string>> files;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            auto name = "js/module" + std::to_string(i) + (i % 4 ? ".js" : ".css");
+            std::string text;
+
+            while (text.size() < 1024 + (i * 97) % (7 * 1024))
+                text += "export function handler" + std::to_string(text.size()) + "(event) { return event.detail ?? null; }\n";
+
+            std::ofstream(dir + "/" + name) << text;
+            bytes += text.size();
+            files.push_back({ name, std::move(text) });
+            names.push_back(std::move(name));
+        }
+
+        stored   = (base / "stored.zip").string();
+        deflated = (base / "deflated.zip").string();
+
+        write_zip(stored, files, false);
+        write_zip(deflated, files, true);
+    }
+
+    ~TempAssets()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(std::filesystem::path(dir).parent_path(), ec);
+    }
+
+    std::string dir, stored, deflated;
+    std::vector<std::string> names;
+    size_t bytes = 0;
+};
+
+// Serving every one of the assets once. Cold mounts them afresh each time,
+// as on a launch; warm serves them again from the same mount, from the
+// cache of inflated entries. Loose files are read the way file responses
+// get read; archive entries are served from the view, touching each page
+// as a write to the socket would.
+static auto serve_bench(std::string TempAssets::* source, bool cold) -> bench_setup_t
+{
+    return [source, cold] (BenchContext& context) -> bench_body_t
+    {
+        auto assets        = std::make_shared<TempAssets>();
+        context.bytesPerOp = assets->bytes;
+
+        auto mount = [assets, source] (Vfs& vfs)
+        {
+            if (source == &TempAssets::dir)
+                vfs.mount(std::make_unique<DirectoryMount>(assets->dir));
+            else
+                vfs.mount(ZipMount::open((*assets).*source));
+        };
+
+        auto warm = std::make_shared<Vfs>();
+        mount(*warm);
+
+        return [assets, warm, mount, cold, &context] (size_t iterations)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            for (size_t i = 0; i < iterations; i++)
+            {
+                auto vfs = cold ? std::make_shared<Vfs>() : warm;
+
+                if (cold)
+                    mount(*vfs);
+
+                for (const auto& name : assets->names)
+                {
+                    if (auto path = vfs->filepath(name); ! path.empty())
+                    {
+                        bench_keep(file_read_bytes(path));
+                    }
+                    else if (auto view = vfs->view(name))
+                    {
+                        uint8_t touched = 0;
+
+                        for (size_t at = 0; at < view->bytes.size(); at += 4096)
+                            touched ^= view->bytes[at];
+
+                        bench_keep(touched);
+                    }
+                }
+            }
+
+            const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+            context.metrics["usPerRequest"] = elapsed.count() / (double) iterations / (double) TempAssets::count;
+        };
+    };
+}
+
+static BenchRegistrar vfsColdLoose("vfs/cold_start/loose_256", serve_bench(&TempAssets::dir, true));
+static BenchRegistrar vfsColdStored("vfs/cold_start/zip_stored_256", serve_bench(&TempAssets::stored, true));
+static BenchRegistrar vfsColdDeflated("vfs/cold_start/zip_deflated_256", serve_bench(&TempAssets::deflated, true));
+static BenchRegistrar vfsWarmLoose("vfs/warm/loose_256", serve_bench(&TempAssets::dir, false));
+static BenchRegistrar vfsWarmDeflated("vfs/warm/zip_deflated_256", serve_bench(&TempAssets::deflated, false));
@@ -0,0 +1,223 @@
+#include "stats.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// lookingglass_bench_compare [--threshold percent] [--alpha p] baseline current
+//
+// baseline is a results file from lookingglass_bench --out, or a --history
+// directory, in which case its newest run other than current is used (the
+// copy of current that the same --history run wrote doesn't count).
+// Exits with 1 when a benchmark got slower by more than the threshold and
+// Mann-Whitney says the slowdown is significant.
+
+struct CompareOptions
+{
+    double threshold = 10.0;
+    double alpha     = 0.05;
+    std::string baseline;
+    std::string current;
+};
+
+static auto read_results(const std::string& path) -> std::optional<nlohmann::json>
+{
+    std::ifstream file(path);
+    auto json = nlohmann::json::parse(file, nullptr, false);
+
+    if (json.is_discarded() || ! json.contains("benchmarks"))
+        return std::nullopt;
+
+    return json;
+}
+
+// The run an environment block describes, history copies keep it
+static auto same_run(const nlohmann::json& a, const nlohmann::json& b) -> bool
+{
+    const auto first  = a.value("environment", nlohmann::json::object());
+    const auto second = b.value("environment", nlohmann::json::object());
+
+    return first.value("timestamp", "") == second.value("timestamp", "")
+        && first.value("commit", "") == second.value("commit", "")
+        && first.value("host", "") == second.value("host", "");
+}
+
+// History files are named by timestamp, newest is tried first. The copy
+// --history made of current itself is skipped, whatever it's called.
+static auto latest_in_history(const std::string& directory, const std::string& currentPath, const nlohmann::json& current) -> std::optional<std::string>
+{
+    std::error_code ec;
+    std::vector<std::filesystem::path> paths;
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+        if (entry.path().extension() == ".json" && ! std::filesystem::equivalent(entry.path(), currentPath, ec))
+            paths.push_back(entry.path());
+
+    std::sort(paths.begin(), paths.end(), [] (const auto& a, const auto& b) { return a.filename() > b.filename(); });
+
+    for (const auto& path : paths)
+    {
+        const auto results = read_results(path.string());
+
+        if (! results || ! same_run(*results, current))
+            return path.string();
+    }
+
+    return std::nullopt;
+}
+
+static auto samples_of(const nlohmann::json& benchmark) -> std::vector<double>
+{
+    return benchmark.value("samplesNs", std::vector<double>{});
+}
+
+// Differences that make the numbers incomparable rather than regressed
+static auto warn_environment(const nlohmann::json& baseline, const nlohmann::json& current) -> void
+{
+    const auto a = baseline.value("environment", nlohmann::json::object());
+    const auto b = current.value("environment", nlohmann::json::object());
+
+    for (const auto key : { "cpu", "hardwareConcurrency", "compiler", "buildType", "os" })
+        if (a.value(key, nlohmann::json()) != b.value(key, nlohmann::json()))
+            printf("warning: %s differs: %s vs %s\n", key, a.value(key, nlohmann::json()).dump().c_str(), b.value(key, nlohmann::json()).dump().c_str());
+
+    if (b.value("governor", "") != "" && b.value("governor", "") != "performance")
+        printf("warning: cpu governor is %s, expect noisy timings\n", b.value("governor", "").c_str());
+}
+
+static auto parse_options(int argc, const char** argv, CompareOptions& options) -> bool
+{
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+
+        if ((arg == "--threshold" || arg == "--alpha") && i + 1 < argc)
+        {
+            (arg == "--threshold" ? options.threshold : options.alpha) = std::atof(argv[++i]);
+            continue;
+        }
+
+        if (arg.starts_with("--"))
+            return false;
+
+        paths.emplace_back(arg);
+    }
+
+    if (paths.size() != 2)
+        return false;
+
+    options.baseline = paths[0];
+    options.current  = paths[1];
+
+    return true;
+}
+
+auto main(int argc, const char** argv) -> int
+{
+    CompareOptions options;
+
+    if (! parse_options(argc, argv, options))
+    {
+        printf("usage: %s [--threshold percent] [--alpha p] baseline.json|history-dir current.json\n", argv[0]);
+        return 2;
+    }
+
+    const auto current = read_results(options.current);
+
+    if (! current)
+    {
+        printf("Error: can't read %s\n", options.current.c_str());
+        return 2;
+    }
+
+    if (std::error_code ec; std::filesystem::is_directory(options.baseline, ec))
+    {
+        auto latest = latest_in_history(options.baseline, options.current, *current);
+
+        if (! latest)
+        {
+            printf("No baseline in %s yet\n", options.baseline.c_str());
+            return 0;
+        }
+
+        options.baseline = *latest;
+    }
+
+    const auto baseline = read_results(options.baseline);
+
+    if (! baseline)
+    {
+        printf("Error: can't read %s\n", options.baseline.c_str());
+        return 2;
+    }
+
+    const auto commit = baseline->value("environment", nlohmann::json::object()).value("commit", "");
+    printf("baseline: %s%s%s\n", options.baseline.c_str(), commit.empty() ? "" : " at ", commit.c_str());
+
+    warn_environment(*baseline, *current);
+
+    std::map<std::string, const nlohmann::json*> before;
+
+    for (const auto& benchmark : (*baseline)["benchmarks"])
+        before[benchmark.value("name", "")] = &benchmark;
+
+    size_t regressions = 0;
+
+    printf("%-40s %14s %14s %8s %9s\n", "benchmark", "baseline ns", "current ns", "change", "p");
+
+    for (const auto& benchmark : (*current)["benchmarks"])
+    {
+        const auto name = benchmark.value("name", "");
+        const auto it   = before.find(name);
+
+        if (it == before.end())
+        {
+            printf("%-40s %14s %14.1f %8s\n", name.c_str(), "-", median_of(samples_of(benchmark)), "new");
+            continue;
+        }
+
+        const auto a = samples_of(*it->second);
+        const auto b = samples_of(benchmark);
+
+        const auto medianA = median_of(a);
+        const auto medianB = median_of(b);
+        const auto change  = medianA > 0 ? 100.0 * (medianB - medianA) / medianA : 0.0;
+        const auto test    = mann_whitney(a, b);
+
+        const char* verdict = "";
+
+        if (change > options.threshold && test.pGreater < options.alpha)
+        {
+            verdict = "REGRESSION";
+            regressions++;
+        }
+        else if (change < -options.threshold && test.pLess < options.alpha)
+        {
+            verdict = "faster";
+        }
+
+        printf("%-40s %14.1f %14.1f %+7.1f%% %9.2g %s\n", name.c_str(), medianA, medianB, change,
+               change >= 0 ? test.pGreater : test.pLess, verdict);
+
+        before.erase(it);
+    }
+
+    for (const auto& [name, benchmark] : before)
+        printf("%-40s %14.1f %14s %8s\n", name.c_str(), median_of(samples_of(*benchmark)), "-", "gone");
+
+    if (regressions)
+        printf("%zu regression(s) above %.1f%% at p < %.3g\n", regressions, options.threshold, options.alpha);
+
+    return regressions ? 1 : 0;
+}
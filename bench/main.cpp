@@ -0,0 +1,326 @@
+#include "bench.h"
+
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+struct BenchOptions
+{
+    std::string filter;
+    std::string output;
+    std::string history;
+    size_t samples = 10;
+    std::chrono::nanoseconds minSampleTime = std::chrono::milliseconds(50);
+    bool list = false;
+};
+
+auto benchmarks() -> std::vector<Benchmark>&
+{
+    static std::vector<Benchmark> registry;
+    return registry;
+}
+
+// First line a command prints, empty if it failed
+static auto command_output(const std::string& command) -> std::string
+{
+    std::string line;
+
+    if (auto pipe = popen(command.c_str(), "r"))
+    {
+        char buffer[256];
+
+        if (fgets(buffer, sizeof(buffer), pipe))
+            line = buffer;
+
+        pclose(pipe);
+    }
+
+    while (! line.empty() && (line.back() == '\n' || line.back() == '\r'))
+        line.pop_back();
+
+    return line;
+}
+
+static auto file_first_line(const char* path, std::string_view prefix = {}) -> std::string
+{
+    std::ifstream file(path);
+
+    for (std::string line; std::getline(file, line);)
+        if (line.starts_with(prefix))
+        {
+            auto value = line.substr(prefix.size());
+            return value.substr(std::min(value.find_first_not_of(" \t:"), value.size()));
+        }
+
+    return {};
+}
+
+static auto cpu_model() -> std::string
+{
+#if defined(__APPLE__)
+    char brand[256]{};
+    size_t size = sizeof(brand);
+
+    if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) == 0)
+        return brand;
+#else
+    if (auto model = file_first_line("/proc/cpuinfo", "model name"); ! model.empty())
+        return model;
+#endif
+
+    utsname name{};
+    uname(&name);
+
+    return name.machine;
+}
+
+// What the numbers were measured on, so comparisons can tell a regression
+// from a different machine or build
+static auto bench_environment() -> nlohmann::json
+{
+    utsname name{};
+    uname(&name);
+
+    char host[256]{};
+    gethostname(host, sizeof(host) - 1);
+
+    char timestamp[32]{};
+    const auto now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    const std::string git = "git -C \"" LOOKINGGLASS_SOURCE_DIR "\" ";
+    auto commit = command_output(git + "rev-parse --short HEAD 2>/dev/null");
+
+    if (! commit.empty() && ! command_output(git + "status --porcelain --untracked-files=no 2>/dev/null").empty())
+        commit += "-dirty";
+
+#if defined(__clang__)
+    const auto compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    const auto compiler = "gcc " __VERSION__;
+#else
+    const auto compiler = "unknown";
+#endif
+
+#if defined(NDEBUG)
+    const auto assertions = false;
+#else
+    const auto assertions = true;
+#endif
+
+    return {
+        { "timestamp",           timestamp },
+        { "commit",              commit },
+        { "host",                host },
+        { "os",                  std::string(name.sysname) + " " + name.release + " " + name.machine },
+        { "cpu",                 cpu_model() },
+        { "hardwareConcurrency", std::thread::hardware_concurrency() },
+        { "governor",            file_first_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor") },
+        { "compiler",            compiler },
+        { "buildType",           LOOKINGGLASS_BUILD_TYPE[0] ? LOOKINGGLASS_BUILD_TYPE : "unspecified" },
+        { "assertions",          assertions }
+    };
+}
+
+// history/20261018T120000Z-1a2b3c4.json, names sort oldest first
+static auto history_path(const std::string& directory, const nlohmann::json& environment) -> std::string
+{
+    auto stamp = environment["timestamp"].get<std::string>();
+    std::erase(stamp, '-');
+    std::erase(stamp, ':');
+
+    const auto commit = environment["commit"].get<std::string>();
+    return (std::filesystem::path(directory) / (stamp + "-" + (commit.empty() ? "nogit" : commit) + ".json")).string();
+}
+
+static auto write_results(const std::string& path, const nlohmann::json& results) -> bool
+{
+    std::ofstream file(path);
+
+    if (! (file << results.dump(2) << "\n"))
+    {
+        printf("Error: can't write %s\n", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static auto time_body(const bench_body_t& body, size_t iterations) -> std::chrono::nanoseconds
+{
+    const auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    return std::chrono::steady_clock::now() - start;
+}
+
+// Grows the iteration count until one sample takes at least minSampleTime
+static auto calibrate(const bench_body_t& body, std::chrono::nanoseconds minSampleTime) -> size_t
+{
+    size_t iterations = 1;
+
+    for (;;)
+    {
+        const auto elapsed = time_body(body, iterations);
+
+        if (elapsed >= minSampleTime || iterations >= (size_t(1) << 32))
+            return iterations;
+
+        const auto scale = elapsed.count() > 0 ? 1.2 * (double) minSampleTime.count() / (double) elapsed.count() : 10.0;
+        iterations = std::max(iterations + 1, (size_t) ((double) iterations * std::clamp(scale, 2.0, 10.0)));
+    }
+}
+
+static auto run_benchmark(const Benchmark& benchmark, const BenchOptions& options) -> nlohmann::json
+{
+    BenchContext context;
+    auto body = benchmark.setup(context);
+
+    const auto iterations = calibrate(body, options.minSampleTime);
+    std::vector<double> samples;
+
+    for (size_t i = 0; i < options.samples; i++)
+        samples.push_back((double) time_body(body, iterations).count() / (double) iterations);
+
+    body = nullptr;
+
+    auto sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    const auto count  = sorted.size();
+    const auto median = count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+
+    double mean = 0;
+
+    for (auto sample : samples)
+        mean += sample / (double) count;
+
+    double variance = 0;
+
+    for (auto sample : samples)
+        variance += (sample - mean) * (sample - mean) / (double) std::max<size_t>(count - 1, 1);
+
+    nlohmann::json result = {
+        { "name",       benchmark.name },
+        { "iterations", iterations },
+        { "samplesNs",  samples },
+        { "medianNs",   median },
+        { "meanNs",     mean },
+        { "minNs",      sorted.front() },
+        { "stddevNs",   std::sqrt(variance) },
+        { "metrics",    context.metrics }
+    };
+
+    if (context.bytesPerOp)
+        result["mbPerSec"] = (double) context.bytesPerOp / median * 1e9 / (1024.0 * 1024.0);
+
+    printf("%-40s %14.1f ns/op  +-%5.1f%%", benchmark.name.c_str(), median, mean > 0 ? 100.0 * std::sqrt(variance) / mean : 0.0);
+
+    if (context.bytesPerOp)
+        printf("  %10.1f MB/s", result["mbPerSec"].get<double>());
+
+    printf("\n");
+    fflush(stdout);
+
+    return result;
+}
+
+static auto parse_options(int argc, const char** argv, BenchOptions& options) -> bool
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        const auto value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (arg == "--list")
+        {
+            options.list = true;
+            continue;
+        }
+
+        if (! value)
+            return false;
+
+        if (arg == "--filter")
+            options.filter = value;
+        else if (arg == "--out")
+            options.output = value;
+        else if (arg == "--history")
+            options.history = value;
+        else if (arg == "--samples")
+            options.samples = std::max(1, std::atoi(value));
+        else if (arg == "--min-time")
+            options.minSampleTime = std::chrono::milliseconds(std::max(1, std::atoi(value)));
+        else
+            return false;
+
+        i++;
+    }
+
+    return true;
+}
+
+// lookingglass_bench [--filter substring] [--samples n] [--min-time ms] [--out results.json]
+//                    [--history dir] [--list]
+//
+// --history keeps a timestamped copy of the results in dir for
+// lookingglass_bench_compare to use as the baseline of the next run.
+auto main(int argc, const char** argv) -> int
+{
+    BenchOptions options;
+
+    if (! parse_options(argc, argv, options))
+    {
+        printf("usage: %s [--filter substring] [--samples n] [--min-time ms] [--out results.json] [--history dir] [--list]\n", argv[0]);
+        return 1;
+    }
+
+    auto& registry = benchmarks();
+    std::sort(registry.begin(), registry.end(), [] (auto& a, auto& b) { return a.name < b.name; });
+
+    auto results = nlohmann::json::array();
+
+    for (const auto& benchmark : registry)
+    {
+        if (! options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+            continue;
+
+        if (options.list)
+            printf("%s\n", benchmark.name.c_str());
+        else
+            results.push_back(run_benchmark(benchmark, options));
+    }
+
+    if (options.list)
+        return 0;
+
+    const nlohmann::json document = { { "environment", bench_environment() }, { "benchmarks", results } };
+
+    if (! options.output.empty() && ! write_results(options.output, document))
+        return 1;
+
+    if (! options.history.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(options.history, ec);
+
+        if (! write_results(history_path(options.history, document["environment"]), document))
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Null distribution of U for sample sizes n and m, as counts per value of U.
+// counts(n, m, u) = counts(n - 1, m, u - m) + counts(n, m - 1, u)
+static auto u_distribution(size_t n, size_t m) -> std::vector<double>
+{
+    // table[j][u] holds counts for (i, j) as i goes from 0 to n
+    std::vector<std::vector<double>> table(m + 1);
+
+    for (size_t j = 0; j <= m; j++)
+        table[j] = { 1.0 };
+
+    for (size_t i = 1; i <= n; i++)
+    {
+        std::vector<std::vector<double>> next(m + 1);
+        next[0] = { 1.0 };
+
+        for (size_t j = 1; j <= m; j++)
+        {
+            next[j].assign(i * j + 1, 0.0);
+
+            for (size_t u = 0; u < table[j].size(); u++)
+                next[j][u + j] += table[j][u];
+
+            for (size_t u = 0; u < next[j - 1].size(); u++)
+                next[j][u] += next[j - 1][u];
+        }
+
+        table = std::move(next);
+    }
+
+    return table[m];
+}
+
+auto mann_whitney(const std::vector<double>& a, const std::vector<double>& b) -> MannWhitney
+{
+    MannWhitney result;
+
+    const auto n = a.size();
+    const auto m = b.size();
+
+    if (n == 0 || m == 0)
+        return result;
+
+    // Rank the pooled samples, ties get their average rank
+    std::vector<std::pair<double, bool>> pooled;
+
+    for (auto value : a)
+        pooled.push_back({ value, false });
+
+    for (auto value : b)
+        pooled.push_back({ value, true });
+
+    std::sort(pooled.begin(), pooled.end(), [] (auto& x, auto& y) { return x.first < y.first; });
+
+    double rankSumB = 0;
+    double tieTerm  = 0;
+
+    for (size_t i = 0; i < pooled.size();)
+    {
+        auto j = i;
+
+        while (j < pooled.size() && pooled[j].first == pooled[i].first)
+            j++;
+
+        const auto rank = (double) (i + j + 1) / 2.0;
+        const auto ties = (double) (j - i);
+
+        for (auto k = i; k < j; k++)
+            if (pooled[k].second)
+                rankSumB += rank;
+
+        tieTerm += ties * ties * ties - ties;
+        i = j;
+    }
+
+    result.u = rankSumB - (double) (m * (m + 1)) / 2.0;
+
+    if (tieTerm == 0 && n * m <= 400)
+    {
+        const auto counts = u_distribution(n, m);
+        const auto total  = std::accumulate(counts.begin(), counts.end(), 0.0);
+        const auto u      = (size_t) result.u;
+
+        result.pGreater = std::accumulate(counts.begin() + (long) u, counts.end(), 0.0) / total;
+        result.pLess    = std::accumulate(counts.begin(), counts.begin() + (long) u + 1, 0.0) / total;
+        result.exact    = true;
+
+        return result;
+    }
+
+    const auto count    = (double) (n + m);
+    const auto mean     = (double) (n * m) / 2.0;
+    const auto variance = (double) (n * m) / 12.0 * ((count + 1) - tieTerm / (count * (count - 1)));
+
+    if (variance <= 0)
+        return result;
+
+    const auto sigma = std::sqrt(variance);
+
+    result.pGreater = 0.5 * std::erfc((result.u - mean - 0.5) / sigma / std::sqrt(2.0));
+    result.pLess    = 0.5 * std::erfc((mean - result.u - 0.5) / sigma / std::sqrt(2.0));
+
+    return result;
+}
+
+auto median_of(std::vector<double> values) -> double
+{
+    if (values.empty())
+        return 0;
+
+    std::sort(values.begin(), values.end());
+
+    const auto count = values.size();
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+struct MannWhitney
+{
+    double u = 0;        // pairs where the second sample is larger, ties count half
+    double pGreater = 1; // one-sided p that the second sample tends to be larger
+    double pLess = 1;    // and that it tends to be smaller
+    bool exact = false;
+};
+
+// Mann-Whitney U test of b against a. Exact for small samples without
+// ties, normal approximation with tie and continuity correction otherwise.
+auto mann_whitney(const std::vector<double>& a, const std::vector<double>& b) -> MannWhitney;
+
+auto median_of(std::vector<double> values) -> double;
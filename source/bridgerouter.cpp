@@ -0,0 +1,213 @@
+#include "bridgerouter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// "[id, ...]" -> id, and the ", ...]" after it
+static auto split_id(std::string_view content, int64_t& id) -> std::optional<std::string_view>
+{
+    if (content.empty() || content.front() != '[')
+        return std::nullopt;
+
+    const auto [end, error] = std::from_chars(content.data() + 1, content.data() + content.size(), id);
+
+    if (error != std::errc())
+        return std::nullopt;
+
+    return content.substr((size_t) (end - content.data()));
+}
+
+BridgeRouter::BridgeRouter(WebViewInterface& app, send_t&& send) : app(app), sendText(std::move(send))
+{
+}
+
+auto BridgeRouter::onMessage(client_t client, const nlohmann::json& message) -> bool
+{
+    auto& page = pages[client];
+    std::optional<ScriptMessage> call;
+
+    try
+    {
+        call = decode_script_message(page.shapes, message);
+    }
+    catch (const std::exception&)
+    {
+    }
+
+    // Let the app turn it down the way it turns down any bad call
+    if (! call || call->name.empty())
+        return app.onScriptMessage(message);
+
+    const auto& name = call->name;
+    auto content     = call->content ? *call->content : nlohmann::json();
+    int64_t job      = 0;
+
+    try
+    {
+        // Shapes stay with the page that registered them, the app only sees objects
+        if (name == "__shape")
+            return page.shapes.add(content.at(0).get<uint32_t>(), content.at(1).get<std::vector<std::string>>());
+
+        // Sent as each document starts, after its shapes: only its calls are given up on
+        if (name == "__bridgeStart")
+        {
+            forget(client, "page reloaded");
+            return true;
+        }
+
+        if (name == "__jobStart")
+        {
+            job       = nextJob++;
+            jobs[job] = { client, content.at(0).get<int64_t>() };
+
+            content[0] = job;
+        }
+        else if (name == "__jobCancel")
+        {
+            const auto local = content.at(0).get<int64_t>();
+            const auto it    = std::find_if(jobs.begin(), jobs.end(), [client, local] (const auto& entry)
+                {
+                    return entry.second.client == client && entry.second.id == local;
+                });
+
+            // Over already, or never started
+            if (it == jobs.end())
+                return true;
+
+            content[0] = it->first;
+        }
+        else if (name == "__scriptResult")
+        {
+            scriptCalls.erase(content.at(0).get<int64_t>());
+        }
+    }
+    catch (const std::exception&)
+    {
+        jobs.erase(job);
+        return app.onScriptMessage(message);
+    }
+
+    int64_t id = 0;
+
+    if (call->id > 0)
+    {
+        id          = nextInvoke++;
+        invokes[id] = { client, call->id };
+    }
+
+    const auto handled = forward(client, name, std::move(content), id);
+
+    // Turned down, nothing is coming back for it
+    if (! handled)
+    {
+        invokes.erase(id);
+        jobs.erase(job);
+    }
+
+    return handled;
+}
+
+auto BridgeRouter::onClose(client_t client) -> void
+{
+    forget(client, "page closed");
+    pages.erase(client);
+}
+
+auto BridgeRouter::sendMessage(const std::string& name, const std::string& content) -> void
+{
+    if (name == "__reply" || name == "__reject")
+        return sendRouted(invokes, name, content, true);
+
+    if (name == "__jobEvent")
+    {
+        int64_t id = 0;
+        const auto rest = split_id(content, id);
+
+        return sendRouted(jobs, name, content, ! rest || ! rest->starts_with(", \"progress\""));
+    }
+
+    // Made while a page's message was handled: that page answers it. Made
+    // on the app's own account: every page is asked and the first answer wins.
+    if (name == "__callFromNative" && current)
+    {
+        const auto call = nlohmann::json::parse(content, nullptr, false);
+
+        if (call.is_array() && call.size() > 1 && call[0].is_number_integer() && call[1].is_string())
+            scriptCalls[call[0].get<int64_t>()] = { current, call[1].get<std::string>() };
+    }
+
+    send(name == "__channelBatch" ? 0 : current, name, content);
+}
+
+auto BridgeRouter::forget(client_t client, const std::string& error) -> void
+{
+    std::vector<int64_t> cancelled;
+    std::vector<std::pair<int64_t, std::string>> failed;
+
+    for (auto it = jobs.begin(); it != jobs.end();)
+    {
+        if (it->second.client != client)
+        {
+            ++it;
+            continue;
+        }
+
+        cancelled.push_back(it->first);
+        it = jobs.erase(it);
+    }
+
+    for (auto it = scriptCalls.begin(); it != scriptCalls.end();)
+    {
+        if (it->second.client != client)
+        {
+            ++it;
+            continue;
+        }
+
+        failed.emplace_back(it->first, std::move(it->second.function));
+        it = scriptCalls.erase(it);
+    }
+
+    std::erase_if(invokes, [client] (const auto& entry) { return entry.second.client == client; });
+
+    for (auto job : cancelled)
+        forward(0, "__jobCancel", nlohmann::json::array({ job }), 0);
+
+    for (auto& [id, function] : failed)
+        forward(0, "__scriptResult", nlohmann::json::array({ id, nullptr, function + ": " + error }), 0);
+}
+
+auto BridgeRouter::forward(client_t client, const std::string& name, nlohmann::json content, int64_t id) -> bool
+{
+    const auto previous = std::exchange(current, client);
+    const auto handled  = app.onScriptMessage({ { "name", name }, { "content", std::move(content) }, { "id", id ? nlohmann::json(id) : nlohmann::json() } });
+
+    current = previous;
+    return handled;
+}
+
+auto BridgeRouter::sendRouted(std::map<int64_t, Route>& routes, const std::string& name, const std::string& content, bool done) -> void
+{
+    int64_t id = 0;
+    const auto rest = split_id(content, id);
+    const auto it   = routes.find(id);
+
+    // Its page has gone or started over
+    if (! rest || it == routes.end())
+        return;
+
+    const auto route = it->second;
+
+    if (done)
+        routes.erase(it);
+
+    send(route.client, name, "[" + std::to_string(route.id) + std::string(*rest));
+}
+
+auto BridgeRouter::send(client_t client, const std::string& name, const std::string& content) -> void
+{
+    sendText(client, "{\"name\":" + nlohmann::json(name).dump() + ",\"content\":" + content + "}");
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "messageshapes.h"
+#include "webviewinterface.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+
+// Lets several pages share one app over the websocket bridge. Each page
+// numbers its invokes, jobs and shapes from the start, so on the way in
+// they're swapped for app-wide ones and on the way out back to the page's
+// own, and whatever answers a page's call goes to that page alone. Channel
+// batches are app state and go to every page.
+struct BridgeRouter
+{
+    using client_t = uint64_t;
+
+    // Client 0 means every client
+    using send_t = std::function<void(client_t client, const std::string& text)>;
+
+    BridgeRouter(WebViewInterface& app, send_t&& send);
+
+    // A message from a page, false if the app turned it down
+    auto onMessage(client_t client, const nlohmann::json& message) -> bool;
+
+    // The page's jobs are cancelled and native calls waiting on it fail
+    auto onClose(client_t client) -> void;
+
+    // Everything the app sends, see WebViewInterface::sendMessage
+    auto sendMessage(const std::string& name, const std::string& content) -> void;
+
+private:
+    struct Page
+    {
+        ShapeRegistry shapes;
+    };
+
+    // An app-wide id and the page it stands for
+    struct Route
+    {
+        client_t client = 0;
+        int64_t id      = 0;
+    };
+
+    struct ScriptCall
+    {
+        client_t client = 0;
+        std::string function;
+    };
+
+    auto forget(client_t client, const std::string& error) -> void;
+    auto forward(client_t client, const std::string& name, nlohmann::json content, int64_t id) -> bool;
+    auto sendRouted(std::map<int64_t, Route>& routes, const std::string& name, const std::string& content, bool done) -> void;
+    auto send(client_t client, const std::string& name, const std::string& content) -> void;
+
+    WebViewInterface& app;
+    send_t sendText;
+    std::map<client_t, Page> pages;
+    std::map<int64_t, Route> invokes;
+    std::map<int64_t, Route> jobs;
+    std::map<int64_t, ScriptCall> scriptCalls;
+    int64_t nextInvoke = 1;
+    int64_t nextJob    = 1;
+    client_t current   = 0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "executor.h"
+#include "timerscheduler.h"
+#include "webviewinterface.h"
+
+#include <functional>
+#include <memory>
+
+// The message thread's run loop. Every platform backend provides one: the
+// Cocoa run loop on macOS, epoll/eventfd/timerfd on Linux. post() may be
+// called from any thread, everything else belongs to the loop's thread.
+struct EventLoop : Executor
+{
+    virtual auto run() -> void = 0;
+    virtual auto quit() -> void = 0;
+    virtual auto makeTimer(int milliseconds, std::function<void()>&& function, TimerMode mode) -> std::unique_ptr<Timer> = 0;
+    virtual auto getTimers() -> TimerScheduler& = 0;
+};
+
+// The loop driving the message thread, owned by the platform backend
+auto getMessageLoop() -> EventLoop&;
@@ -0,0 +1,142 @@
+#include "eventloop_linux.h"
+#include "webviewinterface.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+
+static auto monotonicMilliseconds() -> uint64_t
+{
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+EpollEventLoop::EpollEventLoop()
+    : queue([this]
+        {
+            uint64_t one = 1;
+            [[maybe_unused]] auto n = write(wakeFd, &one, sizeof(one));
+        }),
+      timers(monotonicMilliseconds, [this] (std::optional<uint64_t> wakeAt)
+        {
+            // Absolute CLOCK_MONOTONIC deadline, all zeroes disarms
+            itimerspec spec{};
+
+            if (wakeAt)
+                spec.it_value = { (time_t) (*wakeAt / 1000), (long) (*wakeAt % 1000) * 1000000L };
+
+            timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+        })
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    watch(wakeFd, EPOLLIN, [this] (uint32_t)
+        {
+            uint64_t count = 0;
+            [[maybe_unused]] auto n = read(wakeFd, &count, sizeof(count));
+            queue.drain();
+        });
+
+    watch(timerFd, EPOLLIN, [this] (uint32_t)
+        {
+            uint64_t expirations = 0;
+
+            if (read(timerFd, &expirations, sizeof(expirations)) == sizeof(expirations))
+                timers.fire();
+        });
+}
+
+EpollEventLoop::~EpollEventLoop()
+{
+    close(timerFd);
+    close(wakeFd);
+    close(epollFd);
+}
+
+auto EpollEventLoop::run() -> void
+{
+    std::array<epoll_event, 64> events;
+
+    running = true;
+
+    while (running)
+    {
+        const auto count = epoll_wait(epollFd, events.data(), (int) events.size(), -1);
+
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < count && running; i++)
+        {
+            // Looked up per event, an earlier callback may have unwatched it.
+            // Hold a reference so a watcher can unwatch itself.
+            if (auto it = watchers.find(events[i].data.fd); it != watchers.end())
+            {
+                auto watcher = it->second;
+                (*watcher)(events[i].events);
+            }
+        }
+    }
+}
+
+auto EpollEventLoop::quit() -> void
+{
+    post([this] { running = false; });
+}
+
+auto EpollEventLoop::post(std::function<void()>&& callback) -> void
+{
+    queue.post(std::move(callback));
+}
+
+auto EpollEventLoop::postDelayed(int milliseconds, std::function<void()>&& callback) -> void
+{
+    timers.postDelayed(milliseconds, std::move(callback));
+}
+
+auto EpollEventLoop::makeTimer(int milliseconds, std::function<void()>&& function, TimerMode mode) -> std::unique_ptr<Timer>
+{
+    return timers.makeTimer(milliseconds, std::move(function), mode);
+}
+
+auto EpollEventLoop::watch(int fd, uint32_t events, watcher_t&& watcher) -> bool
+{
+    epoll_event event{};
+    event.events  = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+        return false;
+
+    watchers[fd] = std::make_shared<watcher_t>(std::move(watcher));
+    return true;
+}
+
+auto EpollEventLoop::modify(int fd, uint32_t events) -> bool
+{
+    epoll_event event{};
+    event.events  = events;
+    event.data.fd = fd;
+
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+auto EpollEventLoop::unwatch(int fd) -> void
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    watchers.erase(fd);
+}
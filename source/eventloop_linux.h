@@ -0,0 +1,44 @@
+#pragma once
+
+#include "eventloop.h"
+#include "messagequeue.h"
+#include "timerscheduler.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+
+// Headless event loop on epoll. Posted callbacks go through a
+// MessageQueue woken by an eventfd, timers share one timing wheel armed
+// through a single timerfd.
+struct EpollEventLoop : EventLoop
+{
+    using watcher_t = std::function<void(uint32_t events)>;
+
+    EpollEventLoop();
+    ~EpollEventLoop() override;
+
+    auto run() -> void override;
+    auto quit() -> void override;
+    auto post(std::function<void()>&& callback) -> void override;
+    auto postDelayed(int milliseconds, std::function<void()>&& callback) -> void override;
+    auto makeTimer(int milliseconds, std::function<void()>&& function, TimerMode mode) -> std::unique_ptr<Timer> override;
+    auto getTimers() -> TimerScheduler& override { return timers; }
+
+    // Calls watcher with the ready epoll events whenever fd becomes ready
+    auto watch(int fd, uint32_t events, watcher_t&& watcher) -> bool;
+    auto modify(int fd, uint32_t events) -> bool;
+    auto unwatch(int fd) -> void;
+
+    auto getQueue() -> MessageQueue& { return queue; }
+
+private:
+    int epollFd = -1;
+    int wakeFd  = -1;
+    int timerFd = -1;
+    bool running = false;
+    MessageQueue queue;
+    TimerScheduler timers;
+    std::map<int, std::shared_ptr<watcher_t>> watchers;
+};
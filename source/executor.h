@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+
+// Somewhere to run callbacks, now or after a delay. Coroutine tasks use an
+// executor to find their way back to the thread that owns them.
+struct Executor
+{
+    virtual ~Executor() = default;
+    virtual auto post(std::function<void()>&& callback) -> void = 0;
+    virtual auto postDelayed(int milliseconds, std::function<void()>&& callback) -> void = 0;
+};
+
+// Executor drained by hand from one thread, used to drive tasks without a
+// run loop (headless tools, benchmarks). Posting is safe from any thread.
+struct ManualExecutor : Executor
+{
+    using clock = std::chrono::steady_clock;
+
+    auto post(std::function<void()>&& callback) -> void override
+    {
+        std::lock_guard lock(mutex);
+        ready.push_back(std::move(callback));
+    }
+
+    auto postDelayed(int milliseconds, std::function<void()>&& callback) -> void override
+    {
+        std::lock_guard lock(mutex);
+        delayed.emplace(clock::now() + std::chrono::milliseconds(milliseconds), std::move(callback));
+    }
+
+    // Runs everything that is due, returns the number of callbacks run
+    auto poll() -> size_t
+    {
+        std::deque<std::function<void()>> batch;
+
+        {
+            std::lock_guard lock(mutex);
+
+            for (auto now = clock::now(); ! delayed.empty() && delayed.begin()->first <= now;)
+            {
+                ready.push_back(std::move(delayed.begin()->second));
+                delayed.erase(delayed.begin());
+            }
+
+            std::swap(batch, ready);
+        }
+
+        for (auto& callback : batch)
+            callback();
+
+        return batch.size();
+    }
+
+    auto empty() -> bool
+    {
+        std::lock_guard lock(mutex);
+        return ready.empty() && delayed.empty();
+    }
+
+    std::mutex mutex;
+    std::deque<std::function<void()>> ready;
+    std::multimap<clock::time_point, std::function<void()>> delayed;
+};
@@ -0,0 +1,469 @@
+#include "fileio.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define LOOKINGGLASS_IO_URING 1
+#endif
+
+FileContents::FileContents(FileContents&& other) noexcept
+    : buffer(std::move(other.buffer))
+    , mapping(std::exchange(other.mapping, nullptr))
+    , mappingSize(std::exchange(other.mappingSize, 0))
+{
+}
+
+auto FileContents::operator=(FileContents&& other) noexcept -> FileContents&
+{
+    if (this != &other)
+    {
+        if (mapping)
+            munmap(mapping, mappingSize);
+
+        buffer      = std::move(other.buffer);
+        mapping     = std::exchange(other.mapping, nullptr);
+        mappingSize = std::exchange(other.mappingSize, 0);
+    }
+
+    return *this;
+}
+
+FileContents::~FileContents()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+}
+
+// Closes the descriptor when it goes out of scope
+struct FileDescriptor
+{
+    explicit FileDescriptor(std::string_view filepath)
+        : fd(::open(std::string(filepath).c_str(), O_RDONLY | O_CLOEXEC))
+    {
+    }
+
+    ~FileDescriptor()
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    auto operator=(const FileDescriptor&) -> FileDescriptor& = delete;
+
+    int fd;
+};
+
+// Sizes from fstat are exact for regular files. Anything else (pipes,
+// procfs) reports 0 or a guess and is read until EOF instead.
+static auto regular_size(int fd, size_t& size) -> bool
+{
+    struct stat info{};
+
+    if (fstat(fd, &info) != 0)
+        return false;
+
+    size = S_ISREG(info.st_mode) ? (size_t) info.st_size : 0;
+    return true;
+}
+
+template <typename Buffer>
+static auto read_fd(int fd, size_t size, Buffer& buffer) -> bool
+{
+    buffer.resize(size);
+
+    size_t offset = 0;
+
+    for (;;)
+    {
+        // A file that isn't sized up front grows as it's read
+        if (offset == buffer.size())
+        {
+            if (size)
+                break;
+
+            buffer.resize(std::max<size_t>(64 * 1024, buffer.size() * 2));
+        }
+
+        auto n = ::pread(fd, buffer.data() + offset, buffer.size() - offset, (off_t) offset);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0)
+            return false;
+
+        if (n == 0)
+            break;
+
+        offset += (size_t) n;
+    }
+
+    // Shrunk since the fstat, or unsized
+    buffer.resize(offset);
+    return true;
+}
+
+template <typename Buffer>
+static auto read_path(std::string_view filepath) -> std::optional<Buffer>
+{
+    FileDescriptor file(filepath);
+    size_t size = 0;
+
+    if (file.fd < 0 || ! regular_size(file.fd, size))
+        return std::nullopt;
+
+    Buffer buffer;
+
+    if (! read_fd(file.fd, size, buffer))
+        return std::nullopt;
+
+    return buffer;
+}
+
+auto file_read_bytes(std::string_view filepath) -> std::optional<std::vector<uint8_t>>
+{
+    return read_path<std::vector<uint8_t>>(filepath);
+}
+
+auto file_read_text(std::string_view filepath) -> std::optional<std::string>
+{
+    return read_path<std::string>(filepath);
+}
+
+auto file_read_contents(std::string_view filepath, size_t mapThreshold) -> std::optional<FileContents>
+{
+    FileDescriptor file(filepath);
+    size_t size = 0;
+
+    if (file.fd < 0 || ! regular_size(file.fd, size))
+        return std::nullopt;
+
+    FileContents contents;
+
+    if (size && size >= mapThreshold)
+    {
+        if (auto mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0); mapping != MAP_FAILED)
+        {
+            madvise(mapping, size, MADV_WILLNEED);
+
+            contents.mapping     = mapping;
+            contents.mappingSize = size;
+
+            return contents;
+        }
+    }
+
+    if (! read_fd(file.fd, size, contents.buffer))
+        return std::nullopt;
+
+    return contents;
+}
+
+auto file_read_batch_sync(const std::vector<std::string>& filepaths) -> std::vector<std::optional<std::vector<uint8_t>>>
+{
+    std::vector<std::optional<std::vector<uint8_t>>> results;
+    results.reserve(filepaths.size());
+
+    for (const auto& filepath : filepaths)
+        results.push_back(file_read_bytes(filepath));
+
+    return results;
+}
+
+#if defined(LOOKINGGLASS_IO_URING)
+
+// Just enough of io_uring for batches of reads, on raw syscalls so there's
+// no liburing dependency. One ring per thread, created on first use.
+struct ReadRing
+{
+    static constexpr unsigned depth = 64;
+
+    ReadRing()
+    {
+        io_uring_params params{};
+        fd = (int) syscall(__NR_io_uring_setup, depth, &params);
+
+        if (fd < 0)
+            return;
+
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        const auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+        if (single)
+            sqSize = cqSize = std::max(sqSize, cqSize);
+
+        sqRing = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cqRing = single ? sqRing : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes     = (io_uring_sqe*) mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED)
+        {
+            release();
+            return;
+        }
+
+        auto sq = (uint8_t*) sqRing;
+        auto cq = (uint8_t*) cqRing;
+
+        sqTail  = (unsigned*) (sq + params.sq_off.tail);
+        sqMask  = (unsigned*) (sq + params.sq_off.ring_mask);
+        sqArray = (unsigned*) (sq + params.sq_off.array);
+        cqHead  = (unsigned*) (cq + params.cq_off.head);
+        cqTail  = (unsigned*) (cq + params.cq_off.tail);
+        cqMask  = (unsigned*) (cq + params.cq_off.ring_mask);
+        cqes    = (io_uring_cqe*) (cq + params.cq_off.cqes);
+    }
+
+    ~ReadRing()
+    {
+        release();
+    }
+
+    auto valid() const -> bool { return fd >= 0; }
+
+    auto release() -> void
+    {
+        if (sqes && sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+
+        if (cqRing && cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqSize);
+
+        if (sqRing && sqRing != MAP_FAILED)
+            munmap(sqRing, sqSize);
+
+        if (fd >= 0)
+            ::close(fd);
+
+        fd     = -1;
+        sqes   = nullptr;
+        sqRing = cqRing = nullptr;
+    }
+
+    // Queues a read, the kernel sees it on the next enter()
+    auto read(int file, uint8_t* buffer, size_t size, uint64_t offset, uint64_t userData) -> void
+    {
+        const auto tail  = *sqTail;
+        const auto index = tail & *sqMask;
+
+        auto& sqe     = sqes[index];
+        sqe           = {};
+        sqe.opcode    = IORING_OP_READ;
+        sqe.fd        = file;
+        sqe.addr      = (uint64_t) buffer;
+        sqe.len       = (uint32_t) std::min<size_t>(size, 1u << 30);
+        sqe.off       = offset;
+        sqe.user_data = userData;
+
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        queued++;
+    }
+
+    // Submits what's queued and waits for at least one completion
+    auto enter() -> bool
+    {
+        for (;;)
+        {
+            auto n = syscall(__NR_io_uring_enter, fd, queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+            if (n >= 0)
+            {
+                queued -= (unsigned) n;
+                return true;
+            }
+
+            if (errno != EINTR)
+                return false;
+        }
+    }
+
+    template <typename Callback>
+    auto reap(Callback&& callback) -> void
+    {
+        auto head       = *cqHead;
+        const auto tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; head++)
+        {
+            const auto& cqe = cqes[head & *cqMask];
+            callback(cqe.user_data, cqe.res);
+        }
+
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    int fd = -1;
+    unsigned queued = 0;
+
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqSize = 0;
+    size_t cqSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize    = 0;
+
+    unsigned* sqTail  = nullptr;
+    unsigned* sqMask  = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead  = nullptr;
+    unsigned* cqTail  = nullptr;
+    unsigned* cqMask  = nullptr;
+    io_uring_cqe* cqes = nullptr;
+};
+
+static auto read_ring() -> ReadRing*
+{
+    thread_local ReadRing ring;
+    return ring.valid() ? &ring : nullptr;
+}
+
+auto file_read_batch(const std::vector<std::string>& filepaths) -> std::vector<std::optional<std::vector<uint8_t>>>
+{
+    auto ring = read_ring();
+
+    if (! ring)
+        return file_read_batch_sync(filepaths);
+
+    struct Pending
+    {
+        size_t index;
+        int fd;
+        size_t offset = 0;
+    };
+
+    std::vector<std::optional<std::vector<uint8_t>>> results(filepaths.size());
+    std::vector<Pending> pending;
+
+    // Opens and sizes stay synchronous, only the reads overlap
+    for (size_t i = 0; i < filepaths.size(); i++)
+    {
+        auto fd     = ::open(filepaths[i].c_str(), O_RDONLY | O_CLOEXEC);
+        size_t size = 0;
+
+        if (fd < 0 || ! regular_size(fd, size) || size == 0)
+        {
+            if (fd >= 0)
+            {
+                std::vector<uint8_t> buffer;
+
+                if (read_fd(fd, size, buffer))
+                    results[i] = std::move(buffer);
+
+                ::close(fd);
+            }
+
+            continue;
+        }
+
+        results[i].emplace(size);
+        pending.push_back({ i, fd });
+    }
+
+    size_t next     = 0;
+    size_t inFlight = 0;
+
+    auto submit = [&] (Pending& read)
+    {
+        auto& buffer = *results[read.index];
+        ring->read(read.fd, buffer.data() + read.offset, buffer.size() - read.offset, read.offset, (uint64_t) (&read - pending.data()));
+        inFlight++;
+    };
+
+    // Starts over with pread when the ring can't do it, e.g. kernels without IORING_OP_READ
+    auto finishSync = [&] (Pending& read)
+    {
+        if (! read_fd(read.fd, results[read.index]->size(), *results[read.index]))
+            results[read.index].reset();
+    };
+
+    while (next < pending.size() || inFlight)
+    {
+        while (next < pending.size() && inFlight < ReadRing::depth)
+            submit(pending[next++]);
+
+        if (! ring->enter())
+        {
+            // Nothing more goes through this ring, so nothing queued is left
+            // behind for the next batch; the rest are read by hand
+            ring->release();
+
+            for (auto& read : pending)
+                if (read.fd >= 0)
+                    finishSync(read);
+
+            break;
+        }
+
+        ring->reap([&] (uint64_t userData, int32_t result)
+            {
+                auto& read   = pending[userData];
+                auto& buffer = *results[read.index];
+
+                inFlight--;
+
+                if (result == -EINTR || result == -EAGAIN)
+                {
+                    submit(read);
+                    return;
+                }
+
+                if (result < 0)
+                {
+                    finishSync(read);
+                }
+                else if (result > 0 && (read.offset += (size_t) result) < buffer.size())
+                {
+                    // Short read, carry on from where it stopped
+                    submit(read);
+                    return;
+                }
+                else
+                {
+                    buffer.resize(read.offset);
+                }
+
+                ::close(read.fd);
+                read.fd = -1;
+            });
+    }
+
+    for (auto& read : pending)
+        if (read.fd >= 0)
+            ::close(read.fd);
+
+    return results;
+}
+
+auto file_batch_backend() -> const char*
+{
+    return read_ring() ? "io_uring" : "pread";
+}
+
+#else
+
+auto file_read_batch(const std::vector<std::string>& filepaths) -> std::vector<std::optional<std::vector<uint8_t>>>
+{
+    return file_read_batch_sync(filepaths);
+}
+
+auto file_batch_backend() -> const char*
+{
+    return "pread";
+}
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A file's contents, read into memory or, for big files, mapped
+struct FileContents
+{
+    FileContents() = default;
+    FileContents(FileContents&& other) noexcept;
+    auto operator=(FileContents&& other) noexcept -> FileContents&;
+    ~FileContents();
+
+    FileContents(const FileContents&) = delete;
+    auto operator=(const FileContents&) -> FileContents& = delete;
+
+    auto data() const -> const uint8_t* { return mapping ? (const uint8_t*) mapping : buffer.data(); }
+    auto size() const -> size_t { return mapping ? mappingSize : buffer.size(); }
+    auto view() const -> std::string_view { return { (const char*) data(), size() }; }
+    auto mapped() const -> bool { return mapping != nullptr; }
+
+    std::vector<uint8_t> buffer;
+    void* mapping      = nullptr; // unmapped on destruction
+    size_t mappingSize = 0;
+};
+
+// Files of at least mapThreshold bytes are mapped instead of read
+constexpr size_t defaultMapThreshold = 256 * 1024;
+
+auto file_read_contents(std::string_view filepath, size_t mapThreshold = defaultMapThreshold) -> std::optional<FileContents>;
+
+// One open, one fstat and an exact-size buffer. Safe from any thread.
+auto file_read_bytes(std::string_view filepath) -> std::optional<std::vector<uint8_t>>;
+auto file_read_text(std::string_view filepath) -> std::optional<std::string>;
+
+// Reads many files at once: with io_uring where the kernel allows it, all
+// reads are in flight together; otherwise one pread loop after another.
+// Results are in the order of filepaths.
+auto file_read_batch(const std::vector<std::string>& filepaths) -> std::vector<std::optional<std::vector<uint8_t>>>;
+
+// Forces file_read_batch onto the pread loop, for comparing the two
+auto file_read_batch_sync(const std::vector<std::string>& filepaths) -> std::vector<std::optional<std::vector<uint8_t>>>;
+
+// "io_uring" or "pread", whichever file_read_batch uses on this thread
+auto file_batch_backend() -> const char*;
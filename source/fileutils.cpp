@@ -0,0 +1,60 @@
+#include "fileutils.h"
+#include "fileio.h"
+
+#include <filesystem>
+#include <map>
+
+auto toU8Vec(std::string_view string) -> std::vector<uint8_t>
+{
+    return { (const char*) string.begin(),
+             (const char*) string.end() };
+}
+
+auto file_get_last_write_time(std::string_view filepath) -> int64_t
+{
+    using namespace std::filesystem;
+    std::error_code ec;
+
+    return (int64_t) last_write_time(path(filepath), ec).time_since_epoch()
+                                                        .count();
+}
+
+auto file_get_size(std::string_view filepath) -> size_t
+{
+    using namespace std::filesystem;
+    std::error_code ec;
+
+    return file_size(path(filepath), ec);
+}
+
+auto file_read_binary(std::string_view filepath) -> std::optional<std::vector<uint8_t>>
+{
+    return file_read_bytes(filepath);
+}
+
+auto file_read_string(std::string_view filepath) -> std::optional<std::string>
+{
+    return file_read_text(filepath);
+}
+
+auto file_get_mimetype(std::string_view filepath) -> std::string
+{
+    static const std::map<std::string, std::string, std::less<>> types = {
+        { ".html", "text/html" },
+        { ".js",   "text/javascript" },
+        { ".css",  "text/css" },
+        { ".json", "application/json" },
+        { ".svg",  "image/svg+xml" },
+        { ".png",  "image/png" },
+        { ".jpg",  "image/jpeg" },
+        { ".wasm", "application/wasm" },
+    };
+
+    const auto dot = filepath.rfind('.');
+
+    if (dot != std::string_view::npos)
+        if (auto it = types.find(filepath.substr(dot)); it != types.end())
+            return it->second;
+
+    return "application/octet-stream";
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+auto toU8Vec(std::string_view string) -> std::vector<uint8_t>;
+
+auto file_get_last_write_time(std::string_view filepath) -> int64_t;
+auto file_get_size(std::string_view filepath) -> size_t;
+auto file_read_binary(std::string_view filepath) -> std::optional<std::vector<uint8_t>>;
+auto file_read_string(std::string_view filepath) -> std::optional<std::string>;
+
+// Content type for a file name's extension
+auto file_get_mimetype(std::string_view filepath) -> std::string;
@@ -0,0 +1,131 @@
+#include "flowcontrol.h"
+
+#include <algorithm>
+
+FlowController::FlowController(FlowConfig config)
+    : config(config), currentInterval(config.minInterval)
+{
+}
+
+auto FlowController::canSend(clock::time_point now) -> bool
+{
+    expire(now);
+
+    if (pending.size() >= config.maxInFlight)
+        return false;
+
+    return ! lastSend || now - *lastSend >= currentInterval;
+}
+
+auto FlowController::onSent(uint64_t sequence, clock::time_point now) -> void
+{
+    pending.emplace_back(sequence, now);
+    lastSend = now;
+    stats.sent++;
+}
+
+auto FlowController::onAck(uint64_t sequence, milliseconds renderTime, clock::time_point now) -> bool
+{
+    auto it = std::find_if(pending.begin(), pending.end(), [sequence] (const auto& p) { return p.first == sequence; });
+
+    if (it == pending.end())
+        return false;
+
+    const auto rtt = milliseconds(now - it->second).count();
+
+    // Acks are in order, anything older than this one was lost
+    stats.lost += (uint64_t) std::distance(pending.begin(), it);
+    pending.erase(pending.begin(), std::next(it));
+
+    const auto a = config.smoothing;
+    stats.rttMs    = stats.acked ? stats.rttMs + a * (rtt - stats.rttMs) : rtt;
+    stats.renderMs = stats.acked ? stats.renderMs + a * (renderTime.count() - stats.renderMs) : renderTime.count();
+    stats.acked++;
+
+    // Time spent waiting inside the page before it got to render is what
+    // signals overload; the render time itself sets the pace floor.
+    adapt(std::max(rtt - renderTime.count(), 0.0));
+    return true;
+}
+
+auto FlowController::getStats() const -> Stats
+{
+    auto result       = stats;
+    result.intervalMs = currentInterval.count();
+    result.inFlight   = pending.size();
+    return result;
+}
+
+auto FlowController::expire(clock::time_point now) -> void
+{
+    while (! pending.empty() && now - pending.front().second > config.ackTimeout)
+    {
+        pending.pop_front();
+        stats.timedOut++;
+        currentInterval = std::min(currentInterval * config.backoff, config.maxInterval);
+    }
+}
+
+auto FlowController::adapt(double queueDelayMs) -> void
+{
+    const auto floor = std::clamp(milliseconds(stats.renderMs), config.minInterval, config.maxInterval);
+
+    if (queueDelayMs > config.targetLatency.count())
+        currentInterval = std::min(currentInterval * config.backoff, config.maxInterval);
+    else
+        currentInterval = currentInterval - config.recoveryStep;
+
+    currentInterval = std::max(currentInterval, floor);
+}
+
+auto to_json(nlohmann::json& json, const FlowController::Stats& stats) -> void
+{
+    json = {
+        { "sent",       stats.sent },
+        { "acked",      stats.acked },
+        { "timedOut",   stats.timedOut },
+        { "lost",       stats.lost },
+        { "coalesced",  stats.coalesced },
+        { "rttMs",      stats.rttMs },
+        { "renderMs",   stats.renderMs },
+        { "intervalMs", stats.intervalMs },
+        { "inFlight",   stats.inFlight },
+    };
+}
+
+OutboundChannel::OutboundChannel(send_t&& send, FlowConfig config)
+    : flow(config), send(std::move(send))
+{
+}
+
+auto OutboundChannel::push(const std::string& key, nlohmann::json state) -> void
+{
+    auto [it, inserted] = dirty.insert_or_assign(key, std::move(state));
+
+    if (! inserted)
+        flow.stats.coalesced++;
+}
+
+auto OutboundChannel::pump(FlowController::clock::time_point now) -> bool
+{
+    if (dirty.empty() || ! flow.canSend(now))
+        return false;
+
+    auto batch = nlohmann::json::object();
+
+    for (auto& [key, state] : dirty)
+        batch[key] = std::move(state);
+
+    dirty.clear();
+
+    const auto sequence = nextSequence++;
+    flow.onSent(sequence, now);
+    send(sequence, batch);
+
+    return true;
+}
+
+auto OutboundChannel::onAck(uint64_t sequence, FlowController::milliseconds renderTime, FlowController::clock::time_point now) -> void
+{
+    flow.onAck(sequence, renderTime, now);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+
+struct FlowConfig
+{
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    size_t maxInFlight         = 2;
+    milliseconds minInterval   = milliseconds(16);
+    milliseconds maxInterval   = milliseconds(1000);
+    milliseconds targetLatency = milliseconds(50);
+    milliseconds ackTimeout    = milliseconds(5000);
+    milliseconds recoveryStep  = milliseconds(4);
+    double backoff             = 1.5;
+    double smoothing           = 0.2;
+};
+
+// Ack based pacing for pushes to the page. Each batch sent is acked by the
+// page once rendered; the controller keeps a bounded window of unacked
+// batches and stretches or shrinks the send interval from the measured
+// queueing delay (multiplicative back off, additive recovery), never
+// going below the page's own render time.
+struct FlowController
+{
+    using clock        = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+
+    struct Stats
+    {
+        uint64_t sent      = 0;
+        uint64_t acked     = 0;
+        uint64_t timedOut  = 0;
+        uint64_t lost      = 0; // skipped over by a later ack
+        uint64_t coalesced = 0;
+        double rttMs       = 0;
+        double renderMs    = 0;
+        double intervalMs  = 0;
+        size_t inFlight    = 0;
+    };
+
+    explicit FlowController(FlowConfig config = {});
+
+    auto canSend(clock::time_point now) -> bool;
+    auto onSent(uint64_t sequence, clock::time_point now) -> void;
+    auto onAck(uint64_t sequence, milliseconds renderTime, clock::time_point now) -> bool;
+
+    auto interval() const -> milliseconds { return currentInterval; }
+    auto inFlight() const -> size_t { return pending.size(); }
+    auto getStats() const -> Stats;
+
+    FlowConfig config;
+    Stats stats;
+
+private:
+    auto expire(clock::time_point now) -> void;
+    auto adapt(double queueDelayMs) -> void;
+
+    std::deque<std::pair<uint64_t, clock::time_point>> pending;
+    std::optional<clock::time_point> lastSend;
+    milliseconds currentInterval;
+};
+
+auto to_json(nlohmann::json& json, const FlowController::Stats& stats) -> void;
+
+// Keyed state pushed to the page through a FlowController. Pushing a key
+// that has not been sent yet replaces the older value, so a slow page only
+// ever sees the latest state of each key.
+struct OutboundChannel
+{
+    using send_t = std::function<void(uint64_t sequence, const nlohmann::json& batch)>;
+
+    OutboundChannel(send_t&& send, FlowConfig config = {});
+
+    auto push(const std::string& key, nlohmann::json state) -> void;
+    auto pump(FlowController::clock::time_point now) -> bool;
+    auto onAck(uint64_t sequence, FlowController::milliseconds renderTime, FlowController::clock::time_point now) -> void;
+
+    auto idle() const -> bool { return dirty.empty() && flow.inFlight() == 0; }
+    auto hasPending() const -> bool { return ! dirty.empty(); }
+
+    FlowController flow;
+
+private:
+    send_t send;
+    std::map<std::string, nlohmann::json> dirty;
+    uint64_t nextSequence = 1;
+};
@@ -0,0 +1,111 @@
+#include "framescheduler.h"
+
+#include <algorithm>
+
+FrameScheduler::FrameScheduler(now_t&& now, request_t&& requestFrame, microseconds budget, microseconds frameInterval)
+    : budget(budget), frameInterval(frameInterval), now(std::move(now)), requestFrame(std::move(requestFrame))
+{
+}
+
+auto FrameScheduler::post(TaskPriority priority, std::function<void()>&& task) -> void
+{
+    postSliced(priority, [task = std::move(task)]
+        {
+            task();
+            return false;
+        });
+}
+
+auto FrameScheduler::postSliced(TaskPriority priority, slice_t&& slice) -> void
+{
+    queues[(size_t) priority].push_back(std::move(slice));
+    request();
+}
+
+auto FrameScheduler::runFrame() -> void
+{
+    // Slices posting more work mid-frame are picked up by the request at the end
+    requested = true;
+    stats.frames++;
+
+    const auto start    = now();
+    const auto deadline = start + budget;
+    auto busy           = false;
+
+    while (auto queue = next(! busy))
+    {
+        const auto isIdle = queue == &queues[(size_t) TaskPriority::idle];
+        busy              = busy || ! isIdle;
+        auto slice        = std::move(queue->front());
+        queue->pop_front();
+
+        const auto more = slice();
+
+        stats.slices++;
+        stats.idleSlices += isIdle;
+
+        // Unfinished work goes to the back so same-priority tasks interleave
+        if (more)
+            queue->push_back(std::move(slice));
+        else
+            stats.completed++;
+
+        const auto time = now();
+
+        if (time >= deadline)
+        {
+            if (time > deadline)
+            {
+                const auto over = (uint64_t) (time - deadline).count();
+
+                stats.overruns++;
+                stats.totalOverrunUs += over;
+                stats.maxOverrunUs    = std::max(stats.maxOverrunUs, over);
+            }
+
+            break;
+        }
+    }
+
+    requested = pending() > 0;
+
+    // Leave the rest of the frame to the run loop (input, painting)
+    if (requested)
+        requestFrame(std::max(frameInterval - (now() - start), microseconds(0)));
+}
+
+auto FrameScheduler::pending() const -> size_t
+{
+    return queues[0].size() + queues[1].size() + queues[2].size();
+}
+
+auto FrameScheduler::next(bool idle) -> std::deque<slice_t>*
+{
+    for (auto& queue : queues)
+        if (! queue.empty() && (idle || &queue != &queues[(size_t) TaskPriority::idle]))
+            return &queue;
+
+    return nullptr;
+}
+
+auto FrameScheduler::request() -> void
+{
+    if (requested)
+        return;
+
+    requested = true;
+    requestFrame(microseconds(0));
+}
+
+auto to_json(nlohmann::json& json, const FrameScheduler::Stats& stats) -> void
+{
+    json = {
+        { "frames",         stats.frames },
+        { "slices",         stats.slices },
+        { "completed",      stats.completed },
+        { "idleSlices",     stats.idleSlices },
+        { "overruns",       stats.overruns },
+        { "maxOverrunUs",   stats.maxOverrunUs },
+        { "totalOverrunUs", stats.totalOverrunUs },
+    };
+}
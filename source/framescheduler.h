@@ -0,0 +1,72 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+enum class TaskPriority
+{
+    userBlocking,
+    normal,
+    idle
+};
+
+// Cooperative scheduler for work that has to stay on the message thread.
+// Work is split into slices and run a frame at a time: each frame runs
+// slices, highest priority first, until its budget is spent, then hands
+// the thread back to the run loop until the next frame. Idle tasks only
+// run in frames that had nothing else to do; a frame that ran other work
+// leaves them for the next one.
+struct FrameScheduler
+{
+    using microseconds = std::chrono::microseconds;
+    using now_t        = std::function<microseconds()>;
+    using request_t    = std::function<void(microseconds delay)>;
+
+    // A slice returns true while it has more work to do
+    using slice_t = std::function<bool()>;
+
+    struct Stats
+    {
+        uint64_t frames         = 0;
+        uint64_t slices         = 0;
+        uint64_t completed      = 0;
+        uint64_t idleSlices     = 0;
+        uint64_t overruns       = 0;
+        uint64_t maxOverrunUs   = 0;
+        uint64_t totalOverrunUs = 0;
+    };
+
+    FrameScheduler(now_t&& now,
+                   request_t&& requestFrame,
+                   microseconds budget        = std::chrono::milliseconds(6),
+                   microseconds frameInterval = std::chrono::milliseconds(16));
+
+    auto post(TaskPriority priority, std::function<void()>&& task) -> void;
+    auto postSliced(TaskPriority priority, slice_t&& slice) -> void;
+
+    // Runs one frame's worth of slices, requests the next frame if needed
+    auto runFrame() -> void;
+
+    auto pending() const -> size_t;
+    auto getStats() const -> Stats { return stats; }
+
+    microseconds budget;
+    microseconds frameInterval;
+
+private:
+    auto next(bool idle) -> std::deque<slice_t>*;
+    auto request() -> void;
+
+    now_t now;
+    request_t requestFrame;
+    std::array<std::deque<slice_t>, 3> queues;
+    bool requested = false;
+    Stats stats;
+};
+
+auto to_json(nlohmann::json& json, const FrameScheduler::Stats& stats) -> void;
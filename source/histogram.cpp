@@ -0,0 +1,83 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <bit>
+
+auto LatencyHistogram::bucketOf(uint64_t value) -> size_t
+{
+    // Values below subCount get a bucket each, above that the top subBits
+    // bits after the leading one pick the sub-bucket
+    if (value < subCount)
+        return (size_t) value;
+
+    const auto magnitude = std::bit_width(value) - 1;
+    const auto shift     = magnitude - subBits;
+    const auto sub       = (value >> shift) & (subCount - 1);
+
+    return (size_t) ((shift + 1) * subCount + sub);
+}
+
+auto LatencyHistogram::bucketLimit(size_t bucket) -> uint64_t
+{
+    if (bucket < subCount)
+        return bucket;
+
+    const auto shift = bucket / subCount - 1;
+    const auto sub   = bucket % subCount;
+
+    return ((subCount + sub + 1) << shift) - 1;
+}
+
+auto LatencyHistogram::record(uint64_t nanoseconds) -> void
+{
+    buckets[std::min(bucketOf(nanoseconds), buckets.size() - 1)]++;
+    count++;
+    sum += nanoseconds;
+    min  = std::min(min, nanoseconds);
+    max  = std::max(max, nanoseconds);
+}
+
+auto LatencyHistogram::merge(const LatencyHistogram& other) -> void
+{
+    for (size_t i = 0; i < buckets.size(); i++)
+        buckets[i] += other.buckets[i];
+
+    count += other.count;
+    sum   += other.sum;
+    min    = std::min(min, other.min);
+    max    = std::max(max, other.max);
+}
+
+auto LatencyHistogram::percentile(double fraction) const -> uint64_t
+{
+    if (count == 0)
+        return 0;
+
+    const auto target = std::max<uint64_t>(1, (uint64_t) (fraction * (double) count + 0.5));
+    uint64_t seen     = 0;
+
+    for (size_t i = 0; i < buckets.size(); i++)
+    {
+        seen += buckets[i];
+
+        if (seen >= target)
+            return std::clamp(bucketLimit(i), min, max);
+    }
+
+    return max;
+}
+
+auto to_json(nlohmann::json& json, const LatencyHistogram& histogram) -> void
+{
+    const auto us = [] (double nanoseconds) { return nanoseconds / 1000.0; };
+
+    json = {
+        { "count",  histogram.count },
+        { "meanUs", us(histogram.mean()) },
+        { "minUs",  us((double) (histogram.count ? histogram.min : 0)) },
+        { "p50Us",  us((double) histogram.percentile(0.50)) },
+        { "p90Us",  us((double) histogram.percentile(0.90)) },
+        { "p99Us",  us((double) histogram.percentile(0.99)) },
+        { "maxUs",  us((double) histogram.max) },
+    };
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <cstdint>
+
+// Log-linear latency histogram: 16 sub-buckets per power of two, so any
+// percentile is within ~6% of the true value, in constant memory.
+struct LatencyHistogram
+{
+    static constexpr int subBits  = 4;
+    static constexpr int subCount = 1 << subBits;
+
+    auto record(uint64_t nanoseconds) -> void;
+    auto merge(const LatencyHistogram& other) -> void;
+
+    // Upper bound of the bucket holding the given fraction (0..1) of samples
+    auto percentile(double fraction) const -> uint64_t;
+    auto mean() const -> double { return count ? (double) sum / (double) count : 0.0; }
+
+    uint64_t count = 0;
+    uint64_t sum   = 0;
+    uint64_t min   = UINT64_MAX;
+    uint64_t max   = 0;
+
+private:
+    static auto bucketOf(uint64_t value) -> size_t;
+    static auto bucketLimit(size_t bucket) -> uint64_t;
+
+    std::array<uint64_t, 64 * subCount> buckets{};
+};
+
+// Count, mean and percentiles in microseconds
+auto to_json(nlohmann::json& json, const LatencyHistogram& histogram) -> void;
@@ -0,0 +1,330 @@
+#include "htmlinliner.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+    struct Attribute
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // Attributes of a start tag, text is everything between the tag name and '>'
+    auto parse_attributes(std::string_view text) -> std::vector<Attribute>
+    {
+        std::vector<Attribute> attributes;
+        size_t i = 0;
+
+        const auto skip_space = [&]
+        {
+            while (i < text.size() && std::isspace((unsigned char) text[i]))
+                i++;
+        };
+
+        while (true)
+        {
+            skip_space();
+
+            if (i >= text.size() || text[i] == '/')
+                break;
+
+            const auto nameStart = i;
+
+            while (i < text.size() && ! std::isspace((unsigned char) text[i]) && text[i] != '=' && text[i] != '/')
+                i++;
+
+            Attribute attribute{ text.substr(nameStart, i - nameStart), {} };
+            skip_space();
+
+            if (i < text.size() && text[i] == '=')
+            {
+                i++;
+                skip_space();
+
+                if (i < text.size() && (text[i] == '"' || text[i] == '\''))
+                {
+                    const auto quote = text[i++];
+                    const auto end   = std::min(text.find(quote, i), text.size());
+
+                    attribute.value = text.substr(i, end - i);
+                    i = end + 1;
+                }
+                else
+                {
+                    const auto start = i;
+
+                    while (i < text.size() && ! std::isspace((unsigned char) text[i]))
+                        i++;
+
+                    attribute.value = text.substr(start, i - start);
+                }
+            }
+
+            if (attribute.name.empty())
+                i++;
+            else
+                attributes.push_back(attribute);
+        }
+
+        return attributes;
+    }
+
+    auto find_attribute(const std::vector<Attribute>& attributes, std::string_view name) -> const Attribute*
+    {
+        for (auto& attribute : attributes)
+            if (attribute.name == name)
+                return &attribute;
+
+        return nullptr;
+    }
+
+    auto write_attributes(std::string& out, const std::vector<Attribute>& attributes, std::initializer_list<std::string_view> skip) -> void
+    {
+        for (auto& attribute : attributes)
+        {
+            if (std::find(skip.begin(), skip.end(), attribute.name) != skip.end())
+                continue;
+
+            out += ' ';
+            out += attribute.name;
+
+            if (! attribute.value.empty())
+            {
+                out += "=\"";
+
+                // Values may have come in single quotes
+                for (auto c : attribute.value)
+                    if (c == '"')
+                        out += "&quot;";
+                    else
+                        out += c;
+
+                out += '"';
+            }
+        }
+    }
+
+    auto replace_all(std::string& string, std::string_view from, std::string_view to) -> void
+    {
+        for (auto pos = string.find(from); pos != std::string::npos; pos = string.find(from, pos + to.size()))
+            string.replace(pos, from.size(), to);
+    }
+}
+
+auto local_asset_path(std::string_view reference) -> std::optional<std::string>
+{
+    if (reference.starts_with("local://"))
+        reference.remove_prefix(8);
+
+    reference = reference.substr(0, reference.find_first_of("?#"));
+
+    if (reference.empty() || reference.find("://") != std::string_view::npos
+        || reference.starts_with('/') || reference.find("..") != std::string_view::npos
+        || reference.starts_with("data:") || reference.starts_with("javascript:"))
+        return std::nullopt;
+
+    return std::string(reference);
+}
+
+auto inline_critical_assets(std::string_view html, const asset_reader_t& read, const InlineOptions& options) -> InlineResult
+{
+    InlineResult result;
+    result.html.reserve(html.size());
+
+    size_t pos = 0;
+
+    while (pos < html.size())
+    {
+        const auto script = html.find("<script", pos);
+        const auto link   = html.find("<link", pos);
+        const auto start  = std::min(script, link);
+
+        if (start == std::string_view::npos)
+            break;
+
+        const auto isScript = start == script;
+        const auto nameEnd  = start + (isScript ? 7 : 5);
+        const auto tagEnd   = html.find('>', nameEnd);
+
+        if (tagEnd == std::string_view::npos)
+            break;
+
+        // <scripts> or <linked> aren't ours
+        if (html[nameEnd] != '>' && ! std::isspace((unsigned char) html[nameEnd]))
+        {
+            result.html.append(html.substr(pos, nameEnd - pos));
+            pos = nameEnd;
+            continue;
+        }
+
+        const auto attributes = parse_attributes(html.substr(nameEnd, tagEnd - nameEnd));
+        auto end              = tagEnd + 1;
+        const Attribute* url  = nullptr;
+
+        if (isScript)
+        {
+            constexpr std::string_view close = "</script>";
+
+            // The body goes along with the tag, markup in a script isn't markup
+            const auto closeAt = html.find(close, end);
+            const auto empty   = closeAt == end;
+
+            end = closeAt == std::string_view::npos ? html.size() : closeAt + close.size();
+
+            // Only plain blocking scripts with an empty body
+            if (empty && ! find_attribute(attributes, "async") && ! find_attribute(attributes, "defer")
+                      && ! find_attribute(attributes, "type"))
+                url = find_attribute(attributes, "src");
+        }
+        else if (auto rel = find_attribute(attributes, "rel"); rel && rel->value == "stylesheet")
+        {
+            url = find_attribute(attributes, "href");
+        }
+
+        const auto path = url ? local_asset_path(url->value) : std::nullopt;
+
+        result.html.append(html.substr(pos, start - pos));
+        pos = end;
+
+        if (! path)
+        {
+            result.html.append(html.substr(start, end - start));
+            continue;
+        }
+
+        InlineEntry entry{ *path, isScript ? "script" : "style" };
+
+        if (isScript && options.bootstrap.contains(*path))
+        {
+            entry.action = InlineEntry::Action::bootstrap;
+            result.manifest.push_back(std::move(entry));
+            continue;
+        }
+
+        if (! options.inlining)
+        {
+            result.html.append(html.substr(start, end - start));
+            result.manifest.push_back(std::move(entry));
+            continue;
+        }
+
+        auto data        = read(*path);
+        const auto limit = isScript ? options.maxScriptBytes : options.maxStyleBytes;
+
+        if (data)
+            entry.bytes = data->size();
+
+        // A closing tag inside a stylesheet can't be escaped, leave it linked
+        const auto fits = data && entry.bytes <= limit && result.inlinedBytes + entry.bytes <= options.maxTotalBytes
+                               && (isScript || data->find("</style") == std::string::npos);
+
+        if (! fits)
+        {
+            entry.action = data ? InlineEntry::Action::linked : InlineEntry::Action::missing;
+            result.html.append(html.substr(start, end - start));
+            result.manifest.push_back(std::move(entry));
+            continue;
+        }
+
+        if (isScript)
+        {
+            replace_all(*data, "</script", "<\\/script");
+            replace_all(*data, "<!--", "<\\!--");
+
+            result.html += "<script";
+            write_attributes(result.html, attributes, { "src" });
+            result.html += ">";
+            result.html += *data;
+            result.html += "</script>";
+        }
+        else
+        {
+            result.html += "<style";
+            write_attributes(result.html, attributes, { "rel", "href", "type" });
+            result.html += ">";
+            result.html += *data;
+            result.html += "</style>";
+        }
+
+        entry.action         = InlineEntry::Action::inlined;
+        result.inlinedBytes += entry.bytes;
+        result.manifest.push_back(std::move(entry));
+    }
+
+    result.html.append(html.substr(std::min(pos, html.size())));
+    return result;
+}
+
+auto find_subresources(std::string_view html) -> std::vector<std::string>
+{
+    std::vector<std::string> paths;
+
+    for (auto pos = html.find('<'); pos != std::string_view::npos; pos = html.find('<', pos + 1))
+    {
+        const auto tag = html.substr(pos + 1);
+        std::string_view name;
+
+        for (auto candidate : { std::string_view("script"), std::string_view("link"), std::string_view("img") })
+            if (tag.starts_with(candidate) && tag.size() > candidate.size()
+                && (tag[candidate.size()] == '>' || std::isspace((unsigned char) tag[candidate.size()])))
+                name = candidate;
+
+        if (name.empty())
+            continue;
+
+        const auto tagEnd = tag.find('>');
+
+        if (tagEnd == std::string_view::npos)
+            break;
+
+        const auto attributes = parse_attributes(tag.substr(name.size(), tagEnd - name.size()));
+        const Attribute* url  = nullptr;
+
+        if (name == "link")
+        {
+            auto rel = find_attribute(attributes, "rel");
+
+            if (rel && (rel->value == "stylesheet" || rel->value == "preload" || rel->value == "modulepreload" || rel->value == "icon"))
+                url = find_attribute(attributes, "href");
+        }
+        else
+        {
+            url = find_attribute(attributes, "src");
+        }
+
+        if (auto path = url ? local_asset_path(url->value) : std::nullopt)
+            if (std::find(paths.begin(), paths.end(), *path) == paths.end())
+                paths.push_back(std::move(*path));
+
+        pos += tagEnd;
+
+        // Nothing in a script's body is a tag
+        if (name == "script")
+            if (pos = html.find("</script>", pos); pos == std::string_view::npos)
+                break;
+    }
+
+    return paths;
+}
+
+auto to_json(nlohmann::json& json, const InlineEntry& entry) -> void
+{
+    constexpr const char* actions[] = { "inlined", "bootstrap", "linked", "missing" };
+
+    json = {
+        { "path",   entry.path },
+        { "kind",   entry.kind },
+        { "bytes",  entry.bytes },
+        { "action", actions[(size_t) entry.action] },
+    };
+}
+
+auto to_json(nlohmann::json& json, const InlineResult& result) -> void
+{
+    json = {
+        { "inlinedBytes", result.inlinedBytes },
+        { "assets",       result.manifest },
+    };
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <functional>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Rewrites a served html document so small critical scripts and styles are
+// inlined instead of costing a scheme handler round trip each. Scripts
+// the app injects as document-start user scripts (the bridge bootstrap)
+// are dropped from the document so they don't run twice.
+struct InlineOptions
+{
+    size_t maxScriptBytes = 32 * 1024;
+    size_t maxStyleBytes  = 32 * 1024;
+    size_t maxTotalBytes  = 128 * 1024;
+
+    // Off, documents are left as they are apart from dropping the bootstrap
+    bool inlining = true;
+
+    // Local paths already provided as user scripts
+    std::set<std::string, std::less<>> bootstrap;
+};
+
+struct InlineEntry
+{
+    enum class Action
+    {
+        inlined,
+        bootstrap,
+        linked,
+        missing
+    };
+
+    std::string path;
+    std::string kind;
+    size_t bytes = 0;
+    Action action = Action::linked;
+};
+
+struct InlineResult
+{
+    std::string html;
+    std::vector<InlineEntry> manifest;
+    size_t inlinedBytes = 0;
+};
+
+using asset_reader_t = std::function<std::optional<std::string>(const std::string& path)>;
+
+auto inline_critical_assets(std::string_view html, const asset_reader_t& read, const InlineOptions& options = {}) -> InlineResult;
+
+// "local://a.js" or "a.js" -> "a.js", nullopt for anything outside the app folder
+auto local_asset_path(std::string_view reference) -> std::optional<std::string>;
+
+// Local files a document will fetch: <script src>, <link href> (stylesheets,
+// preloads and icons) and <img src>, in document order without repeats
+auto find_subresources(std::string_view html) -> std::vector<std::string>;
+
+auto to_json(nlohmann::json& json, const InlineEntry& entry) -> void;
+auto to_json(nlohmann::json& json, const InlineResult& result) -> void;
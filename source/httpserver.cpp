@@ -0,0 +1,570 @@
+#include "httpserver.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+static auto equals_ignore_case(std::string_view a, std::string_view b) -> bool
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [] (char x, char y)
+        {
+            return std::tolower((unsigned char) x) == std::tolower((unsigned char) y);
+        });
+}
+
+static auto trim(std::string_view string) -> std::string_view
+{
+    while (! string.empty() && (string.front() == ' ' || string.front() == '\t'))
+        string.remove_prefix(1);
+
+    while (! string.empty() && (string.back() == ' ' || string.back() == '\t'))
+        string.remove_suffix(1);
+
+    return string;
+}
+
+static auto percent_decode(std::string_view string) -> std::string
+{
+    std::string decoded;
+    decoded.reserve(string.size());
+
+    for (size_t i = 0; i < string.size(); i++)
+    {
+        if (string[i] == '%' && i + 2 < string.size() && std::isxdigit((unsigned char) string[i + 1])
+                                                      && std::isxdigit((unsigned char) string[i + 2]))
+        {
+            decoded += (char) std::stoi(std::string(string.substr(i + 1, 2)), nullptr, 16);
+            i += 2;
+        }
+        else
+        {
+            decoded += string[i];
+        }
+    }
+
+    return decoded;
+}
+
+auto HttpRequest::header(std::string_view name) const -> const std::string*
+{
+    for (auto& [key, value] : headers)
+        if (equals_ignore_case(key, name))
+            return &value;
+
+    return nullptr;
+}
+
+auto parse_http_request(std::string_view buffer, HttpRequest& request) -> long
+{
+    const auto headEnd = buffer.find("\r\n\r\n");
+
+    if (headEnd == std::string_view::npos)
+        return buffer.size() > HttpServer::maxHeaderBytes ? -1 : 0;
+
+    auto head = buffer.substr(0, headEnd);
+
+    // Request line: METHOD SP target SP HTTP/1.x
+    const auto lineEnd = std::min(head.find("\r\n"), head.size());
+    const auto line    = head.substr(0, lineEnd);
+    const auto space1  = line.find(' ');
+    const auto space2  = line.rfind(' ');
+
+    if (space1 == std::string_view::npos || space2 == space1)
+        return -1;
+
+    const auto version = line.substr(space2 + 1);
+
+    if (version != "HTTP/1.1" && version != "HTTP/1.0")
+        return -1;
+
+    request              = {};
+    request.method       = line.substr(0, space1);
+    request.target       = line.substr(space1 + 1, space2 - space1 - 1);
+    request.minorVersion = version.back() - '0';
+    request.path         = percent_decode(request.target.substr(0, request.target.find_first_of("?#")));
+    request.keepAlive    = request.minorVersion == 1;
+
+    head.remove_prefix(std::min(lineEnd + 2, head.size()));
+
+    while (! head.empty())
+    {
+        const auto end   = std::min(head.find("\r\n"), head.size());
+        const auto field = head.substr(0, end);
+        const auto colon = field.find(':');
+
+        if (colon == std::string_view::npos || colon == 0)
+            return -1;
+
+        request.headers.emplace_back(field.substr(0, colon), trim(field.substr(colon + 1)));
+        head.remove_prefix(std::min(end + 2, head.size()));
+    }
+
+    if (auto connection = request.header("Connection"))
+    {
+        if (equals_ignore_case(*connection, "close"))
+            request.keepAlive = false;
+        else if (equals_ignore_case(*connection, "keep-alive"))
+            request.keepAlive = true;
+    }
+
+    // No chunked request bodies, nothing here needs them
+    if (request.header("Transfer-Encoding"))
+        return -1;
+
+    if (auto length = request.header("Content-Length"))
+    {
+        char* end = nullptr;
+        request.contentLength = std::strtoull(length->c_str(), &end, 10);
+
+        if (end == length->c_str() || *end != 0 || request.contentLength > HttpServer::maxBodyBytes)
+            return -1;
+    }
+
+    const auto total = headEnd + 4 + request.contentLength;
+    return buffer.size() < total ? 0 : (long) total;
+}
+
+auto http_status_text(int status) -> const char*
+{
+    switch (status)
+    {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 500: return "Internal Server Error";
+        default:  return "Unknown";
+    }
+}
+
+auto HttpServer::Output::bufferedSize() const -> size_t
+{
+    return head.size() + (response ? response->body().size() : 0);
+}
+
+HttpServer::HttpServer(EpollEventLoop& loop, handler_t&& handler) : loop(loop), handler(std::move(handler))
+{
+}
+
+HttpServer::~HttpServer()
+{
+    close();
+}
+
+auto HttpServer::listen(uint16_t requestedPort, const char* address) -> bool
+{
+    // sendfile has no MSG_NOSIGNAL, a client hanging up mustn't kill us
+    std::signal(SIGPIPE, SIG_IGN);
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (listenFd < 0)
+        return false;
+
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(requestedPort);
+    inet_pton(AF_INET, address, &addr.sin_addr);
+
+    socklen_t length = sizeof(addr);
+
+    if (bind(listenFd, (sockaddr*) &addr, sizeof(addr)) != 0
+        || ::listen(listenFd, SOMAXCONN) != 0
+        || getsockname(listenFd, (sockaddr*) &addr, &length) != 0)
+    {
+        perror("HttpServer::listen");
+        close();
+        return false;
+    }
+
+    port = ntohs(addr.sin_port);
+
+    return loop.watch(listenFd, EPOLLIN, [this] (uint32_t)
+        {
+            accept();
+        });
+}
+
+auto HttpServer::close() -> void
+{
+    while (! connections.empty())
+        drop(connections.begin()->first);
+
+    if (listenFd >= 0)
+    {
+        loop.unwatch(listenFd);
+        ::close(listenFd);
+        listenFd = -1;
+    }
+}
+
+auto HttpServer::accept() -> void
+{
+    while (true)
+    {
+        const auto fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd < 0)
+            return;
+
+        // Responses are written whole, don't let Nagle hold back the tail
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        auto connection = std::make_unique<Connection>();
+        connection->fd     = fd;
+        connection->events = EPOLLIN | EPOLLRDHUP;
+        connections[fd]    = std::move(connection);
+        stats.accepted++;
+
+        loop.watch(fd, EPOLLIN | EPOLLRDHUP, [this, fd] (uint32_t events)
+            {
+                onEvents(fd, events);
+            });
+    }
+}
+
+auto HttpServer::onEvents(int fd, uint32_t events) -> void
+{
+    auto it = connections.find(fd);
+
+    if (it == connections.end())
+        return;
+
+    auto& connection = *it->second;
+
+    if (events & (EPOLLERR | EPOLLHUP))
+        return drop(fd);
+
+    if ((events & EPOLLOUT) && ! flush(connection))
+        return drop(fd);
+
+    if ((events & (EPOLLIN | EPOLLRDHUP)) && ! connection.closing)
+        read(connection);
+
+    // Requests left unparsed at the bound are picked up again as the
+    // client drains what's queued ahead of them
+    while (true)
+    {
+        const auto requests = stats.requests;
+
+        if (! parse(connection))
+            return;
+
+        if (! flush(connection))
+            return drop(fd);
+
+        if (stats.requests == requests || backlogged(connection))
+            break;
+    }
+
+    if ((connection.readClosed || connection.closing) && connection.output.empty())
+        drop(fd);
+}
+
+auto HttpServer::read(Connection& connection) -> void
+{
+    std::array<char, 64 * 1024> buffer;
+
+    // Whatever doesn't fit waits in the socket, level triggered EPOLLIN comes back for it
+    while (connection.input.size() < maxHeaderBytes + maxBodyBytes)
+    {
+        const auto n = recv(connection.fd, buffer.data(), buffer.size(), 0);
+
+        if (n > 0)
+        {
+            connection.input.append(buffer.data(), (size_t) n);
+            continue;
+        }
+
+        if (n == 0)
+            connection.readClosed = true;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            connection.readClosed = true;
+        else if (errno == EINTR)
+            continue;
+
+        break;
+    }
+}
+
+// Answers the complete requests in the buffer, pipelined ones included,
+// until the output queue is full. False if the connection was upgraded.
+auto HttpServer::parse(Connection& connection) -> bool
+{
+    size_t offset = 0;
+
+    while (! connection.closing && ! backlogged(connection))
+    {
+        HttpRequest request;
+        const auto consumed = parse_http_request(std::string_view(connection.input).substr(offset), request);
+
+        if (consumed == 0)
+            break;
+
+        if (consumed < 0)
+        {
+            respondError(connection, 400);
+            break;
+        }
+
+        offset += (size_t) consumed;
+        stats.requests++;
+
+        if (onUpgrade && request.header("Upgrade"))
+        {
+            const auto fd = connection.fd;
+
+            // Whatever the client sent after the handshake belongs to the new owner
+            if (connection.output.empty() && onUpgrade(fd, request, connection.input.substr(offset)))
+            {
+                loop.unwatch(fd);
+                connections.erase(fd);
+                return false;
+            }
+        }
+
+        respond(connection, request);
+    }
+
+    connection.input.erase(0, offset);
+    return true;
+}
+
+auto HttpServer::backlogged(const Connection& connection) const -> bool
+{
+    if (connection.output.size() >= maxQueuedResponses)
+        return true;
+
+    size_t bytes = 0;
+
+    for (const auto& output : connection.output)
+        bytes += output.bufferedSize() - output.sent + output.fileRemaining;
+
+    return bytes >= maxQueuedBytes;
+}
+
+auto HttpServer::respond(Connection& connection, const HttpRequest& request) -> void
+{
+    const auto isHead = request.method == "HEAD";
+
+    if (request.method != "GET" && ! isHead)
+        return respondError(connection, 405);
+
+    std::unique_ptr<UrlResponse> response;
+
+    try
+    {
+        response = handler(request);
+    }
+    catch (const std::exception& e)
+    {
+        printf("Error: %s %s: %s\n", request.method.c_str(), request.target.c_str(), e.what());
+        return respondError(connection, 500);
+    }
+
+    if (! response)
+        return respondError(connection, 404);
+
+    Output output;
+    size_t length = response->body().size();
+
+    // The file is opened once it reaches the front of the queue, a client
+    // pipelining requests doesn't get to hold a descriptor per request
+    if (! response->filepath.empty())
+    {
+        struct stat info{};
+
+        if (stat(response->filepath.c_str(), &info) != 0 || ! S_ISREG(info.st_mode))
+            return respondError(connection, 404);
+
+        length               = (size_t) info.st_size;
+        output.fileRemaining = isHead ? 0 : length;
+        output.filepath      = isHead ? std::string() : std::move(response->filepath);
+    }
+
+    output.closeAfter = ! request.keepAlive;
+    output.head       = "HTTP/1.1 200 OK\r\nContent-Type: " + response->mimetype
+                      + "\r\nContent-Length: " + std::to_string(length)
+                      + (request.keepAlive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+
+    if (! isHead && output.filepath.empty())
+        output.response = std::move(response);
+
+    connection.output.push_back(std::move(output));
+    connection.closing = ! request.keepAlive;
+}
+
+auto HttpServer::respondError(Connection& connection, int status) -> void
+{
+    const std::string body = std::to_string(status) + " " + http_status_text(status) + "\n";
+
+    Output output;
+    output.head = "HTTP/1.1 " + body.substr(0, body.size() - 1)
+                + "\r\nContent-Type: text/plain\r\nContent-Length: " + std::to_string(body.size())
+                + "\r\n\r\n" + body;
+
+    // The stream can't be trusted after a bad request
+    output.closeAfter  = status == 400;
+    connection.closing = connection.closing || output.closeAfter;
+    connection.output.push_back(std::move(output));
+}
+
+auto HttpServer::flush(Connection& connection) -> bool
+{
+    while (! connection.output.empty())
+    {
+        // Gather buffered bytes across queued responses up to the first file
+        std::array<iovec, 64> iov;
+        size_t count = 0;
+
+        for (auto& output : connection.output)
+        {
+            if (count + 2 > iov.size())
+                break;
+
+            if (output.sent < output.head.size())
+                iov[count++] = { output.head.data() + output.sent, output.head.size() - output.sent };
+
+            if (output.response && ! output.response->body().empty())
+            {
+                const auto body = output.response->body();
+                const auto from  = std::max(output.sent, output.head.size()) - output.head.size();
+
+                if (from < body.size())
+                    iov[count++] = { (void*) (body.data() + from), body.size() - from };
+            }
+
+            if (output.fileRemaining > 0 || output.closeAfter)
+                break;
+        }
+
+        if (count > 0)
+        {
+            msghdr message{};
+            message.msg_iov    = iov.data();
+            message.msg_iovlen = count;
+
+            const auto n = sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+
+                if (errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            stats.bytesSent += (uint64_t) n;
+
+            auto remaining = (size_t) n;
+
+            for (auto& output : connection.output)
+            {
+                const auto take = std::min(remaining, output.bufferedSize() - output.sent);
+
+                output.sent += take;
+                remaining   -= take;
+
+                if (remaining == 0)
+                    break;
+            }
+        }
+
+        auto& front = connection.output.front();
+
+        if (front.sent < front.bufferedSize())
+            continue;
+
+        if (front.fileRemaining > 0)
+        {
+            if (front.file < 0)
+                front.file = open(front.filepath.c_str(), O_RDONLY | O_CLOEXEC);
+
+            // Gone since it was answered, the promised length can't be met
+            if (front.file < 0)
+                return false;
+
+            const auto n = sendfile(connection.fd, front.file, &front.fileOffset, front.fileRemaining);
+
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+
+                if (errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            // File shrank under us, the promised length can't be met
+            if (n == 0)
+                return false;
+
+            front.fileRemaining -= (size_t) n;
+            stats.bytesSent     += (uint64_t) n;
+            stats.fileBytes     += (uint64_t) n;
+            continue;
+        }
+
+        if (front.file >= 0)
+            ::close(front.file);
+
+        const auto closeAfter = front.closeAfter;
+        connection.output.pop_front();
+
+        if (closeAfter)
+            return false;
+    }
+
+    // Only ask for writability while something is waiting on it, and stop
+    // reading once the connection is on its way out or has enough queued
+    const auto reading = ! connection.readClosed && ! connection.closing && ! backlogged(connection);
+    const auto events  = (reading ? EPOLLIN | EPOLLRDHUP : 0u) | (connection.output.empty() ? 0u : EPOLLOUT);
+
+    if (events != connection.events)
+    {
+        connection.events = events;
+        loop.modify(connection.fd, events);
+    }
+
+    return true;
+}
+
+auto HttpServer::drop(int fd) -> void
+{
+    auto it = connections.find(fd);
+
+    if (it == connections.end())
+        return;
+
+    for (auto& output : it->second->output)
+        if (output.file >= 0)
+            ::close(output.file);
+
+    loop.unwatch(fd);
+    ::close(fd);
+    connections.erase(it);
+}
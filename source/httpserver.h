@@ -0,0 +1,121 @@
+#pragma once
+
+#include "eventloop_linux.h"
+#include "webviewinterface.h"
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct HttpRequest
+{
+    std::string method;
+    std::string target;
+    std::string path;
+    int minorVersion     = 1;
+    bool keepAlive       = true;
+    size_t contentLength = 0;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    auto header(std::string_view name) const -> const std::string*;
+};
+
+// Parses one request from the front of buffer. Returns the bytes it took
+// (headers and body), 0 if the request isn't all there yet, -1 if malformed.
+auto parse_http_request(std::string_view buffer, HttpRequest& request) -> long;
+
+// HTTP/1.1 on 127.0.0.1 driven by an EpollEventLoop, answering requests
+// with the same UrlResponses the WebView gets. Connections are kept alive
+// and pipelined requests are answered in order with batched writes; file
+// backed responses go out with sendfile, opened when their turn comes.
+struct HttpServer
+{
+    using handler_t = std::function<std::unique_ptr<UrlResponse>(const HttpRequest&)>;
+
+    // Called for requests asking to upgrade (websocket), returns true if it
+    // took the connection; the server forgets the fd after that
+    using upgrade_t = std::function<bool(int fd, const HttpRequest&, std::string leftover)>;
+
+    struct Stats
+    {
+        uint64_t accepted  = 0;
+        uint64_t requests  = 0;
+        uint64_t bytesSent = 0;
+        uint64_t fileBytes = 0;
+    };
+
+    static constexpr size_t maxHeaderBytes = 16 * 1024;
+    static constexpr size_t maxBodyBytes   = 1024 * 1024;
+
+    // Queued output past which a connection's requests are left unparsed
+    // (and its socket unread) until the client takes some of it
+    static constexpr size_t maxQueuedResponses = 16;
+    static constexpr size_t maxQueuedBytes     = 256 * 1024;
+
+    HttpServer(EpollEventLoop& loop, handler_t&& handler);
+    ~HttpServer();
+
+    HttpServer(const HttpServer&) = delete;
+    auto operator=(const HttpServer&) -> HttpServer& = delete;
+
+    // Port 0 picks a free one, see getPort()
+    auto listen(uint16_t port, const char* address = "127.0.0.1") -> bool;
+    auto close() -> void;
+
+    auto getPort() const -> uint16_t { return port; }
+    auto getStats() const -> Stats { return stats; }
+
+    upgrade_t onUpgrade;
+
+private:
+    struct Output
+    {
+        std::string head;
+        std::unique_ptr<UrlResponse> response;
+        std::string filepath;
+        size_t sent          = 0;
+        int file             = -1;
+        off_t fileOffset     = 0;
+        size_t fileRemaining = 0;
+        bool closeAfter      = false;
+
+        auto bufferedSize() const -> size_t;
+    };
+
+    struct Connection
+    {
+        int fd = -1;
+        std::string input;
+        std::deque<Output> output;
+        uint32_t events = 0;
+        bool readClosed = false;
+        bool closing    = false;
+    };
+
+    auto accept() -> void;
+    auto onEvents(int fd, uint32_t events) -> void;
+    auto read(Connection& connection) -> void;
+    auto parse(Connection& connection) -> bool;
+    auto backlogged(const Connection& connection) const -> bool;
+    auto respond(Connection& connection, const HttpRequest& request) -> void;
+    auto respondError(Connection& connection, int status) -> void;
+    auto flush(Connection& connection) -> bool;
+    auto drop(int fd) -> void;
+
+    EpollEventLoop& loop;
+    handler_t handler;
+    int listenFd  = -1;
+    uint16_t port = 0;
+    std::map<int, std::unique_ptr<Connection>> connections;
+    Stats stats;
+};
+
+auto http_status_text(int status) -> const char*;
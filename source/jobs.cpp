@@ -0,0 +1,193 @@
+#include "jobs.h"
+
+#include <cmath>
+
+auto ProgressThrottle::shouldEmit(double progress, clock::time_point now) -> bool
+{
+    const auto complete = progress >= 1.0;
+    const auto moved    = std::abs(progress - lastProgress) >= minDelta;
+    const auto due      = ! lastTime || now - *lastTime >= interval;
+
+    if (complete ? progress != lastProgress : (due && moved))
+    {
+        lastTime     = now;
+        lastProgress = progress;
+        return true;
+    }
+
+    return false;
+}
+
+auto jobEventTypeName(JobEvent::Type type) -> const char*
+{
+    switch (type)
+    {
+        case JobEvent::Type::progress:  return "progress";
+        case JobEvent::Type::finished:  return "finished";
+        case JobEvent::Type::failed:    return "failed";
+        case JobEvent::Type::cancelled: return "cancelled";
+    }
+
+    return "unknown";
+}
+
+struct JobContext::State
+{
+    uint64_t id;
+    CancellationToken token;
+    ProgressThrottle throttle;
+    JobRegistry::clock_t now;
+    Executor& home;
+    std::function<void(const JobEvent&)> deliver;
+
+    // Latest unsent report, only one is ever queued on the home executor
+    std::mutex mutex;
+    std::optional<nlohmann::json> pending;
+};
+
+auto JobContext::isCancelled() const -> bool
+{
+    return state->token.isCancelled();
+}
+
+auto JobContext::progress(double fraction, const nlohmann::json& detail) -> void
+{
+    auto& s = *state;
+
+    std::lock_guard lock(s.mutex);
+
+    if (! s.throttle.shouldEmit(fraction, s.now()))
+        return;
+
+    const auto queued = s.pending.has_value();
+    s.pending = nlohmann::json{ { "progress", fraction }, { "detail", detail } };
+
+    if (queued)
+        return;
+
+    s.home.post([weak = std::weak_ptr<State>(state)]
+        {
+            auto s = weak.lock();
+
+            if (! s)
+                return;
+
+            std::optional<nlohmann::json> payload;
+
+            {
+                std::lock_guard lock(s->mutex);
+                payload.swap(s->pending);
+            }
+
+            if (payload && ! s->token.isCancelled())
+                s->deliver({ s->id, JobEvent::Type::progress, std::move(*payload) });
+        });
+}
+
+JobRegistry::JobRegistry(WorkerPool& pool, Executor& home, event_t&& onEvent)
+    : pool(pool), home(home), onEvent(std::move(onEvent))
+{
+}
+
+// Jobs still running see their token cancelled, and whatever they post
+// home afterwards is dropped
+JobRegistry::~JobRegistry()
+{
+    *alive = false;
+
+    for (auto& [id, state] : active)
+        state->token.cancel();
+}
+
+auto JobRegistry::registerJob(const std::string& name, job_t&& job) -> void
+{
+    jobs[name] = std::move(job);
+}
+
+auto JobRegistry::start(uint64_t id, const std::string& name, const nlohmann::json& args) -> bool
+{
+    auto job = jobs.find(name);
+
+    if (job == jobs.end() || active.contains(id))
+        return false;
+
+    auto state = std::shared_ptr<JobContext::State>(new JobContext::State{
+        .id       = id,
+        .throttle = throttle,
+        .now      = now,
+        .home     = home,
+        .deliver  = onEvent,
+    });
+
+    active[id] = state;
+
+    auto done = [this, alive = alive] (uint64_t id, JobEvent::Type type, nlohmann::json payload)
+    {
+        if (*alive)
+            finish(id, type, std::move(payload));
+    };
+
+    pool.post([&home = home, done, context = JobContext{ state }, function = job->second, args] () mutable
+        {
+            auto type = JobEvent::Type::finished;
+            nlohmann::json payload;
+
+            try
+            {
+                payload = function(context, args);
+            }
+            catch (const std::exception& e)
+            {
+                type    = JobEvent::Type::failed;
+                payload = e.what();
+            }
+            catch (...)
+            {
+                type    = JobEvent::Type::failed;
+                payload = "unknown error";
+            }
+
+            if (context.isCancelled())
+                type = JobEvent::Type::cancelled;
+
+            home.post([done, id = context.state->id, type, payload = std::move(payload)] () mutable
+                {
+                    done(id, type, std::move(payload));
+                });
+        });
+
+    return true;
+}
+
+auto JobRegistry::cancel(uint64_t id) -> bool
+{
+    if (auto it = active.find(id); it != active.end())
+    {
+        it->second->token.cancel();
+        return true;
+    }
+
+    return false;
+}
+
+auto JobRegistry::running() const -> size_t
+{
+    return active.size();
+}
+
+auto JobRegistry::finish(uint64_t id, JobEvent::Type type, nlohmann::json payload) -> void
+{
+    auto it = active.find(id);
+
+    if (it == active.end())
+        return;
+
+    // Drop any report still queued, it would arrive after the result
+    {
+        std::lock_guard lock(it->second->mutex);
+        it->second->pending.reset();
+    }
+
+    active.erase(it);
+    onEvent({ id, type, std::move(payload) });
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "executor.h"
+#include "workerpool.h"
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+// Set by whoever wants a job to stop, polled by the job itself
+struct CancellationToken
+{
+    auto cancel() -> void { flag->store(true, std::memory_order_relaxed); }
+    auto isCancelled() const -> bool { return flag->load(std::memory_order_relaxed); }
+
+    std::shared_ptr<std::atomic<bool>> flag = std::make_shared<std::atomic<bool>>(false);
+};
+
+// Decides which progress reports are worth sending. A report goes out when
+// enough time has passed since the last one and the value moved by at
+// least minDelta; completion is always reported.
+struct ProgressThrottle
+{
+    using clock = std::chrono::steady_clock;
+
+    explicit ProgressThrottle(std::chrono::milliseconds interval = std::chrono::milliseconds(50),
+                              double minDelta = 0.01)
+        : interval(interval), minDelta(minDelta) { }
+
+    auto shouldEmit(double progress, clock::time_point now) -> bool;
+
+    std::chrono::milliseconds interval;
+    double minDelta;
+    std::optional<clock::time_point> lastTime;
+    double lastProgress = 0;
+};
+
+struct JobEvent
+{
+    enum class Type { progress, finished, failed, cancelled };
+
+    uint64_t id;
+    Type type;
+    nlohmann::json payload;
+};
+
+auto jobEventTypeName(JobEvent::Type type) -> const char*;
+
+// Handed to a running job on its worker thread
+struct JobContext
+{
+    auto isCancelled() const -> bool;
+    auto progress(double fraction, const nlohmann::json& detail = {}) -> void;
+
+    struct State;
+    std::shared_ptr<State> state;
+};
+
+// Runs named jobs on a worker pool. All events, including throttled
+// progress, are delivered on the home executor. Call start/cancel from
+// the home executor's thread only.
+struct JobRegistry
+{
+    using job_t   = std::function<nlohmann::json(JobContext&, const nlohmann::json&)>;
+    using event_t = std::function<void(const JobEvent&)>;
+    using clock_t = std::function<ProgressThrottle::clock::time_point()>;
+
+    JobRegistry(WorkerPool& pool, Executor& home, event_t&& onEvent);
+    ~JobRegistry();
+
+    auto registerJob(const std::string& name, job_t&& job) -> void;
+    auto start(uint64_t id, const std::string& name, const nlohmann::json& args) -> bool;
+    auto cancel(uint64_t id) -> bool;
+    auto running() const -> size_t;
+
+    ProgressThrottle throttle;
+    clock_t now = [] { return ProgressThrottle::clock::now(); };
+
+private:
+    auto finish(uint64_t id, JobEvent::Type type, nlohmann::json payload) -> void;
+
+    WorkerPool& pool;
+    Executor& home;
+    event_t onEvent;
+    std::map<std::string, job_t, std::less<>> jobs;
+    std::map<uint64_t, std::shared_ptr<JobContext::State>> active;
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+};
@@ -0,0 +1,165 @@
+#include "webviewinterface.h"
+#include "eventloop_linux.h"
+#include "startuptrace.h"
+#include "httpserver.h"
+#include "websocketserver.h"
+#include "bridgerouter.h"
+
+#include <nlohmann/json.hpp>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+
+// Headless backend: there is no page, so scripts go nowhere and loading
+// a url just runs it through onUrlRequest. Enough to drive and profile the
+// app's native side on machines without a GUI. With LOOKINGGLASS_HTTP_PORT
+// set, browsers connected to /__bridge stand in for the page.
+struct WebViewInterface::Impl
+{
+    BridgeRouter* router = nullptr;
+};
+
+static auto messageLoop() -> EpollEventLoop&
+{
+    static EpollEventLoop loop;
+    return loop;
+}
+
+auto getMessageLoop() -> EventLoop&
+{
+    return messageLoop();
+}
+
+WebViewInterface::~WebViewInterface()
+{
+    delete std::exchange(impl, nullptr);
+}
+
+auto WebViewInterface::execute(const std::string& script) -> void
+{
+}
+
+auto WebViewInterface::sendMessage(const std::string& name, const std::string& content) -> void
+{
+    if (onSendMessage)
+        onSendMessage(name, content);
+
+    if (impl && impl->router)
+        impl->router->sendMessage(name, content);
+}
+
+auto WebViewInterface::loadUrl(const std::string& url) -> void
+{
+    callOnMessageThread([this, url]
+        {
+            auto response = onUrlRequest({ .path = url });
+            const auto body = ! response                   ? std::string("not found")
+                            : response->filepath.empty() ? std::to_string(response->body().size())
+                                                         : response->filepath;
+
+            printf("Loaded %s: %s\n", url.c_str(), body.c_str());
+        });
+}
+
+auto WebViewInterface::loadHtml(const std::string& html) -> void
+{
+}
+
+auto startWebApp(WebViewInterface* iface) -> int
+{
+    startupTrace().mark("startWebApp");
+
+    auto& loop = messageLoop();
+
+    iface->impl = new WebViewInterface::Impl{};
+
+    // Quit cleanly on ctrl-c/kill. Worker threads may already exist, so
+    // rather than masking signals the handler pokes an eventfd, which is
+    // async-signal-safe, and the loop quits from there.
+    static int quitFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    loop.watch(quitFd, EPOLLIN, [&loop] (uint32_t)
+        {
+            loop.quit();
+        });
+
+    struct sigaction action{};
+    action.sa_handler = [] (int)
+    {
+        uint64_t one = 1;
+        [[maybe_unused]] auto n = write(quitFd, &one, sizeof(one));
+    };
+
+    sigaction(SIGINT,  &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // LOOKINGGLASS_HTTP_PORT serves the app's urls to browsers and load generators
+    HttpServer server(loop, [iface] (const HttpRequest& request)
+        {
+            const auto path = request.path == "/" ? std::string("index.html") : request.path.substr(1);
+            return iface->onUrlRequest({ .path = "local://" + path });
+        });
+
+    // Pages served that way reach onScriptMessage over a websocket on /__bridge,
+    // each with its ids and shapes kept apart from the others'
+    std::unique_ptr<BridgeRouter> router;
+
+    WebSocketServer sockets(loop, [&router] (WebSocketServer::client_t client, std::string_view text)
+        {
+            auto message = nlohmann::json::parse(text, nullptr, false);
+
+            if (message.is_discarded())
+            {
+                printf("Error: bad bridge message from client %llu\n", (unsigned long long) client);
+                return;
+            }
+
+            router->onMessage(client, message);
+        });
+
+    router = std::make_unique<BridgeRouter>(*iface, [&sockets] (BridgeRouter::client_t client, const std::string& text)
+        {
+            if (client)
+                sockets.send(client, text);
+            else
+                sockets.broadcast(text);
+        });
+
+    sockets.onClose = [&router] (WebSocketServer::client_t client)
+    {
+        router->onClose(client);
+    };
+
+    server.onUpgrade = [&sockets] (int fd, const HttpRequest& request, std::string leftover)
+    {
+        return request.path == "/__bridge" && sockets.adopt(fd, request, std::move(leftover));
+    };
+
+    iface->impl->router = router.get();
+
+    if (auto port = std::getenv("LOOKINGGLASS_HTTP_PORT"))
+    {
+        if (server.listen((uint16_t) std::atoi(port)))
+            printf("Serving http://127.0.0.1:%d/\n", server.getPort());
+    }
+
+    iface->onStart();
+    loop.run();
+
+    iface->impl->router = nullptr;
+    sockets.onClose     = nullptr;
+    sockets.close();
+    server.close();
+
+    loop.unwatch(quitFd);
+    iface->onStop();
+    startupTrace().flush();
+
+    return 0;
+}
@@ -4,8 +4,13 @@
 #import <WebKit/WebKit.h>
 
 #include "webviewinterface.h"
+#include "eventloop.h"
+#include "messagequeue.h"
+#include "timerscheduler.h"
+#include "startuptrace.h"
 
 #include <cassert>
+#include <chrono>
 #include <nlohmann/json.hpp>
 
 static auto nsStringToStdString(const NSString* string) -> std::string
@@ -19,7 +24,7 @@ static auto stdStringToNsString(const std::string& string) -> NSString*
     return [NSString stringWithUTF8String:string.c_str()];
 }
 
-static auto vecToNsData(const std::vector<uint8_t>& data) -> NSData*
+static auto vecToNsData(std::span<const uint8_t> data) -> NSData*
 {
     NSData* nsData = [NSData dataWithBytes:data.data() length:data.size()];
     return nsData;
@@ -52,30 +57,23 @@ WebViewInterface::~WebViewInterface()
     delete std::exchange(impl, nullptr);
 }
 
-auto WebViewInterface::getPreferences() const -> Preferences
-{
-    return {};
-}
 
-static auto stdFunctionToDispatchBlock(std::function<void()>&& callback) -> dispatch_block_t
+auto WebViewInterface::execute(const std::string& script) -> void
 {
-    auto cb = std::move(callback); // force block to capture by copy
-    return dispatch_block_create((dispatch_block_flags_t) 0, ^
-        {
-            cb();
-        });
-}
+    assert(impl != nullptr);
 
-auto WebViewInterface::callOnMessageThread(std::function<void()>&& callback) -> void
-{
-    dispatch_after(DISPATCH_TIME_NOW,
-                   dispatch_get_main_queue(),
-                   stdFunctionToDispatchBlock(std::move(callback)));
+    [impl->webView evaluateJavaScript:stdStringToNsString(script)
+                    completionHandler:nil];
 }
 
-auto WebViewInterface::execute(const std::string& script) -> void
+auto WebViewInterface::sendMessage(const std::string& name, const std::string& content) -> void
 {
-    assert(impl != nullptr);
+    if (onSendMessage)
+        onSendMessage(name, content);
+
+    // No web view while replaying headless
+    if (impl)
+        execute(name + "(..." + content + ");");
 }
 
 auto WebViewInterface::loadUrl(const std::string& urlString) -> void
@@ -96,68 +94,121 @@ auto WebViewInterface::loadHtml(const std::string& html) -> void
                           baseURL:nil];
 }
 
-auto WebViewInterface::makeTimer(int milliseconds, std::function<void()>&& function) -> std::unique_ptr<Timer>
+static auto steadyMilliseconds() -> uint64_t
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// The Cocoa run loop as an EventLoop. Posted callbacks are batched through
+// a MessageQueue with one dispatch_async_f wakeup per batch, so no block
+// is allocated per callback. Timers share one timing wheel driven by a
+// single dispatch timer source instead of an NSTimer each.
+struct CocoaEventLoop : EventLoop
 {
-    struct NativeTimer : Timer
+    CocoaEventLoop()
+        : queue([this]
+            {
+                dispatch_async_f(dispatch_get_main_queue(), this, [] (void* context)
+                    {
+                        static_cast<CocoaEventLoop*>(context)->queue.drain();
+                    });
+            }),
+          timers(steadyMilliseconds, [this] (std::optional<uint64_t> wakeAt)
+            {
+                if (! wakeAt)
+                {
+                    dispatch_source_set_timer(timerSource, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+                    return;
+                }
+
+                const auto now   = steadyMilliseconds();
+                const auto delay = *wakeAt > now ? *wakeAt - now : 0;
+
+                // The slack doubles as leeway so the OS can coalesce us too
+                dispatch_source_set_timer(timerSource,
+                                          dispatch_time(DISPATCH_TIME_NOW, (int64_t) delay * NSEC_PER_MSEC),
+                                          DISPATCH_TIME_FOREVER,
+                                          timers.slack * NSEC_PER_MSEC);
+            })
     {
-        NativeTimer(int milliseconds, std::function<void()>&& callback) : function(std::move(callback))
-        {
-            start(milliseconds);
-        }
+        timerSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
 
-        ~NativeTimer()
-        {
-            stop();
-        }
+        dispatch_set_context(timerSource, this);
+        dispatch_source_set_event_handler_f(timerSource, [] (void* context)
+            {
+                static_cast<CocoaEventLoop*>(context)->timers.fire();
+            });
 
-        auto start(int milliseconds) -> void override
-        {
-            stop();
-
-            const auto interval = milliseconds / (double) 1000;
-            timer = [NSTimer timerWithTimeInterval:interval
-                             repeats:YES
-                             block:^(NSTimer*)
-                             {
-                                 function();
-                             }];
-
-            [[NSRunLoop currentRunLoop] addTimer:timer
-                                         forMode:NSDefaultRunLoopMode];
-        }
+        dispatch_resume(timerSource);
+    }
 
-        auto stop() -> void override
-        {
-            if (! timer)
-                return;
+    auto run() -> void override
+    {
+        [NSApp run];
+    }
 
-            [timer invalidate];
-            timer = nullptr;
-        }
+    auto quit() -> void override
+    {
+        post([] { [NSApp terminate:nil]; });
+    }
 
-        auto tick() -> void override
-        {
-            function();
-        }
+    auto post(std::function<void()>&& callback) -> void override
+    {
+        queue.post(std::move(callback));
+    }
 
-        std::function<void()> function;
-        NSTimer* timer;
-    };
+    auto postDelayed(int milliseconds, std::function<void()>&& callback) -> void override
+    {
+        timers.postDelayed(milliseconds, std::move(callback));
+    }
+
+    auto makeTimer(int milliseconds, std::function<void()>&& function, TimerMode mode) -> std::unique_ptr<Timer> override
+    {
+        return timers.makeTimer(milliseconds, std::move(function), mode);
+    }
+
+    auto getTimers() -> TimerScheduler& override
+    {
+        return timers;
+    }
 
-    return std::make_unique<NativeTimer>(milliseconds, std::move(function));
+    MessageQueue queue;
+    TimerScheduler timers;
+    dispatch_source_t timerSource;
+};
+
+auto getMessageLoop() -> EventLoop&
+{
+    static CocoaEventLoop loop;
+    return loop;
 }
 
 static auto idToJson(id data)           -> nlohmann::json;
+static auto idNullToJson(id data)       -> nlohmann::json;
 static auto idNumberToJson(id data)     -> nlohmann::json;
 static auto idDateToJson(id data)       -> nlohmann::json;
 static auto idStringToJson(id data)     -> nlohmann::json;
 static auto idArrayToJson(id data)      -> nlohmann::json;
 static auto idDictionaryToJson(id data) -> nlohmann::json;
 
+static auto idNullToJson(id data) -> nlohmann::json
+{
+    return nullptr;
+}
+
 static auto idNumberToJson(id data) -> nlohmann::json
 {
     auto number = (NSNumber*) data;
-    return nsStringToStdString([number stringValue]);
+
+    // Keep numbers numeric, packed messages rely on integer shape ids
+    if (CFGetTypeID((__bridge CFTypeRef) number) == CFBooleanGetTypeID())
+        return (bool) [number boolValue];
+
+    if (CFNumberIsFloatType((__bridge CFNumberRef) number))
+        return [number doubleValue];
+
+    return [number longLongValue];
 }
 
 static auto idDateToJson(id data) -> nlohmann::json
@@ -173,18 +224,21 @@ static auto idStringToJson(id data) -> nlohmann::json
 
 static auto idArrayToJson(id data) -> nlohmann::json
 {
-    nlohmann::json result;
-    auto array = (NSArray*) data;
+    auto result = nlohmann::json::array();
+    auto array  = (NSArray*) data;
+    auto& vec   = result.get_ref<nlohmann::json::array_t&>();
+
+    vec.reserve([array count]);
 
     for (id v in array)
-        result += idToJson(v);
+        vec.emplace_back(idToJson(v));
 
     return result;
 }
 
 static auto idDictionaryToJson(id data) -> nlohmann::json
 {
-    nlohmann::json result;
+    auto result = nlohmann::json::object();
     auto dict = (NSDictionary*) data;
 
     for (NSString* key in dict)
@@ -195,6 +249,9 @@ static auto idDictionaryToJson(id data) -> nlohmann::json
 
 static auto idToJson(id data) -> nlohmann::json
 {
+    if (data == nil || [data isKindOfClass:[NSNull class]])
+        return idNullToJson(data);
+
     if ([data isKindOfClass:[NSNumber class]])
         return idNumberToJson(data);
 
@@ -245,11 +302,17 @@ static auto idToJson(id data) -> nlohmann::json
             auto nsResponse = createNSURLResponse(200, request.path, response->mimetype);
 
             [task didReceiveResponse:nsResponse];
-            [task didReceiveData:vecToNsData(response->data)];
+
+            if (! response->filepath.empty())
+                [task didReceiveData:[NSData dataWithContentsOfFile:stdStringToNsString(response->filepath)
+                                                            options:NSDataReadingMappedIfSafe
+                                                              error:nil]];
+            else
+                [task didReceiveData:vecToNsData(response->body())];
         }
         else
         {
-            auto nsResponse = createNSURLResponse(404, request.path, response->mimetype);
+            auto nsResponse = createNSURLResponse(404, request.path, "text/plain");
 
             [task didReceiveResponse:nsResponse];
         }
@@ -273,6 +336,8 @@ static auto idToJson(id data) -> nlohmann::json
 @implementation AppDelegate
     - (void)applicationDidFinishLaunching:(NSNotification *)aNotification
     {
+        startupTrace().mark("applicationDidFinishLaunching");
+
         // 1. Create the main window
         NSRect contentRect = NSMakeRect(100, 100, 1000, 700);
         NSWindowStyleMask styleMask = NSWindowStyleMaskTitled
@@ -309,9 +374,18 @@ static auto idToJson(id data) -> nlohmann::json
         _urlSchemeHandler.webViewInterface = _webViewInterface;
         [configuration setURLSchemeHandler:_urlSchemeHandler forURLScheme:@"local"];
 
+        for (const auto& source : _webViewInterface->getUserScripts())
+        {
+            auto script = [[WKUserScript alloc] initWithSource:stdStringToNsString(source)
+                                                 injectionTime:WKUserScriptInjectionTimeAtDocumentStart
+                                              forMainFrameOnly:YES];
+            [configuration.userContentController addUserScript:script];
+        }
+
         _webView = [[WKWebView alloc] initWithFrame:contentRect
                                       configuration:configuration];
         _webViewInterface->impl = new WebViewInterface::Impl{_webView};
+        startupTrace().mark("webViewCreated");
 
         _webView.autoresizingMask = NSViewWidthSizable
                                   | NSViewHeightSizable;
@@ -320,9 +394,29 @@ static auto idToJson(id data) -> nlohmann::json
         _window.contentView = _webView;
         [_window makeKeyAndOrderFront:nil];
 
+        // Throttle timers while the window can't be seen
+        [[NSNotificationCenter defaultCenter] addObserverForName:NSWindowDidChangeOcclusionStateNotification
+                                                          object:_window
+                                                           queue:nil
+                                                      usingBlock:^(NSNotification*)
+                                                      {
+                                                          const auto visible = (_window.occlusionState & NSWindowOcclusionStateVisible) != 0;
+                                                          getMessageLoop().getTimers().setBackground(! visible);
+                                                      }];
+
         _webViewInterface->onStart();
     }
 
+    - (void) applicationDidHide:(NSNotification*) aNotification
+    {
+        getMessageLoop().getTimers().setBackground(true);
+    }
+
+    - (void) applicationDidUnhide:(NSNotification*) aNotification
+    {
+        getMessageLoop().getTimers().setBackground(false);
+    }
+
     - (BOOL) applicationShouldTerminateAfterLastWindowClosed:(NSApplication*) sender
     {
         return YES;
@@ -331,5 +425,6 @@ static auto idToJson(id data) -> nlohmann::json
     - (void) applicationWillTerminate:(NSNotification*) aNotification
     {
         [self.webView.configuration.userContentController removeScriptMessageHandlerForName:@"myHandler"];
+        _webViewInterface->onStop();
     }
 @end
@@ -5,6 +5,8 @@ static AppDelegate* sAppDelegate;
 
 auto startWebApp(WebViewInterface* iface) -> int
 {
+    startupTrace().mark("startWebApp");
+
     @autoreleasepool
     {
         [NSApplication sharedApplication];
@@ -13,7 +15,7 @@ auto startWebApp(WebViewInterface* iface) -> int
         sAppDelegate.webViewInterface = iface;
 
         [NSApp setDelegate:sAppDelegate];
-        [NSApp run];
+        getMessageLoop().run();
     }
 
     return 0;
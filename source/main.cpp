@@ -1,145 +1,47 @@
+#include "webappinterface.h"
+#include "startuptrace.h"
+#include "replaylog.h"
+#include "replaydriver.h"
 
-
-#include "webviewinterface.h"
-#include <nlohmann/json.hpp>
-
+#include <cstdio>
 #include <string>
 #include <string_view>
-#include <filesystem>
-#include <fstream>
-#include <optional>
-#include <map>
 
-static auto toU8Vec(std::string_view string) -> std::vector<uint8_t>
+// Runs a session recorded with LOOKINGGLASS_RECORD without a window and
+// prints per-endpoint latencies
+static auto replay_session(WebAppInterface& app, const std::string& path, bool fast) -> int
 {
-    return { (const char*) string.begin(),
-             (const char*) string.end() };
-}
-
-static auto file_get_last_write_time(std::string_view filepath)
-{
-    using namespace std::filesystem;
-    std::error_code ec;
-
-    return last_write_time(path(filepath), ec).time_since_epoch()
-                                              .count();
-}
+    auto records = read_replay_log(path);
 
-static auto file_get_size(std::string_view filepath) -> size_t
-{
-    using namespace std::filesystem;
-    std::error_code ec;
-
-    return file_size(path(filepath), ec);
-}
-
-static auto file_read_binary(std::string_view filepath) -> std::optional<std::vector<uint8_t>>
-{
-    if (auto file = std::ifstream(filepath, std::ios::binary); file.is_open())
+    if (! records)
     {
-        std::vector<uint8_t> vec;
-
-        vec.resize(file_get_size(filepath));
-        file.read((char*) vec.data(), vec.size());
-
-        return std::make_optional(vec);
+        printf("Error: can't read replay log %s\n", path.c_str());
+        return 1;
     }
 
-    return std::nullopt;
-}
-
-static auto file_read_string(std::string_view filepath) -> std::optional<std::string>
-{
-    if (auto file = std::ifstream(filepath); file.is_open())
-    {
-        std::string string;
+    auto& loop = app.getEventLoop();
+    ReplayDriver driver(app, std::move(*records), fast ? ReplayDriver::Speed::fast : ReplayDriver::Speed::realtime);
 
-        while (! file.eof())
+    driver.start([&loop] (const nlohmann::json& report)
         {
-            static char buffer[1024]{};
-            auto n = file.readsome(buffer, sizeof(buffer));
-            string += { buffer, buffer + n };
-        }
-
-        return std::make_optional(string);
-    }
+            printf("%s\n", report.dump(2).c_str());
+            loop.quit();
+        });
 
-    return std::nullopt;
+    loop.run();
+    return 0;
 }
 
-struct WebAppInterface : WebViewInterface
+auto main(int argc, const char** argv) -> int
 {
-    using endpoint_t = std::function<void(const nlohmann::json&)>;
-    std::map<std::string, endpoint_t> functions;
-    Timer::ptr timer;
-
-    WebAppInterface()
-    {
-        registerScriptEndpoint("print", [] (const nlohmann::json& json)
-            {
-                auto string = json[0].get<std::string>();
-                printf("print(\"%s\")\n", string.c_str());
-            });
-    }
+    startupTrace().mark("main");
 
-    auto getWindowTitle() const -> const char* override
-    {
-        return "LookingGlass - Test App";
-    }
-
-    auto onStart() -> void override
-    {
-        loadUrl("local://index.html");
-    }
-
-    auto onScriptMessage(const nlohmann::json& message) -> bool override
-    {
-        try
-        {
-            auto key = message["name"].get<std::string>();
-            auto func = functions.at(key);
-            func(message["content"]);
-            return true;
-        }
-        catch(const std::exception & e)
-        {
-            auto json = message.dump();
-            printf("Error: bad script call: %s\n", json.c_str());
-        }
-
-        return false;
-    }
-
-    auto registerScriptEndpoint(const std::string& name, endpoint_t&& endpoint) -> void
-    {
-        functions[name] = std::move(endpoint);
-    }
-
-    auto onUrlRequest(const UrlRequest& request) -> std::unique_ptr<UrlResponse> override
-    {
-        constexpr std::string_view prefix = "local://";
-        constexpr auto root               = "/Users/chroma/Desktop/lookingglass/app/";
-
-        std::string path = root + request.path.substr(prefix.length());
-
-        printf("Request: %s\n", path.c_str());
-
-        if (auto data = file_read_binary(path))
-        {
-            auto response = std::make_unique<UrlResponse>();
-
-            response->data     = *data;
-            response->mimetype = "text/html";
-
-            return response;
-        }
+    WebAppInterface app;
+    app.startPrewarm();
 
-        return nullptr;
-    }
-};
+    // lookingglass --replay session.lgr [--fast]
+    if (argc >= 3 && std::string_view(argv[1]) == "--replay")
+        return replay_session(app, argv[2], argc >= 4 && std::string_view(argv[3]) == "--fast");
 
-auto main(int, const char**) -> int
-{
-    WebAppInterface app;
     return startWebApp(&app);
 }
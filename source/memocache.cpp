@@ -0,0 +1,177 @@
+#include "memocache.h"
+
+#include <algorithm>
+#include <functional>
+
+auto to_json(nlohmann::json& json, const MemoStats& stats) -> void
+{
+    json = {
+        { "hits",          stats.hits },
+        { "misses",        stats.misses },
+        { "evictions",     stats.evictions },
+        { "invalidations", stats.invalidations },
+        { "entries",       stats.entries },
+        { "bytes",         stats.bytes },
+        { "budget",        stats.budget },
+    };
+}
+
+MemoCache::MemoCache(size_t budgetBytes)
+{
+    stats.budget = budgetBytes;
+}
+
+auto MemoCache::hash(std::string_view endpoint, const nlohmann::json& args) -> uint64_t
+{
+    auto seed = (uint64_t) std::hash<std::string_view>{}(endpoint);
+    auto h    = (uint64_t) std::hash<nlohmann::json>{}(args);
+
+    return seed ^ (h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+auto MemoCache::find(std::string_view endpoint, const nlohmann::json& args) -> result_t
+{
+    auto [first, last] = index.equal_range(hash(endpoint, args));
+
+    for (auto it = first; it != last; ++it)
+    {
+        auto entry = it->second;
+
+        // Hashes can collide, only the exact arguments are a hit
+        if (entry->endpoint == endpoint && entry->args == args)
+        {
+            lru.splice(lru.begin(), lru, entry);
+            stats.hits++;
+            return entry->result;
+        }
+    }
+
+    stats.misses++;
+    return nullptr;
+}
+
+auto MemoCache::insert(std::string_view endpoint,
+                       const nlohmann::json& args,
+                       result_t result,
+                       const std::vector<std::string>& tags) -> void
+{
+    if (! result)
+        return;
+
+    const auto key   = hash(endpoint, args);
+    const auto bytes = sizeof(Entry) + endpoint.size() + args.dump().size() + result->size();
+
+    if (bytes > stats.budget)
+        return;
+
+    auto [first, last] = index.equal_range(key);
+
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->second->endpoint == endpoint && it->second->args == args)
+        {
+            erase(it->second);
+            break;
+        }
+    }
+
+    lru.push_front(Entry{ key, std::string(endpoint), args, std::move(result), tags, bytes });
+    index.emplace(key, lru.begin());
+
+    stats.entries++;
+    stats.bytes += bytes;
+
+    evictToBudget();
+}
+
+auto MemoCache::invalidate(std::string_view tag) -> size_t
+{
+    size_t count = 0;
+
+    for (auto it = lru.begin(); it != lru.end();)
+    {
+        auto next = std::next(it);
+
+        if (std::find(it->tags.begin(), it->tags.end(), tag) != it->tags.end())
+        {
+            erase(it);
+            count++;
+        }
+
+        it = next;
+    }
+
+    stats.invalidations += count;
+    return count;
+}
+
+auto MemoCache::invalidateEndpoint(std::string_view endpoint) -> size_t
+{
+    size_t count = 0;
+
+    for (auto it = lru.begin(); it != lru.end();)
+    {
+        auto next = std::next(it);
+
+        if (it->endpoint == endpoint)
+        {
+            erase(it);
+            count++;
+        }
+
+        it = next;
+    }
+
+    stats.invalidations += count;
+    return count;
+}
+
+auto MemoCache::clear() -> void
+{
+    stats.invalidations += lru.size();
+
+    lru.clear();
+    index.clear();
+
+    stats.entries = 0;
+    stats.bytes   = 0;
+}
+
+auto MemoCache::setBudget(size_t budgetBytes) -> void
+{
+    stats.budget = budgetBytes;
+    evictToBudget();
+}
+
+auto MemoCache::getStats() const -> MemoStats
+{
+    return stats;
+}
+
+auto MemoCache::erase(iterator_t entry) -> void
+{
+    auto [first, last] = index.equal_range(entry->key);
+
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->second == entry)
+        {
+            index.erase(it);
+            break;
+        }
+    }
+
+    stats.entries--;
+    stats.bytes -= entry->bytes;
+
+    lru.erase(entry);
+}
+
+auto MemoCache::evictToBudget() -> void
+{
+    while (stats.bytes > stats.budget && ! lru.empty())
+    {
+        erase(std::prev(lru.end()));
+        stats.evictions++;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Opt-in memoization for pure script endpoints. Results are stored already
+// serialized, keyed on a hash of the endpoint name and its JSON arguments.
+struct MemoOptions
+{
+    std::vector<std::string> tags;
+};
+
+struct MemoStats
+{
+    uint64_t hits          = 0;
+    uint64_t misses        = 0;
+    uint64_t evictions     = 0;
+    uint64_t invalidations = 0;
+    size_t   entries       = 0;
+    size_t   bytes         = 0;
+    size_t   budget        = 0;
+};
+
+auto to_json(nlohmann::json& json, const MemoStats& stats) -> void;
+
+struct MemoCache
+{
+    using result_t = std::shared_ptr<const std::string>;
+
+    explicit MemoCache(size_t budgetBytes = 4 * 1024 * 1024);
+
+    static auto hash(std::string_view endpoint, const nlohmann::json& args) -> uint64_t;
+
+    auto find(std::string_view endpoint, const nlohmann::json& args) -> result_t;
+    auto insert(std::string_view endpoint,
+                const nlohmann::json& args,
+                result_t result,
+                const std::vector<std::string>& tags) -> void;
+
+    auto invalidate(std::string_view tag) -> size_t;
+    auto invalidateEndpoint(std::string_view endpoint) -> size_t;
+    auto clear() -> void;
+
+    auto setBudget(size_t budgetBytes) -> void;
+    auto getStats() const -> MemoStats;
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        std::string endpoint;
+        nlohmann::json args;
+        result_t result;
+        std::vector<std::string> tags;
+        size_t bytes;
+    };
+
+    using iterator_t = std::list<Entry>::iterator;
+
+    auto erase(iterator_t it) -> void;
+    auto evictToBudget() -> void;
+
+    std::list<Entry> lru; // most recently used first
+    std::unordered_multimap<uint64_t, iterator_t> index;
+    MemoStats stats;
+};
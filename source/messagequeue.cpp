@@ -0,0 +1,56 @@
+#include "messagequeue.h"
+
+MessageQueue::MessageQueue(wakeup_t&& wakeup, std::chrono::microseconds budget)
+    : budget(budget), wakeup(std::move(wakeup))
+{
+}
+
+auto MessageQueue::post(std::function<void()>&& callback) -> void
+{
+    queue.push(std::move(callback));
+
+    if (! scheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+        wakeup();
+    }
+}
+
+auto MessageQueue::drain() -> size_t
+{
+    using clock = std::chrono::steady_clock;
+
+    // Cleared before popping so a post racing with the end of this drain
+    // always schedules another one.
+    scheduled.store(false, std::memory_order_release);
+
+    const auto deadline = clock::now() + budget;
+    size_t count = 0;
+
+    while (auto callback = queue.pop())
+    {
+        (*callback)();
+        count++;
+
+        if (clock::now() >= deadline && ! queue.empty())
+        {
+            overruns++;
+
+            if (! scheduled.exchange(true, std::memory_order_acq_rel))
+            {
+                wakeups.fetch_add(1, std::memory_order_relaxed);
+                wakeup();
+            }
+
+            break;
+        }
+    }
+
+    drained += count;
+    return count;
+}
+
+auto MessageQueue::getStats() const -> Stats
+{
+    return { wakeups.load(std::memory_order_relaxed), drained, overruns };
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mpscqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+// Callbacks posted from any thread, run in batches on the message thread.
+// The platform is woken once per batch rather than once per callback, and
+// a drain stops after its time budget so input and painting get a turn;
+// whatever is left is picked up by the next wakeup.
+struct MessageQueue
+{
+    using wakeup_t = std::function<void()>;
+
+    explicit MessageQueue(wakeup_t&& wakeup,
+                          std::chrono::microseconds budget = std::chrono::milliseconds(4));
+
+    auto post(std::function<void()>&& callback) -> void;
+    auto drain() -> size_t;
+
+    struct Stats
+    {
+        uint64_t wakeups   = 0;
+        uint64_t drained   = 0;
+        uint64_t overruns  = 0;
+    };
+
+    auto getStats() const -> Stats;
+
+    std::chrono::microseconds budget;
+
+private:
+    wakeup_t wakeup;
+    MpscQueue<std::function<void()>> queue;
+    std::atomic<bool> scheduled = false;
+    std::atomic<uint64_t> wakeups = 0;
+    uint64_t drained  = 0;
+    uint64_t overruns = 0;
+};
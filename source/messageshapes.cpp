@@ -0,0 +1,130 @@
+#include "messageshapes.h"
+
+#include <stdexcept>
+
+auto MessageShape::slot(std::string_view key) const -> std::optional<size_t>
+{
+    // Shapes are small, a linear scan beats hashing the key
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i] == key)
+            return i;
+
+    return std::nullopt;
+}
+
+auto ShapeView::contains(std::string_view key) const -> bool
+{
+    if (auto index = shape.slot(key))
+        return *index + 1 < packed.size();
+
+    return false;
+}
+
+auto ShapeView::operator[](std::string_view key) const -> const nlohmann::json&
+{
+    if (auto index = shape.slot(key))
+        return packed.at(*index + 1);
+
+    throw std::out_of_range("shape " + std::to_string(shape.id) + " has no key " + std::string(key));
+}
+
+auto ShapeRegistry::add(uint32_t id, std::vector<std::string> keys) -> bool
+{
+    if (id >= maxShapes || keys.empty())
+        return false;
+
+    if (id >= shapes.size())
+        shapes.resize(id + 1);
+
+    shapes[id] = MessageShape{ id, std::move(keys) };
+    return true;
+}
+
+auto ShapeRegistry::find(uint32_t id) const -> const MessageShape*
+{
+    if (id < shapes.size() && ! shapes[id].keys.empty())
+        return &shapes[id];
+
+    return nullptr;
+}
+
+auto ShapeRegistry::view(const nlohmann::json& packed) const -> std::optional<ShapeView>
+{
+    if (! packed.is_array() || packed.empty() || ! packed[0].is_number_integer())
+        return std::nullopt;
+
+    if (auto id = packed[0].get<int64_t>(); id < 0 || id >= maxShapes)
+        return std::nullopt;
+
+    if (auto shape = find(packed[0].get<uint32_t>()))
+        return ShapeView{ *shape, packed };
+
+    return std::nullopt;
+}
+
+auto ShapeRegistry::pack(uint32_t id, const nlohmann::json& object) const -> nlohmann::json
+{
+    auto shape = find(id);
+
+    if (! shape || ! object.is_object())
+        return nullptr;
+
+    auto packed = nlohmann::json::array();
+    auto& array = packed.get_ref<nlohmann::json::array_t&>();
+
+    array.reserve(shape->keys.size() + 1);
+    array.emplace_back(id);
+
+    for (const auto& key : shape->keys)
+    {
+        auto it = object.find(key);
+        array.emplace_back(it != object.end() ? *it : nlohmann::json());
+    }
+
+    return packed;
+}
+
+auto ShapeRegistry::unpack(const nlohmann::json& packed) const -> nlohmann::json
+{
+    auto view = this->view(packed);
+
+    if (! view)
+        return nullptr;
+
+    auto object = nlohmann::json::object();
+    const auto& keys = view->shape.keys;
+
+    for (size_t i = 0; i < keys.size() && i + 1 < packed.size(); i++)
+        object[keys[i]] = packed[i + 1];
+
+    return object;
+}
+
+auto decode_script_message(const ShapeRegistry& shapes, const nlohmann::json& message) -> std::optional<ScriptMessage>
+{
+    if (message.is_array())
+    {
+        if (auto view = shapes.view(message))
+            return from_shape<ScriptMessage>(*view);
+
+        return std::nullopt;
+    }
+
+    if (! message.is_object())
+        return std::nullopt;
+
+    // The same rules as from_shape: null or missing keeps the default, a
+    // value of the wrong type throws
+    ScriptMessage decoded;
+
+    if (auto it = message.find("name"); it != message.end() && ! it->is_null())
+        it->get_to(decoded.name);
+
+    if (auto it = message.find("content"); it != message.end())
+        decoded.content = &*it;
+
+    if (auto it = message.find("id"); it != message.end() && ! it->is_null())
+        it->get_to(decoded.id);
+
+    return decoded;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// A shape is an ordered list of keys registered once by the page.
+// Packed messages are then sent as positional arrays tagged with the
+// shape id: [id, value0, value1, ...], value N belonging to key N.
+struct MessageShape
+{
+    uint32_t id = 0;
+    std::vector<std::string> keys;
+
+    auto slot(std::string_view key) const -> std::optional<size_t>;
+};
+
+struct ShapeView
+{
+    const MessageShape& shape;
+    const nlohmann::json& packed;
+
+    auto contains(std::string_view key) const -> bool;
+    auto operator[](std::string_view key) const -> const nlohmann::json&;
+
+    template <typename T>
+    auto get(std::string_view key) const -> T
+    {
+        return (*this)[key].get<T>();
+    }
+
+    // Writes the key's value into out, leaves out alone when the message
+    // doesn't carry it or carries null (what pack() sends for missing keys)
+    template <typename T>
+    auto read(std::string_view key, T& out) const -> bool
+    {
+        if (auto index = shape.slot(key); index && *index + 1 < packed.size() && ! packed[*index + 1].is_null())
+        {
+            packed[*index + 1].get_to(out);
+            return true;
+        }
+
+        return false;
+    }
+
+    // Points at the value instead of copying it, for ones that may be large
+    auto read(std::string_view key, const nlohmann::json*& out) const -> bool
+    {
+        if (auto index = shape.slot(key); index && *index + 1 < packed.size())
+        {
+            out = &packed[*index + 1];
+            return true;
+        }
+
+        return false;
+    }
+};
+
+// Maps a struct's fields to shape keys for from_shape, e.g.
+//
+//   template <> struct ShapeFields<Call>
+//   {
+//       static constexpr auto fields = std::make_tuple(shape_field("name", &Call::name),
+//                                                      shape_field("id",   &Call::id));
+//   };
+template <typename T>
+struct ShapeFields;
+
+template <typename Member>
+struct ShapeField
+{
+    std::string_view key;
+    Member member;
+};
+
+template <typename Member>
+constexpr auto shape_field(std::string_view key, Member member) -> ShapeField<Member>
+{
+    return { key, member };
+}
+
+// Decodes a packed message straight into T, no intermediate object. Keys
+// the shape lacks keep T's defaults, values of the wrong type throw like
+// ShapeView::get.
+template <typename T>
+auto from_shape(const ShapeView& view) -> T
+{
+    T value{};
+
+    std::apply([&view, &value] (const auto&... field) { (view.read(field.key, value.*field.member), ...); },
+               ShapeFields<T>::fields);
+
+    return value;
+}
+
+struct ShapeRegistry
+{
+    static constexpr uint32_t maxShapes = 1024;
+
+    auto add(uint32_t id, std::vector<std::string> keys) -> bool;
+    auto find(uint32_t id) const -> const MessageShape*;
+
+    auto view(const nlohmann::json& packed) const -> std::optional<ShapeView>;
+    auto pack(uint32_t id, const nlohmann::json& object) const -> nlohmann::json;
+    auto unpack(const nlohmann::json& packed) const -> nlohmann::json;
+
+    std::vector<MessageShape> shapes;
+};
+
+// A script call in either form bridge.js sends, { name, content, id } or
+// packed. content points into the message, id is 0 for calls without a reply.
+struct ScriptMessage
+{
+    std::string name;
+    const nlohmann::json* content = nullptr;
+    int64_t id = 0;
+};
+
+template <>
+struct ShapeFields<ScriptMessage>
+{
+    static constexpr auto fields = std::make_tuple(shape_field("name",    &ScriptMessage::name),
+                                                   shape_field("content", &ScriptMessage::content),
+                                                   shape_field("id",      &ScriptMessage::id));
+};
+
+// nullopt for messages of an unknown shape or neither form. Used by the app
+// and the replay driver alike, so both read a message the same way.
+auto decode_script_message(const ShapeRegistry& shapes, const nlohmann::json& message) -> std::optional<ScriptMessage>;
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <utility>
+
+// Lock-free multi-producer single-consumer queue (Vyukov's intrusive
+// design with a stub node). push() is wait-free, pop() is called from
+// one consumer thread only.
+template <typename T>
+struct MpscQueue
+{
+    MpscQueue() : head(&stub), tail(&stub) { }
+
+    ~MpscQueue()
+    {
+        while (pop()) { }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    auto operator=(const MpscQueue&) -> MpscQueue& = delete;
+
+    auto push(T value) -> void
+    {
+        push(new Node{ {}, std::move(value) });
+    }
+
+    auto pop() -> std::optional<T>
+    {
+        auto node = tail;
+        auto next = node->next.load(std::memory_order_acquire);
+
+        if (node == &stub)
+        {
+            if (! next)
+                return std::nullopt;
+
+            tail = next;
+            node = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (! next)
+        {
+            // A producer has swapped head but not linked its node yet,
+            // it is a couple of instructions away so wait it out.
+            while (node != head.load(std::memory_order_acquire) && ! (next = node->next.load(std::memory_order_acquire)))
+                std::this_thread::yield();
+
+            if (! next)
+            {
+                push(&stub);
+                next = node->next.load(std::memory_order_acquire);
+
+                while (! next)
+                {
+                    std::this_thread::yield();
+                    next = node->next.load(std::memory_order_acquire);
+                }
+            }
+        }
+
+        tail = next;
+
+        auto value = std::move(*node->value);
+        delete node;
+        return value;
+    }
+
+    auto empty() const -> bool
+    {
+        return tail == &stub && ! stub.next.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next = nullptr;
+        std::optional<T> value;
+    };
+
+    auto push(Node* node) -> void
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        auto previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    Node stub;
+    std::atomic<Node*> head;
+    Node* tail;
+};
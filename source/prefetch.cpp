@@ -0,0 +1,154 @@
+#include "prefetch.h"
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+SubresourcePrefetch::SubresourcePrefetch(WorkerPool& pool, read_t&& read, PrefetchOptions options)
+    : options(options), pool(pool), read(std::move(read))
+{
+}
+
+SubresourcePrefetch::~SubresourcePrefetch()
+{
+    group.wait();
+}
+
+auto SubresourcePrefetch::start(const std::string& root, const std::vector<std::string>& paths) -> void
+{
+    const auto now = clock::now();
+    std::lock_guard lock(mutex);
+
+    sweep(now);
+
+    for (const auto& path : paths)
+    {
+        if (entries.contains(path))
+            continue;
+
+        auto promise = std::make_shared<std::promise<Loaded>>();
+        entries[path] = { promise->get_future(), now };
+        stats.started++;
+
+        group.run([this, file = root + path, promise]
+            {
+                const auto begin = clock::now();
+                Loaded loaded{ read(file), clock::now() - begin };
+
+                if (loaded.data)
+                {
+                    std::lock_guard lock(mutex);
+
+                    if (bufferedBytes + loaded.data->size() > options.maxBytes)
+                    {
+                        stats.overBudget++;
+                        loaded.data.reset();
+                    }
+                    else
+                    {
+                        bufferedBytes += loaded.data->size();
+                        stats.bytes   += loaded.data->size();
+                    }
+                }
+
+                promise->set_value(std::move(loaded));
+            });
+    }
+}
+
+auto SubresourcePrefetch::take(const std::string& path) -> data_t
+{
+    std::future<Loaded> future;
+
+    {
+        std::lock_guard lock(mutex);
+
+        sweep(clock::now());
+
+        auto it = entries.find(path);
+
+        if (it == entries.end())
+        {
+            stats.misses++;
+            return std::nullopt;
+        }
+
+        future = std::move(it->second.loaded);
+        entries.erase(it);
+    }
+
+    const auto begin = clock::now();
+    const auto ready = future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    auto loaded      = future.get();
+    const auto wait  = clock::now() - begin;
+
+    std::lock_guard lock(mutex);
+
+    if (! loaded.data)
+    {
+        stats.misses++;
+        return std::nullopt;
+    }
+
+    bufferedBytes -= loaded.data->size();
+
+    stats.hits++;
+    stats.waited  += ready ? 0 : 1;
+    stats.waitUs  += (uint64_t) duration_cast<microseconds>(wait).count();
+    stats.savedUs += (uint64_t) std::max<int64_t>(0, duration_cast<microseconds>(loaded.readTime - wait).count());
+
+    return std::move(loaded.data);
+}
+
+auto SubresourcePrefetch::getStats() const -> PrefetchStats
+{
+    std::lock_guard lock(mutex);
+    return stats;
+}
+
+auto SubresourcePrefetch::wait() -> void
+{
+    group.wait();
+}
+
+// Drops finished reads nobody asked for in time
+auto SubresourcePrefetch::sweep(clock::time_point now) -> void
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        auto& entry = it->second;
+
+        if (now - entry.started < options.ttl || entry.loaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+
+        if (const auto loaded = entry.loaded.get(); loaded.data)
+        {
+            bufferedBytes     -= loaded.data->size();
+            stats.wastedBytes += loaded.data->size();
+        }
+
+        stats.expired++;
+        it = entries.erase(it);
+    }
+}
+
+auto to_json(nlohmann::json& json, const PrefetchStats& stats) -> void
+{
+    const auto taken = stats.hits + stats.misses;
+
+    json = {
+        { "started",     stats.started },
+        { "hits",        stats.hits },
+        { "waited",      stats.waited },
+        { "misses",      stats.misses },
+        { "hitRate",     taken ? (double) stats.hits / (double) taken : 0.0 },
+        { "expired",     stats.expired },
+        { "overBudget",  stats.overBudget },
+        { "bytes",       stats.bytes },
+        { "wastedBytes", stats.wastedBytes },
+        { "savedUs",     stats.savedUs },
+        { "waitUs",      stats.waitUs }
+    };
+}
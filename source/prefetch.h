@@ -0,0 +1,85 @@
+#pragma once
+
+#include "workerpool.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct PrefetchOptions
+{
+    std::chrono::milliseconds ttl{ 5000 }; // unclaimed reads are dropped after this
+    size_t maxBytes = 16 * 1024 * 1024;    // buffered at once, reads past it are dropped
+};
+
+struct PrefetchStats
+{
+    uint64_t started     = 0;
+    uint64_t hits        = 0;
+    uint64_t waited      = 0; // hits that were still being read
+    uint64_t misses      = 0; // takes with nothing buffered
+    uint64_t expired     = 0;
+    uint64_t overBudget  = 0;
+    uint64_t bytes       = 0;
+    uint64_t wastedBytes = 0;
+    uint64_t savedUs     = 0; // read time hits didn't spend waiting
+    uint64_t waitUs      = 0;
+};
+
+auto to_json(nlohmann::json& json, const PrefetchStats& stats) -> void;
+
+// Reads a page's subresources on the worker pool as soon as the page is
+// served, so the requests that follow once it's parsed come from memory.
+// Unlike AssetPrewarm it runs for every page and buffers only briefly.
+struct SubresourcePrefetch
+{
+    using data_t = std::optional<std::vector<uint8_t>>;
+    using read_t = std::function<data_t(const std::string& path)>;
+    using clock  = std::chrono::steady_clock;
+
+    SubresourcePrefetch(WorkerPool& pool, read_t&& read, PrefetchOptions options = {});
+    ~SubresourcePrefetch();
+
+    // Paths are relative to root, anything already buffered or in flight is skipped
+    auto start(const std::string& root, const std::vector<std::string>& paths) -> void;
+
+    // Hands over a buffered asset, waiting for it if it is still being read.
+    // nullopt when there's none, the caller reads it itself.
+    auto take(const std::string& path) -> data_t;
+
+    auto getStats() const -> PrefetchStats;
+    auto wait() -> void;
+
+    PrefetchOptions options;
+
+private:
+    struct Loaded
+    {
+        data_t data;
+        clock::duration readTime{};
+    };
+
+    struct Entry
+    {
+        std::future<Loaded> loaded;
+        clock::time_point started;
+    };
+
+    auto sweep(clock::time_point now) -> void;
+
+    WorkerPool& pool;
+    read_t read;
+    TaskGroup group{ pool };
+    mutable std::mutex mutex;
+    std::map<std::string, Entry, std::less<>> entries;
+    size_t bufferedBytes = 0;
+    PrefetchStats stats;
+};
@@ -0,0 +1,120 @@
+#include "prewarm.h"
+#include "htmlinliner.h"
+
+#include <chrono>
+#include <cstdio>
+
+AssetPrewarm::AssetPrewarm(WorkerPool& pool, read_t&& read) : pool(pool), read(std::move(read))
+{
+}
+
+AssetPrewarm::~AssetPrewarm()
+{
+    group.wait();
+}
+
+auto AssetPrewarm::start(const std::string& assetRoot, const std::vector<std::string>& paths) -> void
+{
+    root = assetRoot;
+
+    for (auto& path : paths)
+        warm(path);
+}
+
+auto AssetPrewarm::startConfig(const std::string& path) -> void
+{
+    auto promise = std::make_shared<std::promise<nlohmann::json>>();
+    config       = promise->get_future().share();
+
+    group.run([this, path, promise]
+        {
+            auto json = nlohmann::json();
+
+            if (auto data = read(path))
+            {
+                json = nlohmann::json::parse(data->begin(), data->end(), nullptr, false);
+
+                if (json.is_discarded())
+                {
+                    printf("Error: bad config: %s\n", path.c_str());
+                    json = nullptr;
+                }
+            }
+
+            promise->set_value(std::move(json));
+        });
+}
+
+auto AssetPrewarm::take(const std::string& path) -> std::optional<data_t>
+{
+    std::shared_future<data_t> future;
+
+    {
+        std::lock_guard lock(mutex);
+
+        auto it = assets.find(path);
+
+        // An erased entry stays behind as an invalid future, so a page
+        // referencing it again isn't warmed a second time
+        if (it == assets.end() || ! it->second.valid())
+            return std::nullopt;
+
+        future = std::exchange(it->second, {});
+    }
+
+    // Still being read: the caller is quicker reading it itself than
+    // waiting behind whatever else is queued on the pool
+    if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return std::nullopt;
+
+    return future.get();
+}
+
+auto AssetPrewarm::contains(const std::string& path) const -> bool
+{
+    std::lock_guard lock(mutex);
+
+    auto it = assets.find(path);
+    return it != assets.end() && it->second.valid();
+}
+
+auto AssetPrewarm::getConfig() const -> nlohmann::json
+{
+    return config.valid() ? config.get() : nlohmann::json();
+}
+
+auto AssetPrewarm::wait() -> void
+{
+    group.wait();
+}
+
+auto AssetPrewarm::warm(const std::string& path) -> void
+{
+    auto promise = std::make_shared<std::promise<data_t>>();
+
+    {
+        std::lock_guard lock(mutex);
+
+        if (! assets.try_emplace(path, promise->get_future().share()).second)
+            return;
+    }
+
+    group.run([this, path, promise]
+        {
+            auto data = read(root + path);
+
+            if (data && path.ends_with(".html"))
+                scan(path, *data);
+
+            promise->set_value(std::move(data));
+        });
+}
+
+auto AssetPrewarm::scan(const std::string& path, const std::vector<uint8_t>& data) -> void
+{
+    const auto slash = path.rfind('/');
+    const auto base  = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+
+    for (auto& reference : find_subresources({ (const char*) data.data(), data.size() }))
+        warm(base + reference);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "workerpool.h"
+
+#include <nlohmann/json.hpp>
+
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Reads the first page's assets and the app config on the worker pool while
+// the native window is still being built, so the first url requests are
+// served from memory. Html files are scanned for the local subresources
+// the inliner would see (find_subresources), which are warmed as well.
+struct AssetPrewarm
+{
+    using data_t = std::optional<std::vector<uint8_t>>;
+    using read_t = std::function<data_t(const std::string& path)>;
+
+    AssetPrewarm(WorkerPool& pool, read_t&& read);
+    ~AssetPrewarm();
+
+    // Paths are relative to root, e.g. "index.html"
+    auto start(const std::string& root, const std::vector<std::string>& paths) -> void;
+    auto startConfig(const std::string& path) -> void;
+
+    // Hands over a warmed asset if it has been read, nullopt if it hasn't
+    // (or is still being read) and the caller should read it itself.
+    // Assets are only handed over once, later requests go to disk.
+    auto take(const std::string& path) -> std::optional<data_t>;
+
+    // Warmed or being warmed, and not handed over yet
+    auto contains(const std::string& path) const -> bool;
+
+    // Parsed config, or null if there is none or it doesn't parse
+    auto getConfig() const -> nlohmann::json;
+
+    auto wait() -> void;
+
+private:
+    auto warm(const std::string& path) -> void;
+    auto scan(const std::string& path, const std::vector<uint8_t>& data) -> void;
+
+    WorkerPool& pool;
+    read_t read;
+    TaskGroup group{ pool };
+    std::string root;
+    mutable std::mutex mutex;
+    std::map<std::string, std::shared_future<data_t>> assets;
+    std::shared_future<nlohmann::json> config;
+};
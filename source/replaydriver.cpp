@@ -0,0 +1,163 @@
+#include "replaydriver.h"
+#include "eventloop.h"
+
+static auto elapsed_ns(ReplayDriver::clock::time_point since) -> uint64_t
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(ReplayDriver::clock::now() - since).count();
+}
+
+ReplayDriver::ReplayDriver(WebViewInterface& app, std::vector<ReplayRecord> records, Speed speed)
+    : app(app), loop(app.getEventLoop()), records(std::move(records)), speed(speed)
+{
+}
+
+auto ReplayDriver::start(done_t&& onDone) -> void
+{
+    done    = std::move(onDone);
+    started = clock::now();
+
+    app.onSendMessage = [this] (const std::string& name, const std::string& content)
+    {
+        onMessageSent(name, content);
+    };
+
+    loop.post([this] { step(); });
+}
+
+auto ReplayDriver::report() const -> nlohmann::json
+{
+    const auto ms = [] (auto duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+
+    auto endpoints = nlohmann::json::object();
+
+    for (auto& [name, histogram] : latencies)
+        endpoints[name] = histogram;
+
+    return {
+        { "records",    records.size() },
+        { "speed",      speed == Speed::fast ? "fast" : "realtime" },
+        { "recordedMs", records.empty() ? 0.0 : (double) records.back().time / 1000.0 },
+        { "wallMs",     ms(finished - started) },
+        { "timerFires", timerFires },
+        { "failures",   failures },
+        { "unanswered", pendingReplies.size() },
+        { "endpoints",  std::move(endpoints) },
+    };
+}
+
+auto ReplayDriver::step() -> void
+{
+    if (next == records.size())
+    {
+        finished = clock::now();
+        return waitForReplies();
+    }
+
+    replay(records[next++]);
+
+    if (next == records.size() || speed == Speed::fast)
+        return loop.post([this] { step(); });
+
+    // Realtime: wait until the next record is due relative to the start
+    const auto due   = started + std::chrono::microseconds(records[next].time);
+    const auto delay = std::chrono::ceil<std::chrono::milliseconds>(due - clock::now()).count();
+
+    if (delay > 0)
+        loop.postDelayed((int) delay, [this] { step(); });
+    else
+        loop.post([this] { step(); });
+}
+
+auto ReplayDriver::replay(const ReplayRecord& record) -> void
+{
+    switch (record.type)
+    {
+        case ReplayRecord::Type::scriptMessage:
+        {
+            auto message = record.message();
+
+            if (message.is_discarded())
+                failures++;
+            else
+                replayMessage(message);
+
+            break;
+        }
+
+        case ReplayRecord::Type::urlRequest:
+        {
+            const auto start = clock::now();
+
+            if (! app.onUrlRequest({ .path = record.payload }))
+                failures++;
+
+            latencies["url:" + record.payload].record(elapsed_ns(start));
+            break;
+        }
+
+        case ReplayRecord::Type::timerFire:
+            timerFires++;
+            break;
+    }
+}
+
+auto ReplayDriver::replayMessage(const nlohmann::json& message) -> void
+{
+    std::string name;
+    int64_t id = 0;
+
+    // Read the way onScriptMessage reads it, tracking shapes as the page registers them
+    try
+    {
+        if (auto call = decode_script_message(shapes, message))
+        {
+            name = std::move(call->name);
+            id   = call->id;
+
+            if (name == "__shape" && call->content)
+                shapes.add(call->content->at(0).get<uint32_t>(), call->content->at(1).get<std::vector<std::string>>());
+        }
+    }
+    catch (const std::exception&)
+    {
+        // The app turns it down as a bad call, replay it all the same
+    }
+
+    if (id > 0)
+        pendingReplies[id] = { "reply:" + name, clock::now() };
+
+    const auto start = clock::now();
+
+    if (! app.onScriptMessage(message))
+        failures++;
+
+    latencies["script:" + name].record(elapsed_ns(start));
+}
+
+auto ReplayDriver::onMessageSent(const std::string& name, const std::string& content) -> void
+{
+    if (name != "__reply" && name != "__reject")
+        return;
+
+    // content is "[id, ...]"
+    const auto id = std::strtoll(content.c_str() + 1, nullptr, 10);
+    auto it       = pendingReplies.find(id);
+
+    if (it == pendingReplies.end())
+        return;
+
+    latencies[it->second.first].record(elapsed_ns(it->second.second));
+    failures += name == "__reject";
+    pendingReplies.erase(it);
+}
+
+auto ReplayDriver::waitForReplies() -> void
+{
+    if (pendingReplies.empty() || clock::now() - finished > replyTimeout)
+    {
+        app.onSendMessage = nullptr;
+        return done(report());
+    }
+
+    loop.postDelayed(10, [this] { waitForReplies(); });
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "histogram.h"
+#include "messageshapes.h"
+#include "replaylog.h"
+#include "webviewinterface.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+struct EventLoop;
+
+// Feeds a recorded session back into an app on its message thread, either
+// at the recorded pace or back to back, timing every script message and
+// url request per endpoint. Invokes are also timed until their reply.
+// Recorded timer fires aren't replayed, the app's own timers still run.
+struct ReplayDriver
+{
+    using clock  = std::chrono::steady_clock;
+    using done_t = std::function<void(const nlohmann::json& report)>;
+
+    enum class Speed
+    {
+        realtime,
+        fast
+    };
+
+    // How long to wait for outstanding replies once the log runs out
+    static constexpr auto replyTimeout = std::chrono::seconds(5);
+
+    ReplayDriver(WebViewInterface& app, std::vector<ReplayRecord> records, Speed speed);
+
+    auto start(done_t&& done) -> void;
+    auto report() const -> nlohmann::json;
+
+private:
+    auto step() -> void;
+    auto replay(const ReplayRecord& record) -> void;
+    auto replayMessage(const nlohmann::json& message) -> void;
+    auto onMessageSent(const std::string& name, const std::string& content) -> void;
+    auto waitForReplies() -> void;
+
+    WebViewInterface& app;
+    EventLoop& loop;
+    std::vector<ReplayRecord> records;
+    Speed speed;
+    size_t next = 0;
+    clock::time_point started;
+    clock::time_point finished;
+    ShapeRegistry shapes;
+    std::map<std::string, LatencyHistogram, std::less<>> latencies;
+    std::map<int64_t, std::pair<std::string, clock::time_point>> pendingReplies;
+    uint64_t timerFires = 0;
+    uint64_t failures   = 0;
+    done_t done;
+};
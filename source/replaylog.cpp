@@ -0,0 +1,173 @@
+#include "replaylog.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+static constexpr char magic[4] = { 'L', 'G', 'R', 'P' };
+
+static auto put_varint(std::string& out, uint64_t value) -> void
+{
+    while (value >= 0x80)
+    {
+        out += (char) (value | 0x80);
+        value >>= 7;
+    }
+
+    out += (char) value;
+}
+
+static auto get_varint(std::string_view& in) -> std::optional<uint64_t>
+{
+    uint64_t value = 0;
+
+    for (int shift = 0; shift < 64 && ! in.empty(); shift += 7)
+    {
+        const auto byte = (uint8_t) in.front();
+        in.remove_prefix(1);
+        value |= (uint64_t) (byte & 0x7f) << shift;
+
+        if (! (byte & 0x80))
+            return value;
+    }
+
+    return std::nullopt;
+}
+
+auto ReplayRecord::message() const -> nlohmann::json
+{
+    return nlohmann::json::from_cbor(payload, true, false);
+}
+
+auto ReplayRecord::timerId() const -> uint64_t
+{
+    std::string_view in = payload;
+    return get_varint(in).value_or(0);
+}
+
+ReplayWriter::ReplayWriter(const std::string& path) : file(path, std::ios::binary | std::ios::trunc)
+{
+    if (! file)
+    {
+        printf("Error: can't record to %s\n", path.c_str());
+        return;
+    }
+
+    file.write(magic, sizeof(magic));
+    file.put((char) (version & 0xff));
+    file.put((char) (version >> 8));
+}
+
+ReplayWriter::~ReplayWriter()
+{
+    flush();
+}
+
+auto ReplayWriter::scriptMessage(const nlohmann::json& message) -> void
+{
+    const auto cbor = nlohmann::json::to_cbor(message);
+    write(ReplayRecord::Type::scriptMessage, cbor.data(), cbor.size());
+}
+
+auto ReplayWriter::urlRequest(const std::string& url) -> void
+{
+    write(ReplayRecord::Type::urlRequest, url.data(), url.size());
+}
+
+auto ReplayWriter::timerFired(uint64_t id) -> void
+{
+    std::string payload;
+    put_varint(payload, id);
+    write(ReplayRecord::Type::timerFire, payload.data(), payload.size());
+}
+
+auto ReplayWriter::flush() -> void
+{
+    std::lock_guard lock(mutex);
+    file.flush();
+}
+
+auto ReplayWriter::nextTimerId() -> uint64_t
+{
+    std::lock_guard lock(mutex);
+    return ++timers;
+}
+
+auto ReplayWriter::write(ReplayRecord::Type type, const void* data, size_t size) -> void
+{
+    const auto now = (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+
+    std::lock_guard lock(mutex);
+
+    if (! file)
+        return;
+
+    std::string header;
+    header += (char) type;
+    put_varint(header, now - std::min(now, lastTime));
+    put_varint(header, size);
+
+    lastTime = std::max(lastTime, now);
+
+    file.write(header.data(), (std::streamsize) header.size());
+    file.write((const char*) data, (std::streamsize) size);
+}
+
+auto read_replay_log(const std::string& path) -> std::optional<std::vector<ReplayRecord>>
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (! file)
+        return std::nullopt;
+
+    const std::string contents{ std::istreambuf_iterator<char>(file), {} };
+    std::string_view in = contents;
+
+    if (in.size() < 6 || in.substr(0, 4) != std::string_view(magic, 4))
+        return std::nullopt;
+
+    const auto fileVersion = (uint16_t) ((uint8_t) in[4] | (uint8_t) in[5] << 8);
+
+    if (fileVersion != ReplayWriter::version)
+        return std::nullopt;
+
+    in.remove_prefix(6);
+
+    std::vector<ReplayRecord> records;
+    uint64_t time = 0;
+
+    while (! in.empty())
+    {
+        const auto type = (uint8_t) in.front();
+        in.remove_prefix(1);
+
+        auto delta = get_varint(in);
+        auto size  = get_varint(in);
+
+        // A truncated tail (the app was killed mid-write) ends the log
+        if (! delta || ! size || *size > in.size() || type < 1 || type > 3)
+            break;
+
+        time += *delta;
+        records.push_back({ (ReplayRecord::Type) type, time, std::string(in.substr(0, *size)) });
+        in.remove_prefix(*size);
+    }
+
+    return records;
+}
+
+auto replayRecorder() -> ReplayWriter*
+{
+    static auto recorder = [] () -> std::unique_ptr<ReplayWriter>
+    {
+        if (auto path = std::getenv("LOOKINGGLASS_RECORD"))
+            return std::make_unique<ReplayWriter>(path);
+
+        return nullptr;
+    }();
+
+    return recorder && recorder->isOpen() ? recorder.get() : nullptr;
+}
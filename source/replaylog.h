@@ -0,0 +1,67 @@
+#pragma once
+
+#include <nlohmann/json_fwd.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Everything that reached the app from outside, in order, so a session can
+// be replayed headless. The log is a "LGRP" header followed by records of
+// [type u8][time delta µs, varint][size, varint][payload]: script messages
+// as CBOR, url requests as their url, timer fires as a varint timer id.
+struct ReplayRecord
+{
+    enum class Type : uint8_t
+    {
+        scriptMessage = 1,
+        urlRequest    = 2,
+        timerFire     = 3
+    };
+
+    Type type     = Type::scriptMessage;
+    uint64_t time = 0;
+    std::string payload;
+
+    auto message() const -> nlohmann::json;
+    auto timerId() const -> uint64_t;
+};
+
+struct ReplayWriter
+{
+    using clock = std::chrono::steady_clock;
+
+    static constexpr uint16_t version = 1;
+
+    explicit ReplayWriter(const std::string& path);
+    ~ReplayWriter();
+
+    auto isOpen() const -> bool { return file.is_open(); }
+
+    // Safe from any thread
+    auto scriptMessage(const nlohmann::json& message) -> void;
+    auto urlRequest(const std::string& url) -> void;
+    auto timerFired(uint64_t id) -> void;
+    auto flush() -> void;
+
+    // Ids for timers made while recording, in creation order
+    auto nextTimerId() -> uint64_t;
+
+private:
+    auto write(ReplayRecord::Type type, const void* data, size_t size) -> void;
+
+    std::mutex mutex;
+    std::ofstream file;
+    clock::time_point start = clock::now();
+    uint64_t lastTime       = 0;
+    uint64_t timers         = 0;
+};
+
+auto read_replay_log(const std::string& path) -> std::optional<std::vector<ReplayRecord>>;
+
+// The process-wide recorder, nullptr unless LOOKINGGLASS_RECORD names a log file
+auto replayRecorder() -> ReplayWriter*;
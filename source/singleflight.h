@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Coalesces concurrent calls for the same key: the first caller runs the
+// load, callers arriving while it runs wait for it and get the same value
+// (or exception). Nothing is kept once the load lands, so later calls load
+// again. Value should be cheap to copy, e.g. a shared_ptr. A load must not
+// run() its own key, it would wait on itself.
+template <typename Key, typename Value>
+struct SingleFlight
+{
+    struct Stats
+    {
+        uint64_t flights   = 0; // loads actually run
+        uint64_t coalesced = 0; // calls that waited on someone else's load
+        uint64_t maxShared = 0; // most calls sharing one load
+    };
+
+    template <typename Load>
+    auto run(const Key& key, Load&& load) -> Value
+    {
+        std::shared_future<Value> flight;
+
+        {
+            std::lock_guard lock(mutex);
+
+            if (auto it = flights.find(key); it != flights.end())
+            {
+                auto& running = it->second;
+
+                // The promise is only made once someone has to wait, so
+                // uncontended calls don't pay for it
+                if (! running.waiters)
+                {
+                    running.waiters = std::make_shared<std::promise<Value>>();
+                    running.result  = running.waiters->get_future().share();
+                }
+
+                stats.coalesced++;
+                stats.maxShared = std::max(stats.maxShared, ++running.callers);
+                flight = running.result;
+            }
+            else
+            {
+                stats.flights++;
+                flights.emplace(key, Flight{});
+            }
+        }
+
+        if (flight.valid())
+            return flight.get();
+
+        try
+        {
+            auto value = load();
+
+            if (auto waiters = land(key))
+                waiters->set_value(value);
+
+            return value;
+        }
+        catch (...)
+        {
+            if (auto waiters = land(key))
+                waiters->set_exception(std::current_exception());
+
+            throw;
+        }
+    }
+
+    auto getStats() const -> Stats
+    {
+        std::lock_guard lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Flight
+    {
+        std::shared_ptr<std::promise<Value>> waiters;
+        std::shared_future<Value> result;
+        uint64_t callers = 1;
+    };
+
+    // Removed before the result is published, so a call arriving after the
+    // load finished starts a fresh one rather than reading a stale result
+    auto land(const Key& key) -> std::shared_ptr<std::promise<Value>>
+    {
+        std::lock_guard lock(mutex);
+
+        auto it      = flights.find(key);
+        auto waiters = std::move(it->second.waiters);
+
+        flights.erase(it);
+        return waiters;
+    }
+
+    mutable std::mutex mutex;
+    std::map<Key, Flight, std::less<>> flights;
+    Stats stats;
+};
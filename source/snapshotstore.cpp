@@ -0,0 +1,174 @@
+#include "snapshotstore.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+SnapshotStore::SnapshotStore(std::string path) : path(std::move(path))
+{
+}
+
+auto SnapshotStore::load(std::string_view version) const -> std::optional<DomSnapshot>
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (! file)
+        return std::nullopt;
+
+    auto json = nlohmann::json::parse(file, nullptr, false);
+
+    if (json.is_discarded() || ! json.is_object()
+        || json.value("format", 0) != format || json.value("version", "") != version)
+    {
+        printf("Snapshot: discarding stale %s\n", path.c_str());
+        clear();
+        return std::nullopt;
+    }
+
+    return DomSnapshot{
+        json.value("page", ""),
+        json.value("body", ""),
+        json.value("state", nlohmann::json()),
+        std::string(version),
+    };
+}
+
+auto SnapshotStore::save(const DomSnapshot& snapshot) const -> bool
+{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    const auto json = nlohmann::json{
+        { "format",  format },
+        { "version", snapshot.version },
+        { "page",    snapshot.page },
+        { "body",    snapshot.body },
+        { "state",   snapshot.state },
+    };
+
+    // Write then rename so a crash mid-write never leaves half a snapshot
+    const auto temporary = path + ".tmp";
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        if (! (file << json.dump()))
+            return false;
+    }
+
+    std::filesystem::rename(temporary, path, ec);
+    return ! ec;
+}
+
+auto SnapshotStore::clear() const -> void
+{
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+auto asset_version(const std::string& root) -> std::string
+{
+    using namespace std::filesystem;
+
+    std::vector<std::string> entries;
+    std::error_code ec;
+
+    for (auto it = recursive_directory_iterator(root, ec); ! ec && it != recursive_directory_iterator(); it.increment(ec))
+    {
+        if (! it->is_regular_file(ec))
+            continue;
+
+        std::ostringstream entry;
+        entry << relative(it->path(), root, ec).generic_string() << ':'
+              << it->file_size(ec) << ':'
+              << it->last_write_time(ec).time_since_epoch().count();
+
+        entries.push_back(entry.str());
+    }
+
+    // Directory order isn't stable across filesystems
+    std::sort(entries.begin(), entries.end());
+
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (auto& entry : entries)
+    {
+        for (auto c : entry)
+            hash = (hash ^ (uint8_t) c) * 0x100000001b3;
+
+        hash = (hash ^ '\n') * 0x100000001b3;
+    }
+
+    char hex[17]{};
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) hash);
+
+    return hex;
+}
+
+auto default_snapshot_path() -> std::string
+{
+    auto home = std::getenv("HOME");
+
+#if defined(__APPLE__)
+    return std::string(home ? home : ".") + "/Library/Caches/lookingglass/snapshot.json";
+#else
+    if (auto cache = std::getenv("XDG_CACHE_HOME"))
+        return std::string(cache) + "/lookingglass/snapshot.json";
+
+    return std::string(home ? home : ".") + "/.cache/lookingglass/snapshot.json";
+#endif
+}
+
+// Where the opening tag called name ends (its '>'), so "<head" doesn't match "<header"
+static auto find_open_tag(std::string_view html, std::string_view name) -> size_t
+{
+    for (auto pos = html.find(name); pos != std::string_view::npos; pos = html.find(name, pos + 1))
+    {
+        const auto after = pos + name.size();
+
+        if (after < html.size() && (html[after] == '>' || html[after] == '/' || std::isspace((unsigned char) html[after])))
+            return html.find('>', after);
+    }
+
+    return std::string_view::npos;
+}
+
+auto apply_snapshot(std::string_view html, const DomSnapshot* snapshot) -> std::string
+{
+    auto global = nlohmann::json{
+        { "hydrated", snapshot != nullptr },
+        { "state",    snapshot ? snapshot->state : nlohmann::json() },
+    }.dump();
+
+    // Keep the json from closing the script element
+    for (auto pos = global.find("</"); pos != std::string::npos; pos = global.find("</", pos + 3))
+        global.replace(pos, 2, "<\\/");
+
+    std::string result(html);
+
+    if (snapshot)
+    {
+        const auto bodyOpen  = find_open_tag(result, "<body");
+        const auto bodyClose = result.rfind("</body>");
+
+        if (bodyOpen != std::string::npos && bodyClose != std::string::npos && bodyClose > bodyOpen)
+            result.replace(bodyOpen + 1, bodyClose - bodyOpen - 1, snapshot->body);
+    }
+
+    // Into the head, or straight after <html> (or at the very start) when the
+    // document leaves the head out, either way before the page's own scripts
+    auto at = find_open_tag(result, "<head");
+
+    if (at == std::string::npos)
+        at = find_open_tag(result, "<html");
+
+    at = at == std::string::npos ? 0 : at + 1;
+
+    result.insert(at, "<script>var __snapshot = " + global + ";</script>");
+    return result;
+}
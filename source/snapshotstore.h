@@ -0,0 +1,42 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+// The settled <body> of a page plus whatever state the page chose to keep,
+// served on the next launch so the first paint doesn't wait for scripts.
+struct DomSnapshot
+{
+    std::string page;
+    std::string body;
+    nlohmann::json state;
+    std::string version;
+};
+
+// One snapshot on disk, tagged with the asset version it was taken against.
+// Loading a snapshot for a different version deletes it.
+struct SnapshotStore
+{
+    static constexpr int format = 1;
+
+    explicit SnapshotStore(std::string path);
+
+    auto load(std::string_view version) const -> std::optional<DomSnapshot>;
+    auto save(const DomSnapshot& snapshot) const -> bool;
+    auto clear() const -> void;
+
+    std::string path;
+};
+
+// Hash of every file's name, size and modification time under root
+auto asset_version(const std::string& root) -> std::string;
+
+// Default location for the snapshot file, in the user's cache folder
+auto default_snapshot_path() -> std::string;
+
+// Adds the page's __snapshot global to html and, given a snapshot, swaps in
+// its body so the page can hydrate rather than build
+auto apply_snapshot(std::string_view html, const DomSnapshot* snapshot) -> std::string;
@@ -0,0 +1,145 @@
+#include "startuptrace.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+static auto current_thread_index() -> uint32_t
+{
+    static std::atomic<uint32_t> next = 1;
+    thread_local const uint32_t index = next++;
+
+    return index;
+}
+
+StartupTrace::StartupTrace() : origin(clock::now())
+{
+    if (auto path = std::getenv("LOOKINGGLASS_STARTUP_TRACE"))
+        outputPath = path;
+}
+
+auto StartupTrace::mark(std::string_view name) -> void
+{
+    const auto time = clock::now();
+
+    std::lock_guard lock(mutex);
+    marks.push_back({ std::string(name), time, current_thread_index() });
+}
+
+auto StartupTrace::markOnce(std::string_view name) -> bool
+{
+    const auto time = clock::now();
+
+    std::lock_guard lock(mutex);
+
+    if (find(name))
+        return false;
+
+    marks.push_back({ std::string(name), time, current_thread_index() });
+    return true;
+}
+
+auto StartupTrace::getMarks() const -> std::vector<Mark>
+{
+    std::lock_guard lock(mutex);
+    return marks;
+}
+
+auto StartupTrace::elapsed(std::string_view from, std::string_view to) const -> std::chrono::microseconds
+{
+    std::lock_guard lock(mutex);
+
+    auto a = find(from);
+    auto b = find(to);
+
+    if (! a || ! b)
+        return std::chrono::microseconds(-1);
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(b->time - a->time);
+}
+
+auto StartupTrace::toChromeTrace() const -> nlohmann::json
+{
+    const auto sorted = [this]
+    {
+        auto copy = getMarks();
+        std::stable_sort(copy.begin(), copy.end(), [] (auto& a, auto& b) { return a.time < b.time; });
+        return copy;
+    }();
+
+    const auto micros = [this] (clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - origin).count();
+    };
+
+    auto events = nlohmann::json::array();
+
+    // One instant per mark, plus a span for each phase so the gaps read as bars
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        const auto& mark = sorted[i];
+
+        events.push_back({
+            { "name", mark.name },
+            { "ph",   "i" },
+            { "s",    "g" },
+            { "ts",   micros(mark.time) },
+            { "pid",  1 },
+            { "tid",  mark.thread },
+        });
+
+        if (i + 1 < sorted.size())
+        {
+            events.push_back({
+                { "name", mark.name + " -> " + sorted[i + 1].name },
+                { "cat",  "startup" },
+                { "ph",   "X" },
+                { "ts",   micros(mark.time) },
+                { "dur",  micros(sorted[i + 1].time) - micros(mark.time) },
+                { "pid",  1 },
+                { "tid",  0 },
+            });
+        }
+    }
+
+    return {
+        { "traceEvents",     std::move(events) },
+        { "displayTimeUnit", "ms" },
+    };
+}
+
+auto StartupTrace::flush() const -> bool
+{
+    if (outputPath.empty())
+        return false;
+
+    std::ofstream file(outputPath, std::ios::trunc);
+
+    if (! file)
+    {
+        printf("Error: can't write startup trace to %s\n", outputPath.c_str());
+        return false;
+    }
+
+    file << toChromeTrace().dump(1);
+    return file.good();
+}
+
+auto StartupTrace::find(std::string_view name) const -> const Mark*
+{
+    for (auto& mark : marks)
+        if (mark.name == name)
+            return &mark;
+
+    return nullptr;
+}
+
+auto startupTrace() -> StartupTrace&
+{
+    static StartupTrace trace;
+    return trace;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <nlohmann/json_fwd.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Monotonic timeline of launch phases (main, startWebApp, window/webview
+// creation, onStart, first url request, first script message, page load),
+// exported as Chrome trace-event JSON for chrome://tracing or Perfetto.
+struct StartupTrace
+{
+    using clock = std::chrono::steady_clock;
+
+    struct Mark
+    {
+        std::string name;
+        clock::time_point time;
+        uint32_t thread;
+    };
+
+    StartupTrace();
+
+    // Safe from any thread
+    auto mark(std::string_view name) -> void;
+
+    // Only records the first call for a name, returns false after that
+    auto markOnce(std::string_view name) -> bool;
+
+    auto getMarks() const -> std::vector<Mark>;
+    auto elapsed(std::string_view from, std::string_view to) const -> std::chrono::microseconds;
+
+    auto toChromeTrace() const -> nlohmann::json;
+
+    // Writes the trace to outputPath if one is set (LOOKINGGLASS_STARTUP_TRACE)
+    auto flush() const -> bool;
+
+    clock::time_point origin;
+    std::string outputPath;
+
+private:
+    auto find(std::string_view name) const -> const Mark*;
+
+    mutable std::mutex mutex;
+    std::vector<Mark> marks;
+};
+
+auto startupTrace() -> StartupTrace&;
@@ -0,0 +1,440 @@
+#pragma once
+
+#include "executor.h"
+#include "workerpool.h"
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+// Recycles coroutine frames by size class. Free lists are per thread, a
+// block freed on another thread simply joins that thread's list.
+struct FramePool
+{
+    static constexpr size_t minBlock   = 64;
+    static constexpr size_t classCount = 6; // 64 .. 2048 bytes
+    static constexpr size_t maxCached  = 256;
+
+    static auto allocate(size_t size) -> void*
+    {
+        auto sizeClass = classFor(size + sizeof(Header));
+
+        if (sizeClass < classCount)
+        {
+            auto& list = lists()[sizeClass];
+
+            if (auto block = list.head)
+            {
+                list.head = block->next;
+                list.count--;
+                return prepare(block, sizeClass);
+            }
+
+            return prepare(::operator new(minBlock << sizeClass), sizeClass);
+        }
+
+        return prepare(::operator new(size + sizeof(Header)), classCount);
+    }
+
+    static auto deallocate(void* pointer) -> void
+    {
+        auto header    = static_cast<Header*>(pointer) - 1;
+        auto sizeClass = header->sizeClass;
+
+        if (sizeClass < classCount)
+        {
+            auto& list = lists()[sizeClass];
+
+            if (list.count < maxCached)
+            {
+                auto block  = reinterpret_cast<FreeBlock*>(header);
+                block->next = list.head;
+                list.head   = block;
+                list.count++;
+                return;
+            }
+        }
+
+        ::operator delete(header);
+    }
+
+private:
+    struct alignas(std::max_align_t) Header
+    {
+        size_t sizeClass;
+    };
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct FreeList
+    {
+        FreeBlock* head = nullptr;
+        size_t count    = 0;
+
+        ~FreeList()
+        {
+            while (head)
+                ::operator delete(std::exchange(head, head->next));
+        }
+    };
+
+    static auto classFor(size_t bytes) -> size_t
+    {
+        size_t sizeClass = 0;
+
+        while (sizeClass < classCount && (minBlock << sizeClass) < bytes)
+            sizeClass++;
+
+        return sizeClass;
+    }
+
+    static auto prepare(void* block, size_t sizeClass) -> void*
+    {
+        auto header = new (block) Header{ sizeClass };
+        return header + 1;
+    }
+
+    static auto lists() -> std::array<FreeList, classCount>&
+    {
+        thread_local std::array<FreeList, classCount> lists;
+        return lists;
+    }
+};
+
+template <typename T = void>
+struct Task;
+
+namespace detail
+{
+    struct PromiseBase
+    {
+        struct FinalAwaiter
+        {
+            auto await_ready() noexcept -> bool { return false; }
+            auto await_resume() noexcept -> void { }
+
+            template <typename Promise>
+            auto await_suspend(std::coroutine_handle<Promise> handle) noexcept -> std::coroutine_handle<>
+            {
+                auto& promise = handle.promise();
+
+                if (promise.continuation)
+                    return promise.continuation;
+
+                if (promise.detached)
+                    handle.destroy();
+
+                return std::noop_coroutine();
+            }
+        };
+
+        static auto operator new(size_t size) -> void*
+        {
+            return FramePool::allocate(size);
+        }
+
+        static auto operator delete(void* pointer) -> void
+        {
+            FramePool::deallocate(pointer);
+        }
+
+        auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+        auto final_suspend() noexcept -> FinalAwaiter { return {}; }
+
+        std::coroutine_handle<> continuation;
+        bool detached = false;
+    };
+
+    template <typename T>
+    struct Promise : PromiseBase
+    {
+        template <typename U>
+        auto return_value(U&& value) -> void
+        {
+            result.template emplace<1>(std::forward<U>(value));
+        }
+
+        auto unhandled_exception() -> void
+        {
+            result.template emplace<2>(std::current_exception());
+        }
+
+        auto take() -> T
+        {
+            if (result.index() == 2)
+                std::rethrow_exception(std::get<2>(result));
+
+            return std::move(std::get<1>(result));
+        }
+
+        std::variant<std::monostate, T, std::exception_ptr> result;
+    };
+
+    template <>
+    struct Promise<void> : PromiseBase
+    {
+        auto return_void() -> void { }
+
+        auto unhandled_exception() -> void
+        {
+            exception = std::current_exception();
+        }
+
+        auto take() -> void
+        {
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+
+        std::exception_ptr exception;
+    };
+}
+
+// Lazily started coroutine. Awaiting a task starts it and resumes the
+// awaiting coroutine when it finishes; spawn() runs one with no awaiter.
+template <typename T>
+struct [[nodiscard]] Task
+{
+    struct promise_type : detail::Promise<T>
+    {
+        auto get_return_object() -> Task
+        {
+            return Task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+    };
+
+    using handle_t = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(handle_t handle) : handle(handle) { }
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) { }
+
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    auto operator=(Task&& other) noexcept -> Task&
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+
+            handle = std::exchange(other.handle, {});
+        }
+
+        return *this;
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            auto await_ready() noexcept -> bool { return ! handle || handle.done(); }
+
+            auto await_suspend(std::coroutine_handle<> awaiting) noexcept -> std::coroutine_handle<>
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            auto await_resume() -> T
+            {
+                return handle.promise().take();
+            }
+
+            handle_t handle;
+        };
+
+        return Awaiter{ handle };
+    }
+
+    // Starts the task and hands ownership of the frame to the task itself
+    auto detach() && -> void
+    {
+        auto h = std::exchange(handle, {});
+        h.promise().detached = true;
+        h.resume();
+    }
+
+    handle_t handle;
+};
+
+namespace detail
+{
+    template <typename T, typename OnResult, typename OnError>
+    auto runDetached(Task<T> task, OnResult onResult, OnError onError) -> Task<void>
+    {
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                co_await std::move(task);
+                onResult();
+            }
+            else
+            {
+                onResult(co_await std::move(task));
+            }
+        }
+        catch (...)
+        {
+            onError(std::current_exception());
+        }
+    }
+}
+
+// Fire and forget. Exactly one of the callbacks runs when the task ends.
+template <typename T, typename OnResult, typename OnError>
+auto spawn(Task<T> task, OnResult&& onResult, OnError&& onError) -> void
+{
+    detail::runDetached(std::move(task),
+                        std::forward<OnResult>(onResult),
+                        std::forward<OnError>(onError)).detach();
+}
+
+template <typename T>
+auto spawn(Task<T> task) -> void
+{
+    if constexpr (std::is_void_v<T>)
+        spawn(std::move(task), [] { }, [] (std::exception_ptr) { });
+    else
+        spawn(std::move(task), [] (T) { }, [] (std::exception_ptr) { });
+}
+
+// co_await resumeOn(executor) continues the coroutine on that executor
+inline auto resumeOn(Executor& executor)
+{
+    struct Awaiter
+    {
+        auto await_ready() noexcept -> bool { return false; }
+        auto await_resume() noexcept -> void { }
+
+        auto await_suspend(std::coroutine_handle<> handle) -> void
+        {
+            executor.post([handle] { handle.resume(); });
+        }
+
+        Executor& executor;
+    };
+
+    return Awaiter{ executor };
+}
+
+// co_await delay(executor, ms) resumes on the executor after the delay
+inline auto delay(Executor& executor, int milliseconds)
+{
+    struct Awaiter
+    {
+        auto await_ready() noexcept -> bool { return false; }
+        auto await_resume() noexcept -> void { }
+
+        auto await_suspend(std::coroutine_handle<> handle) -> void
+        {
+            executor.postDelayed(milliseconds, [handle] { handle.resume(); });
+        }
+
+        Executor& executor;
+        int milliseconds;
+    };
+
+    return Awaiter{ executor, milliseconds };
+}
+
+// Runs job on the pool, then resumes on the home executor with its result
+template <typename Job>
+auto offload(WorkerPool& pool, Executor& home, Job&& job)
+{
+    using result_t = std::invoke_result_t<Job>;
+    using value_t  = std::conditional_t<std::is_void_v<result_t>, std::monostate, result_t>;
+
+    struct Awaiter
+    {
+        auto await_ready() noexcept -> bool { return false; }
+
+        auto await_suspend(std::coroutine_handle<> handle) -> void
+        {
+            pool.post([this, handle]
+                {
+                    try
+                    {
+                        if constexpr (std::is_void_v<result_t>)
+                            job();
+                        else
+                            result.template emplace<1>(job());
+                    }
+                    catch (...)
+                    {
+                        result.template emplace<2>(std::current_exception());
+                    }
+
+                    home.post([handle] { handle.resume(); });
+                });
+        }
+
+        auto await_resume() -> result_t
+        {
+            if (result.index() == 2)
+                std::rethrow_exception(std::get<2>(result));
+
+            if constexpr (! std::is_void_v<result_t>)
+                return std::move(std::get<1>(result));
+        }
+
+        WorkerPool& pool;
+        Executor& home;
+        std::decay_t<Job> job;
+        std::variant<std::monostate, value_t, std::exception_ptr> result;
+    };
+
+    return Awaiter{ pool, home, std::forward<Job>(job), {} };
+}
+
+// Adapts a callback style API. start receives a resolve and reject pair and
+// the coroutine resumes wherever one of them is called.
+template <typename T>
+auto awaitCallback(std::function<void(std::function<void(T)>, std::function<void(std::exception_ptr)>)> start)
+{
+    struct Awaiter
+    {
+        auto await_ready() noexcept -> bool { return false; }
+
+        auto await_suspend(std::coroutine_handle<> handle) -> void
+        {
+            start([this, handle] (T value)
+                {
+                    result.template emplace<1>(std::move(value));
+                    handle.resume();
+                },
+                [this, handle] (std::exception_ptr error)
+                {
+                    result.template emplace<2>(error);
+                    handle.resume();
+                });
+        }
+
+        auto await_resume() -> T
+        {
+            if (result.index() == 2)
+                std::rethrow_exception(std::get<2>(result));
+
+            return std::move(std::get<1>(result));
+        }
+
+        std::function<void(std::function<void(T)>, std::function<void(std::exception_ptr)>)> start;
+        std::variant<std::monostate, T, std::exception_ptr> result;
+    };
+
+    return Awaiter{ std::move(start), {} };
+}
@@ -0,0 +1,168 @@
+#include "timerscheduler.h"
+
+#include <algorithm>
+#include <bit>
+
+auto CoalescingPolicy::period(uint64_t requested) const -> uint64_t
+{
+    return background ? requested * backgroundPeriodScale : requested;
+}
+
+auto CoalescingPolicy::tolerance(uint64_t requested) const -> uint64_t
+{
+    return background ? std::max(requested, backgroundMinTolerance) : requested;
+}
+
+auto CoalescingPolicy::align(uint64_t due, uint64_t tolerance) const -> uint64_t
+{
+    if (tolerance < 2)
+        return due;
+
+    const auto granule = std::bit_floor(tolerance);
+    return (due + granule - 1) & ~(granule - 1);
+}
+
+struct WheelTimer : Timer
+{
+    WheelTimer(TimerScheduler& scheduler, TimerMode mode, std::function<void()>&& callback)
+        : scheduler(scheduler), mode(mode), function(std::move(callback))
+    {
+        entry.callback = [this]
+        {
+            // Repeat from the nominal due time, not the aligned deadline,
+            // so coalescing never makes a timer drift.
+            if (this->mode == TimerMode::repeating)
+            {
+                const auto time = this->scheduler.currentTime();
+                const auto step = this->scheduler.policy.period(period);
+
+                due = due + step > time ? due + step : time + step;
+                this->scheduler.schedule(entry, due, tolerance);
+            }
+
+            function();
+        };
+    }
+
+    auto start(int milliseconds) -> void override
+    {
+        period = (uint64_t) std::max(milliseconds, 1);
+        due    = scheduler.currentTime() + scheduler.policy.period(period);
+
+        scheduler.schedule(entry, due, tolerance);
+    }
+
+    auto stop() -> void override
+    {
+        scheduler.cancel(entry);
+    }
+
+    auto tick() -> void override
+    {
+        function();
+    }
+
+    auto setTolerance(int milliseconds) -> void override
+    {
+        tolerance = (uint64_t) std::max(milliseconds, 0);
+    }
+
+    TimerScheduler& scheduler;
+    TimerMode mode;
+    std::function<void()> function;
+    uint64_t period    = 1;
+    uint64_t due       = 0;
+    uint64_t tolerance = 0;
+    TimingWheel::Entry entry;
+};
+
+TimerScheduler::TimerScheduler(now_t&& now, rearm_t&& rearm, uint64_t slack)
+    : wheel(now()), slack(slack), now(std::move(now)), rearm(std::move(rearm))
+{
+}
+
+auto TimerScheduler::makeTimer(int milliseconds, std::function<void()>&& function, TimerMode mode) -> std::unique_ptr<Timer>
+{
+    auto timer = std::make_unique<WheelTimer>(*this, mode, std::move(function));
+    timer->start(milliseconds);
+    return timer;
+}
+
+auto TimerScheduler::postDelayed(int milliseconds, std::function<void()>&& callback) -> void
+{
+    auto& entry = delayed.emplace_back();
+
+    // The wheel runs this from a copy, so the entry can go before the callback runs
+    entry.callback = [this, it = std::prev(delayed.end()), callback = std::move(callback)] () mutable
+    {
+        auto run = std::move(callback);
+        delayed.erase(it);
+        run();
+    };
+
+    schedule(entry, now() + (uint64_t) std::max(milliseconds, 0), 0);
+}
+
+auto TimerScheduler::schedule(TimingWheel::Entry& entry, uint64_t due, uint64_t tolerance) -> void
+{
+    // Catch an idle wheel up so placement is measured from real time
+    if (wheel.size() == 0 && ! firing)
+        wheel.advance(now());
+
+    wheel.schedule(entry, policy.align(due, policy.tolerance(tolerance)));
+
+    // Re-arm only if this deadline comes before the pending wakeup;
+    // stopping a timer never re-arms, a spare wakeup is cheaper.
+    if (! firing && (! armed || entry.deadline + slack < *armed))
+        arm(entry.deadline);
+}
+
+auto TimerScheduler::cancel(TimingWheel::Entry& entry) -> void
+{
+    wheel.cancel(entry);
+}
+
+auto TimerScheduler::fire() -> size_t
+{
+    const auto time = now();
+
+    armed.reset();
+
+    if (time / 1000 != currentSecond)
+    {
+        stats.wakeupsPerSecond = time / 1000 == currentSecond + 1 ? currentSecondWakeups : 0;
+        currentSecond          = time / 1000;
+        currentSecondWakeups   = 0;
+    }
+
+    stats.wakeups++;
+    currentSecondWakeups++;
+
+    firing = true;
+    const auto count = wheel.advance(time);
+    firing = false;
+
+    stats.fired += count;
+
+    arm(wheel.earliest());
+    return count;
+}
+
+auto TimerScheduler::setBackground(bool background) -> void
+{
+    // Timers pick the new policy up when they next reschedule
+    policy.background = background;
+}
+
+auto TimerScheduler::getStats() const -> TimerStats
+{
+    auto result   = stats;
+    result.active = wheel.size();
+    return result;
+}
+
+auto TimerScheduler::arm(std::optional<uint64_t> deadline) -> void
+{
+    armed = deadline ? std::make_optional(*deadline + slack) : std::nullopt;
+    rearm(armed);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "timingwheel.h"
+#include "webviewinterface.h"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+
+// How much timers may be bent to save wakeups. A timer with a tolerance
+// has its deadline rounded up onto a grid as coarse as that tolerance
+// allows (the largest power of two not above it), so timers with similar
+// tolerances land on the same grid points and share a wakeup. In the
+// background repeating periods are stretched and every tolerance is
+// raised to a floor.
+struct CoalescingPolicy
+{
+    bool background                 = false;
+    uint64_t backgroundPeriodScale  = 4;
+    uint64_t backgroundMinTolerance = 100;
+
+    auto period(uint64_t requested) const -> uint64_t;
+    auto tolerance(uint64_t requested) const -> uint64_t;
+    auto align(uint64_t due, uint64_t tolerance) const -> uint64_t;
+};
+
+struct TimerStats
+{
+    uint64_t wakeups          = 0;
+    uint64_t fired            = 0;
+    uint64_t wakeupsPerSecond = 0; // over the last full second
+    size_t   active           = 0;
+};
+
+// Runs every Timer of an event loop off a single TimingWheel and a single
+// platform timer. The platform timer is armed for the earliest deadline
+// plus the slack, and every timer due by then fires in that wakeup.
+// Time comes from the now function, so a virtual clock can drive it.
+struct TimerScheduler
+{
+    using now_t   = std::function<uint64_t()>;
+    using rearm_t = std::function<void(std::optional<uint64_t> wakeAt)>;
+
+    TimerScheduler(now_t&& now, rearm_t&& rearm, uint64_t slack = 1);
+
+    auto makeTimer(int milliseconds, std::function<void()>&& function, TimerMode mode) -> std::unique_ptr<Timer>;
+
+    // One-shot callback with no Timer to hold, its entry belongs to the
+    // scheduler until it fires or the scheduler goes away
+    auto postDelayed(int milliseconds, std::function<void()>&& callback) -> void;
+
+    // Schedules entry for the due time, bent by the coalescing policy
+    auto schedule(TimingWheel::Entry& entry, uint64_t due, uint64_t tolerance) -> void;
+    auto cancel(TimingWheel::Entry& entry) -> void;
+
+    // Called by the backend when the platform timer goes off
+    auto fire() -> size_t;
+
+    auto setBackground(bool background) -> void;
+    auto getStats() const -> TimerStats;
+    auto currentTime() const -> uint64_t { return now(); }
+
+    TimingWheel wheel;
+    std::list<TimingWheel::Entry> delayed; // destroyed before the wheel, entries cancel themselves
+    CoalescingPolicy policy;
+    uint64_t slack;
+
+private:
+    auto arm(std::optional<uint64_t> deadline) -> void;
+
+    now_t now;
+    rearm_t rearm;
+    std::optional<uint64_t> armed;
+    bool firing = false;
+
+    TimerStats stats;
+    uint64_t currentSecond = 0;
+    uint64_t currentSecondWakeups = 0;
+};
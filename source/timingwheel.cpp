@@ -0,0 +1,223 @@
+#include "timingwheel.h"
+
+#include <algorithm>
+#include <bit>
+
+auto TimingWheel::List::push(Entry& entry) -> void
+{
+    entry.prev = nullptr;
+    entry.next = head;
+    entry.list = this;
+
+    if (head)
+        head->prev = &entry;
+    else if (occupancy)
+        *occupancy |= bit;
+
+    head = &entry;
+}
+
+auto TimingWheel::List::remove(Entry& entry) -> void
+{
+    if (entry.prev)
+        entry.prev->next = entry.next;
+    else
+        head = entry.next;
+
+    if (entry.next)
+        entry.next->prev = entry.prev;
+
+    if (! head && occupancy)
+        *occupancy &= ~bit;
+
+    entry.prev = entry.next = nullptr;
+    entry.list = nullptr;
+}
+
+TimingWheel::Entry::~Entry()
+{
+    if (destroyed)
+        *destroyed = true;
+
+    if (wheel)
+        wheel->cancel(*this);
+}
+
+TimingWheel::TimingWheel(uint64_t now) : time(now)
+{
+    for (int level = 0; level < levelCount; level++)
+    {
+        for (int slot = 0; slot < slotCount; slot++)
+        {
+            slots[level][slot].occupancy = &occupancy[level];
+            slots[level][slot].bit       = uint64_t(1) << slot;
+        }
+    }
+}
+
+auto TimingWheel::schedule(Entry& entry, uint64_t deadline) -> void
+{
+    cancel(entry);
+
+    entry.deadline = std::max(deadline, time + 1);
+    entry.wheel    = this;
+    place(entry);
+    count++;
+}
+
+auto TimingWheel::cancel(Entry& entry) -> void
+{
+    if (! entry.list)
+        return;
+
+    entry.list->remove(entry);
+    count--;
+}
+
+auto TimingWheel::place(Entry& entry) -> void
+{
+    // Anything beyond the wheel's range parks in the top level and is
+    // placed again when that slot cascades.
+    const auto target = std::min(entry.deadline, time + range - 1);
+    const auto delta  = target - time;
+
+    int level = 0;
+
+    while (level < levelCount - 1 && delta >= (uint64_t(1) << (levelBits * (level + 1))))
+        level++;
+
+    const auto slot = (target >> (levelBits * level)) & (slotCount - 1);
+    slots[level][slot].push(entry);
+}
+
+auto TimingWheel::cascade(int level) -> void
+{
+    const auto index = (time >> (levelBits * level)) & (slotCount - 1);
+
+    if (index == 0 && level + 1 < levelCount)
+        cascade(level + 1);
+
+    auto& list = slots[level][index];
+
+    while (auto entry = list.head)
+    {
+        list.remove(*entry);
+        place(*entry);
+    }
+}
+
+auto TimingWheel::step(List& expired) -> void
+{
+    time++;
+
+    if ((time & (slotCount - 1)) == 0)
+        cascade(1);
+
+    auto& list = slots[0][time & (slotCount - 1)];
+
+    while (auto entry = list.head)
+    {
+        list.remove(*entry);
+        expired.push(*entry);
+    }
+}
+
+auto TimingWheel::advance(uint64_t now) -> size_t
+{
+    size_t fired = 0;
+
+    // Tick by tick, so a callback sees the time it was due at and can
+    // cancel anything due after it
+    while (time < now)
+    {
+        if (count == 0)
+        {
+            time = now;
+            break;
+        }
+
+        // Nothing left in level 0, skip straight to the next cascade
+        if (occupancy[0] == 0)
+        {
+            const auto boundary = time | (slotCount - 1);
+
+            if (boundary >= now)
+            {
+                time = now;
+                break;
+            }
+
+            time = boundary;
+        }
+
+        List expired;
+        step(expired);
+        fired += run(expired);
+    }
+
+    return fired;
+}
+
+auto TimingWheel::run(List& expired) -> size_t
+{
+    size_t fired = 0;
+
+    while (auto entry = expired.head)
+    {
+        expired.remove(*entry);
+        count--;
+
+        if (entry->period > 0)
+            schedule(*entry, entry->deadline + entry->period);
+
+        // The callback may destroy its own entry, so run it from a local
+        bool destroyed = false;
+        auto callback  = std::move(entry->callback);
+
+        entry->destroyed = &destroyed;
+        callback();
+
+        if (! destroyed)
+        {
+            entry->destroyed = nullptr;
+
+            if (! entry->callback)
+                entry->callback = std::move(callback);
+        }
+
+        fired++;
+    }
+
+    return fired;
+}
+
+auto TimingWheel::earliest() const -> std::optional<uint64_t>
+{
+    std::optional<uint64_t> result;
+
+    for (int level = 0; level < levelCount; level++)
+    {
+        if (! occupancy[level])
+            continue;
+
+        // Slots in rotation order after the current one hold successive
+        // windows of time, the current slot (if used) wraps to the end.
+        const auto shift    = levelBits * level;
+        const auto index    = (time >> shift) & (slotCount - 1);
+        const auto first    = (index + 1) & (slotCount - 1);
+        const auto distance = 1 + (uint64_t) std::countr_zero(std::rotr(occupancy[level], (int) first));
+        const auto slot     = (index + distance) & (slotCount - 1);
+
+        // Everything in that slot is due at or after the start of its window
+        const auto windowStart = ((time >> shift) + distance) << shift;
+
+        if (level > 0 && result && *result <= windowStart)
+            continue;
+
+        for (auto entry = slots[level][slot].head; entry; entry = entry->next)
+            if (! result || entry->deadline < *result)
+                result = entry->deadline;
+    }
+
+    return result;
+}
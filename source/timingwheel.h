@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+// Hierarchical timing wheel with millisecond ticks: four levels of 64
+// slots, each level 64 times coarser than the one below. Scheduling and
+// cancelling are O(1); entries cascade down a level as their deadline
+// comes into range. Time only moves when advance() is called, so the
+// wheel can be driven by a real or a virtual clock.
+struct TimingWheel
+{
+    static constexpr int levelBits  = 6;
+    static constexpr int slotCount  = 1 << levelBits;
+    static constexpr int levelCount = 4;
+    static constexpr uint64_t range = uint64_t(1) << (levelBits * levelCount);
+
+    struct Entry;
+
+    struct List
+    {
+        Entry* head = nullptr;
+        uint64_t* occupancy = nullptr;
+        uint64_t bit = 0;
+
+        auto push(Entry& entry) -> void;
+        auto remove(Entry& entry) -> void;
+    };
+
+    struct Entry
+    {
+        Entry() = default;
+        Entry(const Entry&) = delete;
+        ~Entry();
+
+        auto scheduled() const -> bool { return list != nullptr; }
+
+        uint64_t deadline = 0;
+        uint64_t period   = 0; // 0 for one-shot
+        std::function<void()> callback;
+
+        Entry* prev = nullptr;
+        Entry* next = nullptr;
+        List* list  = nullptr;
+        TimingWheel* wheel = nullptr;
+        bool* destroyed = nullptr;
+    };
+
+    explicit TimingWheel(uint64_t now = 0);
+
+    auto schedule(Entry& entry, uint64_t deadline) -> void;
+    auto cancel(Entry& entry) -> void;
+
+    // Fires everything due up to and including now, returns the count
+    auto advance(uint64_t now) -> size_t;
+
+    auto earliest() const -> std::optional<uint64_t>;
+    auto size() const -> size_t { return count; }
+    auto current() const -> uint64_t { return time; }
+
+private:
+    auto place(Entry& entry) -> void;
+    auto cascade(int level) -> void;
+    auto step(List& expired) -> void;
+    auto run(List& expired) -> size_t;
+
+    uint64_t time;
+    size_t count = 0;
+    std::array<uint64_t, levelCount> occupancy{};
+    std::array<std::array<List, slotCount>, levelCount> slots;
+};
@@ -0,0 +1,290 @@
+#include "vfs.h"
+#include "fileio.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <filesystem>
+
+auto vfs_normalize(std::string_view path) -> std::optional<std::string_view>
+{
+    while (path.starts_with('/') || path.starts_with("./"))
+        path.remove_prefix(path.starts_with('/') ? 1 : 2);
+
+    if (path.empty())
+        return std::nullopt;
+
+    for (size_t start = 0; start <= path.size(); )
+    {
+        const auto end = std::min(path.find('/', start), path.size());
+
+        if (path.substr(start, end - start) == "..")
+            return std::nullopt;
+
+        start = end + 1;
+    }
+
+    return path;
+}
+
+auto EmbeddedMount::add(std::string path, std::string_view data) -> void
+{
+    files.insert_or_assign(std::move(path), data);
+}
+
+auto EmbeddedMount::stat(std::string_view path) -> std::optional<VfsStat>
+{
+    if (auto it = files.find(path); it != files.end())
+        return VfsStat{ it->second.size() };
+
+    return std::nullopt;
+}
+
+auto EmbeddedMount::read(std::string_view path) -> std::optional<std::vector<uint8_t>>
+{
+    if (auto it = files.find(path); it != files.end())
+        return std::vector<uint8_t>(it->second.begin(), it->second.end());
+
+    return std::nullopt;
+}
+
+auto EmbeddedMount::view(std::string_view path) -> std::optional<VfsView>
+{
+    if (auto it = files.find(path); it != files.end())
+        return VfsView{ { (const uint8_t*) it->second.data(), it->second.size() } };
+
+    return std::nullopt;
+}
+
+auto EmbeddedMount::list() -> std::vector<std::pair<std::string, VfsStat>>
+{
+    std::vector<std::pair<std::string, VfsStat>> entries;
+
+    for (const auto& [path, data] : files)
+        entries.push_back({ path, { data.size() } });
+
+    return entries;
+}
+
+DirectoryMount::DirectoryMount(std::string folder, bool isImmutable) : root(std::move(folder)), isImmutable(isImmutable)
+{
+    if (! root.empty() && ! root.ends_with('/'))
+        root += '/';
+}
+
+auto DirectoryMount::stat(std::string_view path) -> std::optional<VfsStat>
+{
+    struct stat info;
+
+    if (::stat(filepath(path).c_str(), &info) != 0 || ! S_ISREG(info.st_mode))
+        return std::nullopt;
+
+    return VfsStat{ (size_t) info.st_size, (int64_t) info.st_mtime };
+}
+
+auto DirectoryMount::read(std::string_view path) -> std::optional<std::vector<uint8_t>>
+{
+    return file_read_bytes(filepath(path));
+}
+
+auto DirectoryMount::filepath(std::string_view path) -> std::string
+{
+    return root + std::string(path);
+}
+
+auto DirectoryMount::list() -> std::vector<std::pair<std::string, VfsStat>>
+{
+    using namespace std::filesystem;
+
+    std::vector<std::pair<std::string, VfsStat>> entries;
+    std::error_code ec;
+
+    for (auto it = recursive_directory_iterator(root, ec); ! ec && it != recursive_directory_iterator(); it.increment(ec))
+    {
+        const auto path = it->path().lexically_relative(root).generic_string();
+
+        if (auto info = stat(path))
+            entries.push_back({ path, *info });
+    }
+
+    return entries;
+}
+
+Vfs::Vfs(VfsOptions options) : options(options)
+{
+}
+
+auto Vfs::mount(std::unique_ptr<VfsMount> mount, std::string prefix) -> VfsMount&
+{
+    if (! prefix.empty() && ! prefix.ends_with('/'))
+        prefix += '/';
+
+    auto& mounted = *mounts.emplace_back(Mounted{ std::move(mount), std::move(prefix) }).mount;
+    invalidate();
+
+    return mounted;
+}
+
+auto Vfs::unmountAll() -> void
+{
+    mounts.clear();
+    invalidate();
+}
+
+auto Vfs::stat(std::string_view path) -> std::optional<VfsStat>
+{
+    if (auto clean = vfs_normalize(path))
+        if (auto resolved = lookup(*clean); resolved.mount >= 0)
+            return resolved.stat;
+
+    return std::nullopt;
+}
+
+auto Vfs::read(std::string_view path) -> std::optional<std::vector<uint8_t>>
+{
+    if (auto clean = vfs_normalize(path))
+        if (auto resolved = lookup(*clean); resolved.mount >= 0)
+        {
+            const auto& mounted = mounts[resolved.mount];
+
+            if (auto data = mounted.mount->read(clean->substr(mounted.prefix.size())))
+                return data;
+
+            // Gone since it was resolved, look again next time
+            invalidate(*clean);
+        }
+
+    return std::nullopt;
+}
+
+auto Vfs::filepath(std::string_view path) -> std::string
+{
+    if (auto clean = vfs_normalize(path))
+        if (auto resolved = lookup(*clean); resolved.mount >= 0)
+        {
+            const auto& mounted = mounts[resolved.mount];
+            return mounted.mount->filepath(clean->substr(mounted.prefix.size()));
+        }
+
+    return {};
+}
+
+auto Vfs::view(std::string_view path) -> std::optional<VfsView>
+{
+    if (auto clean = vfs_normalize(path))
+        if (auto resolved = lookup(*clean); resolved.mount >= 0)
+        {
+            const auto& mounted = mounts[resolved.mount];
+            return mounted.mount->view(clean->substr(mounted.prefix.size()));
+        }
+
+    return std::nullopt;
+}
+
+auto Vfs::precompute() -> void
+{
+    const auto now = clock::now();
+
+    // Lowest priority first, mounts above overwrite what they shadow
+    for (auto i = (int) mounts.size() - 1; i >= 0; i--)
+    {
+        auto entries = mounts[i].mount->list();
+
+        std::lock_guard lock(mutex);
+
+        for (auto& [relative, info] : entries)
+        {
+            auto path = mounts[i].prefix + relative;
+            auto permanent = true;
+
+            for (int above = 0; above <= i; above++)
+                if (path.starts_with(mounts[above].prefix))
+                    permanent = permanent && mounts[above].mount->immutable();
+
+            cache.insert_or_assign(std::move(path), Resolved{ i, info, permanent, now });
+        }
+    }
+}
+
+auto Vfs::invalidate() -> void
+{
+    std::lock_guard lock(mutex);
+    cache.clear();
+}
+
+auto Vfs::invalidate(std::string_view path) -> void
+{
+    std::lock_guard lock(mutex);
+
+    if (auto it = cache.find(path); it != cache.end())
+        cache.erase(it);
+}
+
+auto Vfs::getStats() const -> VfsStats
+{
+    std::lock_guard lock(mutex);
+
+    auto result    = stats;
+    result.entries = cache.size();
+
+    return result;
+}
+
+auto Vfs::lookup(std::string_view path) -> Resolved
+{
+    {
+        std::lock_guard lock(mutex);
+        stats.lookups++;
+
+        if (auto it = cache.find(path); it != cache.end())
+            if (it->second.permanent || clock::now() - it->second.checked < options.ttl)
+            {
+                stats.hits++;
+                stats.negativeHits += it->second.mount < 0;
+
+                return it->second;
+            }
+    }
+
+    // Stats hit the disk, keep them outside the lock
+    auto resolved = probe(path);
+
+    std::lock_guard lock(mutex);
+
+    if (cache.size() >= options.maxEntries)
+        cache.clear();
+
+    cache.insert_or_assign(std::string(path), resolved);
+
+    return resolved;
+}
+
+auto Vfs::probe(std::string_view path) -> Resolved
+{
+    Resolved resolved{ -1, {}, true, clock::now() };
+    uint64_t probes = 0;
+
+    for (int i = 0; i < (int) mounts.size(); i++)
+    {
+        const auto& mounted = mounts[i];
+
+        if (! path.starts_with(mounted.prefix))
+            continue;
+
+        // A miss in a mutable mount may turn into a hit later, as may a hit
+        resolved.permanent = resolved.permanent && mounted.mount->immutable();
+        probes++;
+
+        if (auto info = mounted.mount->stat(path.substr(mounted.prefix.size())))
+        {
+            resolved.mount = i;
+            resolved.stat  = *info;
+            break;
+        }
+    }
+
+    std::lock_guard lock(mutex);
+    stats.probes += probes;
+
+    return resolved;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct VfsStat
+{
+    size_t size       = 0;
+    int64_t writeTime = 0; // 0 where there's no such thing, e.g. embedded files
+};
+
+// A file's bytes where a mount already holds them in memory. owner keeps
+// them alive, null for ones built into the binary.
+struct VfsView
+{
+    std::span<const uint8_t> bytes;
+    std::shared_ptr<const void> owner;
+};
+
+// A source of files. Paths are relative to the mount, e.g. "js/app.js".
+struct VfsMount
+{
+    virtual ~VfsMount() = default;
+
+    virtual auto stat(std::string_view path) -> std::optional<VfsStat> = 0;
+    virtual auto read(std::string_view path) -> std::optional<std::vector<uint8_t>> = 0;
+
+    // A file on disk holding exactly the path's bytes, so backends can
+    // sendfile it. Empty when there's none.
+    virtual auto filepath(std::string_view path) -> std::string { return {}; }
+
+    // The path's bytes without a copy, nullopt where the mount would have to read them
+    virtual auto view(std::string_view path) -> std::optional<VfsView> { return std::nullopt; }
+
+    // Every file, for Vfs::precompute()
+    virtual auto list() -> std::vector<std::pair<std::string, VfsStat>> = 0;
+
+    // Contents never change while mounted, lookups through it can be cached for good
+    virtual auto immutable() const -> bool = 0;
+};
+
+// Files compiled into the binary, see embedded_assets()
+struct EmbeddedMount : VfsMount
+{
+    // data must outlive the mount
+    auto add(std::string path, std::string_view data) -> void;
+
+    auto stat(std::string_view path) -> std::optional<VfsStat> override;
+    auto read(std::string_view path) -> std::optional<std::vector<uint8_t>> override;
+    auto view(std::string_view path) -> std::optional<VfsView> override;
+    auto list() -> std::vector<std::pair<std::string, VfsStat>> override;
+    auto immutable() const -> bool override { return true; }
+
+    std::map<std::string, std::string_view, std::less<>> files;
+};
+
+// A folder on disk. Mutable unless told otherwise, so edits show up once
+// the Vfs's cached lookups expire.
+struct DirectoryMount : VfsMount
+{
+    explicit DirectoryMount(std::string root, bool isImmutable = false);
+
+    auto stat(std::string_view path) -> std::optional<VfsStat> override;
+    auto read(std::string_view path) -> std::optional<std::vector<uint8_t>> override;
+    auto filepath(std::string_view path) -> std::string override;
+    auto list() -> std::vector<std::pair<std::string, VfsStat>> override;
+    auto immutable() const -> bool override { return isImmutable; }
+
+    std::string root; // with a trailing slash
+    bool isImmutable;
+};
+
+struct VfsOptions
+{
+    std::chrono::milliseconds ttl{ 1000 }; // how long lookups involving mutable mounts are trusted
+    size_t maxEntries = 16 * 1024;         // the cache starts over past this
+};
+
+struct VfsStats
+{
+    uint64_t lookups      = 0;
+    uint64_t hits         = 0; // answered from the cache
+    uint64_t negativeHits = 0; // of which for files that don't exist
+    uint64_t probes       = 0; // VfsMount::stat calls
+    size_t   entries      = 0;
+};
+
+// Ordered overlay of mounts: a path resolves to the first mount, in mount
+// order, that has it. Resolutions, including misses, are cached, so a hot
+// path or a missing file costs a hash lookup rather than a stat per mount.
+// Safe to use from several threads.
+struct Vfs
+{
+    using clock = std::chrono::steady_clock;
+
+    explicit Vfs(VfsOptions options = {});
+
+    // prefix places the mount under a folder, e.g. "vendor/"
+    // Mount and unmount before serving, lookups don't lock the mount list
+    auto mount(std::unique_ptr<VfsMount> mount, std::string prefix = {}) -> VfsMount&;
+    auto unmountAll() -> void;
+
+    auto stat(std::string_view path) -> std::optional<VfsStat>;
+    auto read(std::string_view path) -> std::optional<std::vector<uint8_t>>;
+    auto filepath(std::string_view path) -> std::string;
+    auto view(std::string_view path) -> std::optional<VfsView>;
+
+    // Fills the cache from every mount's listing, so first lookups don't probe
+    auto precompute() -> void;
+
+    // Forgets cached lookups, all of them or one path's
+    auto invalidate() -> void;
+    auto invalidate(std::string_view path) -> void;
+
+    auto getStats() const -> VfsStats;
+
+    VfsOptions options;
+
+private:
+    struct Mounted
+    {
+        std::unique_ptr<VfsMount> mount;
+        std::string prefix;
+    };
+
+    struct Resolved
+    {
+        int mount = -1; // -1 when no mount has it
+        VfsStat stat;
+        bool permanent = false;
+        clock::time_point checked;
+    };
+
+    // Heterogeneous lookups, so finding a cached path doesn't build a string
+    struct Hash
+    {
+        using is_transparent = void;
+
+        auto operator()(std::string_view path) const -> size_t { return std::hash<std::string_view>{}(path); }
+    };
+
+    auto lookup(std::string_view path) -> Resolved;
+    auto probe(std::string_view path) -> Resolved;
+
+    std::vector<Mounted> mounts;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Resolved, Hash, std::equal_to<>> cache;
+    VfsStats stats;
+};
+
+// Clean relative path or nullopt for anything escaping the root
+auto vfs_normalize(std::string_view path) -> std::optional<std::string_view>;
+
+// Files built into the library (the bridge script), generated by CMake
+auto embedded_assets() -> const std::vector<std::pair<std::string_view, std::string_view>>&;
@@ -0,0 +1,697 @@
+#include "webappinterface.h"
+#include "startuptrace.h"
+#include "replaylog.h"
+
+#include <cstdlib>
+
+// The app packed into one zip, LOOKINGGLASS_APP_ARCHIVE
+static auto app_archive() -> std::string
+{
+    auto archive = std::getenv("LOOKINGGLASS_APP_ARCHIVE");
+    return archive ? archive : "";
+}
+
+// The app folder, LOOKINGGLASS_APP_ROOT points it elsewhere (e.g. headless
+// runs). Next to an archive it's only there to override files in it.
+static auto app_root() -> std::string
+{
+    if (auto root = std::getenv("LOOKINGGLASS_APP_ROOT"))
+        return std::string(root) + "/";
+
+    return app_archive().empty() ? LOOKINGGLASS_APP_DIR "/" : "";
+}
+
+WebAppInterface::WebAppInterface()
+{
+    mountAppFolder(app_root(), app_archive());
+
+    registerScriptEndpoint("__shape", [this] (const nlohmann::json& json)
+        {
+            shapes.add(json[0].get<uint32_t>(), json[1].get<std::vector<std::string>>());
+        });
+
+    // [id, value] or [id, null, error] answering callScript()
+    registerScriptEndpoint("__scriptResult", [this] (const nlohmann::json& json)
+        {
+            finishScriptCall(json);
+        });
+
+    // Sent by bridge.js as each document starts, calls into the last one won't be answered
+    registerScriptEndpoint("__bridgeStart", [this] (const nlohmann::json&)
+        {
+            rejectScriptCalls("page reloaded");
+        });
+
+    registerScriptEndpoint("__jobStart", [this] (const nlohmann::json& json)
+        {
+            const auto id = json.at(0).get<uint64_t>();
+
+            if (! jobs.start(id, json.at(1).get<std::string>(), json.size() > 2 ? json[2] : nlohmann::json()))
+                sendJobEvent({ id, JobEvent::Type::failed, "unknown job" });
+        });
+
+    registerScriptEndpoint("__jobCancel", [this] (const nlohmann::json& json)
+        {
+            jobs.cancel(json.at(0).get<uint64_t>());
+        });
+
+    // [channel, sequence, renderMs]
+    registerScriptEndpoint("__channelAck", [this] (const nlohmann::json& json)
+        {
+            if (auto it = channels.find(json.at(0).get_ref<const std::string&>()); it != channels.end())
+            {
+                it->second->channel.onAck(json.at(1).get<uint64_t>(),
+                                          FlowController::milliseconds(json.at(2).get<double>()),
+                                          FlowController::clock::now());
+
+                // The ack may have opened the window for state held back
+                pumpChannel(*it->second);
+            }
+        });
+
+    registerScriptEndpoint("__memoInvalidate", [this] (const nlohmann::json& json)
+        {
+            for (const auto& tag : json)
+                memoCache.invalidate(tag.get_ref<const std::string&>());
+        });
+
+    registerScriptEndpoint("__memoStats", [this] (const nlohmann::json&) -> nlohmann::json
+        {
+            return memoCache.getStats();
+        }, std::nullopt);
+
+    registerScriptEndpoint("__frameStats", [this] (const nlohmann::json&) -> nlohmann::json
+        {
+            return frames.getStats();
+        }, std::nullopt);
+
+    // [url, body, state] from the page once it has settled, saved in onStop
+    registerScriptEndpoint("__snapshot", [this] (const nlohmann::json& json)
+        {
+            if (! snapshotsEnabled())
+                return;
+
+            auto page = json.at(0).get<std::string>();
+
+            if (page.starts_with("local://"))
+                page.erase(0, 8);
+
+            latestSnapshot = DomSnapshot{ page, json.at(1).get<std::string>(), json.at(2), launchSnapshot.get().version };
+        });
+
+    // Phases only the page can see, the trace is written once it has loaded
+    registerScriptEndpoint("__startupMark", [] (const nlohmann::json& json)
+        {
+            const auto name = json.at(0).get<std::string>();
+
+            if (startupTrace().markOnce(name) && name == "pageLoad")
+                startupTrace().flush();
+        });
+
+    registerScriptEndpoint("print", [] (const nlohmann::json& json)
+        {
+            auto string = json[0].get<std::string>();
+            printf("print(\"%s\")\n", string.c_str());
+        });
+}
+
+auto WebAppInterface::frameClock() -> std::chrono::microseconds
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch());
+}
+
+auto WebAppInterface::mountAppFolder(const std::string& folder, const std::string& zip) -> void
+{
+    auto embedded = std::make_unique<EmbeddedMount>();
+
+    for (const auto& [path, data] : embedded_assets())
+        embedded->add(std::string(path), data);
+
+    root       = folder;
+    archive    = zip;
+    appArchive = nullptr;
+
+    vfs.unmountAll();
+
+    if (! root.empty())
+        vfs.mount(std::make_unique<DirectoryMount>(root));
+
+    if (! archive.empty())
+        if (auto mount = ZipMount::open(archive))
+        {
+            appArchive = mount.get();
+            vfs.mount(std::move(mount));
+        }
+
+    vfs.mount(std::move(embedded));
+}
+
+auto WebAppInterface::getWindowTitle() const -> const char*
+{
+    if (windowTitle.empty())
+    {
+        const auto config = prewarm.getConfig();
+        windowTitle = config.is_object() ? config.value("title", "LookingGlass - Test App") : "LookingGlass - Test App";
+    }
+
+    return windowTitle.c_str();
+}
+
+auto WebAppInterface::getUserScripts() -> std::vector<std::string>
+{
+    constexpr auto bridge = "bridge.js";
+
+    if (auto source = readAsset(bridge))
+    {
+        inlineOptions.bootstrap.emplace(bridge);
+        return { std::move(*source) };
+    }
+
+    return {};
+}
+
+auto WebAppInterface::readAsset(const std::string& name) -> std::optional<std::string>
+{
+    auto warmed = prewarm.take(name);
+
+    if (auto data = warmed ? std::move(*warmed) : vfs.read(name))
+        return std::string(data->begin(), data->end());
+
+    return std::nullopt;
+}
+
+auto WebAppInterface::snapshotsEnabled() const -> bool
+{
+    const auto config = prewarm.getConfig();
+    return launchSnapshot.valid() && config.is_object() && config.value("snapshot", false);
+}
+
+auto WebAppInterface::takeLaunchSnapshot(const std::string& page) -> const DomSnapshot*
+{
+    auto& launch = launchSnapshot.get();
+    std::lock_guard lock(urlMutex);
+
+    if (snapshotServed || ! launch.snapshot || launch.snapshot->page != page)
+        return nullptr;
+
+    snapshotServed = true;
+    return &*launch.snapshot;
+}
+
+auto WebAppInterface::onStop() -> void
+{
+    if (auto recorder = replayRecorder())
+        recorder->flush();
+
+    if (latestSnapshot && snapshotsEnabled() && ! snapshots.save(*latestSnapshot))
+        printf("Error: can't save snapshot to %s\n", snapshots.path.c_str());
+
+    rejectScriptCalls("app stopped");
+}
+
+auto WebAppInterface::inlineAssets() const -> bool
+{
+    const auto config = prewarm.getConfig();
+    return ! config.is_object() || config.value("inlineAssets", true);
+}
+
+auto WebAppInterface::prefetchEnabled() const -> bool
+{
+    const auto config = prewarm.getConfig();
+    return ! config.is_object() || config.value("prefetch", true);
+}
+
+auto WebAppInterface::prefetchSubresources(const std::string& page, std::string_view html) -> void
+{
+    const auto slash = page.rfind('/');
+    const auto base  = slash == std::string::npos ? std::string() : page.substr(0, slash + 1);
+
+    std::vector<std::string> paths;
+
+    // The first page's assets are already being read by the prewarm
+    for (auto& path : find_subresources(html))
+        if (! prewarm.contains(base + path))
+            paths.push_back(base + path);
+
+    prefetch.start({}, paths);
+}
+
+auto WebAppInterface::startPrewarm() -> void
+{
+    prewarm.startConfig("config.json");
+    prewarm.start({}, { "index.html" });
+
+    // Resolve everything mounted up front, first requests then skip the stats
+    workers.post([this] { vfs.precompute(); });
+
+    // Hashing the app folder and reading last run's snapshot stay off the main thread too
+    auto promise   = std::make_shared<std::promise<LaunchSnapshot>>();
+    launchSnapshot = promise->get_future().share();
+
+    workers.post([store = snapshots, root = root, archive = archive, promise]
+        {
+            auto version = asset_version(root);
+
+            if (! archive.empty())
+                version += "-" + std::to_string(file_get_size(archive)) + "-" + std::to_string(file_get_last_write_time(archive));
+
+            auto snapshot = store.load(version);
+
+            promise->set_value({ std::move(version), std::move(snapshot) });
+        });
+}
+
+auto WebAppInterface::onStart() -> void
+{
+    startupTrace().mark("onStart");
+    loadUrl("local://index.html");
+}
+
+auto WebAppInterface::onScriptMessage(const nlohmann::json& message) -> bool
+{
+    if (auto recorder = replayRecorder())
+        recorder->scriptMessage(message);
+
+    startupTrace().markOnce("firstScriptMessage");
+
+    try
+    {
+        // Objects or packed [shapeId, ...values], see messageshapes.h
+        const auto call = decode_script_message(shapes, message);
+
+        if (! call || call->name.empty())
+            throw std::invalid_argument("unknown message shape or no name");
+
+        static const nlohmann::json none;
+
+        dispatch(call->name, call->content ? *call->content : none, call->id);
+        return true;
+    }
+    catch(const std::exception & e)
+    {
+        auto json = message.dump();
+        printf("Error: bad script call: %s\n", json.c_str());
+    }
+
+    return false;
+}
+
+auto WebAppInterface::dispatch(std::string_view name, const nlohmann::json& content, int64_t id) -> void
+{
+    if (auto it = asyncFunctions.find(name); it != asyncFunctions.end())
+    {
+        spawn(it->second(content),
+              [this, id] (const nlohmann::json& result) { reply(id, result.dump()); },
+              [this, id] (std::exception_ptr error)
+              {
+                  try
+                  {
+                      std::rethrow_exception(error);
+                  }
+                  catch (const std::exception& e)
+                  {
+                      reject(id, e.what());
+                  }
+                  catch (...)
+                  {
+                      reject(id, "unknown error");
+                  }
+              });
+
+        return;
+    }
+
+    if (auto it = scriptFunctions.find(name); it != scriptFunctions.end())
+    {
+        try
+        {
+            reply(id, *invoke(it->first, it->second, content));
+        }
+        catch (const std::exception& e)
+        {
+            reject(id, e.what());
+        }
+
+        return;
+    }
+
+    auto it = functions.find(name);
+
+    if (it == functions.end())
+        throw std::out_of_range("no endpoint named " + std::string(name));
+
+    it->second(content);
+}
+
+auto WebAppInterface::invoke(const std::string& name, const ScriptFunction& func, const nlohmann::json& content) -> MemoCache::result_t
+{
+    if (func.memo)
+        if (auto result = memoCache.find(name, content))
+            return result;
+
+    auto result = std::make_shared<const std::string>(func.function(content).dump());
+
+    if (func.memo)
+        memoCache.insert(name, content, result, func.memo->tags);
+
+    return result;
+}
+
+auto WebAppInterface::reply(int64_t id, const std::string& json) -> void
+{
+    if (id > 0)
+        sendMessage("__reply", "[" + std::to_string(id) + ", " + json + "]");
+}
+
+auto WebAppInterface::reject(int64_t id, const std::string& error) -> void
+{
+    if (id > 0)
+        sendMessage("__reject", "[" + std::to_string(id) + ", " + nlohmann::json(error).dump() + "]");
+}
+
+auto WebAppInterface::startScriptCall(const std::string& function, const nlohmann::json& args, std::function<void(const nlohmann::json&)>&& resume) -> void
+{
+    const auto id = nextScriptCallId++;
+    auto& call    = pendingScriptCalls[id];
+
+    call.function = function;
+    call.resume   = std::move(resume);
+
+    if (scriptCallTimeout > 0)
+        call.timeout = makeTimer(scriptCallTimeout, [this, id, function] { finishScriptCall({ id, nullptr, function + ": timed out" }); }, TimerMode::oneShot);
+
+    sendMessage("__callFromNative", "[" + std::to_string(id) + ", "
+                                       + nlohmann::json(function).dump() + ", "
+                                       + args.dump() + "]");
+}
+
+auto WebAppInterface::finishScriptCall(const nlohmann::json& result) -> void
+{
+    auto it = pendingScriptCalls.find(result.at(0).get<int64_t>());
+
+    if (it == pendingScriptCalls.end())
+        return;
+
+    // Out of the map first, resuming may start another call
+    auto call = std::move(it->second);
+    pendingScriptCalls.erase(it);
+    call.resume(result);
+}
+
+auto WebAppInterface::rejectScriptCalls(const std::string& error) -> void
+{
+    for (auto& [id, call] : std::exchange(pendingScriptCalls, {}))
+        call.resume({ id, nullptr, call.function + ": " + error });
+}
+
+auto WebAppInterface::registerScriptEndpoint(const std::string& name, endpoint_t&& endpoint) -> void
+{
+    functions[name] = std::move(endpoint);
+}
+
+auto WebAppInterface::registerScriptEndpoint(const std::string& name, function_t&& function, std::optional<MemoOptions> memo) -> void
+{
+    memoCache.invalidateEndpoint(name);
+    scriptFunctions[name] = { std::move(function), std::move(memo) };
+}
+
+auto WebAppInterface::invalidateMemo(std::string_view tag) -> size_t
+{
+    return memoCache.invalidate(tag);
+}
+
+auto WebAppInterface::registerJob(const std::string& name, JobRegistry::job_t&& job) -> void
+{
+    jobs.registerJob(name, std::move(job));
+}
+
+auto WebAppInterface::sendJobEvent(const JobEvent& event) -> void
+{
+    sendMessage("__jobEvent", "[" + std::to_string(event.id) + ", \""
+                                 + jobEventTypeName(event.type) + "\", "
+                                 + event.payload.dump() + "]");
+}
+
+auto WebAppInterface::openChannel(const std::string& name, FlowConfig config) -> OutboundChannel&
+{
+    auto& push = channels[name];
+
+    auto send = [this, name] (uint64_t sequence, const nlohmann::json& batch)
+    {
+        sendMessage("__channelBatch", "[" + nlohmann::json(name).dump() + ", "
+                                         + std::to_string(sequence) + ", "
+                                         + batch.dump() + "]");
+    };
+
+    push = std::make_unique<PushChannel>(PushChannel{ OutboundChannel(std::move(send), config) });
+
+    const auto tick = std::max((int) config.minInterval.count(), 1);
+
+    // Ticks only while there's state waiting on the window or the interval,
+    // acks restart it through pumpChannel
+    push->timer = makeTimer(tick, [raw = push.get()]
+        {
+            raw->channel.pump(FlowController::clock::now());
+
+            if (! raw->channel.hasPending())
+            {
+                raw->timer->stop();
+                raw->pumping = false;
+            }
+        });
+
+    push->timer->stop();
+    return push->channel;
+}
+
+auto WebAppInterface::pushState(std::string_view channel, const std::string& key, nlohmann::json state) -> void
+{
+    auto it = channels.find(channel);
+
+    if (it == channels.end())
+        return;
+
+    it->second->channel.push(key, std::move(state));
+    pumpChannel(*it->second);
+}
+
+auto WebAppInterface::pumpChannel(PushChannel& push) -> void
+{
+    push.channel.pump(FlowController::clock::now());
+
+    if (! push.channel.hasPending() || push.pumping)
+        return;
+
+    push.timer->start(std::max((int) push.channel.flow.config.minInterval.count(), 1));
+    push.pumping = true;
+}
+
+auto WebAppInterface::registerAsyncScriptEndpoint(const std::string& name, task_t&& task) -> void
+{
+    asyncFunctions[name] = std::move(task);
+}
+
+auto WebAppInterface::schedule(TaskPriority priority, std::function<void()>&& task) -> void
+{
+    frames.post(priority, std::move(task));
+}
+
+auto WebAppInterface::scheduleSliced(TaskPriority priority, FrameScheduler::slice_t&& slice) -> void
+{
+    frames.postSliced(priority, std::move(slice));
+}
+
+auto WebAppInterface::requestFrame(std::chrono::microseconds delay) -> void
+{
+    const auto milliseconds = (int) std::chrono::ceil<std::chrono::milliseconds>(delay).count();
+
+    if (milliseconds > 0)
+        messageThread.postDelayed(milliseconds, [this] { frames.runFrame(); });
+    else
+        messageThread.post([this] { frames.runFrame(); });
+}
+
+auto WebAppInterface::onUrlRequest(const UrlRequest& request) -> std::unique_ptr<UrlResponse>
+{
+    constexpr std::string_view prefix = "local://";
+
+    startupTrace().markOnce("firstUrlRequest");
+
+    if (auto recorder = replayRecorder())
+        recorder->urlRequest(request.path);
+
+    if (request.path == "local://__inline")
+    {
+        auto response = std::make_unique<UrlResponse>();
+
+        std::lock_guard lock(urlMutex);
+
+        response->data     = toU8Vec(inlineManifest.dump());
+        response->mimetype = "application/json";
+
+        return response;
+    }
+
+    if (request.path == "local://__prefetch")
+    {
+        auto response = std::make_unique<UrlResponse>();
+
+        response->data     = toU8Vec(nlohmann::json(prefetch.getStats()).dump());
+        response->mimetype = "application/json";
+
+        return response;
+    }
+
+    if (request.path == "local://__flights")
+    {
+        const auto stats = urlFlights.getStats();
+        auto response    = std::make_unique<UrlResponse>();
+
+        response->data     = toU8Vec(nlohmann::json{ { "flights",   stats.flights },
+                                                     { "coalesced", stats.coalesced },
+                                                     { "maxShared", stats.maxShared } }.dump());
+        response->mimetype = "application/json";
+
+        return response;
+    }
+
+    if (request.path == "local://__vfs")
+    {
+        const auto stats = vfs.getStats();
+        auto response    = std::make_unique<UrlResponse>();
+        auto json        = nlohmann::json{ { "lookups",      stats.lookups },
+                                           { "hits",         stats.hits },
+                                           { "negativeHits", stats.negativeHits },
+                                           { "probes",       stats.probes },
+                                           { "entries",      stats.entries } };
+
+        if (appArchive)
+        {
+            const auto zip  = appArchive->getStats();
+            json["archive"] = { { "stored",     zip.stored },
+                                { "inflated",   zip.inflated },
+                                { "cacheHits",  zip.cacheHits },
+                                { "cacheBytes", zip.cacheBytes } };
+        }
+
+        response->data     = toU8Vec(json.dump());
+        response->mimetype = "application/json";
+
+        return response;
+    }
+
+    if (request.path == "local://__startup")
+    {
+        auto response = std::make_unique<UrlResponse>();
+
+        response->data     = toU8Vec(startupTrace().toChromeTrace().dump());
+        response->mimetype = "application/json";
+
+        return response;
+    }
+
+    const auto name = request.path.substr(std::min(prefix.length(), request.path.size()));
+
+    // Requests can come off the network too (httpserver.h), stay in the app folder
+    if (name.find("..") != std::string::npos)
+        return nullptr;
+
+    if (logRequests)
+        printf("Request: %s\n", name.c_str());
+
+    // Concurrent requests for the same url share one load and one body
+    auto shared = urlFlights.run(name, [this, &name] { return makeResponse(name); });
+
+    if (! shared)
+        return nullptr;
+
+    auto response = std::make_unique<UrlResponse>();
+
+    response->mimetype = shared->mimetype;
+    response->filepath = shared->filepath;
+
+    if (shared->filepath.empty())
+    {
+        response->view  = shared->body();
+        response->owner = shared;
+    }
+
+    return response;
+}
+
+auto WebAppInterface::makeResponse(const std::string& name) -> std::shared_ptr<const UrlResponse>
+{
+    auto warmed = prewarm.take(name);
+
+    if (! warmed && ! name.ends_with(".html"))
+        if (auto prefetched = prefetch.take(name))
+            warmed.emplace(std::move(prefetched));
+
+    // Nothing to rewrite, hand over the file itself when it's on disk, or
+    // its bytes where a mount already has them in memory
+    if (! warmed && ! name.ends_with(".html"))
+    {
+        if (auto path = vfs.filepath(name); ! path.empty())
+        {
+            auto response = std::make_shared<UrlResponse>();
+
+            response->filepath = std::move(path);
+            response->mimetype = file_get_mimetype(name);
+
+            return response;
+        }
+
+        if (auto bytes = vfs.view(name))
+        {
+            auto response = std::make_shared<UrlResponse>();
+
+            response->view     = bytes->bytes;
+            response->owner    = std::move(bytes->owner);
+            response->mimetype = file_get_mimetype(name);
+
+            return response;
+        }
+    }
+
+    if (auto data = warmed ? std::move(*warmed) : vfs.read(name))
+    {
+        auto response = std::make_shared<UrlResponse>();
+
+        response->data     = std::move(*data);
+        response->mimetype = file_get_mimetype(name);
+
+        // Inline small scripts and styles the document would otherwise fetch
+        // one by one. With inlining off the bootstrap tags still go, the
+        // bridge would run twice otherwise.
+        if (name.ends_with(".html") && (inlineAssets() || ! inlineOptions.bootstrap.empty()))
+        {
+            auto options     = inlineOptions;
+            options.inlining = inlineAssets();
+
+            const auto html = std::string_view((const char*) response->data.data(), response->data.size());
+            auto result     = inline_critical_assets(html, [this] (const std::string& asset) { return readAsset(asset); }, options);
+
+            response->data = toU8Vec(result.html);
+
+            if (logRequests)
+                printf("Inlined %zu bytes into %s\n", result.inlinedBytes, name.c_str());
+
+            std::lock_guard lock(urlMutex);
+            inlineManifest = std::move(result);
+        }
+
+        // Serve last run's settled DOM, the page's scripts then hydrate it
+        if (name.ends_with(".html") && snapshotsEnabled())
+        {
+            const auto html = std::string_view((const char*) response->data.data(), response->data.size());
+            response->data  = toU8Vec(apply_snapshot(html, takeLaunchSnapshot(name)));
+        }
+
+        if (name.ends_with(".html") && prefetchEnabled())
+            prefetchSubresources(name, { (const char*) response->data.data(), response->data.size() });
+
+        return response;
+    }
+
+    return nullptr;
+}
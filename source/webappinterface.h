@@ -0,0 +1,218 @@
+#pragma once
+
+#include "webviewinterface.h"
+#include "messageshapes.h"
+#include "memocache.h"
+#include "task.h"
+#include "jobs.h"
+#include "flowcontrol.h"
+#include "eventloop.h"
+#include "framescheduler.h"
+#include "prewarm.h"
+#include "prefetch.h"
+#include "singleflight.h"
+#include "htmlinliner.h"
+#include "snapshotstore.h"
+#include "vfs.h"
+#include "zipmount.h"
+#include "fileutils.h"
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// The app: script endpoints, url handling and the native services behind
+// them, independent of the backend that hosts the page.
+struct WebAppInterface : WebViewInterface
+{
+    using endpoint_t = std::function<void(const nlohmann::json&)>;
+    using function_t = std::function<nlohmann::json(const nlohmann::json&)>;
+    using task_t     = std::function<Task<nlohmann::json>(const nlohmann::json&)>;
+
+    struct LaunchSnapshot
+    {
+        std::string version;
+        std::optional<DomSnapshot> snapshot;
+    };
+
+    struct PushChannel
+    {
+        OutboundChannel channel;
+        Timer::ptr timer;
+        bool pumping = false;
+    };
+
+    struct ScriptFunction
+    {
+        function_t function;
+        std::optional<MemoOptions> memo;
+    };
+
+    // A callScript() waiting on the page, resumed with [id, value] or [id, null, error]
+    struct PendingScriptCall
+    {
+        std::string function;
+        std::function<void(const nlohmann::json&)> resume;
+        Timer::ptr timeout;
+    };
+
+    std::map<std::string, endpoint_t, std::less<>> functions;
+    std::map<std::string, ScriptFunction, std::less<>> scriptFunctions;
+    std::map<std::string, task_t, std::less<>> asyncFunctions;
+    std::map<int64_t, PendingScriptCall> pendingScriptCalls;
+    std::map<std::string, std::unique_ptr<PushChannel>, std::less<>> channels;
+    int64_t nextScriptCallId = 1;
+    int scriptCallTimeout    = 60000; // milliseconds, 0 waits for as long as the page lasts
+    ShapeRegistry shapes;
+    MemoCache memoCache;
+    EventLoop& messageThread = getEventLoop();
+    Vfs vfs; // outlives the workers, they read through it
+    WorkerPool workers;
+    JobRegistry jobs{ workers, messageThread, [this] (const JobEvent& event) { sendJobEvent(event); } };
+    AssetPrewarm prewarm{ workers, [this] (const std::string& path) { return vfs.read(path); } };
+    SubresourcePrefetch prefetch{ workers, [this] (const std::string& path) { return vfs.read(path); } };
+    mutable std::string windowTitle;
+    InlineOptions inlineOptions;
+    nlohmann::json inlineManifest;
+    SnapshotStore snapshots{ default_snapshot_path() };
+    std::shared_future<LaunchSnapshot> launchSnapshot;
+    std::optional<DomSnapshot> latestSnapshot;
+    bool snapshotServed = false;
+    FrameScheduler frames{ frameClock, [this] (auto delay) { requestFrame(delay); } };
+    Timer::ptr timer;
+    SingleFlight<std::string, std::shared_ptr<const UrlResponse>> urlFlights;
+    std::mutex urlMutex; // state url requests share when they run off the message thread
+    bool logRequests = true;
+    std::string root;            // the app folder, with a trailing slash, empty for none
+    std::string archive;         // the app zip, empty for none
+    ZipMount* appArchive = nullptr;
+
+    WebAppInterface();
+
+    // Assets come from the app folder, then the app zip, then what's built
+    // in. Call before serving to point the app elsewhere.
+    auto mountAppFolder(const std::string& folder, const std::string& zip = {}) -> void;
+
+    static auto frameClock() -> std::chrono::microseconds;
+
+    auto getWindowTitle() const -> const char* override;
+
+    // The bridge goes in as a user script so pages don't wait on fetching it
+    auto getUserScripts() -> std::vector<std::string> override;
+
+    auto readAsset(const std::string& name) -> std::optional<std::string>;
+
+    // Opt in with "snapshot": true in config.json
+    auto snapshotsEnabled() const -> bool;
+
+    // The snapshot saved by the last run, handed out once for its page
+    auto takeLaunchSnapshot(const std::string& page) -> const DomSnapshot*;
+    auto inlineAssets() const -> bool;
+
+    // Opt out with "prefetch": false in config.json
+    auto prefetchEnabled() const -> bool;
+
+    // Starts reading what a served page is about to ask for
+    auto prefetchSubresources(const std::string& page, std::string_view html) -> void;
+
+    // Called from main before startWebApp, overlaps file reads with window creation
+    auto startPrewarm() -> void;
+
+    auto onStart() -> void override;
+    auto onStop() -> void override;
+    auto onScriptMessage(const nlohmann::json& message) -> bool override;
+    auto dispatch(std::string_view name, const nlohmann::json& content, int64_t id) -> void;
+    auto invoke(const std::string& name, const ScriptFunction& func, const nlohmann::json& content) -> MemoCache::result_t;
+    auto reply(int64_t id, const std::string& json) -> void;
+    auto reject(int64_t id, const std::string& error) -> void;
+    auto registerScriptEndpoint(const std::string& name, endpoint_t&& endpoint) -> void;
+
+    // Endpoints that return a value, pass MemoOptions to memoize pure ones
+    auto registerScriptEndpoint(const std::string& name, function_t&& function, std::optional<MemoOptions> memo) -> void;
+    auto invalidateMemo(std::string_view tag) -> size_t;
+
+    // Long running work started with startJob() in the page
+    auto registerJob(const std::string& name, JobRegistry::job_t&& job) -> void;
+    auto sendJobEvent(const JobEvent& event) -> void;
+
+    // Flow controlled state pushes, the page listens with onChannel(name)
+    auto openChannel(const std::string& name, FlowConfig config = {}) -> OutboundChannel&;
+    auto pushState(std::string_view channel, const std::string& key, nlohmann::json state) -> void;
+    auto pumpChannel(PushChannel& push) -> void;
+
+    // Coroutine endpoints, the returned value is sent back to invoke()
+    auto registerAsyncScriptEndpoint(const std::string& name, task_t&& task) -> void;
+
+    // Awaitables for coroutine endpoints, all of them resume on the message thread
+    auto sleep(int milliseconds)
+    {
+        return delay(messageThread, milliseconds);
+    }
+
+    template <typename Job>
+    auto runOnWorker(Job&& job)
+    {
+        return offload(workers, messageThread, std::forward<Job>(job));
+    }
+
+    // Callback flavour of runOnWorker: done receives job's result on the
+    // message thread, or no argument when job returns void
+    template <typename Job, typename Done>
+    auto runInBackground(Job&& job, Done&& done) -> void
+    {
+        workers.post([this, job = std::forward<Job>(job), done = std::forward<Done>(done)] () mutable
+            {
+                if constexpr (std::is_void_v<std::invoke_result_t<std::decay_t<Job>&>>)
+                {
+                    job();
+                    callOnMessageThread([done = std::move(done)] () mutable { done(); });
+                }
+                else
+                {
+                    callOnMessageThread([done = std::move(done), result = job()] () mutable
+                        {
+                            done(std::move(result));
+                        });
+                }
+            });
+    }
+
+    // Message-thread work that must not stall input or painting, run a slice
+    // at a time within the frame budget. Idle tasks wait for a quiet frame.
+    auto schedule(TaskPriority priority, std::function<void()>&& task) -> void;
+    auto scheduleSliced(TaskPriority priority, FrameScheduler::slice_t&& slice) -> void;
+    auto requestFrame(std::chrono::microseconds delay) -> void;
+
+    // Calls a page function and resumes with what it returns. Throws if the
+    // page throws, reloads before answering or takes over scriptCallTimeout.
+    auto callScript(const std::string& function, const nlohmann::json& args)
+    {
+        return awaitCallback<nlohmann::json>([this, function, args] (auto resolve, auto reject)
+            {
+                startScriptCall(function, args, [resolve, reject] (const nlohmann::json& result)
+                    {
+                        if (result.size() > 2)
+                            reject(std::make_exception_ptr(std::runtime_error(result[2].get<std::string>())));
+                        else
+                            resolve(result.size() > 1 ? result[1] : nlohmann::json());
+                    });
+            });
+    }
+
+    auto startScriptCall(const std::string& function, const nlohmann::json& args, std::function<void(const nlohmann::json&)>&& resume) -> void;
+    auto finishScriptCall(const nlohmann::json& result) -> void;
+
+    // Fails every call still waiting, e.g. when the page they went to is gone
+    auto rejectScriptCalls(const std::string& error) -> void;
+
+    // Safe to call from several threads at once, identical requests share a response
+    auto onUrlRequest(const UrlRequest& request) -> std::unique_ptr<UrlResponse> override;
+    auto makeResponse(const std::string& name) -> std::shared_ptr<const UrlResponse>;
+};
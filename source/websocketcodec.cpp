@@ -0,0 +1,257 @@
+#include "websocketcodec.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    auto rotl(uint32_t value, int bits) -> uint32_t
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    auto sha1(std::string_view input) -> std::array<uint8_t, 20>
+    {
+        uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+
+        std::string message(input);
+        const uint64_t bits = (uint64_t) input.size() * 8;
+
+        message += (char) 0x80;
+
+        while (message.size() % 64 != 56)
+            message += (char) 0;
+
+        for (int i = 7; i >= 0; i--)
+            message += (char) (bits >> (i * 8));
+
+        for (size_t chunk = 0; chunk < message.size(); chunk += 64)
+        {
+            uint32_t w[80];
+
+            for (int i = 0; i < 16; i++)
+            {
+                auto p = (const uint8_t*) message.data() + chunk + i * 4;
+                w[i]   = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+            }
+
+            for (int i = 16; i < 80; i++)
+                w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+            auto a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+            for (int i = 0; i < 80; i++)
+            {
+                uint32_t f, k;
+
+                if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5a827999; }
+                else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ed9eba1; }
+                else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }
+                else             { f = b ^ c ^ d;                   k = 0xca62c1d6; }
+
+                const auto t = rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = t;
+            }
+
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        std::array<uint8_t, 20> digest;
+
+        for (int i = 0; i < 20; i++)
+            digest[i] = (uint8_t) (h[i / 4] >> (24 - (i % 4) * 8));
+
+        return digest;
+    }
+
+    auto base64(const uint8_t* data, size_t size) -> std::string
+    {
+        constexpr auto alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        std::string encoded;
+
+        for (size_t i = 0; i < size; i += 3)
+        {
+            const uint32_t n = (uint32_t) data[i] << 16
+                             | (i + 1 < size ? (uint32_t) data[i + 1] << 8 : 0)
+                             | (i + 2 < size ? (uint32_t) data[i + 2] : 0);
+
+            encoded += alphabet[(n >> 18) & 63];
+            encoded += alphabet[(n >> 12) & 63];
+            encoded += i + 1 < size ? alphabet[(n >> 6) & 63] : '=';
+            encoded += i + 2 < size ? alphabet[n & 63] : '=';
+        }
+
+        return encoded;
+    }
+}
+
+auto websocket_accept(std::string_view key) -> std::string
+{
+    const auto digest = sha1(std::string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+    return base64(digest.data(), digest.size());
+}
+
+auto websocket_mask(uint8_t* data, size_t size, const uint8_t key[4], size_t offset) -> void
+{
+    // Key stream lined up with data[0]
+    uint8_t stream[16];
+
+    for (int i = 0; i < 16; i++)
+        stream[i] = key[(offset + i) & 3];
+
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const auto mask = _mm_loadu_si128((const __m128i*) stream);
+
+    for (; i + 64 <= size; i += 64)
+    {
+        auto p = (__m128i*) (data + i);
+
+        _mm_storeu_si128(p + 0, _mm_xor_si128(_mm_loadu_si128(p + 0), mask));
+        _mm_storeu_si128(p + 1, _mm_xor_si128(_mm_loadu_si128(p + 1), mask));
+        _mm_storeu_si128(p + 2, _mm_xor_si128(_mm_loadu_si128(p + 2), mask));
+        _mm_storeu_si128(p + 3, _mm_xor_si128(_mm_loadu_si128(p + 3), mask));
+    }
+
+    for (; i + 16 <= size; i += 16)
+    {
+        auto p = (__m128i*) (data + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask));
+    }
+#elif defined(__ARM_NEON)
+    const auto mask = vld1q_u8(stream);
+
+    for (; i + 16 <= size; i += 16)
+        vst1q_u8(data + i, veorq_u8(vld1q_u8(data + i), mask));
+#else
+    uint64_t word;
+    std::memcpy(&word, stream, sizeof(word));
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t value;
+        std::memcpy(&value, data + i, sizeof(value));
+        value ^= word;
+        std::memcpy(data + i, &value, sizeof(value));
+    }
+#endif
+
+    // Every block above is a multiple of 4, so the stream is still in phase
+    for (; i < size; i++)
+        data[i] ^= stream[i & 15];
+}
+
+auto parse_websocket_frame(std::string& buffer, size_t offset, WebSocketFrame& frame, bool requireMask) -> long
+{
+    const auto available = buffer.size() - offset;
+    auto bytes           = (uint8_t*) buffer.data() + offset;
+
+    if (available < 2)
+        return 0;
+
+    const auto masked = (bytes[1] & 0x80) != 0;
+    uint64_t length   = bytes[1] & 0x7f;
+    size_t header     = 2;
+
+    // Reserved bits mean an extension we never negotiated
+    if ((bytes[0] & 0x70) != 0 || masked != requireMask)
+        return -1;
+
+    if (length == 126)
+    {
+        if (available < 4)
+            return 0;
+
+        length = (uint64_t) bytes[2] << 8 | bytes[3];
+        header = 4;
+    }
+    else if (length == 127)
+    {
+        if (available < 10)
+            return 0;
+
+        length = 0;
+
+        for (int i = 0; i < 8; i++)
+            length = length << 8 | bytes[2 + i];
+
+        header = 10;
+    }
+
+    if (length > maxWebSocketPayload)
+        return -1;
+
+    const auto keyAt = header;
+    header += masked ? 4 : 0;
+
+    if (available < header + length)
+        return 0;
+
+    frame.fin    = (bytes[0] & 0x80) != 0;
+    frame.opcode = bytes[0] & 0x0f;
+
+    // Control frames can't be fragmented or carry more than 125 bytes
+    if ((frame.opcode & 0x8) && (! frame.fin || length > 125))
+        return -1;
+
+    if (masked)
+        websocket_mask(bytes + header, (size_t) length, bytes + keyAt);
+
+    frame.payload = { (const char*) bytes + header, (size_t) length };
+    return (long) (header + length);
+}
+
+auto encode_websocket_frame(uint8_t opcode, std::string_view payload, const uint8_t* mask) -> std::string
+{
+    std::string frame;
+    frame.reserve(payload.size() + 14);
+
+    frame += (char) (0x80 | opcode);
+
+    const uint8_t maskBit = mask ? 0x80 : 0;
+
+    if (payload.size() < 126)
+    {
+        frame += (char) (maskBit | payload.size());
+    }
+    else if (payload.size() <= 0xffff)
+    {
+        frame += (char) (maskBit | 126);
+        frame += (char) (payload.size() >> 8);
+        frame += (char) payload.size();
+    }
+    else
+    {
+        frame += (char) (maskBit | 127);
+
+        for (int i = 7; i >= 0; i--)
+            frame += (char) ((uint64_t) payload.size() >> (i * 8));
+    }
+
+    if (! mask)
+        return frame += payload;
+
+    frame.append((const char*) mask, 4);
+
+    const auto start = frame.size();
+    frame += payload;
+    websocket_mask((uint8_t*) frame.data() + start, payload.size(), mask);
+
+    return frame;
+}
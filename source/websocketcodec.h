@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// RFC 6455 framing, shared by the websocket server and its benchmarks
+namespace WebSocketOpcode
+{
+    constexpr uint8_t continuation = 0x0;
+    constexpr uint8_t text         = 0x1;
+    constexpr uint8_t binary       = 0x2;
+    constexpr uint8_t close        = 0x8;
+    constexpr uint8_t ping         = 0x9;
+    constexpr uint8_t pong         = 0xa;
+}
+
+struct WebSocketFrame
+{
+    bool fin       = true;
+    uint8_t opcode = 0;
+    std::string_view payload;
+};
+
+constexpr size_t maxWebSocketPayload = 16 * 1024 * 1024;
+
+// Sec-WebSocket-Accept for a client's Sec-WebSocket-Key
+auto websocket_accept(std::string_view key) -> std::string;
+
+// XORs data with the 4 byte key, starting offset bytes into the key stream.
+// 16 bytes at a time with SSE2 or NEON where available.
+auto websocket_mask(uint8_t* data, size_t size, const uint8_t key[4], size_t offset = 0) -> void;
+
+// Parses the frame at buffer[offset], unmasking its payload in place.
+// Returns the frame's size, 0 if it isn't all there yet, -1 if malformed.
+// requireMask is set for frames coming from clients, which must be masked.
+auto parse_websocket_frame(std::string& buffer, size_t offset, WebSocketFrame& frame, bool requireMask = true) -> long;
+
+// Server frames are sent unmasked, clients pass a key
+auto encode_websocket_frame(uint8_t opcode, std::string_view payload, const uint8_t* mask = nullptr) -> std::string;
@@ -0,0 +1,322 @@
+#include "websocketserver.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+
+WebSocketServer::WebSocketServer(EpollEventLoop& loop, message_t&& onMessage) : loop(loop), onMessage(std::move(onMessage))
+{
+}
+
+WebSocketServer::~WebSocketServer()
+{
+    close();
+}
+
+auto WebSocketServer::adopt(int fd, const HttpRequest& request, std::string leftover) -> bool
+{
+    auto upgrade = request.header("Upgrade");
+    auto key     = request.header("Sec-WebSocket-Key");
+    auto version = request.header("Sec-WebSocket-Version");
+
+    if (! upgrade || ! key || ! version || *version != "13" || request.method != "GET")
+        return false;
+
+    auto client    = std::make_unique<Client>();
+    client->id     = nextClient++;
+    client->fd     = fd;
+    client->input  = std::move(leftover);
+    client->events = EPOLLIN | EPOLLRDHUP;
+
+    const auto id = client->id;
+
+    enqueue(*client, std::make_shared<const std::string>("HTTP/1.1 101 Switching Protocols\r\n"
+                                                         "Upgrade: websocket\r\n"
+                                                         "Connection: Upgrade\r\n"
+                                                         "Sec-WebSocket-Accept: " + websocket_accept(*key) + "\r\n\r\n"));
+
+    clients[id] = std::move(client);
+
+    // The http server still has fd registered until we return, so take it
+    // over on the next turn of the loop
+    loop.post([this, id]
+        {
+            auto it = clients.find(id);
+
+            if (it == clients.end())
+                return;
+
+            loop.watch(it->second->fd, it->second->events, [this, id] (uint32_t events)
+                {
+                    onEvents(id, events);
+                });
+
+            if (onOpen)
+                onOpen(id);
+
+            onEvents(id, EPOLLIN | EPOLLOUT);
+        });
+
+    return true;
+}
+
+auto WebSocketServer::send(client_t id, std::string_view message) -> void
+{
+    auto it = clients.find(id);
+
+    if (it == clients.end())
+        return;
+
+    enqueue(*it->second, std::make_shared<const std::string>(encode_websocket_frame(WebSocketOpcode::text, message)));
+    stats.messagesOut++;
+
+    if (! flush(*it->second))
+        drop(id);
+}
+
+auto WebSocketServer::broadcast(std::string_view message) -> void
+{
+    if (clients.empty())
+        return;
+
+    const auto frame = std::make_shared<const std::string>(encode_websocket_frame(WebSocketOpcode::text, message));
+
+    std::vector<client_t> failed;
+
+    for (auto& [id, client] : clients)
+    {
+        enqueue(*client, frame);
+        stats.messagesOut++;
+
+        if (! flush(*client))
+            failed.push_back(id);
+    }
+
+    for (auto id : failed)
+        drop(id);
+}
+
+auto WebSocketServer::close() -> void
+{
+    while (! clients.empty())
+        drop(clients.begin()->first);
+}
+
+auto WebSocketServer::onEvents(client_t id, uint32_t events) -> void
+{
+    auto it = clients.find(id);
+
+    if (it == clients.end())
+        return;
+
+    auto& client = *it->second;
+
+    if ((events & (EPOLLERR | EPOLLHUP)) || ((events & EPOLLOUT) && ! flush(client)))
+        return drop(id);
+
+    if ((events & (EPOLLIN | EPOLLRDHUP)) && ! client.closing && ! read(client))
+        return drop(id);
+
+    // read() hands messages out, a handler may have dropped us
+    if (! clients.contains(id))
+        return;
+
+    if (! flush(client) || (client.closing && client.output.empty()))
+        drop(id);
+}
+
+auto WebSocketServer::read(Client& client) -> bool
+{
+    std::array<char, 64 * 1024> buffer;
+    auto peerClosed = false;
+
+    while (true)
+    {
+        const auto n = recv(client.fd, buffer.data(), buffer.size(), 0);
+
+        if (n > 0)
+        {
+            client.input.append(buffer.data(), (size_t) n);
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        peerClosed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+    }
+
+    const auto id = client.id;
+    size_t offset = 0;
+
+    while (! client.closing)
+    {
+        WebSocketFrame frame;
+        const auto consumed = parse_websocket_frame(client.input, offset, frame);
+
+        if (consumed == 0)
+            break;
+
+        if (consumed < 0)
+            return false;
+
+        offset += (size_t) consumed;
+
+        switch (frame.opcode)
+        {
+            case WebSocketOpcode::ping:
+                enqueue(client, std::make_shared<const std::string>(encode_websocket_frame(WebSocketOpcode::pong, frame.payload)));
+                continue;
+
+            case WebSocketOpcode::pong:
+                continue;
+
+            case WebSocketOpcode::close:
+                enqueue(client, std::make_shared<const std::string>(encode_websocket_frame(WebSocketOpcode::close, frame.payload.substr(0, 2))));
+                client.closing = true;
+                continue;
+
+            case WebSocketOpcode::continuation:
+                if (client.messageOpcode == 0)
+                    return false;
+                break;
+
+            default:
+                if (client.messageOpcode != 0)
+                    return false;
+
+                client.messageOpcode = frame.opcode;
+                break;
+        }
+
+        if (client.message.size() + frame.payload.size() > maxWebSocketPayload)
+            return false;
+
+        // Unfragmented messages, the common case, are handed out without a copy
+        if (frame.fin && client.message.empty())
+        {
+            client.messageOpcode = 0;
+            stats.messagesIn++;
+            onMessage(id, frame.payload);
+        }
+        else
+        {
+            client.message += frame.payload;
+
+            if (frame.fin)
+            {
+                auto message = std::move(client.message);
+
+                client.message.clear();
+                client.messageOpcode = 0;
+                stats.messagesIn++;
+                onMessage(id, message);
+            }
+        }
+
+        if (! clients.contains(id))
+            return true;
+    }
+
+    client.input.erase(0, offset);
+    return ! peerClosed || ! client.output.empty();
+}
+
+auto WebSocketServer::enqueue(Client& client, const frame_t& frame) -> void
+{
+    client.output.push_back(frame);
+    client.queued += frame->size();
+}
+
+auto WebSocketServer::flush(Client& client) -> bool
+{
+    while (! client.output.empty())
+    {
+        std::array<iovec, 64> iov;
+        size_t count = 0;
+
+        for (auto& frame : client.output)
+        {
+            if (count == iov.size())
+                break;
+
+            const auto skip = count == 0 ? client.sent : 0;
+            iov[count++]    = { (void*) (frame->data() + skip), frame->size() - skip };
+        }
+
+        msghdr message{};
+        message.msg_iov    = iov.data();
+        message.msg_iovlen = count;
+
+        const auto n = sendmsg(client.fd, &message, MSG_NOSIGNAL);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            return false;
+        }
+
+        stats.bytesOut += (uint64_t) n;
+        client.queued  -= (size_t) n;
+
+        auto remaining = (size_t) n;
+
+        while (remaining > 0)
+        {
+            const auto left = client.output.front()->size() - client.sent;
+
+            if (remaining < left)
+            {
+                client.sent += remaining;
+                break;
+            }
+
+            remaining  -= left;
+            client.sent = 0;
+            client.output.pop_front();
+        }
+    }
+
+    if (client.queued > maxQueuedBytes)
+    {
+        stats.dropped++;
+        return false;
+    }
+
+    const auto reading = ! client.closing;
+    const auto events  = (reading ? EPOLLIN | EPOLLRDHUP : 0u) | (client.output.empty() ? 0u : EPOLLOUT);
+
+    // Not registered with the loop until adopt()'s deferred watch
+    if (events != client.events && loop.modify(client.fd, events))
+        client.events = events;
+
+    return true;
+}
+
+auto WebSocketServer::drop(client_t id) -> void
+{
+    auto it = clients.find(id);
+
+    if (it == clients.end())
+        return;
+
+    const auto fd = it->second->fd;
+    clients.erase(it);
+
+    loop.unwatch(fd);
+    ::close(fd);
+
+    if (onClose)
+        onClose(id);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "eventloop_linux.h"
+#include "httpserver.h"
+#include "websocketcodec.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Websocket clients adopted from HttpServer upgrades, on the same epoll
+// loop. Messages are text frames carrying the bridge's JSON. Broadcasts
+// encode a frame once and share it between every client's send queue.
+struct WebSocketServer
+{
+    using client_t  = uint64_t;
+    using message_t = std::function<void(client_t client, std::string_view message)>;
+    using frame_t   = std::shared_ptr<const std::string>;
+
+    struct Stats
+    {
+        uint64_t messagesIn  = 0;
+        uint64_t messagesOut = 0;
+        uint64_t bytesOut    = 0;
+        uint64_t dropped     = 0;
+    };
+
+    // Clients this far behind are dropped rather than buffered forever
+    static constexpr size_t maxQueuedBytes = 16 * 1024 * 1024;
+
+    WebSocketServer(EpollEventLoop& loop, message_t&& onMessage);
+    ~WebSocketServer();
+
+    WebSocketServer(const WebSocketServer&) = delete;
+    auto operator=(const WebSocketServer&) -> WebSocketServer& = delete;
+
+    // Completes the handshake for an upgrade request, see HttpServer::onUpgrade
+    auto adopt(int fd, const HttpRequest& request, std::string leftover) -> bool;
+
+    auto send(client_t client, std::string_view message) -> void;
+    auto broadcast(std::string_view message) -> void;
+    auto close() -> void;
+
+    auto size() const -> size_t { return clients.size(); }
+    auto getStats() const -> Stats { return stats; }
+
+    std::function<void(client_t)> onOpen;
+    std::function<void(client_t)> onClose;
+
+private:
+    struct Client
+    {
+        client_t id = 0;
+        int fd      = -1;
+        std::string input;
+        std::string message;
+        uint8_t messageOpcode = 0;
+        std::deque<frame_t> output;
+        size_t sent     = 0;
+        size_t queued   = 0;
+        uint32_t events = 0;
+        bool closing    = false;
+    };
+
+    auto onEvents(client_t id, uint32_t events) -> void;
+    auto read(Client& client) -> bool;
+    auto enqueue(Client& client, const frame_t& frame) -> void;
+    auto flush(Client& client) -> bool;
+    auto drop(client_t id) -> void;
+
+    EpollEventLoop& loop;
+    message_t onMessage;
+    std::map<client_t, std::unique_ptr<Client>> clients;
+    client_t nextClient = 1;
+    Stats stats;
+};
@@ -0,0 +1,32 @@
+#include "webviewinterface.h"
+#include "eventloop.h"
+#include "replaylog.h"
+
+auto WebViewInterface::getPreferences() const -> Preferences
+{
+    return {};
+}
+
+auto WebViewInterface::getEventLoop() -> EventLoop&
+{
+    return getMessageLoop();
+}
+
+auto WebViewInterface::callOnMessageThread(std::function<void()>&& callback) -> void
+{
+    getEventLoop().post(std::move(callback));
+}
+
+auto WebViewInterface::makeTimer(int milliseconds, std::function<void()>&& function, TimerMode mode) -> std::unique_ptr<Timer>
+{
+    if (auto recorder = replayRecorder())
+    {
+        function = [recorder, id = recorder->nextTimerId(), function = std::move(function)]
+        {
+            recorder->timerFired(id);
+            function();
+        };
+    }
+
+    return getEventLoop().makeTimer(milliseconds, std::move(function), mode);
+}
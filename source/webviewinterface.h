@@ -1,11 +1,15 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 #include <functional>
+#include <memory>
 #include <nlohmann/json_fwd.hpp>
 
+struct EventLoop;
+
 struct UrlRequest
 {
     std::string path;
@@ -15,6 +19,24 @@ struct UrlResponse
 {
     std::string mimetype;
     std::vector<uint8_t> data;
+
+    // Set instead of data when the body lives elsewhere: in another response
+    // it's shared with, in a mapped archive or built into the binary.
+    // owner, where there is one, keeps it alive.
+    std::span<const uint8_t> view;
+    std::shared_ptr<const void> owner;
+
+    auto body() const -> std::span<const uint8_t> { return view.data() ? view : std::span<const uint8_t>(data); }
+
+    // When set the body is this file instead of data, so backends can map
+    // or sendfile it rather than copy it through memory
+    std::string filepath;
+};
+
+enum class TimerMode
+{
+    repeating,
+    oneShot
 };
 
 struct Timer
@@ -25,6 +47,9 @@ struct Timer
     virtual auto start(int milliseconds) -> void = 0;
     virtual auto stop() -> void = 0;
     virtual auto tick() -> void = 0;
+
+    // How late the timer may fire so its wakeup can be shared with others
+    virtual auto setTolerance(int milliseconds) -> void { }
 };
 
 struct WebViewInterface
@@ -43,15 +68,30 @@ struct WebViewInterface
     virtual ~WebViewInterface();
 
     auto execute(const std::string& script) -> void;
+
+    // Calls the page's function name with the elements of content, a JSON
+    // array, as its arguments: name(...content)
+    auto sendMessage(const std::string& name, const std::string& content) -> void;
+
+    // Sees every sendMessage, for tools driving the app (see replaydriver.h)
+    std::function<void(const std::string& name, const std::string& content)> onSendMessage;
     auto loadUrl(const std::string& url) -> void;
     auto loadHtml(const std::string& html) -> void;
     auto callOnMessageThread(std::function<void()>&& callback) -> void;
+    auto getEventLoop() -> EventLoop&;
 
-    auto makeTimer(int milliseconds, std::function<void()>&& function) -> std::unique_ptr<Timer>;
+    auto makeTimer(int milliseconds,
+                   std::function<void()>&& function,
+                   TimerMode mode = TimerMode::repeating) -> std::unique_ptr<Timer>;
 
     virtual auto getWindowTitle() const -> const char* = 0;
     virtual auto getPreferences() const -> Preferences;
+
+    // Run at document start, before any of the page's own scripts
+    virtual auto getUserScripts() -> std::vector<std::string> { return {}; }
+
     virtual auto onStart() -> void = 0;
+    virtual auto onStop() -> void { }
     virtual auto onScriptMessage(const nlohmann::json&) -> bool = 0;
     virtual auto onUrlRequest(const UrlRequest& request) -> std::unique_ptr<UrlResponse> = 0;
 
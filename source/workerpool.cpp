@@ -0,0 +1,303 @@
+#include "workerpool.h"
+
+#include <algorithm>
+#include <utility>
+
+// Which pool and queue the current thread works for, if any
+static thread_local const WorkerPool* currentPool = nullptr;
+static thread_local size_t currentIndex           = 0;
+
+WorkerPool::WorkerPool(size_t threadCount)
+{
+    threadCount = std::max<size_t>(threadCount, 1);
+
+    for (size_t i = 0; i < threadCount; i++)
+        workers.push_back(std::make_unique<Worker>());
+
+    for (size_t i = 0; i < threadCount; i++)
+        workers[i]->thread = std::thread([this, i] { run(i); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard lock(sleepMutex);
+        quit = true;
+    }
+
+    wake.notify_all();
+
+    for (auto& worker : workers)
+        worker->thread.join();
+}
+
+auto WorkerPool::post(std::function<void()>&& job) -> void
+{
+    // Workers keep their own jobs local, everyone else spreads them out
+    const auto index = currentPool == this ? currentIndex
+                                           : nextQueue.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+    {
+        auto& worker = *workers[index];
+        std::lock_guard lock(worker.mutex);
+        worker.jobs.push_back(std::move(job));
+    }
+
+    pending.fetch_add(1);
+    wakeOne();
+}
+
+auto WorkerPool::size() const -> size_t
+{
+    return workers.size();
+}
+
+auto WorkerPool::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) -> void
+{
+    if (begin >= end)
+        return;
+
+    grain = std::max<size_t>(grain, 1);
+
+    struct Range
+    {
+        std::atomic<size_t> next;
+        std::atomic<size_t> remaining;
+        size_t end;
+        size_t grain;
+        const std::function<void(size_t, size_t)>* body;
+
+        // Claims chunks until none are left
+        auto work() -> void
+        {
+            for (auto first = next.fetch_add(grain); first < end; first = next.fetch_add(grain))
+            {
+                (*body)(first, std::min(first + grain, end));
+
+                if (remaining.fetch_sub(1, std::memory_order_release) == 1)
+                    remaining.notify_all();
+            }
+        }
+    };
+
+    const auto chunks = (end - begin + grain - 1) / grain;
+    auto range        = std::make_shared<Range>();
+
+    range->next      = begin;
+    range->remaining = chunks;
+    range->end       = end;
+    range->grain     = grain;
+    range->body      = &body;
+
+    const auto helpers = std::min(chunks - 1, workers.size());
+
+    for (size_t i = 0; i < helpers; i++)
+        post([range] { range->work(); });
+
+    range->work();
+
+    // Every chunk is claimed, only ones already running elsewhere are left.
+    // Picking up other jobs here could hold the caller, often the message
+    // thread, on unrelated work long after the loop is done.
+    for (auto left = range->remaining.load(std::memory_order_acquire); left > 0; left = range->remaining.load(std::memory_order_acquire))
+        range->remaining.wait(left, std::memory_order_acquire);
+}
+
+auto WorkerPool::tryRunOne() -> bool
+{
+    std::function<void()> job;
+
+    if (! take(currentPool == this ? currentIndex : 0, job))
+        return false;
+
+    job();
+    executed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+auto WorkerPool::getStats() const -> Stats
+{
+    return { executed.load(std::memory_order_relaxed), stolen.load(std::memory_order_relaxed) };
+}
+
+auto WorkerPool::take(size_t index, std::function<void()>& job) -> bool
+{
+    if (pending.load() == 0)
+        return false;
+
+    {
+        auto& own = *workers[index];
+        std::lock_guard lock(own.mutex);
+
+        if (! own.jobs.empty())
+        {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            pending.fetch_sub(1);
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers.size(); i++)
+    {
+        auto& victim = *workers[(index + i) % workers.size()];
+        std::lock_guard lock(victim.mutex);
+
+        if (! victim.jobs.empty())
+        {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            pending.fetch_sub(1);
+            stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto WorkerPool::wakeOne() -> void
+{
+    // Sleepers register before re-checking pending, so either they see
+    // the new job or we see them (both sides are sequentially consistent)
+    if (sleepers.load() == 0)
+        return;
+
+    {
+        std::lock_guard lock(sleepMutex);
+    }
+
+    wake.notify_one();
+}
+
+auto WorkerPool::run(size_t index) -> void
+{
+    currentPool  = this;
+    currentIndex = index;
+
+    while (true)
+    {
+        std::function<void()> job;
+
+        if (take(index, job))
+        {
+            job();
+            executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock lock(sleepMutex);
+
+        sleepers.fetch_add(1);
+        wake.wait(lock, [this] { return quit || pending.load() > 0; });
+        sleepers.fetch_sub(1);
+
+        if (quit && pending.load() == 0)
+            return;
+    }
+}
+
+auto TaskGroup::State::runOne() -> bool
+{
+    std::function<void()> job;
+
+    {
+        std::lock_guard lock(mutex);
+
+        if (queue.empty())
+            return false;
+
+        job = std::move(queue.front());
+        queue.pop_front();
+    }
+
+    try
+    {
+        job();
+    }
+    catch (...)
+    {
+        std::lock_guard lock(mutex);
+
+        if (! error)
+            error = std::current_exception();
+    }
+
+    finish();
+    return true;
+}
+
+auto TaskGroup::State::drain() -> void
+{
+    // Runs the group's own jobs no one has started, then sleeps until the
+    // ones already running finish. New jobs they add wake it up again.
+    for (auto left = outstanding.load(std::memory_order_acquire); left > 0; left = outstanding.load(std::memory_order_acquire))
+        if (! runOne())
+            outstanding.wait(left, std::memory_order_acquire);
+}
+
+auto TaskGroup::State::finish() -> void
+{
+    const auto left = outstanding.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    outstanding.notify_all();
+
+    if (left != 0)
+        return;
+
+    decltype(waiters) ready;
+
+    {
+        std::lock_guard lock(mutex);
+        ready.swap(waiters);
+    }
+
+    for (auto& [home, done] : ready)
+        home->post(std::move(done));
+}
+
+TaskGroup::TaskGroup(WorkerPool& pool) : pool(pool)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    state->drain();
+}
+
+auto TaskGroup::run(std::function<void()>&& job) -> void
+{
+    state->outstanding.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard lock(state->mutex);
+        state->queue.push_back(std::move(job));
+    }
+
+    // Runs whichever of the group's jobs is next, or nothing if a waiter got to it first
+    pool.post([state = state] { state->runOne(); });
+}
+
+auto TaskGroup::wait() -> void
+{
+    state->drain();
+
+    std::lock_guard lock(state->mutex);
+
+    if (auto error = std::exchange(state->error, nullptr))
+        std::rethrow_exception(error);
+}
+
+auto TaskGroup::notify(Executor& home, std::function<void()>&& done) -> void
+{
+    {
+        std::lock_guard lock(state->mutex);
+
+        if (state->outstanding.load(std::memory_order_acquire) > 0)
+        {
+            state->waiters.emplace_back(&home, std::move(done));
+            return;
+        }
+    }
+
+    home.post(std::move(done));
+}
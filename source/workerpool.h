@@ -0,0 +1,103 @@
+#pragma once
+
+#include "executor.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for work that must not block the message thread.
+// Each worker owns a deque: it pushes and pops its own jobs LIFO while idle
+// workers steal FIFO from the others. Jobs posted from outside the pool
+// are spread round-robin. Results are expected to hop back to the message
+// thread through an Executor (see TaskGroup::notify).
+struct WorkerPool
+{
+    explicit WorkerPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    auto operator=(const WorkerPool&) -> WorkerPool& = delete;
+
+    auto post(std::function<void()>&& job) -> void;
+    auto size() const -> size_t;
+
+    // Runs body over [begin, end) in chunks of grain, the caller helps with
+    // the chunks (and nothing else) and returns once every chunk is done
+    auto parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) -> void;
+
+    // Runs one pending job on the calling thread, if there is one
+    auto tryRunOne() -> bool;
+
+    struct Stats
+    {
+        uint64_t executed = 0;
+        uint64_t stolen   = 0;
+    };
+
+    auto getStats() const -> Stats;
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+        std::thread thread;
+    };
+
+    auto run(size_t index) -> void;
+    auto take(size_t index, std::function<void()>& job) -> bool;
+    auto wakeOne() -> void;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> pending   = 0;
+    std::atomic<size_t> sleepers  = 0;
+    std::atomic<size_t> nextQueue = 0;
+    std::atomic<uint64_t> executed = 0;
+    std::atomic<uint64_t> stolen   = 0;
+    std::atomic<bool> quit = false;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+};
+
+// A set of jobs on a pool that can be waited on (the waiter helps run the
+// group's own jobs, never unrelated ones) or observed asynchronously from
+// another executor. The first exception thrown by a job is rethrown from wait().
+struct TaskGroup
+{
+    explicit TaskGroup(WorkerPool& pool);
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    auto operator=(const TaskGroup&) -> TaskGroup& = delete;
+
+    auto run(std::function<void()>&& job) -> void;
+    auto wait() -> void;
+
+    // Posts done to home once every job run so far has finished
+    auto notify(Executor& home, std::function<void()>&& done) -> void;
+
+private:
+    struct State
+    {
+        std::mutex mutex;
+        std::atomic<size_t> outstanding = 0;
+        std::deque<std::function<void()>> queue; // not started yet
+        std::exception_ptr error;
+        std::vector<std::pair<Executor*, std::function<void()>>> waiters;
+
+        auto runOne() -> bool;
+        auto drain() -> void;
+        auto finish() -> void;
+    };
+
+    WorkerPool& pool;
+    std::shared_ptr<State> state = std::make_shared<State>();
+};
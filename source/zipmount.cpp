@@ -0,0 +1,328 @@
+#include "zipmount.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <ctime>
+
+struct ZipMount::Mapping
+{
+    ~Mapping()
+    {
+        if (data)
+            munmap((void*) data, size);
+    }
+
+    const uint8_t* data = nullptr;
+    size_t size         = 0;
+};
+
+// Little endian fields at an offset the caller has bounds checked
+static auto read16(const uint8_t* p) -> uint16_t { return (uint16_t) (p[0] | p[1] << 8); }
+static auto read32(const uint8_t* p) -> uint32_t { return (uint32_t) read16(p) | (uint32_t) read16(p + 2) << 16; }
+static auto read64(const uint8_t* p) -> uint64_t { return (uint64_t) read32(p) | (uint64_t) read32(p + 4) << 32; }
+
+constexpr uint32_t localSignature     = 0x04034b50;
+constexpr uint32_t centralSignature   = 0x02014b50;
+constexpr uint32_t endSignature       = 0x06054b50;
+constexpr uint32_t end64Signature     = 0x06064b50;
+constexpr uint32_t locator64Signature = 0x07064b50;
+
+constexpr size_t localSize     = 30;
+constexpr size_t centralSize   = 46;
+constexpr size_t endSize       = 22;
+constexpr size_t end64Size     = 56;
+constexpr size_t locator64Size = 20;
+
+constexpr uint16_t storedMethod   = 0;
+constexpr uint16_t deflatedMethod = 8;
+
+static auto dos_time(uint16_t time, uint16_t date) -> int64_t
+{
+    std::tm tm{};
+
+    tm.tm_year = (date >> 9) + 80;
+    tm.tm_mon  = ((date >> 5) & 0xf) - 1;
+    tm.tm_mday = date & 0x1f;
+    tm.tm_hour = time >> 11;
+    tm.tm_min  = (time >> 5) & 0x3f;
+    tm.tm_sec  = (time & 0x1f) * 2;
+
+    return (int64_t) timegm(&tm);
+}
+
+auto ZipMount::open(const std::string& path, ZipOptions options) -> std::unique_ptr<ZipMount>
+{
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return nullptr;
+
+    struct stat info;
+    auto mapping = std::make_shared<Mapping>();
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        auto data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data != MAP_FAILED)
+        {
+            mapping->data = (const uint8_t*) data;
+            mapping->size = (size_t) info.st_size;
+        }
+    }
+
+    close(fd);
+
+    auto mount     = std::make_unique<ZipMount>();
+    mount->options = options;
+    mount->mapping = std::move(mapping);
+
+    if (! mount->mapping->data || ! mount->parse())
+    {
+        printf("Error: can't read %s as a zip archive\n", path.c_str());
+        return nullptr;
+    }
+
+    return mount;
+}
+
+auto ZipMount::parse() -> bool
+{
+    const auto* data = mapping->data;
+    const auto size  = mapping->size;
+
+    if (size < endSize)
+        return false;
+
+    // The end record sits behind a comment of up to 64K
+    auto end = size - endSize;
+    const auto earliest = size > endSize + 0xffff ? size - endSize - 0xffff : 0;
+
+    while (read32(data + end) != endSignature)
+        if (end-- == earliest)
+            return false;
+
+    uint64_t count     = read16(data + end + 10);
+    uint64_t dirSize   = read32(data + end + 12);
+    uint64_t dirOffset = read32(data + end + 16);
+
+    // Zip64 keeps the real values in a record its locator points at
+    if (end >= locator64Size && read32(data + end - locator64Size) == locator64Signature)
+    {
+        const auto end64 = read64(data + end - locator64Size + 8);
+
+        if (size < end64Size || end64 > size - end64Size || read32(data + end64) != end64Signature)
+            return false;
+
+        count     = read64(data + end64 + 32);
+        dirSize   = read64(data + end64 + 40);
+        dirOffset = read64(data + end64 + 48);
+    }
+
+    if (dirOffset > size || dirSize > size - dirOffset)
+        return false;
+
+    // The count comes from the file, only trust it as far as the directory
+    // could hold that many headers
+    entries.reserve(std::min(count, dirSize / centralSize));
+
+    for (auto p = dirOffset; count-- > 0; )
+    {
+        if (p + centralSize > dirOffset + dirSize || read32(data + p) != centralSignature)
+            return false;
+
+        const auto* header   = data + p;
+        const auto nameSize  = read16(header + 28);
+        const auto extraSize = read16(header + 30);
+        const auto next      = p + centralSize + nameSize + extraSize + read16(header + 32);
+
+        if (next > dirOffset + dirSize)
+            return false;
+
+        Entry entry;
+        entry.method         = read16(header + 10);
+        entry.writeTime      = dos_time(read16(header + 12), read16(header + 14));
+        entry.crc            = read32(header + 16);
+        entry.compressedSize = read32(header + 20);
+        entry.size           = read32(header + 24);
+        entry.headerOffset   = read32(header + 42);
+
+        // Sizes and offset saturated at 32 bits are in the zip64 extra field, in this order
+        const auto* extra = header + centralSize + nameSize;
+
+        for (size_t at = 0; at + 4 <= extraSize; at += 4 + read16(extra + at + 2))
+        {
+            if (read16(extra + at) != 0x0001)
+                continue;
+
+            const auto* field = extra + at + 4;
+            const auto* last  = extra + std::min<size_t>(extraSize, at + 4 + read16(extra + at + 2));
+
+            for (auto* value : { &entry.size, &entry.compressedSize, &entry.headerOffset })
+                if (*value == 0xffffffff && field + 8 <= last)
+                {
+                    *value = read64(field);
+                    field += 8;
+                }
+        }
+
+        auto name = std::string((const char*) header + centralSize, nameSize);
+        const auto encrypted = read16(header + 8) & 1;
+        p = next;
+
+        // Folders, encrypted entries and other compression methods aren't served
+        if (name.empty() || name.ends_with('/') || encrypted || (entry.method != storedMethod && entry.method != deflatedMethod))
+            continue;
+
+        entries.insert_or_assign(std::move(name), entry);
+    }
+
+    return true;
+}
+
+auto ZipMount::compressed(const Entry& entry) const -> std::optional<std::span<const uint8_t>>
+{
+    const auto* data = mapping->data;
+    const auto size  = mapping->size;
+
+    if (size < localSize || entry.headerOffset > size - localSize || read32(data + entry.headerOffset) != localSignature)
+        return std::nullopt;
+
+    const auto start = entry.headerOffset + localSize + read16(data + entry.headerOffset + 26)
+                                                      + read16(data + entry.headerOffset + 28);
+
+    if (start > size || entry.compressedSize > size - start)
+        return std::nullopt;
+
+    return std::span(data + start, entry.compressedSize);
+}
+
+auto ZipMount::inflate(std::string_view path, const Entry& entry) -> inflated_t
+{
+    {
+        std::lock_guard lock(mutex);
+
+        if (auto it = cached.find(path); it != cached.end())
+        {
+            recent.splice(recent.begin(), recent, it->second);
+            stats.cacheHits++;
+
+            return it->second->second;
+        }
+    }
+
+    auto input = compressed(entry);
+
+    if (! input || entry.size > UINT_MAX || input->size() > UINT_MAX)
+        return nullptr;
+
+    auto output = std::make_shared<std::vector<uint8_t>>(entry.size);
+
+    // zlib turns down a null output even when there's nothing to write
+    uint8_t none;
+
+    z_stream stream{};
+    stream.next_in   = (Bytef*) input->data();
+    stream.avail_in  = (uInt) input->size();
+    stream.next_out  = output->empty() ? &none : output->data();
+    stream.avail_out = (uInt) output->size();
+
+    // Zip entries are raw deflate, no zlib header
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return nullptr;
+
+    const auto result = ::inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END || stream.total_out != entry.size
+        || crc32(0, output->data(), (uInt) output->size()) != entry.crc)
+    {
+        printf("Error: corrupt zip entry %.*s\n", (int) path.size(), path.data());
+        return nullptr;
+    }
+
+    std::lock_guard lock(mutex);
+    stats.inflated++;
+
+    if (output->size() > options.cacheBytes || cached.contains(path))
+        return output;
+
+    recent.emplace_front(std::string(path), output);
+    cached.emplace(recent.front().first, recent.begin());
+    stats.cacheBytes += output->size();
+
+    while (stats.cacheBytes > options.cacheBytes)
+    {
+        stats.cacheBytes -= recent.back().second->size();
+        cached.erase(recent.back().first);
+        recent.pop_back();
+    }
+
+    return output;
+}
+
+auto ZipMount::stat(std::string_view path) -> std::optional<VfsStat>
+{
+    if (auto it = entries.find(path); it != entries.end())
+        return VfsStat{ it->second.size, it->second.writeTime };
+
+    return std::nullopt;
+}
+
+auto ZipMount::view(std::string_view path) -> std::optional<VfsView>
+{
+    auto it = entries.find(path);
+
+    if (it == entries.end())
+        return std::nullopt;
+
+    if (it->second.method == storedMethod)
+    {
+        auto bytes = compressed(it->second);
+
+        if (! bytes || bytes->size() != it->second.size)
+            return std::nullopt;
+
+        std::lock_guard lock(mutex);
+        stats.stored++;
+
+        return VfsView{ *bytes, mapping };
+    }
+
+    if (auto inflated = inflate(path, it->second))
+        return VfsView{ *inflated, inflated };
+
+    return std::nullopt;
+}
+
+auto ZipMount::read(std::string_view path) -> std::optional<std::vector<uint8_t>>
+{
+    if (auto bytes = view(path))
+        return std::vector<uint8_t>(bytes->bytes.begin(), bytes->bytes.end());
+
+    return std::nullopt;
+}
+
+auto ZipMount::list() -> std::vector<std::pair<std::string, VfsStat>>
+{
+    std::vector<std::pair<std::string, VfsStat>> listing;
+    listing.reserve(entries.size());
+
+    for (const auto& [path, entry] : entries)
+        listing.push_back({ path, { entry.size, entry.writeTime } });
+
+    return listing;
+}
+
+auto ZipMount::getStats() const -> ZipStats
+{
+    std::lock_guard lock(mutex);
+    return stats;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "vfs.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct ZipOptions
+{
+    size_t cacheBytes = 8 * 1024 * 1024; // inflated entries kept, least recently used go first
+};
+
+struct ZipStats
+{
+    uint64_t stored    = 0; // served straight from the mapping
+    uint64_t inflated  = 0;
+    uint64_t cacheHits = 0;
+    size_t   cacheBytes = 0;
+};
+
+// A read-only zip archive, mapped and indexed from its central directory
+// once. Stored entries are served from the mapping without a copy,
+// deflated ones inflated when first asked for. Don't rewrite the archive
+// in place while it's mounted, replace it instead.
+struct ZipMount : VfsMount
+{
+    struct Mapping;
+
+    // nullptr if the file can't be mapped or isn't a zip
+    static auto open(const std::string& path, ZipOptions options = {}) -> std::unique_ptr<ZipMount>;
+
+    auto stat(std::string_view path) -> std::optional<VfsStat> override;
+    auto read(std::string_view path) -> std::optional<std::vector<uint8_t>> override;
+    auto view(std::string_view path) -> std::optional<VfsView> override;
+    auto list() -> std::vector<std::pair<std::string, VfsStat>> override;
+    auto immutable() const -> bool override { return true; }
+
+    auto getStats() const -> ZipStats;
+
+private:
+    struct Entry
+    {
+        uint64_t headerOffset   = 0; // of the local header, whose lengths can differ from the central one's
+        uint64_t compressedSize = 0;
+        uint64_t size           = 0;
+        uint32_t crc            = 0;
+        uint16_t method         = 0;
+        int64_t writeTime       = 0;
+    };
+
+    struct Hash
+    {
+        using is_transparent = void;
+
+        auto operator()(std::string_view path) const -> size_t { return std::hash<std::string_view>{}(path); }
+    };
+
+    using inflated_t = std::shared_ptr<const std::vector<uint8_t>>;
+
+    auto parse() -> bool;
+    auto compressed(const Entry& entry) const -> std::optional<std::span<const uint8_t>>;
+    auto inflate(std::string_view path, const Entry& entry) -> inflated_t;
+
+    ZipOptions options;
+    std::shared_ptr<const Mapping> mapping;
+    std::unordered_map<std::string, Entry, Hash, std::equal_to<>> entries;
+
+    mutable std::mutex mutex;
+    std::list<std::pair<std::string, inflated_t>> recent; // most recently used first
+    std::unordered_map<std::string_view, decltype(recent)::iterator> cached;
+    ZipStats stats;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// An in-memory app folder that counts its reads and can hold one path's
+// read until released, standing in for a slow disk
+struct FakeAssets
+{
+    using data_t = std::optional<std::vector<uint8_t>>;
+
+    auto reader() -> std::function<data_t(const std::string& path)>
+    {
+        return [this] (const std::string& path) -> data_t
+        {
+            reads++;
+
+            if (path == held)
+                while (! released)
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+            std::lock_guard lock(mutex);
+
+            if (auto it = files.find(path); it != files.end())
+                return std::vector<uint8_t>(it->second.begin(), it->second.end());
+
+            return std::nullopt;
+        };
+    }
+
+    std::mutex mutex;
+    std::map<std::string, std::string> files;
+    std::string held;
+    std::atomic<bool> released = false;
+    std::atomic<int> reads = 0;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Blocking client side of a connection to one of the embedded servers
+inline auto connect_local(uint16_t port) -> int
+{
+    auto fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd >= 0 && connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+inline auto send_all(int fd, std::string_view data) -> bool
+{
+    while (! data.empty())
+    {
+        auto n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+
+        if (n <= 0)
+            return false;
+
+        data.remove_prefix((size_t) n);
+    }
+
+    return true;
+}
+
+// One whole response with a Content-Length body, anything after it stays in buffer
+inline auto read_response(int fd, std::string& buffer, bool head = false) -> std::optional<std::string>
+{
+    char chunk[16 * 1024];
+
+    while (true)
+    {
+        if (auto end = buffer.find("\r\n\r\n"); end != std::string::npos)
+        {
+            auto length = buffer.find("Content-Length: ");
+            auto size   = length < end && ! head ? std::strtoul(buffer.c_str() + length + 16, nullptr, 10) : 0;
+
+            if (buffer.size() >= end + 4 + size)
+            {
+                auto response = buffer.substr(0, end + 4 + size);
+                buffer.erase(0, end + 4 + size);
+                return response;
+            }
+        }
+
+        auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+
+        if (n <= 0)
+            return std::nullopt;
+
+        buffer.append(chunk, (size_t) n);
+    }
+}
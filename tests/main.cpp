@@ -0,0 +1,76 @@
+#include "test.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+auto tests() -> std::vector<TestCase>&
+{
+    static std::vector<TestCase> all;
+    return all;
+}
+
+auto test_fail(const char* file, int line, const std::string& what) -> void
+{
+    const char* name = std::strrchr(file, '/');
+    throw TestFailure{ std::string(name ? name + 1 : file) + ":" + std::to_string(line) + ": " + what };
+}
+
+// lookingglass_tests [--filter substring] [--list]
+auto main(int argc, const char** argv) -> int
+{
+    std::string filter;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (! std::strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (! std::strcmp(argv[i], "--list"))
+        {
+            for (auto& test : tests())
+                printf("%s\n", test.name.c_str());
+
+            return 0;
+        }
+    }
+
+    int ran = 0, failed = 0;
+
+    for (auto& test : tests())
+    {
+        if (test.name.find(filter) == std::string::npos)
+            continue;
+
+        const auto start = std::chrono::steady_clock::now();
+        std::string failure;
+
+        try
+        {
+            test.body();
+        }
+        catch (const TestFailure& e)
+        {
+            failure = e.what;
+        }
+        catch (const std::exception& e)
+        {
+            failure = std::string("exception: ") + e.what();
+        }
+
+        const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        ran++;
+
+        if (failure.empty())
+            printf("ok    %-50s %8.1f ms\n", test.name.c_str(), ms);
+        else
+        {
+            printf("FAIL  %-50s %s\n", test.name.c_str(), failure.c_str());
+            failed++;
+        }
+    }
+
+    printf("%d of %d passed\n", ran - failed, ran);
+    return failed || ! ran ? 1 : 0;
+}
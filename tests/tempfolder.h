@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// A scratch folder under the temp directory, gone when the test ends
+struct TempFolder
+{
+    explicit TempFolder(const char* name) : path(std::filesystem::temp_directory_path() / name)
+    {
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+    }
+
+    ~TempFolder()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+
+    auto write(const std::string& name, const std::string& text) const -> void
+    {
+        std::filesystem::create_directories((path / name).parent_path());
+        std::ofstream(path / name, std::ios::binary) << text;
+    }
+
+    std::filesystem::path path;
+};
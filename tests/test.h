@@ -0,0 +1,33 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// A named case. CHECK failures end the case and are reported by main.
+struct TestCase
+{
+    std::string name;
+    std::function<void()> body;
+};
+
+auto tests() -> std::vector<TestCase>&;
+
+// static TestRegistrar name("group/case", [] { ... });
+struct TestRegistrar
+{
+    TestRegistrar(std::string name, std::function<void()>&& body)
+    {
+        tests().push_back({ std::move(name), std::move(body) });
+    }
+};
+
+struct TestFailure
+{
+    std::string what;
+};
+
+[[noreturn]] auto test_fail(const char* file, int line, const std::string& what) -> void;
+
+// Only from the test's own thread, collect results from others and check them after joining
+#define CHECK(condition) ((condition) ? (void) 0 : test_fail(__FILE__, __LINE__, #condition))
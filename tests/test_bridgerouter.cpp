@@ -0,0 +1,226 @@
+#include "test.h"
+#include "bridgerouter.h"
+#include "webappinterface.h"
+
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+// Pages talking to one app through a router, what each of them was sent is
+// kept per client, broadcasts under client 0
+struct BridgeApp : WebAppInterface
+{
+    BridgeApp()
+    {
+        onSendMessage = [this] (const std::string& name, const std::string& content)
+        {
+            router.sendMessage(name, content);
+        };
+    }
+
+    // A new document in page client, with shapes numbered the way bridge.js would
+    auto open(BridgeRouter::client_t client, std::vector<std::vector<std::string>> shapes) -> void
+    {
+        for (uint32_t id = 0; id < shapes.size(); id++)
+            CHECK(router.onMessage(client, { { "name", "__shape" }, { "content", { id, shapes[id] } } }));
+
+        CHECK(router.onMessage(client, { { "name", "__bridgeStart" }, { "content", nlohmann::json::array() } }));
+    }
+
+    // Messages named name that went to client, as their content
+    auto received(BridgeRouter::client_t client, const std::string& name) const -> std::vector<nlohmann::json>
+    {
+        std::vector<nlohmann::json> found;
+
+        if (auto it = sent.find(client); it != sent.end())
+            for (const auto& message : it->second)
+                if (message["name"] == name)
+                    found.push_back(message["content"]);
+
+        return found;
+    }
+
+    // Runs the message loop until done() says so, or the time is up
+    auto runUntil(const std::function<bool()>& done, int milliseconds = 1000) -> void
+    {
+        auto& loop = getEventLoop();
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+
+        std::function<void()> check;
+        check = [&]
+        {
+            if (done() || std::chrono::steady_clock::now() > deadline)
+                loop.quit();
+            else
+                loop.postDelayed(1, [&check] { check(); });
+        };
+
+        loop.post([&check] { check(); });
+        loop.run();
+    }
+
+    std::map<BridgeRouter::client_t, std::vector<nlohmann::json>> sent;
+    BridgeRouter router{ *this, [this] (BridgeRouter::client_t client, const std::string& text)
+        {
+            sent[client].push_back(nlohmann::json::parse(text));
+        } };
+};
+
+static auto echo(WebAppInterface& app, nlohmann::json content) -> Task<nlohmann::json>
+{
+    co_await app.sleep(5);
+    co_return content;
+}
+
+// Two pages using the same invoke ids and shape ids for different shapes
+// each get their own answers, sync or async, and nothing is broadcast
+static TestRegistrar invokes("bridgerouter/invokes", []
+    {
+        BridgeApp app;
+
+        app.registerAsyncScriptEndpoint("echo", [&app] (const nlohmann::json& content) { return echo(app, content); });
+        app.registerScriptEndpoint("add", [] (const nlohmann::json& content) -> nlohmann::json
+            {
+                return content[0].get<int>() + content[1].get<int>();
+            }, std::nullopt);
+
+        app.open(1, { { "name", "content" }, { "name", "content", "id" } });
+        app.open(2, { { "name", "content", "id" }, { "name", "content" } });
+
+        CHECK(app.router.onMessage(1, { 1, "echo", { "first" }, 1 }));
+        CHECK(app.router.onMessage(2, { 0, "echo", { "second" }, 1 }));
+        CHECK(app.router.onMessage(1, { 1, "add", { 1, 2 }, 2 }));
+        CHECK(app.router.onMessage(2, { 0, "add", { 3, 4 }, 2 }));
+
+        // A shape only the other page registered
+        CHECK(! app.router.onMessage(1, { 2, "add", { 1, 1 }, 3 }));
+
+        app.runUntil([&app] { return app.received(1, "__reply").size() == 2 && app.received(2, "__reply").size() == 2; });
+
+        const auto first  = app.received(1, "__reply");
+        const auto second = app.received(2, "__reply");
+
+        CHECK(first.size() == 2 && second.size() == 2);
+        CHECK(first[0] == nlohmann::json({ 2, 3 }) && first[1] == nlohmann::json({ 1, { "first" } }));
+        CHECK(second[0] == nlohmann::json({ 2, 7 }) && second[1] == nlohmann::json({ 1, { "second" } }));
+        CHECK(! app.sent.contains(0));
+    });
+
+// Jobs with the same page ids run side by side, events go to the page that
+// started them, cancelling only reaches that page's own job
+static TestRegistrar jobs("bridgerouter/jobs", []
+    {
+        BridgeApp app;
+
+        app.registerJob("double", [] (JobContext&, const nlohmann::json& args) -> nlohmann::json
+            {
+                return args.get<int>() * 2;
+            });
+
+        app.registerJob("wait", [] (JobContext& context, const nlohmann::json&) -> nlohmann::json
+            {
+                while (! context.isCancelled())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+                return nullptr;
+            });
+
+        app.open(1, { { "name", "content" } });
+        app.open(2, { { "name", "content" } });
+
+        const auto finished = [&app] (BridgeRouter::client_t client, int64_t id) -> nlohmann::json
+        {
+            for (const auto& event : app.received(client, "__jobEvent"))
+                if (event[0] == id && event[1] != "progress")
+                    return event;
+
+            return nullptr;
+        };
+
+        CHECK(app.router.onMessage(1, { 0, "__jobStart", { 1, "double", 10 } }));
+        CHECK(app.router.onMessage(2, { 0, "__jobStart", { 1, "double", 20 } }));
+        CHECK(app.router.onMessage(2, { 0, "__jobStart", { 3, "missing", nullptr } }));
+
+        app.runUntil([&] { return ! finished(1, 1).is_null() && ! finished(2, 1).is_null(); });
+
+        CHECK(finished(1, 1) == nlohmann::json({ 1, "finished", 20 }));
+        CHECK(finished(2, 1) == nlohmann::json({ 1, "finished", 40 }));
+        CHECK(finished(2, 3) == nlohmann::json({ 3, "failed", "unknown job" }));
+
+        // Page 2's first, on a single worker page 1's would hold it up
+        CHECK(app.router.onMessage(2, { 0, "__jobStart", { 2, "wait", nullptr } }));
+        CHECK(app.router.onMessage(1, { 0, "__jobStart", { 2, "wait", nullptr } }));
+        CHECK(app.router.onMessage(2, { 0, "__jobCancel", { 2 } }));
+
+        app.runUntil([&] { return ! finished(2, 2).is_null(); });
+
+        CHECK(finished(2, 2)[1] == "cancelled");
+
+        // Page 1's job of the same id is still running
+        CHECK(finished(1, 2).is_null());
+
+        // Closing the page cancels it, nobody hears about it
+        const auto before = app.sent[1].size();
+        app.router.onClose(1);
+        app.runUntil([] { return false; }, 50);
+
+        CHECK(app.sent[1].size() == before);
+        CHECK(! app.sent.contains(0));
+    });
+
+static auto ask(WebAppInterface& app, std::string function) -> Task<nlohmann::json>
+{
+    co_return co_await app.callScript(function, nlohmann::json::array());
+}
+
+// Calls into the page made for a page's message go to that page only. A
+// page starting over fails its own calls and nobody else's, and what was
+// pending for its last document isn't sent to the new one. Channel batches
+// are for every page.
+static TestRegistrar scriptCalls("bridgerouter/script_calls", []
+    {
+        BridgeApp app;
+
+        app.registerAsyncScriptEndpoint("ask", [&app] (const nlohmann::json& content)
+            {
+                return ask(app, content.get<std::string>());
+            });
+
+        app.open(1, { { "name", "content", "id" } });
+        app.open(2, { { "name", "content", "id" } });
+
+        CHECK(app.router.onMessage(1, { 0, "ask", "fromFirst", 1 }));
+        CHECK(app.router.onMessage(2, { 0, "ask", "fromSecond", 1 }));
+
+        const auto firstCall  = app.received(1, "__callFromNative");
+        const auto secondCall = app.received(2, "__callFromNative");
+
+        CHECK(firstCall.size() == 1 && firstCall[0][1] == "fromFirst");
+        CHECK(secondCall.size() == 1 && secondCall[0][1] == "fromSecond");
+        CHECK(app.pendingScriptCalls.size() == 2);
+
+        app.open(2, { { "name", "content", "id" } });
+
+        CHECK(app.pendingScriptCalls.size() == 1 && app.pendingScriptCalls.contains(firstCall[0][0].get<int64_t>()));
+        CHECK(app.router.onMessage(1, { { "name", "__scriptResult" }, { "content", { firstCall[0][0], "answer" } } }));
+
+        app.runUntil([&app] { return app.received(1, "__reply").size() == 1; });
+
+        CHECK(app.received(1, "__reply") == std::vector<nlohmann::json>({ { 1, "answer" } }));
+        CHECK(app.received(2, "__reject").empty() && app.received(2, "__reply").empty());
+
+        // Closing a page fails what it was asked
+        CHECK(app.router.onMessage(1, { 0, "ask", "again", 2 }));
+        CHECK(app.pendingScriptCalls.size() == 1);
+
+        app.router.onClose(1);
+        CHECK(app.pendingScriptCalls.empty());
+
+        app.openChannel("state");
+        app.pushState("state", "count", 1);
+        app.runUntil([&app] { return ! app.received(0, "__channelBatch").empty(); });
+
+        CHECK(app.received(0, "__channelBatch").size() == 1);
+        CHECK(app.sent.size() == 3);
+    });
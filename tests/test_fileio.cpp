@@ -0,0 +1,102 @@
+#include "test.h"
+#include "fileio.h"
+#include "tempfolder.h"
+
+#include <string>
+#include <vector>
+
+// Bytes that differ from one offset to the next, so a misplaced chunk shows
+static auto pattern(size_t size) -> std::string
+{
+    std::string text(size, '\0');
+
+    for (size_t i = 0; i < size; i++)
+        text[i] = (char) (i * 7 % 251);
+
+    return text;
+}
+
+static auto bytes(const std::string& text) -> std::vector<uint8_t>
+{
+    return { text.begin(), text.end() };
+}
+
+// Both batch readers give back exactly what's on disk, in order, missing
+// files and directories as nullopt, whichever backend is underneath
+static TestRegistrar batch("fileio/batch", []
+    {
+        TempFolder folder("lookingglass_test_fileio");
+
+        const auto big   = pattern(1024 * 1024 + 3);
+        const auto exact = pattern(defaultMapThreshold);
+
+        folder.write("empty.txt", "");
+        folder.write("small.txt", "hello");
+        folder.write("big.bin", big);
+        folder.write("exact.bin", exact);
+        folder.write("dir/inner.txt", "inner");
+
+        const auto path = [&folder] (const char* name) { return (folder.path / name).string(); };
+
+        std::vector<std::string> paths = { path("empty.txt"), path("small.txt"), path("big.bin"), path("missing.txt"),
+                                           path("exact.bin"), path("dir"), path("small.txt") };
+
+        std::vector<std::optional<std::vector<uint8_t>>> expected = { bytes(""), bytes("hello"), bytes(big), std::nullopt,
+                                                                      bytes(exact), std::nullopt, bytes("hello") };
+
+        // More than the ring holds at once
+        for (int i = 0; i < 150; i++)
+        {
+            const auto name = "many/" + std::to_string(i) + ".txt";
+            folder.write(name, pattern((size_t) i * 97));
+
+            paths.push_back(path(name.c_str()));
+            expected.push_back(bytes(pattern((size_t) i * 97)));
+        }
+
+        const auto batched = file_read_batch(paths);
+        const auto sync    = file_read_batch_sync(paths);
+
+        CHECK(batched.size() == paths.size());
+        CHECK(sync.size() == paths.size());
+
+        for (size_t i = 0; i < paths.size() && i < batched.size() && i < sync.size(); i++)
+        {
+            CHECK(batched[i] == expected[i]);
+            CHECK(sync[i] == expected[i]);
+        }
+
+        CHECK(file_read_batch({}).empty());
+        CHECK(file_read_batch_sync({}).empty());
+
+        const std::string backend = file_batch_backend();
+        CHECK(backend == "io_uring" || backend == "pread");
+    });
+
+// Files from the threshold up are mapped, smaller ones read, both the same bytes
+static TestRegistrar contents("fileio/contents", []
+    {
+        TempFolder folder("lookingglass_test_fileio");
+
+        const auto exact = pattern(defaultMapThreshold);
+        const auto under = pattern(defaultMapThreshold - 1);
+
+        folder.write("exact.bin", exact);
+        folder.write("under.bin", under);
+        folder.write("empty.txt", "");
+
+        const auto mapped = file_read_contents((folder.path / "exact.bin").string());
+        CHECK(mapped && mapped->mapped() && mapped->view() == exact);
+
+        const auto read = file_read_contents((folder.path / "under.bin").string());
+        CHECK(read && ! read->mapped() && read->view() == under);
+
+        const auto empty = file_read_contents((folder.path / "empty.txt").string());
+        CHECK(empty && empty->size() == 0);
+
+        CHECK(! file_read_contents((folder.path / "missing.txt").string()));
+
+        // Moved from, the mapping goes with it
+        auto moved = std::move(*file_read_contents((folder.path / "exact.bin").string()));
+        CHECK(moved.mapped() && moved.view() == exact);
+    });
@@ -0,0 +1,187 @@
+#include "test.h"
+#include "flowcontrol.h"
+
+#include <algorithm>
+#include <deque>
+
+using namespace std::chrono_literals;
+
+using flow_clock = FlowController::clock;
+
+// A page that renders one batch at a time, each taking renderMs, and acks
+// it when done. Batches wait their turn behind the ones before them.
+struct SlowPage
+{
+    struct Ack
+    {
+        flow_clock::time_point at;
+        uint64_t sequence;
+    };
+
+    auto receive(uint64_t sequence, const nlohmann::json& batch, flow_clock::time_point now) -> void
+    {
+        const auto start = std::max(now, busyUntil);
+        busyUntil = start + std::chrono::milliseconds(renderMs);
+
+        acks.push_back({ busyUntil, sequence });
+        received++;
+
+        if (batch.contains("counter"))
+            latest = batch["counter"].get<int>();
+    }
+
+    auto deliver(OutboundChannel& channel, flow_clock::time_point now) -> void
+    {
+        while (! acks.empty() && acks.front().at <= now)
+        {
+            if (! drop)
+                channel.onAck(acks.front().sequence, FlowController::milliseconds(renderMs), acks.front().at);
+
+            acks.pop_front();
+        }
+    }
+
+    int renderMs = 40;
+    bool drop    = false;
+    flow_clock::time_point busyUntil;
+    std::deque<Ack> acks;
+    int received = 0;
+    int latest   = -1;
+};
+
+// A producer updating far faster than the page renders: the window stays
+// bounded, the pace settles on the render time, updates coalesce and the
+// page still ends up with the latest state
+static TestRegistrar slowConsumer("flowcontrol/slow_consumer", []
+    {
+        const auto start = flow_clock::time_point(1h);
+        auto now = start;
+
+        SlowPage page;
+        OutboundChannel channel([&] (uint64_t sequence, const nlohmann::json& batch) { page.receive(sequence, batch, now); });
+
+        size_t maxInFlight = 0;
+        int pushes = 0;
+
+        for (; now < start + 10s; now += 1ms)
+        {
+            page.deliver(channel, now);
+            channel.push("counter", pushes++);
+            channel.pump(now);
+
+            maxInFlight = std::max(maxInFlight, channel.flow.inFlight());
+        }
+
+        // Stop producing and let the page catch up
+        for (; ! channel.idle(); now += 1ms)
+        {
+            page.deliver(channel, now);
+            channel.pump(now);
+        }
+
+        const auto stats = channel.flow.getStats();
+
+        CHECK(maxInFlight <= channel.flow.config.maxInFlight);
+        CHECK(page.latest == pushes - 1);
+        CHECK(stats.sent == (uint64_t) page.received);
+        CHECK(stats.sent < 10'000 / 40 + 10);
+        CHECK(stats.coalesced + stats.sent == (uint64_t) pushes);
+        CHECK(stats.intervalMs >= 40);
+        CHECK(stats.renderMs == 40);
+        CHECK(stats.lost == 0);
+        CHECK(stats.timedOut == 0);
+    });
+
+// Once the page speeds up again the interval recovers, one step per ack,
+// down to the new floor
+static TestRegistrar recovery("flowcontrol/recovery", []
+    {
+        const auto start = flow_clock::time_point(1h);
+        auto now = start;
+
+        SlowPage page;
+        OutboundChannel channel([&] (uint64_t sequence, const nlohmann::json& batch) { page.receive(sequence, batch, now); });
+
+        auto run = [&] (std::chrono::milliseconds length)
+        {
+            for (const auto until = now + length; now < until; now += 1ms)
+            {
+                page.deliver(channel, now);
+                channel.push("counter", 0);
+                channel.pump(now);
+            }
+        };
+
+        page.renderMs = 200;
+        run(10s);
+        const auto slow = channel.flow.interval();
+
+        page.renderMs = 5;
+        run(10s);
+
+        CHECK(slow.count() >= 200);
+        CHECK(channel.flow.interval() < slow);
+
+        run(60s);
+        CHECK(channel.flow.interval() == channel.flow.config.minInterval);
+    });
+
+// An ack that skips older batches counts them lost and frees the window
+static TestRegistrar lostBatches("flowcontrol/lost_batches", []
+    {
+        const auto now = flow_clock::time_point(1h);
+        FlowController flow;
+
+        flow.onSent(1, now);
+        flow.onSent(2, now);
+
+        CHECK(! flow.canSend(now + 100ms));
+        CHECK(flow.onAck(2, 10ms, now + 20ms));
+        CHECK(! flow.onAck(1, 10ms, now + 30ms));
+
+        const auto stats = flow.getStats();
+
+        CHECK(stats.lost == 1);
+        CHECK(stats.acked == 1);
+        CHECK(stats.inFlight == 0);
+        CHECK(flow.canSend(now + 100ms));
+    });
+
+// A page that never acks stalls the window until the timeout, then the
+// batches count as timed out and the pace backs off. Batches expire when
+// the channel next tries to send.
+static TestRegistrar timeouts("flowcontrol/ack_timeout", []
+    {
+        const auto start = flow_clock::time_point(1h);
+        auto now = start;
+
+        SlowPage page;
+        page.drop = true;
+
+        OutboundChannel channel([&] (uint64_t sequence, const nlohmann::json& batch) { page.receive(sequence, batch, now); });
+
+        for (; now < start + 4s; now += 1ms)
+        {
+            channel.push("counter", 0);
+            channel.pump(now);
+        }
+
+        CHECK(page.received == 2);
+        CHECK(channel.hasPending());
+
+        for (; now < start + 6s; now += 1ms)
+        {
+            page.deliver(channel, now);
+            channel.pump(now);
+        }
+
+        const auto stats = channel.flow.getStats();
+
+        // The first expiry opened the window for the held back state, after
+        // that there was nothing to send
+        CHECK(stats.timedOut == 1);
+        CHECK(stats.intervalMs > channel.flow.config.minInterval.count());
+        CHECK(page.received == 3);
+        CHECK(! channel.hasPending());
+        CHECK(! channel.idle());
+    });
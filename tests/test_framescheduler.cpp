@@ -0,0 +1,174 @@
+#include "test.h"
+#include "framescheduler.h"
+
+#include <optional>
+#include <string>
+
+using namespace std::chrono_literals;
+
+// A scheduler on a simulated clock. Slices spend time by moving the clock,
+// requested frames run when the clock reaches them.
+struct SimulatedFrames
+{
+    SimulatedFrames() : frames([this] { return time; }, [this] (std::chrono::microseconds delay)
+        {
+            requests++;
+            pendingFrame = time + delay;
+        })
+    {
+    }
+
+    // Runs requested frames until nothing is left or the frame limit is hit
+    auto run(int maxFrames = 1000) -> int
+    {
+        int ran = 0;
+
+        while (pendingFrame && ran < maxFrames)
+        {
+            time = std::max(time, *pendingFrame);
+            pendingFrame.reset();
+            frames.runFrame();
+            ran++;
+        }
+
+        return ran;
+    }
+
+    auto spend(std::chrono::microseconds cost) { return [this, cost] { time += cost; }; }
+
+    std::chrono::microseconds time{ 0 };
+    std::optional<std::chrono::microseconds> pendingFrame;
+    int requests = 0;
+    FrameScheduler frames;
+};
+
+// A frame stops at its budget and asks for the next one after the rest of
+// the frame interval
+static TestRegistrar budget("framescheduler/budget", []
+    {
+        SimulatedFrames sim;
+
+        for (int i = 0; i < 10; i++)
+            sim.frames.post(TaskPriority::normal, sim.spend(2ms));
+
+        CHECK(sim.requests == 1);
+
+        sim.time = 100ms;
+        sim.pendingFrame.reset();
+        sim.frames.runFrame();
+
+        CHECK(sim.frames.getStats().slices == 3);
+        CHECK(sim.pendingFrame == 100ms + 16ms);
+
+        CHECK(sim.run() == 3);
+        CHECK(sim.frames.pending() == 0);
+        CHECK(sim.frames.getStats().completed == 10);
+        CHECK(sim.frames.getStats().overruns == 0);
+    });
+
+// Work posted by a slice mid-frame doesn't ask for a frame of its own on
+// top of the one the frame asks for at its end
+static TestRegistrar noDuplicateFrames("framescheduler/no_duplicate_requests", []
+    {
+        SimulatedFrames sim;
+        int posted = 0;
+
+        sim.frames.postSliced(TaskPriority::normal, [&]
+            {
+                sim.time += 3ms;
+                sim.frames.post(TaskPriority::normal, sim.spend(1ms));
+                return ++posted < 20;
+            });
+
+        sim.run();
+
+        const auto stats = sim.frames.getStats();
+
+        CHECK(stats.completed == 21);
+        CHECK(sim.requests == (int) stats.frames);
+        CHECK(sim.frames.pending() == 0);
+
+        // Posting from outside a frame asks again, once
+        sim.frames.post(TaskPriority::normal, [] { });
+        sim.frames.post(TaskPriority::normal, [] { });
+        CHECK(sim.requests == (int) stats.frames + 1);
+    });
+
+// Higher priorities run first, slices of the same priority take turns
+static TestRegistrar priorities("framescheduler/priorities", []
+    {
+        SimulatedFrames sim;
+        std::string order;
+
+        auto sliced = [&order] (char name)
+        {
+            return [&order, name, left = 3] () mutable
+            {
+                order += name;
+                return --left > 0;
+            };
+        };
+
+        sim.frames.postSliced(TaskPriority::normal, sliced('a'));
+        sim.frames.postSliced(TaskPriority::normal, sliced('b'));
+        sim.frames.post(TaskPriority::userBlocking, [&order] { order += 'U'; });
+
+        sim.run();
+
+        CHECK(order == "Uababab");
+    });
+
+// Idle slices wait for a frame with nothing else in it
+static TestRegistrar idle("framescheduler/idle_waits", []
+    {
+        SimulatedFrames sim;
+        std::string order;
+
+        sim.frames.post(TaskPriority::idle, [&order] { order += 'i'; });
+        sim.frames.post(TaskPriority::normal, [&order] { order += 'n'; });
+
+        CHECK(sim.run(1) == 1);
+        CHECK(order == "n");
+        CHECK(sim.frames.getStats().idleSlices == 0);
+
+        // Busy frames keep holding it back
+        sim.frames.post(TaskPriority::normal, [&order] { order += 'n'; });
+        CHECK(sim.run(1) == 1);
+        CHECK(order == "nn");
+
+        sim.run();
+        CHECK(order == "nni");
+        CHECK(sim.frames.getStats().idleSlices == 1);
+        CHECK(sim.frames.getStats().frames == 3);
+
+        // Urgent work posted by an idle slice still runs in the same frame
+        sim.frames.post(TaskPriority::idle, [&] { order += 'i'; sim.frames.post(TaskPriority::userBlocking, [&order] { order += 'U'; }); });
+        CHECK(sim.run(1) == 1);
+        CHECK(order == "nniiU");
+    });
+
+// A slice running past the deadline ends the frame and is counted
+static TestRegistrar overruns("framescheduler/overruns", []
+    {
+        SimulatedFrames sim;
+
+        sim.frames.post(TaskPriority::normal, sim.spend(20ms));
+        sim.frames.post(TaskPriority::normal, sim.spend(1ms));
+
+        CHECK(sim.run(1) == 1);
+
+        auto stats = sim.frames.getStats();
+
+        CHECK(stats.slices == 1);
+        CHECK(stats.overruns == 1);
+        CHECK(stats.maxOverrunUs == 14000);
+
+        // A frame that ran past the whole interval asks for the next one straight away
+        CHECK(sim.pendingFrame == sim.time);
+
+        sim.run();
+        stats = sim.frames.getStats();
+
+        CHECK(stats.overruns == 1);
+        CHECK(stats.totalOverrunUs == 14000);
+    });
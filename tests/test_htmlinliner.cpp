@@ -0,0 +1,133 @@
+#include "test.h"
+#include "htmlinliner.h"
+#include "fileio.h"
+
+#include <map>
+
+static const std::string appRoot = LOOKINGGLASS_APP_DIR "/";
+
+static auto read_app(const std::string& path) -> std::optional<std::string>
+{
+    return file_read_text(appRoot + path);
+}
+
+static auto bridge_options() -> InlineOptions
+{
+    InlineOptions options;
+    options.bootstrap.emplace("bridge.js");
+    return options;
+}
+
+static auto count(std::string_view text, std::string_view what) -> size_t
+{
+    size_t found = 0;
+
+    for (auto pos = text.find(what); pos != std::string_view::npos; pos = text.find(what, pos + 1))
+        found++;
+
+    return found;
+}
+
+// The app's own index.html: bridge.js is injected so its tag goes, test.js
+// is inlined in its place
+static TestRegistrar appIndex("htmlinliner/app_index", []
+    {
+        const auto html = read_app("index.html");
+        const auto test = read_app("test.js");
+
+        CHECK(html && test);
+
+        const auto result = inline_critical_assets(*html, read_app, bridge_options());
+
+        CHECK(result.html.find("local://bridge.js") == std::string::npos);
+        CHECK(result.html.find("local://test.js") == std::string::npos);
+        CHECK(result.html.find(*test) != std::string::npos);
+        CHECK(result.html.find("side-bar-list") != std::string::npos);
+        CHECK(result.inlinedBytes == test->size());
+
+        CHECK(result.manifest.size() == 2);
+        CHECK(result.manifest[0].path == "bridge.js");
+        CHECK(result.manifest[0].action == InlineEntry::Action::bootstrap);
+        CHECK(result.manifest[1].action == InlineEntry::Action::inlined);
+
+        CHECK(find_subresources(*html) == std::vector<std::string>({ "bridge.js", "test.js" }));
+    });
+
+// With inlining off the bootstrap tag still goes, so the bridge runs once,
+// and nothing else changes
+static TestRegistrar inliningOff("htmlinliner/inlining_off", []
+    {
+        const auto html = read_app("index.html");
+        auto options    = bridge_options();
+
+        options.inlining = false;
+
+        int reads = 0;
+        const auto result = inline_critical_assets(*html, [&reads] (const std::string& path) { reads++; return read_app(path); }, options);
+
+        CHECK(result.html.find("local://bridge.js") == std::string::npos);
+        CHECK(count(result.html, "<script src=\"local://test.js\"></script>") == 1);
+        CHECK(result.inlinedBytes == 0);
+        CHECK(reads == 0);
+
+        // Without the bridge injected the document is served as it is
+        options.bootstrap.clear();
+        CHECK(inline_critical_assets(*html, read_app, options).html == *html);
+    });
+
+// Tags inside a script's body are text, whatever the script's kind
+static TestRegistrar scriptBodies("htmlinliner/script_bodies", []
+    {
+        const std::map<std::string, std::string> files = { { "a.js", "a()" }, { "b.js", "b()" }, { "c.css", "c{}" } };
+        const auto read = [&files] (const std::string& path) -> std::optional<std::string>
+        {
+            if (auto it = files.find(path); it != files.end())
+                return it->second;
+
+            return std::nullopt;
+        };
+
+        const std::string html =
+            "<script>var a = '<script src=\"a.js\"></scr' + 'ipt>';</script>"
+            "<script type=\"module\">import '<link rel=\"stylesheet\" href=\"c.css\">';</script>"
+            "<script src=\"b.js\"></script>"
+            "<script defer src=\"a.js\"></script>";
+
+        const auto result = inline_critical_assets(html, read);
+
+        CHECK(result.manifest.size() == 1);
+        CHECK(result.manifest[0].path == "b.js");
+        CHECK(result.html == "<script>var a = '<script src=\"a.js\"></scr' + 'ipt>';</script>"
+                             "<script type=\"module\">import '<link rel=\"stylesheet\" href=\"c.css\">';</script>"
+                             "<script>b()</script>"
+                             "<script defer src=\"a.js\"></script>");
+
+        CHECK(find_subresources(html) == std::vector<std::string>({ "b.js", "a.js" }));
+
+        // An unclosed script swallows the rest of the document
+        const auto unclosed = inline_critical_assets("<script src=\"a.js\">oops <link rel=\"stylesheet\" href=\"c.css\">", read);
+        CHECK(unclosed.manifest.empty());
+    });
+
+// Attributes carried over to an inlined tag keep their quotes balanced
+static TestRegistrar attributeQuotes("htmlinliner/attribute_quotes", []
+    {
+        const auto read = [] (const std::string&) -> std::optional<std::string> { return "x()"; };
+
+        const auto result = inline_critical_assets("<script src='a.js' data-note='say \"hi\"' nomodule></script>", read);
+
+        CHECK(result.html == "<script data-note=\"say &quot;hi&quot;\" nomodule>x()</script>");
+    });
+
+// Inlined scripts can't close their own tag early, stylesheets that could stay linked
+static TestRegistrar escaping("htmlinliner/escaping", []
+    {
+        const std::map<std::string, std::string> files = { { "a.js", "s = '</script>'; // <!--" }, { "b.css", "/* </style> */" } };
+        const auto read = [&files] (const std::string& path) -> std::optional<std::string> { return files.at(path); };
+
+        const auto result = inline_critical_assets("<script src=\"a.js\"></script><link rel=\"stylesheet\" href=\"b.css\">", read);
+
+        CHECK(result.html.starts_with("<script>s = '<\\/script>'; // <\\!--</script>"));
+        CHECK(result.html.ends_with("<link rel=\"stylesheet\" href=\"b.css\">"));
+        CHECK(result.manifest[1].action == InlineEntry::Action::linked);
+    });
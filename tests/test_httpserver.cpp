@@ -0,0 +1,244 @@
+#include "test.h"
+#include "httpserver.h"
+#include "localclient.h"
+#include "tempfolder.h"
+#include "websocketserver.h"
+
+#include <filesystem>
+#include <thread>
+
+// The server's loop on a thread of its own while the test reads as a client
+struct LoopThread
+{
+    explicit LoopThread(EpollEventLoop& loop) : loop(loop), thread([&loop] { loop.run(); })
+    {
+    }
+
+    ~LoopThread()
+    {
+        loop.quit();
+        thread.join();
+    }
+
+    EpollEventLoop& loop;
+    std::thread thread;
+};
+
+static auto run_for(EpollEventLoop& loop, int milliseconds) -> void
+{
+    loop.postDelayed(milliseconds, [&loop] { loop.quit(); });
+    loop.run();
+}
+
+static auto open_fds() -> size_t
+{
+    size_t count = 0;
+
+    for (auto& entry : std::filesystem::directory_iterator("/proc/self/fd"))
+        count += entry.is_symlink() ? 1 : 0;
+
+    return count;
+}
+
+// A client pipelining requests without reading the answers is held at the
+// queue bound instead of having every response built up in memory
+static TestRegistrar backpressure("httpserver/backpressure", []
+    {
+        constexpr size_t requestCount = 100;
+        const std::vector<uint8_t> body(256 * 1024, 'x');
+
+        EpollEventLoop loop;
+        HttpServer http(loop, [&body] (const HttpRequest&)
+            {
+                auto response = std::make_unique<UrlResponse>();
+
+                response->data     = body;
+                response->mimetype = "text/plain";
+
+                return response;
+            });
+
+        CHECK(http.listen(0));
+
+        const auto fd = connect_local(http.getPort());
+        CHECK(fd >= 0);
+
+        std::string requests;
+
+        for (size_t i = 0; i < requestCount; i++)
+            requests += "GET /data HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+        CHECK(send_all(fd, requests));
+        run_for(loop, 200);
+
+        // Whatever the socket buffers hold, plus the queue
+        CHECK(http.getStats().requests < requestCount);
+
+        size_t answered = 0;
+
+        {
+            LoopThread thread(loop);
+            std::string buffer;
+
+            while (answered < requestCount)
+            {
+                const auto response = read_response(fd, buffer);
+
+                if (! response || response->size() < body.size() || ! response->starts_with("HTTP/1.1 200"))
+                    break;
+
+                answered++;
+            }
+        }
+
+        CHECK(answered == requestCount);
+        CHECK(http.getStats().requests == requestCount);
+
+        ::close(fd);
+    });
+
+// Files are opened when their response is due, not when it's queued, and
+// go out whole and in order
+static TestRegistrar files("httpserver/files", []
+    {
+        TempFolder folder("lookingglass_test_http");
+        folder.write("small.txt", "hello");
+        folder.write("big.bin", std::string(4 * 1024 * 1024, 'b'));
+
+        EpollEventLoop loop;
+        HttpServer http(loop, [&folder] (const HttpRequest& request)
+            {
+                auto response = std::make_unique<UrlResponse>();
+
+                response->filepath = (folder.path / request.path.substr(1)).string();
+                response->mimetype = "application/octet-stream";
+
+                return response;
+            });
+
+        CHECK(http.listen(0));
+
+        const auto fd = connect_local(http.getPort());
+        CHECK(fd >= 0);
+
+        const auto before = open_fds();
+        std::string requests;
+
+        for (int i = 0; i < 8; i++)
+            requests += "GET /big.bin HTTP/1.1\r\n\r\n";
+
+        requests += "HEAD /small.txt HTTP/1.1\r\n\r\n";
+        requests += "GET /missing.txt HTTP/1.1\r\n\r\n";
+        requests += "GET /small.txt HTTP/1.1\r\n\r\n";
+
+        CHECK(send_all(fd, requests));
+        run_for(loop, 100);
+
+        // The accepted connection and the one file being sent
+        CHECK(open_fds() <= before + 2);
+
+        std::vector<std::string> responses;
+
+        {
+            LoopThread thread(loop);
+            std::string buffer;
+
+            for (int i = 0; i < 11; i++)
+            {
+                auto response = read_response(fd, buffer, i == 8);
+
+                if (! response)
+                    break;
+
+                responses.push_back(std::move(*response));
+            }
+        }
+
+        CHECK(responses.size() == 11);
+
+        for (int i = 0; i < 8; i++)
+            CHECK(responses[i].ends_with("\r\n\r\n" + std::string(4 * 1024 * 1024, 'b')));
+
+        CHECK(responses[8].find("Content-Length: 5\r\n") != std::string::npos && responses[8].ends_with("\r\n\r\n"));
+        CHECK(responses[9].starts_with("HTTP/1.1 404"));
+        CHECK(responses[10].ends_with("\r\n\r\nhello"));
+        CHECK(http.getStats().fileBytes == 8 * 4 * 1024 * 1024 + 5);
+
+        ::close(fd);
+    });
+
+// Upgraded to a websocket, frames sent along with the handshake are kept.
+// Fragments are joined into one message around a ping, and a continuation
+// with no message to continue drops the client.
+static TestRegistrar upgrade("httpserver/upgrade", []
+    {
+        EpollEventLoop loop;
+        HttpServer http(loop, [] (const HttpRequest&) { return nullptr; });
+        std::vector<std::string> messages;
+        size_t closed = 0;
+
+        WebSocketServer sockets(loop, [&messages] (WebSocketServer::client_t, std::string_view message)
+            {
+                messages.emplace_back(message);
+            });
+
+        sockets.onClose = [&closed] (WebSocketServer::client_t) { closed++; };
+
+        http.onUpgrade = [&sockets] (int fd, const HttpRequest& request, std::string leftover)
+        {
+            return sockets.adopt(fd, request, std::move(leftover));
+        };
+
+        CHECK(http.listen(0));
+
+        const auto fd = connect_local(http.getPort());
+        CHECK(fd >= 0);
+
+        const uint8_t key[4] = { 1, 2, 3, 4 };
+        const auto bigPart   = std::string(70000, 'b');
+
+        auto first    = encode_websocket_frame(WebSocketOpcode::text, "hello ", key);
+        auto second   = encode_websocket_frame(WebSocketOpcode::continuation, bigPart, key);
+        const auto ping = encode_websocket_frame(WebSocketOpcode::ping, "still there", key);
+        const auto last = encode_websocket_frame(WebSocketOpcode::continuation, " world", key);
+
+        first[0]  = (char) (first[0] & 0x7f);
+        second[0] = (char) (second[0] & 0x7f);
+
+        CHECK(send_all(fd, "GET /__bridge HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                           "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n"
+                           + first + second + ping + last
+                           + encode_websocket_frame(WebSocketOpcode::text, "single", key)));
+        run_for(loop, 100);
+
+        CHECK(messages.size() == 2 && messages[0] == "hello " + bigPart + " world" && messages[1] == "single");
+
+        std::string buffer;
+        const auto response = read_response(fd, buffer);
+
+        CHECK(response && response->starts_with("HTTP/1.1 101") && response->find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos);
+
+        // The pong may not have come in with the handshake response
+        WebSocketFrame frame;
+        char chunk[256];
+        long consumed;
+
+        while ((consumed = parse_websocket_frame(buffer, 0, frame, false)) == 0)
+        {
+            const auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+
+            if (n <= 0)
+                break;
+
+            buffer.append(chunk, (size_t) n);
+        }
+
+        CHECK(consumed > 0 && frame.opcode == WebSocketOpcode::pong && frame.payload == "still there");
+
+        CHECK(send_all(fd, encode_websocket_frame(WebSocketOpcode::continuation, "stray", key)));
+        run_for(loop, 50);
+
+        CHECK(closed == 1 && sockets.size() == 0 && messages.size() == 2);
+
+        ::close(fd);
+    });
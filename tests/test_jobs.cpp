@@ -0,0 +1,185 @@
+#include "test.h"
+#include "jobs.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// A registry on a real pool, with its home executor pumped by hand from
+// the test's thread and a clock that only moves when told to
+struct JobHarness
+{
+    JobHarness() : registry(pool, home, [this] (const JobEvent& event) { events.push_back(event); })
+    {
+        registry.now = [this] { return ProgressThrottle::clock::time_point(std::chrono::milliseconds(time.load())); };
+    }
+
+    // Pumps home until the job's last event arrives
+    auto waitFor(uint64_t id) -> const JobEvent&
+    {
+        const auto deadline = std::chrono::steady_clock::now() + 10s;
+
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            home.poll();
+
+            if (! events.empty() && events.back().id == id && events.back().type != JobEvent::Type::progress)
+                return events.back();
+
+            std::this_thread::sleep_for(100us);
+        }
+
+        test_fail(__FILE__, __LINE__, "job never finished");
+    }
+
+    WorkerPool pool{ 2 };
+    ManualExecutor home;
+    std::vector<JobEvent> events;
+    std::atomic<int64_t> time = 0;
+    JobRegistry registry;
+};
+
+// Reports go out no faster than the interval and only when they move far
+// enough, completion always goes out once
+static TestRegistrar throttle("jobs/progress_throttle", []
+    {
+        using clock = ProgressThrottle::clock;
+
+        ProgressThrottle throttle(50ms, 0.05);
+        const auto at = [] (int ms) { return clock::time_point(std::chrono::milliseconds(ms)); };
+
+        CHECK(! throttle.shouldEmit(0.01, at(0)));
+        CHECK(throttle.shouldEmit(0.1, at(0)));
+        CHECK(! throttle.shouldEmit(0.5, at(49)));
+        CHECK(throttle.shouldEmit(0.5, at(50)));
+        CHECK(! throttle.shouldEmit(0.52, at(200)));
+        CHECK(throttle.shouldEmit(0.6, at(200)));
+        CHECK(throttle.shouldEmit(1.0, at(201)));
+        CHECK(! throttle.shouldEmit(1.0, at(500)));
+    });
+
+// Results, failures and cancellations each come back once on the home executor
+static TestRegistrar outcomes("jobs/outcomes", []
+    {
+        JobHarness harness;
+
+        harness.registry.registerJob("double", [] (JobContext&, const nlohmann::json& args) -> nlohmann::json { return args.get<int>() * 2; });
+        harness.registry.registerJob("throw", [] (JobContext&, const nlohmann::json&) -> nlohmann::json { throw std::runtime_error("broken"); });
+        harness.registry.registerJob("throwInt", [] (JobContext&, const nlohmann::json&) -> nlohmann::json { throw 42; });
+        harness.registry.registerJob("spin", [] (JobContext& context, const nlohmann::json&) -> nlohmann::json
+            {
+                while (! context.isCancelled())
+                    std::this_thread::sleep_for(100us);
+
+                return nullptr;
+            });
+
+        CHECK(harness.registry.start(1, "double", 21));
+        CHECK(! harness.registry.start(1, "double", 21));
+        CHECK(! harness.registry.start(2, "missing", {}));
+
+        auto& doubled = harness.waitFor(1);
+        CHECK(doubled.type == JobEvent::Type::finished);
+        CHECK(doubled.payload == 42);
+
+        CHECK(harness.registry.start(3, "throw", {}));
+        auto& thrown = harness.waitFor(3);
+        CHECK(thrown.type == JobEvent::Type::failed);
+        CHECK(thrown.payload == "broken");
+
+        // Not every throw is a std::exception, the worker survives those too
+        CHECK(harness.registry.start(5, "throwInt", {}));
+        auto& odd = harness.waitFor(5);
+        CHECK(odd.type == JobEvent::Type::failed);
+        CHECK(odd.payload == "unknown error");
+
+        CHECK(harness.registry.start(4, "spin", {}));
+        CHECK(harness.registry.running() == 1);
+        CHECK(harness.registry.cancel(4));
+        CHECK(harness.waitFor(4).type == JobEvent::Type::cancelled);
+
+        CHECK(! harness.registry.cancel(4));
+        CHECK(harness.registry.running() == 0);
+        CHECK(harness.events.size() == 4);
+    });
+
+// A burst of reports while home is busy arrives as one event carrying the
+// latest value, and always before the result
+static TestRegistrar coalescedProgress("jobs/progress_coalescing", []
+    {
+        JobHarness harness;
+
+        harness.registry.throttle = ProgressThrottle(50ms, 0.01);
+        harness.registry.registerJob("count", [] (JobContext& context, const nlohmann::json&) -> nlohmann::json
+            {
+                for (int i = 0; i <= 1000; i++)
+                    context.progress(i / 1000.0);
+
+                return "done";
+            });
+
+        CHECK(harness.registry.start(1, "count", {}));
+
+        // Home stays busy until the job is over
+        while (harness.pool.getStats().executed == 0)
+            std::this_thread::yield();
+
+        harness.waitFor(1);
+
+        CHECK(harness.events.size() == 2);
+        CHECK(harness.events[0].type == JobEvent::Type::progress);
+        CHECK(harness.events[0].payload["progress"] == 1.0);
+        CHECK(harness.events[1].type == JobEvent::Type::finished);
+    });
+
+// Tearing the registry down cancels what's running, and nothing is
+// delivered or touched once it's gone
+static TestRegistrar teardown("jobs/teardown", []
+    {
+        std::atomic<bool> started = false, cancelled = false;
+        std::vector<JobEvent> events;
+
+        WorkerPool pool{ 2 };
+        ManualExecutor home;
+
+        {
+            JobRegistry registry(pool, home, [&events] (const JobEvent& event) { events.push_back(event); });
+
+            registry.registerJob("spin", [&] (JobContext& context, const nlohmann::json&) -> nlohmann::json
+                {
+                    started = true;
+
+                    for (auto until = std::chrono::steady_clock::now() + 10s; std::chrono::steady_clock::now() < until;)
+                    {
+                        if (context.isCancelled())
+                        {
+                            cancelled = true;
+                            break;
+                        }
+
+                        context.progress(0.5);
+                        std::this_thread::sleep_for(100us);
+                    }
+
+                    return nullptr;
+                });
+
+            CHECK(registry.start(1, "spin", {}));
+
+            while (! started)
+                std::this_thread::yield();
+        }
+
+        while (! cancelled)
+            std::this_thread::yield();
+
+        // The job's result and any report it queued land after the registry is gone
+        while (! home.empty() || pool.getStats().executed == 0)
+            home.poll();
+
+        CHECK(events.empty());
+    });
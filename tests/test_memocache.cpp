@@ -0,0 +1,165 @@
+#include "test.h"
+#include "memocache.h"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+
+// A pure endpoint the way the UI calls it, over a seeded sequence of
+// arguments skewed towards a few hot ones
+struct MemoWorkload
+{
+    explicit MemoWorkload(MemoCache& cache) : cache(cache) { }
+
+    auto next() -> int
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        const auto r = (int) (seed >> 33);
+
+        return r % 4 ? r % 8 : (r >> 2) % 64;
+    }
+
+    auto call(int n) -> std::string
+    {
+        const auto args = nlohmann::json::array({ n, "en-GB" });
+
+        if (auto result = cache.find("format", args))
+            return *result;
+
+        computed++;
+        auto result = std::make_shared<const std::string>(expected(n));
+        cache.insert("format", args, result, { "locale" });
+
+        return *result;
+    }
+
+    static auto expected(int n) -> std::string { return "formatted " + std::to_string(n) + std::string((size_t) n, '.'); }
+
+    MemoCache& cache;
+    uint64_t seed = 42;
+    int computed  = 0;
+};
+
+// With room for everything each distinct argument is computed once and
+// every other call is a hit with the same result
+static TestRegistrar hitsAndMisses("memocache/hits_and_misses", []
+    {
+        MemoCache cache;
+        MemoWorkload workload(cache);
+        std::set<int> distinct;
+
+        for (int i = 0; i < 10'000; i++)
+        {
+            const auto n = workload.next();
+            distinct.insert(n);
+            CHECK(workload.call(n) == MemoWorkload::expected(n));
+        }
+
+        const auto stats = cache.getStats();
+
+        CHECK(workload.computed == (int) distinct.size());
+        CHECK(stats.misses == distinct.size());
+        CHECK(stats.hits + stats.misses == 10'000);
+        CHECK(stats.entries == distinct.size());
+        CHECK(stats.evictions == 0);
+    });
+
+// A tight budget keeps the hot arguments, evicts the least recently used
+// and never goes over
+static TestRegistrar budget("memocache/budget", []
+    {
+        MemoCache cache(4096);
+        MemoWorkload workload(cache);
+
+        for (int i = 0; i < 10'000; i++)
+        {
+            const auto n = workload.next();
+
+            CHECK(workload.call(n) == MemoWorkload::expected(n));
+            CHECK(cache.getStats().bytes <= 4096);
+        }
+
+        const auto stats = cache.getStats();
+
+        CHECK(stats.evictions > 0);
+        CHECK(stats.misses == (uint64_t) workload.computed);
+        CHECK(stats.entries == stats.misses - stats.evictions);
+
+        // The hot arguments made it through
+        CHECK(stats.hits > stats.misses);
+
+        // Something over the whole budget is never stored
+        cache.insert("big", 1, std::make_shared<const std::string>(8192, 'x'), {});
+        CHECK(! cache.find("big", 1));
+
+        // Shrinking the budget evicts down to it
+        cache.setBudget(1024);
+        CHECK(cache.getStats().bytes <= 1024);
+        CHECK(cache.getStats().entries > 0);
+    });
+
+// The least recently used entry goes first, a hit counts as a use
+static TestRegistrar lruOrder("memocache/lru_order", []
+    {
+        auto result = std::make_shared<const std::string>("result");
+
+        MemoCache probe;
+        probe.insert("f", 0, result, {});
+        const auto entryBytes = probe.getStats().bytes;
+
+        MemoCache cache(entryBytes * 3);
+
+        cache.insert("f", 1, result, {});
+        cache.insert("f", 2, result, {});
+        cache.insert("f", 3, result, {});
+        CHECK(cache.find("f", 1));
+
+        cache.insert("f", 4, result, {});
+
+        CHECK(cache.find("f", 1));
+        CHECK(! cache.find("f", 2));
+        CHECK(cache.find("f", 3));
+        CHECK(cache.find("f", 4));
+        CHECK(cache.getStats().evictions == 1);
+
+        // Inserting the same call again replaces it rather than adding one
+        cache.insert("f", 4, std::make_shared<const std::string>("other"), {});
+        CHECK(*cache.find("f", 4) == "other");
+        CHECK(cache.getStats().entries == 3);
+
+        // The endpoint is part of the key
+        CHECK(! cache.find("g", 1));
+    });
+
+// Tags and endpoints drop exactly the entries they name
+static TestRegistrar invalidation("memocache/invalidation", []
+    {
+        MemoCache cache;
+        auto result = std::make_shared<const std::string>("result");
+
+        for (int i = 0; i < 10; i++)
+        {
+            cache.insert("format", i, result, { "locale" });
+            cache.insert("lookup", i, result, { "data", i % 2 ? "odd" : "even" });
+        }
+
+        CHECK(cache.invalidate("odd") == 5);
+        CHECK(! cache.find("lookup", 1));
+        CHECK(cache.find("lookup", 2));
+
+        CHECK(cache.invalidate("missing") == 0);
+        CHECK(cache.invalidateEndpoint("format") == 10);
+        CHECK(! cache.find("format", 3));
+
+        CHECK(cache.getStats().entries == 5);
+        CHECK(cache.getStats().invalidations == 15);
+
+        cache.clear();
+
+        const auto stats = cache.getStats();
+
+        CHECK(stats.entries == 0);
+        CHECK(stats.bytes == 0);
+        CHECK(stats.invalidations == 20);
+    });
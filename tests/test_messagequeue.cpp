@@ -0,0 +1,150 @@
+#include "test.h"
+#include "mpscqueue.h"
+#include "messagequeue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+constexpr int producers = 4;
+constexpr int perProducer = 100'000;
+
+// Every push arrives once, and each producer's pushes arrive in the order it made them
+static TestRegistrar mpscNoLoss("messagequeue/mpsc_stress", []
+    {
+        MpscQueue<std::pair<int, int>> queue;
+        std::vector<std::thread> threads;
+
+        for (int p = 0; p < producers; p++)
+            threads.emplace_back([&queue, p]
+                {
+                    for (int i = 0; i < perProducer; i++)
+                        queue.push({ p, i });
+                });
+
+        std::vector<int> next(producers, 0);
+        int received = 0;
+        bool ordered = true;
+
+        while (received < producers * perProducer)
+        {
+            auto item = queue.pop();
+
+            if (! item)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            ordered = ordered && item->second == next[item->first];
+            next[item->first] = item->second + 1;
+            received++;
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        CHECK(ordered);
+        CHECK(! queue.pop());
+        CHECK(queue.empty());
+
+        for (int p = 0; p < producers; p++)
+            CHECK(next[p] == perProducer);
+    });
+
+// Producers posting while the consumer drains on wakeups, the way the
+// message thread does: nothing lost, per-producer order kept, one wakeup
+// covering many posts
+static TestRegistrar drainStress("messagequeue/drain_stress", []
+    {
+        std::mutex mutex;
+        std::condition_variable woken;
+        bool pending = false;
+
+        MessageQueue queue([&]
+            {
+                std::lock_guard lock(mutex);
+                pending = true;
+                woken.notify_one();
+            });
+
+        std::vector<int> next(producers, 0);
+        std::atomic<int> received = 0;
+        bool ordered = true;
+        std::vector<std::thread> threads;
+
+        for (int p = 0; p < producers; p++)
+            threads.emplace_back([&, p]
+                {
+                    for (int i = 0; i < perProducer; i++)
+                        queue.post([&, p, i]
+                            {
+                                ordered = ordered && next[p] == i;
+                                next[p] = i + 1;
+                                received++;
+                            });
+                });
+
+        while (received < producers * perProducer)
+        {
+            {
+                std::unique_lock lock(mutex);
+                woken.wait(lock, [&] { return pending; });
+                pending = false;
+            }
+
+            queue.drain();
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        const auto stats = queue.getStats();
+
+        CHECK(ordered);
+        CHECK(stats.drained == (uint64_t) producers * perProducer);
+        CHECK(stats.wakeups < stats.drained);
+        CHECK(queue.drain() == 0);
+    });
+
+// A drain stops at its budget, asks for another wakeup and leaves the rest
+// in order for the next one
+static TestRegistrar drainBudget("messagequeue/drain_budget", []
+    {
+        int wakeups = 0;
+        MessageQueue queue([&wakeups] { wakeups++; }, std::chrono::milliseconds(2));
+
+        std::vector<int> ran;
+
+        for (int i = 0; i < 50; i++)
+            queue.post([&ran, i]
+                {
+                    ran.push_back(i);
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                });
+
+        CHECK(wakeups == 1);
+
+        const auto first = queue.drain();
+
+        CHECK(first >= 1 && first < 50);
+        CHECK(queue.getStats().overruns == 1);
+        CHECK(wakeups == 2);
+
+        size_t total = first;
+
+        while (total < 50)
+        {
+            const auto drained = queue.drain();
+            CHECK(drained > 0);
+            total += drained;
+        }
+
+        CHECK(total == 50);
+
+        for (int i = 0; i < 50; i++)
+            CHECK(ran[i] == i);
+    });
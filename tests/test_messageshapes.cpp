@@ -0,0 +1,174 @@
+#include "test.h"
+#include "messageshapes.h"
+
+#include <stdexcept>
+
+struct Resize
+{
+    std::string name;
+    int width  = 0;
+    int height = 0;
+    bool fullscreen = false;
+    std::vector<std::string> tags;
+};
+
+template <>
+struct ShapeFields<Resize>
+{
+    static constexpr auto fields = std::make_tuple(shape_field("name",       &Resize::name),
+                                                   shape_field("width",      &Resize::width),
+                                                   shape_field("height",     &Resize::height),
+                                                   shape_field("fullscreen", &Resize::fullscreen),
+                                                   shape_field("tags",       &Resize::tags));
+};
+
+// Shapes register under small ids only, with at least one key
+static TestRegistrar registry("messageshapes/registry", []
+    {
+        ShapeRegistry shapes;
+
+        CHECK(shapes.add(3, { "name", "content" }));
+        CHECK(! shapes.add(ShapeRegistry::maxShapes, { "name" }));
+        CHECK(! shapes.add(4, {}));
+
+        CHECK(shapes.find(3) && shapes.find(3)->keys.size() == 2);
+        CHECK(! shapes.find(0));
+        CHECK(! shapes.find(4));
+
+        CHECK(! shapes.view(nlohmann::json::array()));
+        CHECK(! shapes.view({ 0, "x" }));
+        CHECK(! shapes.view({ -1, "x" }));
+        CHECK(! shapes.view({ "3", "x" }));
+        CHECK(! shapes.view(nlohmann::json::object()));
+        CHECK(shapes.view({ 3, "x" }));
+    });
+
+// pack and unpack are each other's inverse, keys the object lacks go as null
+static TestRegistrar roundTrip("messageshapes/round_trip", []
+    {
+        ShapeRegistry shapes;
+        shapes.add(1, { "name", "content", "id" });
+
+        const nlohmann::json object = { { "name", "resize" }, { "content", { 1, 2 } }, { "id", 7 } };
+        const auto packed = shapes.pack(1, object);
+
+        CHECK(packed == nlohmann::json({ 1, "resize", { 1, 2 }, 7 }));
+        CHECK(shapes.unpack(packed) == object);
+
+        CHECK(shapes.pack(1, { { "name", "ping" } }) == nlohmann::json({ 1, "ping", nullptr, nullptr }));
+        CHECK(shapes.pack(2, object).is_null());
+        CHECK(shapes.unpack({ 2, "x" }).is_null());
+
+        auto view = shapes.view(packed);
+
+        CHECK(view->contains("id"));
+        CHECK(! view->contains("missing"));
+        CHECK(view->get<int>("id") == 7);
+        CHECK((*view)["content"][1] == 2);
+
+        bool threw = false;
+
+        try
+        {
+            (*view)["missing"];
+        }
+        catch (const std::out_of_range&)
+        {
+            threw = true;
+        }
+
+        CHECK(threw);
+    });
+
+// Slots land in the fields they name, in whatever order the shape has them
+static TestRegistrar fromShape("messageshapes/from_shape", []
+    {
+        ShapeRegistry shapes;
+        shapes.add(1, { "name", "width", "height", "fullscreen", "tags" });
+        shapes.add(2, { "height", "tags", "width", "name", "fullscreen" });
+
+        const nlohmann::json first  = { 1, "resize", 800, 600, true, { "a", "b" } };
+        const nlohmann::json second = { 2, 600, { "a", "b" }, 800, "resize", true };
+
+        for (const auto& packed : { first, second })
+        {
+            const auto resize = from_shape<Resize>(*shapes.view(packed));
+
+            CHECK(resize.name == "resize");
+            CHECK(resize.width == 800);
+            CHECK(resize.height == 600);
+            CHECK(resize.fullscreen);
+            CHECK(resize.tags == std::vector<std::string>({ "a", "b" }));
+        }
+
+        // Decoding agrees with unpacking
+        CHECK(shapes.unpack(second) == shapes.unpack(shapes.pack(1, shapes.unpack(second))));
+    });
+
+// Keys the shape doesn't have, a short message and nulls leave the defaults
+static TestRegistrar partial("messageshapes/partial", []
+    {
+        ShapeRegistry shapes;
+        shapes.add(1, { "width", "extra", "name" });
+        shapes.add(2, { "name", "width", "height" });
+
+        const auto fewer = from_shape<Resize>(*shapes.view({ 1, 320, "ignored", "small" }));
+
+        CHECK(fewer.name == "small");
+        CHECK(fewer.width == 320);
+        CHECK(fewer.height == 0);
+        CHECK(fewer.tags.empty());
+
+        const auto shorter = from_shape<Resize>(*shapes.view({ 2, "short" }));
+
+        CHECK(shorter.name == "short");
+        CHECK(shorter.width == 0);
+
+        const auto packed = from_shape<Resize>(*shapes.view(shapes.pack(2, { { "width", 5 } })));
+
+        CHECK(packed.name.empty());
+        CHECK(packed.width == 5);
+
+        // A value of the wrong type is an error, not a default
+        bool threw = false;
+
+        try
+        {
+            from_shape<Resize>(*shapes.view({ 2, "bad", "wide" }));
+        }
+        catch (const nlohmann::json::type_error&)
+        {
+            threw = true;
+        }
+
+        CHECK(threw);
+    });
+
+// Both forms of a script call decode the same way, content without a copy
+static TestRegistrar scriptMessage("messageshapes/script_message", []
+    {
+        ShapeRegistry shapes;
+        shapes.add(0, { "name", "content" });
+        shapes.add(1, { "name", "content", "id" });
+
+        const nlohmann::json packed = { 1, "save", { "a", 2 }, 9 };
+        const auto fromPacked = decode_script_message(shapes, packed);
+
+        CHECK(fromPacked && fromPacked->name == "save" && fromPacked->id == 9);
+        CHECK(fromPacked->content == &packed[2]);
+
+        const nlohmann::json object = { { "name", "save" }, { "content", { "a", 2 } }, { "id", 9 } };
+        const auto fromObject = decode_script_message(shapes, object);
+
+        CHECK(fromObject && fromObject->name == "save" && fromObject->id == 9);
+        CHECK(fromObject->content == &object["content"]);
+
+        // A null or missing id is a call without a reply in either form
+        CHECK(decode_script_message(shapes, { 1, "ping", nlohmann::json::array(), nullptr })->id == 0);
+        CHECK(decode_script_message(shapes, { 0, "ping", nlohmann::json::array() })->id == 0);
+        CHECK(decode_script_message(shapes, { { "name", "ping" }, { "id", nullptr } })->id == 0);
+        CHECK(! decode_script_message(shapes, { { "name", "ping" } })->content);
+
+        CHECK(! decode_script_message(shapes, { 5, "ping" }));
+        CHECK(! decode_script_message(shapes, "ping"));
+    });
@@ -0,0 +1,148 @@
+#include "test.h"
+#include "prefetch.h"
+#include "fakeassets.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+static auto text(const SubresourcePrefetch::data_t& data) -> std::string
+{
+    return data ? std::string(data->begin(), data->end()) : std::string();
+}
+
+// Each buffered read is handed over once, everything else is a miss
+static TestRegistrar accounting("prefetch/accounting", []
+    {
+        FakeAssets assets;
+        assets.files = { { "app/a.js", "aaaa" }, { "app/b.css", "bb" } };
+
+        WorkerPool pool{ 2 };
+        SubresourcePrefetch prefetch(pool, assets.reader());
+
+        prefetch.start("app/", { "a.js", "b.css", "missing.png", "a.js" });
+        prefetch.wait();
+
+        CHECK(assets.reads == 3);
+
+        CHECK(text(prefetch.take("a.js")) == "aaaa");
+        CHECK(! prefetch.take("a.js"));
+        CHECK(! prefetch.take("missing.png"));
+        CHECK(! prefetch.take("never-started.js"));
+
+        auto stats = prefetch.getStats();
+
+        CHECK(stats.started == 3);
+        CHECK(stats.hits == 1);
+        CHECK(stats.misses == 3);
+        CHECK(stats.waited == 0);
+        CHECK(stats.bytes == 6);
+        CHECK(stats.wastedBytes == 0);
+
+        const nlohmann::json json = stats;
+        CHECK(json["hitRate"] == 0.25);
+
+        // Taken, b.css can be started again and is read again
+        CHECK(text(prefetch.take("b.css")) == "bb");
+        prefetch.start("app/", { "b.css" });
+        prefetch.wait();
+
+        CHECK(assets.reads == 4);
+        CHECK(text(prefetch.take("b.css")) == "bb");
+    });
+
+// Reads nobody takes within the ttl are dropped and counted as wasted
+static TestRegistrar ttl("prefetch/ttl", []
+    {
+        FakeAssets assets;
+        assets.files = { { "a.js", "aaaa" }, { "b.js", "bbbbbb" }, { "c.js", "c" } };
+
+        WorkerPool pool{ 2 };
+        SubresourcePrefetch prefetch(pool, assets.reader(), { .ttl = 20ms });
+
+        prefetch.start("", { "a.js", "b.js" });
+        prefetch.wait();
+
+        std::this_thread::sleep_for(40ms);
+
+        // Sweeping happens on start and take
+        prefetch.start("", { "c.js" });
+
+        auto stats = prefetch.getStats();
+
+        CHECK(stats.expired == 2);
+        CHECK(stats.wastedBytes == 10);
+        CHECK(! prefetch.take("a.js"));
+
+        prefetch.wait();
+        CHECK(text(prefetch.take("c.js")) == "c");
+
+        // Expired entries are gone, so the same path can be started again
+        prefetch.start("", { "a.js" });
+        prefetch.wait();
+        CHECK(text(prefetch.take("a.js")) == "aaaa");
+        CHECK(prefetch.getStats().started == 4);
+    });
+
+// Reads past maxBytes aren't kept, taking a buffered one frees its bytes
+static TestRegistrar budget("prefetch/budget", []
+    {
+        FakeAssets assets;
+        assets.files = { { "a.js", "123456" }, { "b.js", "abcdef" }, { "big.js", std::string(11, 'x') } };
+
+        WorkerPool pool{ 1 };
+        SubresourcePrefetch prefetch(pool, assets.reader(), { .maxBytes = 10 });
+
+        prefetch.start("", { "a.js", "b.js", "big.js" });
+        prefetch.wait();
+
+        auto stats = prefetch.getStats();
+
+        CHECK(stats.overBudget == 2);
+        CHECK(stats.bytes == 6);
+
+        const auto a = prefetch.take("a.js");
+        const auto b = prefetch.take("b.js");
+
+        CHECK(! prefetch.take("big.js"));
+        CHECK((a ? 1 : 0) + (b ? 1 : 0) == 1);
+
+        // Nothing is buffered now, so one of them fits again
+        prefetch.start("", { "b.js" });
+        prefetch.wait();
+
+        CHECK(text(prefetch.take("b.js")) == "abcdef");
+        CHECK(prefetch.getStats().overBudget == 2);
+    });
+
+// take waits for a read still in flight, and the ttl never drops one
+static TestRegistrar inFlight("prefetch/in_flight", []
+    {
+        FakeAssets assets;
+        assets.files = { { "slow.js", "slow" } };
+        assets.held  = "slow.js";
+
+        WorkerPool pool{ 1 };
+        SubresourcePrefetch prefetch(pool, assets.reader(), { .ttl = 1ms });
+
+        prefetch.start("", { "slow.js" });
+
+        while (assets.reads < 1)
+            std::this_thread::yield();
+
+        std::this_thread::sleep_for(5ms);
+        prefetch.start("", {});
+
+        std::thread releaser([&assets] { std::this_thread::sleep_for(20ms); assets.released = true; });
+
+        CHECK(text(prefetch.take("slow.js")) == "slow");
+        releaser.join();
+
+        const auto stats = prefetch.getStats();
+
+        CHECK(stats.hits == 1);
+        CHECK(stats.waited == 1);
+        CHECK(stats.expired == 0);
+        CHECK(stats.waitUs >= 10000);
+    });
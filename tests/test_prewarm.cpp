@@ -0,0 +1,101 @@
+#include "test.h"
+#include "prewarm.h"
+#include "fakeassets.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+static auto text(const AssetPrewarm::data_t& data) -> std::string
+{
+    return data ? std::string(data->begin(), data->end()) : std::string();
+}
+
+// Pages pull in their local references, each asset is handed over once
+static TestRegistrar warmed("prewarm/references", []
+    {
+        FakeAssets assets;
+        assets.files = {
+            { "app/index.html", "<script src=\"js/main.js\">f(\"<img src='inert.png'>\")</script><link rel=stylesheet href='style.css'>"
+                                "<img src=\"https://example.com/x.png\"><a href=\"about.html\">about</a>" },
+            { "app/js/main.js", "main" },
+            { "app/style.css",  "body {}" },
+        };
+
+        WorkerPool pool{ 2 };
+        AssetPrewarm prewarm(pool, assets.reader());
+
+        prewarm.start("app/", { "index.html", "missing.js" });
+        prewarm.wait();
+
+        CHECK(prewarm.contains("js/main.js"));
+        CHECK(prewarm.contains("style.css"));
+        CHECK(! prewarm.contains("https://example.com/x.png"));
+
+        // Only what the page will fetch: not links to other pages, not script text
+        CHECK(! prewarm.contains("about.html"));
+        CHECK(! prewarm.contains("inert.png"));
+        CHECK(assets.reads == 4);
+
+        CHECK(text(*prewarm.take("js/main.js")) == "main");
+        CHECK(! prewarm.take("js/main.js"));
+        CHECK(! prewarm.contains("js/main.js"));
+
+        // A missing file is warmed as missing, not as unknown
+        auto missing = prewarm.take("missing.js");
+        CHECK(missing && ! *missing);
+        CHECK(! prewarm.take("never-warmed.js"));
+    });
+
+// take never waits on a read that's still going, the caller reads the file itself
+static TestRegistrar noWaiting("prewarm/take_does_not_block", []
+    {
+        FakeAssets assets;
+        assets.files = { { "slow.js", "slow" }, { "fast.js", "fast" } };
+        assets.held  = "slow.js";
+
+        WorkerPool pool{ 2 };
+        AssetPrewarm prewarm(pool, assets.reader());
+
+        prewarm.start("", { "slow.js", "fast.js" });
+
+        while (! prewarm.contains("fast.js") || assets.reads < 2)
+            std::this_thread::yield();
+
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(! prewarm.take("slow.js"));
+        CHECK(std::chrono::steady_clock::now() - start < 100ms);
+
+        // Given up on, it isn't handed over later either
+        CHECK(! prewarm.contains("slow.js"));
+
+        assets.released = true;
+        prewarm.wait();
+
+        CHECK(! prewarm.take("slow.js"));
+        CHECK(text(*prewarm.take("fast.js")) == "fast");
+    });
+
+// The config is parsed on the pool, a broken one reads as null
+static TestRegistrar config("prewarm/config", []
+    {
+        FakeAssets assets;
+        assets.files = { { "good.json", "{ \"snapshot\": true }" }, { "bad.json", "{ snapshot" } };
+
+        WorkerPool pool{ 1 };
+
+        AssetPrewarm good(pool, assets.reader());
+        CHECK(good.getConfig().is_null());
+
+        good.startConfig("good.json");
+        CHECK(good.getConfig().value("snapshot", false));
+
+        AssetPrewarm bad(pool, assets.reader());
+        bad.startConfig("bad.json");
+        CHECK(bad.getConfig().is_null());
+
+        AssetPrewarm none(pool, assets.reader());
+        none.startConfig("none.json");
+        CHECK(none.getConfig().is_null());
+    });
@@ -0,0 +1,208 @@
+#include "test.h"
+#include "replaylog.h"
+#include "replaydriver.h"
+#include "webappinterface.h"
+#include "tempfolder.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+#include <stdexcept>
+
+static auto read_file(const std::filesystem::path& path) -> std::string
+{
+    std::ifstream file(path, std::ios::binary);
+    return { std::istreambuf_iterator<char>(file), {} };
+}
+
+static auto script_record(const nlohmann::json& message, uint64_t time = 0) -> ReplayRecord
+{
+    const auto cbor = nlohmann::json::to_cbor(message);
+    return { ReplayRecord::Type::scriptMessage, time, std::string(cbor.begin(), cbor.end()) };
+}
+
+// A short session with every kind of record, as ReplayWriter leaves it on disk
+static auto write_session(const TempFolder& folder) -> std::string
+{
+    const auto path = (folder.path / "session.lgr").string();
+
+    ReplayWriter writer(path);
+    CHECK(writer.isOpen());
+
+    writer.scriptMessage({ { "name", "add" }, { "content", { 1, 2 } }, { "id", 1 } });
+    writer.urlRequest("local://index.html");
+    writer.timerFired(300);
+    writer.scriptMessage({ 1, "packed", nullptr });
+    writer.timerFired(uint64_t(1) << 40);
+
+    return path;
+}
+
+// Records come back as they were written, varints of every width included
+static TestRegistrar roundTrip("replay/round_trip", []
+    {
+        TempFolder folder("lookingglass_test_replay");
+        const auto records = read_replay_log(write_session(folder));
+
+        CHECK(records && records->size() == 5);
+
+        CHECK((*records)[0].type == ReplayRecord::Type::scriptMessage);
+        CHECK((*records)[0].message() == nlohmann::json({ { "name", "add" }, { "content", { 1, 2 } }, { "id", 1 } }));
+
+        CHECK((*records)[1].type == ReplayRecord::Type::urlRequest);
+        CHECK((*records)[1].payload == "local://index.html");
+
+        CHECK((*records)[2].type == ReplayRecord::Type::timerFire);
+        CHECK((*records)[2].timerId() == 300);
+
+        CHECK((*records)[3].message() == nlohmann::json({ 1, "packed", nullptr }));
+        CHECK((*records)[4].timerId() == uint64_t(1) << 40);
+
+        for (size_t i = 1; i < records->size(); i++)
+            CHECK((*records)[i].time >= (*records)[i - 1].time);
+
+        // Ids count up from 1 in creation order
+        ReplayWriter writer((folder.path / "ids.lgr").string());
+        CHECK(writer.nextTimerId() == 1);
+        CHECK(writer.nextTimerId() == 2);
+    });
+
+// A log cut off anywhere reads as the records before the cut, one that
+// isn't a log at all doesn't read
+static TestRegistrar truncated("replay/truncated", []
+    {
+        TempFolder folder("lookingglass_test_replay");
+        const auto whole = read_file(write_session(folder));
+        const auto full  = read_replay_log((folder.path / "session.lgr").string());
+        const auto path  = (folder.path / "cut.lgr").string();
+
+        for (size_t size = 6; size < whole.size(); size++)
+        {
+            folder.write("cut.lgr", whole.substr(0, size));
+            const auto records = read_replay_log(path);
+
+            CHECK(records && records->size() < full->size());
+
+            for (size_t i = 0; records && i < records->size(); i++)
+                CHECK((*records)[i].payload == (*full)[i].payload && (*records)[i].time == (*full)[i].time);
+        }
+
+        for (size_t size = 0; size < 6; size++)
+        {
+            folder.write("cut.lgr", whole.substr(0, size));
+            CHECK(! read_replay_log(path));
+        }
+
+        CHECK(! read_replay_log((folder.path / "missing.lgr").string()));
+    });
+
+// Bad headers are refused, a bad record ends the log, a bad payload only
+// spoils its own record
+static TestRegistrar corrupt("replay/corrupt", []
+    {
+        TempFolder folder("lookingglass_test_replay");
+        const auto whole = read_file(write_session(folder));
+        const auto path  = (folder.path / "bad.lgr").string();
+
+        const auto read_with = [&] (std::string bytes)
+        {
+            folder.write("bad.lgr", bytes);
+            return read_replay_log(path);
+        };
+
+        auto magic = whole;
+        magic[0] = 'X';
+        CHECK(! read_with(magic));
+
+        auto version = whole;
+        version[4] = 2;
+        CHECK(! read_with(version));
+
+        // Unknown record type
+        CHECK(read_with(whole + std::string("\x09\x00\x00", 3))->size() == 5);
+
+        // A varint that never ends
+        CHECK(read_with(whole + "\x01" + std::string(12, '\xff'))->size() == 5);
+
+        // A size past the end of the file
+        CHECK(read_with(whole + std::string("\x02\x00\x7f" "abc", 6))->size() == 5);
+
+        // CBOR that doesn't decode is a record, its message is discarded
+        auto records = read_with(whole + std::string("\x01\x00\x02\xff\xff", 5));
+        CHECK(records && records->size() == 6);
+        CHECK(records->back().message().is_discarded());
+    });
+
+// A recorded session plays back into an app: invokes are timed until their
+// reply, failures and timer fires are counted, shapes are tracked as they
+// were registered
+static TestRegistrar driver("replay/driver", []
+    {
+        WebAppInterface app;
+        std::vector<nlohmann::json> recorded;
+
+        app.registerScriptEndpoint("add", [] (const nlohmann::json& content) -> nlohmann::json
+            {
+                return content[0].get<int>() + content[1].get<int>();
+            }, std::nullopt);
+
+        app.registerScriptEndpoint("fail", [] (const nlohmann::json&) -> nlohmann::json
+            {
+                throw std::runtime_error("no");
+            }, std::nullopt);
+
+        app.registerScriptEndpoint("record", [&recorded] (const nlohmann::json& content) { recorded.push_back(content); });
+
+        app.registerAsyncScriptEndpoint("later", [&app] (const nlohmann::json& content) -> Task<nlohmann::json>
+            {
+                co_await app.sleep(10);
+                co_return content;
+            });
+
+        std::vector<ReplayRecord> records = {
+            script_record({ { "name", "__shape" }, { "content", { 1, { "name", "content", "id" } } } }),
+            script_record({ 1, "add", { 1, 2 }, 1 }),
+            script_record({ { "name", "later" }, { "content", "soon" }, { "id", 2 } }),
+            script_record({ 1, "record", "packed", nullptr }),
+            script_record({ 1, "fail", nullptr, 3 }),
+            script_record({ { "name", "nobody" } }),
+            { ReplayRecord::Type::scriptMessage, 0, "\xff\xff" },
+            { ReplayRecord::Type::urlRequest, 0, "local://__prefetch" },
+            { ReplayRecord::Type::timerFire, 30000, "\x01" },
+        };
+
+        auto& loop = app.getEventLoop();
+
+        for (auto speed : { ReplayDriver::Speed::fast, ReplayDriver::Speed::realtime })
+        {
+            nlohmann::json report;
+            ReplayDriver driver(app, records, speed);
+
+            driver.start([&] (const nlohmann::json& result)
+                {
+                    report = result;
+                    loop.quit();
+                });
+
+            loop.run();
+
+            CHECK(report["records"] == records.size());
+            CHECK(report["timerFires"] == 1);
+            CHECK(report["unanswered"] == 0);
+
+            // The rejected invoke, the unknown endpoint and the undecodable message
+            CHECK(report["failures"] == 3);
+
+            const auto& endpoints = report["endpoints"];
+
+            CHECK(endpoints.contains("reply:add") && endpoints.contains("reply:later"));
+            CHECK(endpoints.contains("script:record") && endpoints.contains("url:local://__prefetch"));
+
+            // Realtime waits for the last record's time
+            CHECK(speed == ReplayDriver::Speed::fast || report["wallMs"].get<double>() >= 30.0);
+        }
+
+        // The driver lets go of the send hook once it's done
+        CHECK(! app.onSendMessage);
+        CHECK(recorded == std::vector<nlohmann::json>({ "packed", "packed" }));
+    });
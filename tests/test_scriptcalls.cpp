@@ -0,0 +1,136 @@
+#include "test.h"
+#include "webappinterface.h"
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+static auto await_page(WebAppInterface& app, std::string function) -> Task<nlohmann::json>
+{
+    const auto args = nlohmann::json::array({ 1, 2 });
+    co_return co_await app.callScript(function, args);
+}
+
+// The app with no page behind it: calls into the page are collected, the
+// page's answers are fed back in as script messages
+struct ScriptCallApp : WebAppInterface
+{
+    struct Outcome
+    {
+        std::optional<nlohmann::json> value;
+        std::optional<std::string> error;
+    };
+
+    ScriptCallApp()
+    {
+        onSendMessage = [this] (const std::string& name, const std::string& content)
+        {
+            if (name == "__callFromNative")
+                sent.push_back(nlohmann::json::parse(content));
+        };
+    }
+
+    // Starts a coroutine awaiting the page function, outcome fills in when it ends
+    auto call(const std::string& function) -> Outcome&
+    {
+        auto& outcome = outcomes.emplace_back();
+
+        spawn(await_page(*this, function),
+            [&outcome] (nlohmann::json value) { outcome.value = std::move(value); },
+            [&outcome] (std::exception_ptr error)
+            {
+                try
+                {
+                    std::rethrow_exception(error);
+                }
+                catch (const std::exception& e)
+                {
+                    outcome.error = e.what();
+                }
+            });
+
+        return outcome;
+    }
+
+    auto page(const std::string& name, nlohmann::json content) -> void
+    {
+        onScriptMessage({ { "name", name }, { "content", std::move(content) } });
+    }
+
+    std::vector<nlohmann::json> sent;
+    std::deque<Outcome> outcomes;
+};
+
+// Answers resume the call they belong to, page errors come back as exceptions
+static TestRegistrar answered("scriptcalls/answered", []
+    {
+        ScriptCallApp app;
+
+        auto& sum = app.call("sum");
+        auto& broken = app.call("broken");
+
+        CHECK(app.sent.size() == 2);
+        CHECK(app.sent[0][1] == "sum");
+        CHECK(app.sent[0][2] == nlohmann::json({ 1, 2 }));
+
+        const auto sumId = app.sent[0][0];
+        const auto brokenId = app.sent[1][0];
+
+        app.page("__scriptResult", { brokenId, nullptr, "TypeError: nope" });
+        app.page("__scriptResult", { sumId, 3 });
+
+        CHECK(sum.value == 3);
+        CHECK(! sum.error);
+        CHECK(broken.error == "TypeError: nope");
+        CHECK(app.pendingScriptCalls.empty());
+
+        // A second answer for the same call goes nowhere
+        app.page("__scriptResult", { sumId, 4 });
+        CHECK(sum.value == 3);
+    });
+
+// A new document means the old one's answers will never come
+static TestRegistrar reload("scriptcalls/reload", []
+    {
+        ScriptCallApp app;
+
+        auto& first = app.call("first");
+        auto& second = app.call("second");
+
+        app.page("__bridgeStart", nlohmann::json::array());
+
+        CHECK(first.error == "first: page reloaded");
+        CHECK(second.error == "second: page reloaded");
+        CHECK(app.pendingScriptCalls.empty());
+
+        // Calls made into the new document carry on as usual
+        auto& third = app.call("third");
+        app.page("__scriptResult", { app.sent.back()[0], "ok" });
+        CHECK(third.value == "ok");
+
+        auto& last = app.call("last");
+        app.onStop();
+        CHECK(last.error == "last: app stopped");
+    });
+
+// Calls the page never answers fail after the timeout, answered ones don't
+static TestRegistrar timeout("scriptcalls/timeout", []
+    {
+        ScriptCallApp app;
+        app.scriptCallTimeout = 20;
+
+        auto& slow = app.call("slow");
+        auto& quick = app.call("quick");
+
+        app.page("__scriptResult", { app.sent.back()[0], true });
+
+        auto& loop = app.getEventLoop();
+        loop.postDelayed(100, [&loop] { loop.quit(); });
+        loop.run();
+
+        CHECK(slow.error == "slow: timed out");
+        CHECK(quick.value == true);
+        CHECK(! quick.error);
+        CHECK(app.pendingScriptCalls.empty());
+    });
@@ -0,0 +1,165 @@
+#include "test.h"
+#include "singleflight.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Flights = SingleFlight<std::string, std::shared_ptr<const std::string>>;
+
+// Callers arriving while a load runs share it, value and all
+static TestRegistrar coalesce("singleflight/coalesce", []
+    {
+        Flights flights;
+        std::atomic<int> loads = 0;
+
+        constexpr int callers = 8;
+        std::vector<std::shared_ptr<const std::string>> results(callers);
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < callers; i++)
+            threads.emplace_back([&, i]
+                {
+                    results[i] = flights.run("index.html", [&]
+                        {
+                            loads++;
+
+                            // Hold the load until everyone else is waiting on it
+                            while (flights.getStats().coalesced < callers - 1)
+                                std::this_thread::yield();
+
+                            return std::make_shared<const std::string>("<html></html>");
+                        });
+                });
+
+        for (auto& thread : threads)
+            thread.join();
+
+        const auto stats = flights.getStats();
+
+        CHECK(loads == 1);
+        CHECK(stats.flights == 1);
+        CHECK(stats.coalesced == callers - 1);
+        CHECK(stats.maxShared == callers);
+
+        for (auto& result : results)
+            CHECK(result == results[0] && *result == "<html></html>");
+    });
+
+// A failed load fails everyone waiting on it, and isn't remembered
+static TestRegistrar failure("singleflight/failure", []
+    {
+        Flights flights;
+        std::atomic<bool> waiting = false;
+        std::atomic<int> failed = 0;
+
+        auto call = [&]
+        {
+            try
+            {
+                flights.run("missing.js", [&] () -> std::shared_ptr<const std::string>
+                    {
+                        while (! waiting)
+                            std::this_thread::yield();
+
+                        throw std::runtime_error("missing.js");
+                    });
+            }
+            catch (const std::runtime_error&)
+            {
+                failed++;
+            }
+        };
+
+        std::thread first(call);
+
+        while (flights.getStats().flights == 0)
+            std::this_thread::yield();
+
+        std::thread second([&]
+            {
+                while (flights.getStats().coalesced == 0)
+                    std::this_thread::yield();
+
+                waiting = true;
+            });
+
+        call();
+        first.join();
+        second.join();
+
+        CHECK(failed == 2);
+        CHECK(flights.getStats().flights == 1);
+
+        CHECK(*flights.run("missing.js", [] { return std::make_shared<const std::string>("found"); }) == "found");
+        CHECK(flights.getStats().flights == 2);
+    });
+
+// Nothing is cached: a call after the load landed loads again, different
+// keys never wait on each other
+static TestRegistrar noCaching("singleflight/no_caching", []
+    {
+        Flights flights;
+        int loads = 0;
+
+        auto load = [&loads] { return std::make_shared<const std::string>(std::to_string(++loads)); };
+
+        CHECK(*flights.run("a", load) == "1");
+        CHECK(*flights.run("a", load) == "2");
+        CHECK(*flights.run("b", [&]
+            {
+                // A different key inside a load runs on its own
+                return flights.run("c", load);
+            }) == "3");
+
+        const auto stats = flights.getStats();
+
+        CHECK(stats.flights == 4);
+        CHECK(stats.coalesced == 0);
+        CHECK(stats.maxShared == 0);
+    });
+
+// Many threads over a few keys: every call gets its key's value, and each
+// call either ran a load or shared one
+static TestRegistrar stress("singleflight/stress", []
+    {
+        Flights flights;
+
+        constexpr int threadCount = 8;
+        constexpr int callsEach   = 2000;
+        constexpr int keyCount    = 4;
+
+        std::atomic<int> loads = 0;
+        std::atomic<int> wrong = 0;
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < threadCount; t++)
+            threads.emplace_back([&, t]
+                {
+                    for (int i = 0; i < callsEach; i++)
+                    {
+                        const auto key = std::to_string((t + i) % keyCount);
+                        const auto value = flights.run(key, [&]
+                            {
+                                loads++;
+                                std::this_thread::yield();
+                                return std::make_shared<const std::string>(key);
+                            });
+
+                        if (*value != key)
+                            wrong++;
+                    }
+                });
+
+        for (auto& thread : threads)
+            thread.join();
+
+        const auto stats = flights.getStats();
+
+        CHECK(wrong == 0);
+        CHECK(stats.flights == (uint64_t) loads);
+        CHECK(stats.flights + stats.coalesced == threadCount * callsEach);
+        CHECK(stats.maxShared <= threadCount);
+    });
@@ -0,0 +1,135 @@
+#include "test.h"
+#include "snapshotstore.h"
+#include "fileio.h"
+#include "tempfolder.h"
+
+#include <filesystem>
+
+// A saved snapshot loads back as it was, for the same asset version only
+static TestRegistrar roundTrip("snapshotstore/round_trip", []
+    {
+        TempFolder folder("lookingglass_test_snapshots");
+        SnapshotStore store((folder.path / "nested/snapshot.json").string());
+
+        CHECK(! store.load("v1"));
+
+        const DomSnapshot snapshot{ "index.html", "<ul><li>Hello</li></ul>", { { "open", true } }, "v1" };
+        CHECK(store.save(snapshot));
+        CHECK(! std::filesystem::exists(store.path + ".tmp"));
+
+        auto loaded = store.load("v1");
+
+        CHECK(loaded);
+        CHECK(loaded->page == snapshot.page);
+        CHECK(loaded->body == snapshot.body);
+        CHECK(loaded->state == snapshot.state);
+        CHECK(loaded->version == "v1");
+
+        // Still there for the next launch
+        CHECK(store.load("v1"));
+    });
+
+// Anything that isn't a current snapshot is deleted on load
+static TestRegistrar stale("snapshotstore/stale", []
+    {
+        TempFolder folder("lookingglass_test_snapshots");
+        SnapshotStore store((folder.path / "snapshot.json").string());
+
+        CHECK(store.save({ "index.html", "<p></p>", nullptr, "v1" }));
+        CHECK(! store.load("v2"));
+        CHECK(! std::filesystem::exists(store.path));
+
+        for (auto text : { "{ broken", "[]", "{ \"format\": 0, \"version\": \"v1\" }" })
+        {
+            folder.write("snapshot.json", text);
+
+            CHECK(! store.load("v1"));
+            CHECK(! std::filesystem::exists(store.path));
+        }
+    });
+
+// The asset version follows the files' names, sizes and times, not the
+// order they were made in
+static TestRegistrar version("snapshotstore/asset_version", []
+    {
+        TempFolder a("lookingglass_test_assets_a");
+        TempFolder b("lookingglass_test_assets_b");
+
+        a.write("index.html", "<html></html>");
+        a.write("js/app.js", "app()");
+        b.write("js/app.js", "app()");
+        b.write("index.html", "<html></html>");
+
+        // Same times on both sides, so only order differs
+        const auto time = std::filesystem::last_write_time(a.path / "index.html");
+
+        for (auto name : { "index.html", "js/app.js" })
+        {
+            std::filesystem::last_write_time(a.path / name, time);
+            std::filesystem::last_write_time(b.path / name, time);
+        }
+
+        const auto before = asset_version(a.path.string());
+
+        CHECK(before.size() == 16);
+        CHECK(before == asset_version(a.path.string()));
+        CHECK(before == asset_version(b.path.string()));
+
+        a.write("js/app.js", "app(1)");
+        std::filesystem::last_write_time(a.path / "js/app.js", time);
+        CHECK(asset_version(a.path.string()) != before);
+
+        b.write("js/new.js", "");
+        CHECK(asset_version(b.path.string()) != before);
+    });
+
+// The app's index.html gets the __snapshot global either way and, given a
+// snapshot, its body swapped in
+static TestRegistrar apply("snapshotstore/apply_snapshot", []
+    {
+        const auto html = file_read_text(LOOKINGGLASS_APP_DIR "/index.html");
+        CHECK(html);
+
+        const auto fresh = apply_snapshot(*html, nullptr);
+
+        CHECK(fresh.find("var __snapshot = {\"hydrated\":false,\"state\":null};") != std::string::npos);
+        CHECK(fresh.find("side-bar-list") != std::string::npos);
+
+        const DomSnapshot snapshot{ "index.html", "<p id=\"restored\"></p>", { { "note", "</script><b>" } }, "v1" };
+        const auto hydrated = apply_snapshot(*html, &snapshot);
+
+        CHECK(hydrated.find("side-bar-list") == std::string::npos);
+        CHECK(hydrated.find("<p id=\"restored\"></p></body>") != std::string::npos);
+        CHECK(hydrated.find("\"hydrated\":true") != std::string::npos);
+
+        // State can't end the script element it's written into
+        CHECK(hydrated.find("</script><b>") == std::string::npos);
+        CHECK(hydrated.find("<\\/script><b>") != std::string::npos);
+
+        // The global comes before the page's own scripts
+        CHECK(hydrated.find("__snapshot") < hydrated.find("local://bridge.js"));
+    });
+
+// Tags that only start like head or body aren't them, documents without a
+// head still get the global first
+static TestRegistrar tags("snapshotstore/tags", []
+    {
+        const auto script = std::string("<script>var __snapshot = {\"hydrated\":false,\"state\":null};</script>");
+
+        CHECK(apply_snapshot("<html><body><header>x</header></body></html>", nullptr)
+              == "<html>" + script + "<body><header>x</header></body></html>");
+
+        CHECK(apply_snapshot("<html lang=\"en\"><header></header><head></head></html>", nullptr)
+              == "<html lang=\"en\"><header></header><head>" + script + "</head></html>");
+
+        CHECK(apply_snapshot("<head\n  data-x=\"1\"><title></title>", nullptr)
+              == "<head\n  data-x=\"1\">" + script + "<title></title>");
+
+        CHECK(apply_snapshot("<p>fragment</p>", nullptr) == script + "<p>fragment</p>");
+
+        const DomSnapshot snapshot{ "index.html", "<p>saved</p>", nullptr, "v1" };
+        const auto hydrated = apply_snapshot("<html><bodyguard></bodyguard><body class=\"x\"><p>live</p></body></html>", &snapshot);
+
+        CHECK(hydrated.find("<body class=\"x\"><p>saved</p></body>") != std::string::npos);
+        CHECK(hydrated.find("<bodyguard></bodyguard>") != std::string::npos);
+    });
@@ -0,0 +1,77 @@
+#include "test.h"
+#include "startuptrace.h"
+#include "fileio.h"
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// Marks keep their order and time, markOnce only takes the first
+static TestRegistrar marks("startuptrace/marks", []
+    {
+        StartupTrace trace;
+
+        trace.mark("main");
+        std::this_thread::sleep_for(2ms);
+        CHECK(trace.markOnce("firstScriptMessage"));
+        CHECK(! trace.markOnce("firstScriptMessage"));
+        trace.mark("pageLoad");
+
+        const auto list = trace.getMarks();
+
+        CHECK(list.size() == 3);
+        CHECK(list[0].name == "main");
+        CHECK(list[1].name == "firstScriptMessage");
+        CHECK(list[2].name == "pageLoad");
+        CHECK(trace.elapsed("main", "firstScriptMessage") >= 2ms);
+        CHECK(trace.elapsed("main", "pageLoad") >= trace.elapsed("main", "firstScriptMessage"));
+        CHECK(trace.elapsed("main", "missing") == -1us);
+    });
+
+// Marks from other threads land on their own track, the phases between
+// consecutive marks become spans in time order
+static TestRegistrar chromeTrace("startuptrace/chrome_trace", []
+    {
+        StartupTrace trace;
+
+        trace.mark("main");
+        std::thread([&trace] { trace.mark("firstUrlRequest"); }).join();
+        trace.mark("pageLoad");
+
+        const auto json    = trace.toChromeTrace();
+        const auto& events = json["traceEvents"];
+
+        CHECK(events.size() == 5);
+        CHECK(events[0]["name"] == "main");
+        CHECK(events[1]["name"] == "main -> firstUrlRequest");
+        CHECK(events[1]["ph"] == "X");
+        CHECK(events[2]["tid"] != events[0]["tid"]);
+        CHECK(events[3]["dur"].get<int64_t>() >= 0);
+        CHECK(events[4]["name"] == "pageLoad");
+        CHECK(events[4]["ts"].get<int64_t>() >= events[0]["ts"].get<int64_t>());
+    });
+
+// flush writes only when a path is set, and rewrites the whole file
+static TestRegistrar flush("startuptrace/flush", []
+    {
+        StartupTrace trace;
+        trace.outputPath.clear();
+        trace.mark("main");
+
+        CHECK(! trace.flush());
+
+        const auto path = (std::filesystem::temp_directory_path() / "lookingglass_test_trace.json").string();
+        trace.outputPath = path;
+
+        CHECK(trace.flush());
+        trace.mark("pageLoad");
+        CHECK(trace.flush());
+
+        const auto written = nlohmann::json::parse(file_read_text(path).value_or(""), nullptr, false);
+        std::filesystem::remove(path);
+
+        CHECK(written == trace.toChromeTrace());
+    });
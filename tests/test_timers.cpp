@@ -0,0 +1,281 @@
+#include "test.h"
+#include "timingwheel.h"
+#include "timerscheduler.h"
+
+#include <list>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// A scheduler on a virtual clock: run() jumps the clock from one armed
+// wakeup to the next, the way the platform timer would
+struct VirtualTimers
+{
+    VirtualTimers() : scheduler([this] { return now; }, [this] (std::optional<uint64_t> at) { armed = at; rearms++; }) { }
+
+    auto run(uint64_t until) -> void
+    {
+        while (armed && *armed <= until)
+        {
+            now = *armed;
+            scheduler.fire();
+        }
+
+        now = until;
+    }
+
+    uint64_t now = 0;
+    std::optional<uint64_t> armed;
+    int rearms = 0;
+    TimerScheduler scheduler;
+};
+
+// Entries fire on their deadline, not a tick early, at every level and past the wheel's range
+static TestRegistrar wheelPlacement("timers/wheel_placement", []
+    {
+        const std::vector<uint64_t> deadlines = { 1, 2, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300000,
+                                                  TimingWheel::range - 1, TimingWheel::range + 5 };
+
+        TimingWheel wheel;
+        std::list<TimingWheel::Entry> entries;
+        std::vector<uint64_t> firedAt;
+
+        for (auto deadline : deadlines)
+        {
+            auto& entry    = entries.emplace_back();
+            entry.callback = [&wheel, &firedAt] { firedAt.push_back(wheel.current()); };
+            wheel.schedule(entry, deadline);
+        }
+
+        CHECK(wheel.size() == deadlines.size());
+        CHECK(wheel.earliest() == 1u);
+
+        for (auto deadline : deadlines)
+        {
+            CHECK(wheel.advance(deadline - 1) == 0);
+            CHECK(wheel.earliest() == deadline);
+            CHECK(wheel.advance(deadline) == 1);
+            CHECK(firedAt.back() == deadline);
+        }
+
+        CHECK(wheel.size() == 0);
+        CHECK(! wheel.earliest());
+    });
+
+// Big jumps cascade entries down through every level without losing or misordering any
+static TestRegistrar wheelCascade("timers/wheel_cascade", []
+    {
+        TimingWheel wheel(1000);
+        std::list<TimingWheel::Entry> entries;
+        std::vector<uint64_t> fired;
+
+        for (uint64_t i = 0; i < 2000; i++)
+        {
+            const auto deadline = 1000 + 1 + (i * 7919) % 5'000'000;
+            auto& entry         = entries.emplace_back();
+
+            entry.callback = [&fired, deadline] { fired.push_back(deadline); };
+            wheel.schedule(entry, deadline);
+        }
+
+        // Uneven steps so jumps land both on and off slot boundaries
+        for (uint64_t now = 1000; now < 1000 + 5'000'001; now += 4093)
+        {
+            const auto before = fired.size();
+            wheel.advance(now);
+
+            for (auto i = before; i < fired.size(); i++)
+                CHECK(fired[i] <= now && fired[i] > now - 4093);
+        }
+
+        wheel.advance(1000 + 5'000'001);
+
+        CHECK(fired.size() == 2000);
+        CHECK(wheel.size() == 0);
+    });
+
+// A callback may cancel entries due in the same tick, later entries, or
+// itself, and may destroy its own entry
+static TestRegistrar wheelCancelInCallback("timers/cancel_from_callback", []
+    {
+        TimingWheel wheel;
+        auto self = std::make_unique<TimingWheel::Entry>();
+        TimingWheel::Entry first, sameTick, later, repeating;
+        int firedSameTick = 0, firedLater = 0, firedRepeating = 0, firedSelf = 0;
+
+        first.callback     = [&] { wheel.cancel(sameTick); wheel.cancel(later); };
+        sameTick.callback  = [&] { firedSameTick++; };
+        later.callback     = [&] { firedLater++; };
+        repeating.period   = 5;
+        repeating.callback = [&] { if (++firedRepeating == 2) wheel.cancel(repeating); };
+        self->callback     = [&] { firedSelf++; self.reset(); };
+
+        wheel.schedule(first, 10);
+        wheel.schedule(sameTick, 10);
+        wheel.schedule(later, 20);
+        wheel.schedule(repeating, 5);
+        wheel.schedule(*self, 7);
+
+        // Same-tick order isn't defined, so sameTick may have gone first
+        wheel.advance(100);
+
+        CHECK(firedLater == 0);
+        CHECK(firedSameTick <= 1);
+        CHECK(firedRepeating == 2);
+        CHECK(firedSelf == 1);
+        CHECK(! self);
+        CHECK(wheel.size() == 0);
+    });
+
+// Timers whose tolerances allow it share one wakeup
+static TestRegistrar toleranceCoalescing("timers/tolerance_coalescing", []
+    {
+        VirtualTimers timers;
+        std::vector<uint64_t> firedAt;
+        std::vector<std::unique_ptr<Timer>> list;
+
+        // A tolerance of 50 aligns to a 32ms grid, so 101, 117 and 120 all land on 128
+        for (int ms : { 101, 117, 120 })
+        {
+            auto timer = timers.scheduler.makeTimer(ms, [&] { firedAt.push_back(timers.now); }, TimerMode::oneShot);
+            timer->setTolerance(50);
+            timer->start(ms);
+            list.push_back(std::move(timer));
+        }
+
+        timers.run(128);
+        CHECK(firedAt.empty());
+
+        timers.run(200);
+        CHECK(firedAt == std::vector<uint64_t>(3, 128 + timers.scheduler.slack));
+
+        // Without tolerance each gets its own wakeup
+        VirtualTimers exact;
+        std::vector<uint64_t> exactAt;
+
+        for (int ms : { 101, 117, 120 })
+            list.push_back(exact.scheduler.makeTimer(ms, [&] { exactAt.push_back(exact.now); }, TimerMode::oneShot));
+
+        exact.run(200);
+        CHECK(exactAt == std::vector<uint64_t>({ 102, 118, 121 }));
+        CHECK(exact.scheduler.getStats().wakeups == 3);
+    });
+
+// One-shot timers fire once, repeating ones every period without drifting,
+// until stopped
+static TestRegistrar modes("timers/oneshot_and_repeating", []
+    {
+        VirtualTimers timers;
+        int once = 0, repeated = 0;
+
+        auto oneShot   = timers.scheduler.makeTimer(10, [&once] { once++; }, TimerMode::oneShot);
+        auto repeating = timers.scheduler.makeTimer(10, [&repeated] { repeated++; }, TimerMode::repeating);
+
+        timers.run(105);
+        CHECK(once == 1);
+        CHECK(repeated == 10);
+
+        repeating->stop();
+        timers.run(1000);
+        CHECK(repeated == 10);
+
+        // Restarting a one-shot arms it again
+        oneShot->start(10);
+        timers.run(1009);
+        CHECK(once == 1);
+
+        timers.run(1020);
+        CHECK(once == 2);
+        CHECK(timers.scheduler.getStats().active == 0);
+    });
+
+// postDelayed entries belong to the scheduler and are gone once they fire
+static TestRegistrar delayed("timers/post_delayed", []
+    {
+        VirtualTimers timers;
+        int fired = 0;
+
+        timers.scheduler.postDelayed(5, [&] { fired++; timers.scheduler.postDelayed(5, [&fired] { fired++; }); });
+        timers.scheduler.postDelayed(1000, [&fired] { fired += 100; });
+
+        CHECK(timers.scheduler.delayed.size() == 2);
+
+        timers.run(20);
+        CHECK(fired == 2);
+        CHECK(timers.scheduler.delayed.size() == 1);
+    });
+
+// Deadlines round up onto the largest power of two grid the tolerance allows
+static TestRegistrar policyAlign("timers/policy_align", []
+    {
+        CoalescingPolicy policy;
+
+        CHECK(policy.align(101, 50) == 128);
+        CHECK(policy.align(128, 50) == 128);
+        CHECK(policy.align(129, 64) == 192);
+        CHECK(policy.align(101, 1) == 101);
+        CHECK(policy.align(101, 0) == 101);
+        CHECK(policy.tolerance(0) == 0);
+        CHECK(policy.period(16) == 16);
+
+        policy.background = true;
+
+        CHECK(policy.tolerance(0) == policy.backgroundMinTolerance);
+        CHECK(policy.tolerance(500) == 500);
+        CHECK(policy.period(16) == 16 * policy.backgroundPeriodScale);
+    });
+
+// In the background repeating timers stretch their periods and share
+// wakeups, and come back to full rate in the foreground
+static TestRegistrar backgroundMode("timers/background_mode", []
+    {
+        VirtualTimers timers;
+        int fired = 0;
+        std::vector<std::unique_ptr<Timer>> list;
+
+        for (int ms : { 16, 20, 33, 50 })
+            list.push_back(timers.scheduler.makeTimer(ms, [&fired] { fired++; }, TimerMode::repeating));
+
+        timers.run(10'000);
+        const auto foreground = timers.scheduler.getStats();
+
+        CHECK(fired == 10'000 / 16 + 10'000 / 20 + 10'000 / 33 + 10'000 / 50);
+
+        timers.scheduler.setBackground(true);
+        timers.run(20'000);
+        const auto background = timers.scheduler.getStats();
+
+        // A quarter of the rate at most, and fewer wakeups than timers firing
+        CHECK(background.fired - foreground.fired <= foreground.fired / 4);
+        CHECK(background.wakeups - foreground.wakeups < (background.fired - foreground.fired) / 2);
+
+        timers.scheduler.setBackground(false);
+        timers.run(30'000);
+        const auto restored = timers.scheduler.getStats();
+
+        CHECK(restored.fired - background.fired > foreground.fired * 9 / 10);
+        CHECK(restored.active == 4);
+    });
+
+// wakeupsPerSecond reports the last full second of the virtual clock
+static TestRegistrar wakeupCounter("timers/wakeups_per_second", []
+    {
+        VirtualTimers timers;
+        auto timer = timers.scheduler.makeTimer(10, [] { }, TimerMode::repeating);
+
+        timers.run(999);
+        CHECK(timers.scheduler.getStats().wakeupsPerSecond == 0);
+
+        timers.run(1999);
+        CHECK(timers.scheduler.getStats().wakeupsPerSecond == 99);
+
+        // Stopping leaves the wakeup armed for 2001 in place, it fires
+        // nothing; the next wakeups come after a silent second
+        timer->stop();
+        timers.run(5000);
+
+        timer->start(10);
+        timers.run(5020);
+        CHECK(timers.scheduler.getStats().wakeupsPerSecond == 0);
+        CHECK(timers.scheduler.getStats().wakeups == timers.scheduler.getStats().fired + 1);
+    });
@@ -0,0 +1,247 @@
+#include "test.h"
+#include "vfs.h"
+#include "tempfolder.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// In-memory files that count their stats and can pretend to be mutable
+struct CountingMount : EmbeddedMount
+{
+    explicit CountingMount(bool isImmutable = true) : isImmutable(isImmutable)
+    {
+    }
+
+    auto stat(std::string_view path) -> std::optional<VfsStat> override
+    {
+        stats++;
+        return EmbeddedMount::stat(path);
+    }
+
+    auto immutable() const -> bool override { return isImmutable; }
+
+    bool isImmutable;
+    std::atomic<int> stats = 0;
+};
+
+static auto text(const std::optional<std::vector<uint8_t>>& data) -> std::string
+{
+    return data ? std::string(data->begin(), data->end()) : std::string();
+}
+
+// Leading slashes and dots go, anything climbing out of the root is refused
+static TestRegistrar normalize("vfs/normalize", []
+    {
+        CHECK(vfs_normalize("index.html") == "index.html");
+        CHECK(vfs_normalize("/js/app.js") == "js/app.js");
+        CHECK(vfs_normalize(".//./js/app.js") == "js/app.js");
+        CHECK(vfs_normalize("js/..data") == "js/..data");
+
+        CHECK(! vfs_normalize(""));
+        CHECK(! vfs_normalize("/"));
+        CHECK(! vfs_normalize(".."));
+        CHECK(! vfs_normalize("../secret"));
+        CHECK(! vfs_normalize("js/../../secret"));
+        CHECK(! vfs_normalize("js/.."));
+    });
+
+// The first mount that has a path wins, prefixed mounts only see their folder
+static TestRegistrar mountOrder("vfs/mount_order", []
+    {
+        Vfs vfs;
+
+        auto& top = (CountingMount&) vfs.mount(std::make_unique<CountingMount>());
+        auto& vendor = (CountingMount&) vfs.mount(std::make_unique<CountingMount>(), "vendor");
+        auto& bottom = (CountingMount&) vfs.mount(std::make_unique<CountingMount>());
+
+        top.add("index.html", "top");
+        bottom.add("index.html", "bottom");
+        bottom.add("app.js", "app");
+        vendor.add("lib.js", "vendored");
+        bottom.add("vendor/lib.js", "shadowed");
+
+        CHECK(text(vfs.read("index.html")) == "top");
+        CHECK(text(vfs.read("/app.js")) == "app");
+        CHECK(text(vfs.read("vendor/lib.js")) == "vendored");
+        CHECK(! vfs.read("lib.js"));
+        CHECK(! vfs.read("../index.html"));
+
+        CHECK(vfs.stat("app.js")->size == 3);
+        CHECK(vfs.stat("app.js")->writeTime == 0);
+
+        // Embedded files are handed out in place
+        auto view = vfs.view("vendor/lib.js");
+        CHECK(view && std::string_view((const char*) view->bytes.data(), view->bytes.size()) == "vendored");
+        CHECK(vfs.filepath("vendor/lib.js").empty());
+    });
+
+// Resolutions are cached, misses included, and cost no more probes
+static TestRegistrar caching("vfs/caching", []
+    {
+        Vfs vfs;
+
+        auto& top = (CountingMount&) vfs.mount(std::make_unique<CountingMount>());
+        auto& bottom = (CountingMount&) vfs.mount(std::make_unique<CountingMount>());
+
+        bottom.add("app.js", "app");
+
+        for (int i = 0; i < 10; i++)
+        {
+            CHECK(vfs.stat("app.js"));
+            CHECK(! vfs.stat("missing.js"));
+        }
+
+        CHECK(top.stats == 2);
+        CHECK(bottom.stats == 2);
+
+        const auto stats = vfs.getStats();
+
+        CHECK(stats.lookups == 20);
+        CHECK(stats.hits == 18);
+        CHECK(stats.negativeHits == 9);
+        CHECK(stats.probes == 4);
+        CHECK(stats.entries == 2);
+
+        // Forgetting one path probes only that one again
+        vfs.invalidate("app.js");
+        vfs.stat("app.js");
+        vfs.stat("missing.js");
+        CHECK(vfs.getStats().probes == 6);
+
+        // Past the entry limit the cache starts over
+        vfs.options.maxEntries = 2;
+        vfs.stat("other.js");
+        CHECK(vfs.getStats().entries == 1);
+    });
+
+// Lookups through a mutable mount are trusted for the ttl only, ones through
+// immutable mounts for good
+static TestRegistrar ttl("vfs/ttl", []
+    {
+        Vfs vfs({ .ttl = 0ms });
+
+        auto& fixed = (CountingMount&) vfs.mount(std::make_unique<CountingMount>(), "fixed");
+        auto& edited = (CountingMount&) vfs.mount(std::make_unique<CountingMount>(false));
+
+        fixed.add("a.js", "a");
+
+        vfs.stat("fixed/a.js");
+        vfs.stat("fixed/a.js");
+        CHECK(fixed.stats == 1);
+        CHECK(edited.stats == 0);
+
+        vfs.stat("b.js");
+        vfs.stat("b.js");
+        CHECK(edited.stats == 2);
+
+        // A path an immutable mount doesn't have can still show up in a
+        // mutable one below it
+        vfs.stat("fixed/c.js");
+        vfs.stat("fixed/c.js");
+        CHECK(fixed.stats == 3);
+        CHECK(edited.stats == 4);
+
+        vfs.options.ttl = 1h;
+        vfs.stat("b.js");
+        edited.add("b.js", "b");
+
+        CHECK(! vfs.stat("b.js"));
+        vfs.invalidate();
+        CHECK(vfs.stat("b.js"));
+    });
+
+// A folder on disk: edits show once the cached lookup expires or is forgotten
+static TestRegistrar directory("vfs/directory", []
+    {
+        TempFolder folder("lookingglass_test_vfs");
+        folder.write("index.html", "<html></html>");
+        folder.write("js/app.js", "app()");
+
+        Vfs vfs({ .ttl = 1h });
+        vfs.mount(std::make_unique<DirectoryMount>(folder.path.string()));
+
+        CHECK(text(vfs.read("js/app.js")) == "app()");
+        CHECK(vfs.stat("js/app.js")->writeTime > 0);
+        CHECK(vfs.filepath("index.html") == (folder.path / "index.html").string());
+        CHECK(! vfs.view("index.html"));
+        CHECK(! vfs.stat("js"));
+
+        CHECK(! vfs.stat("new.js"));
+        folder.write("new.js", "new()");
+        CHECK(! vfs.stat("new.js"));
+
+        vfs.invalidate("new.js");
+        CHECK(text(vfs.read("new.js")) == "new()");
+
+        // A file removed since it was resolved reads as missing, and isn't
+        // trusted after that
+        std::filesystem::remove(folder.path / "new.js");
+        CHECK(! vfs.read("new.js"));
+        CHECK(! vfs.stat("new.js"));
+    });
+
+// precompute resolves every listed file up front, later mounts shadowed by
+// earlier ones
+static TestRegistrar precompute("vfs/precompute", []
+    {
+        TempFolder folder("lookingglass_test_vfs");
+        folder.write("index.html", "<html></html>");
+        folder.write("js/app.js", "app()");
+
+        Vfs vfs({ .ttl = 1h });
+
+        auto& top = (CountingMount&) vfs.mount(std::make_unique<CountingMount>());
+        vfs.mount(std::make_unique<DirectoryMount>(folder.path.string()));
+
+        top.add("index.html", "top");
+        vfs.precompute();
+
+        CHECK(vfs.getStats().entries == 2);
+        CHECK(text(vfs.read("index.html")) == "top");
+        CHECK(text(vfs.read("js/app.js")) == "app()");
+        CHECK(top.stats == 0);
+        CHECK(vfs.getStats().probes == 0);
+
+        vfs.unmountAll();
+        CHECK(vfs.getStats().entries == 0);
+        CHECK(! vfs.read("index.html"));
+    });
+
+// Lookups from several threads agree with each other and the stats add up
+static TestRegistrar threads("vfs/threads", []
+    {
+        Vfs vfs({ .ttl = 0ms, .maxEntries = 8 });
+
+        auto& files = (CountingMount&) vfs.mount(std::make_unique<CountingMount>(false));
+
+        for (auto name : { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9" })
+            files.add(name, name);
+
+        std::atomic<int> wrong = 0;
+        std::vector<std::thread> workers;
+
+        for (int t = 0; t < 4; t++)
+            workers.emplace_back([&, t]
+                {
+                    for (int i = 0; i < 2000; i++)
+                    {
+                        const auto name = std::to_string((t * 7 + i) % 12);
+                        const auto data = vfs.read(name);
+
+                        if ((name.size() == 1) != data.has_value() || (data && text(data) != name))
+                            wrong++;
+                    }
+                });
+
+        for (auto& worker : workers)
+            worker.join();
+
+        const auto stats = vfs.getStats();
+
+        CHECK(wrong == 0);
+        CHECK(stats.lookups == 8000);
+        CHECK(stats.hits + stats.probes == stats.lookups);
+        CHECK(stats.entries <= 8);
+    });
@@ -0,0 +1,78 @@
+#include "test.h"
+#include "webappinterface.h"
+
+#include <atomic>
+#include <thread>
+
+// Runs the message loop until done() says so, or a second passes
+static auto run_until(WebAppInterface& app, const std::function<bool()>& done) -> void
+{
+    auto& loop = app.getEventLoop();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+    std::function<void()> check;
+    check = [&]
+    {
+        if (done() || std::chrono::steady_clock::now() > deadline)
+            loop.quit();
+        else
+            loop.postDelayed(1, [&check] { check(); });
+    };
+
+    loop.post([&check] { check(); });
+    loop.run();
+}
+
+// Background work hands its result, or just its completion, back to the message thread
+static TestRegistrar runInBackground("webapp/run_in_background", []
+    {
+        WebAppInterface app;
+
+        const auto home = std::this_thread::get_id();
+        std::atomic<bool> worked = false;
+        std::optional<int> result;
+        bool finished = false;
+        bool onHome = true;
+
+        app.runInBackground([] { return 21 * 2; }, [&] (int value)
+            {
+                result = value;
+                onHome = onHome && std::this_thread::get_id() == home;
+            });
+
+        app.runInBackground([&worked, home]
+            {
+                worked = std::this_thread::get_id() != home;
+            },
+            [&]
+            {
+                finished = true;
+                onHome = onHome && std::this_thread::get_id() == home;
+            });
+
+        run_until(app, [&] { return result && finished; });
+
+        CHECK(result == 42);
+        CHECK(finished && worked);
+        CHECK(onHome);
+    });
+
+// Live messages decode like replayed ones: a null id is no reply, not a bad call
+static TestRegistrar liveDecode("webapp/live_decode", []
+    {
+        WebAppInterface app;
+        std::vector<nlohmann::json> received;
+
+        app.registerScriptEndpoint("record", [&received] (const nlohmann::json& content) { received.push_back(content); });
+
+        CHECK(app.onScriptMessage({ { "name", "__shape" }, { "content", { 1, { "name", "content", "id" } } } }));
+        CHECK(app.onScriptMessage({ 1, "record", { 1 }, nullptr }));
+        CHECK(app.onScriptMessage({ { "name", "record" }, { "content", { 2 } }, { "id", nullptr } }));
+
+        CHECK(received == std::vector<nlohmann::json>({ { 1 }, { 2 } }));
+
+        CHECK(! app.onScriptMessage({ 7, "record", { 3 } }));
+        CHECK(! app.onScriptMessage({ { "content", { 3 } } }));
+        CHECK(! app.onScriptMessage({ 1, "record", { 3 }, "not an id" }));
+        CHECK(received.size() == 2);
+    });
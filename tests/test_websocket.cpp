@@ -0,0 +1,187 @@
+#include "test.h"
+#include "websocketcodec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+static constexpr uint8_t key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+static auto pattern(size_t size) -> std::string
+{
+    std::string text(size, '\0');
+
+    for (size_t i = 0; i < size; i++)
+        text[i] = (char) (i * 13 % 251);
+
+    return text;
+}
+
+// A byte at a time, what the vector paths have to agree with
+static auto mask_reference(std::string text, size_t offset) -> std::string
+{
+    for (size_t i = 0; i < text.size(); i++)
+        text[i] = (char) ((uint8_t) text[i] ^ key[(offset + i) & 3]);
+
+    return text;
+}
+
+// Parses a frame from a copy of bytes, -2 if it didn't take all of them
+static auto parse(std::string bytes, WebSocketFrame& frame, std::string& payload, bool requireMask = true) -> long
+{
+    const auto consumed = parse_websocket_frame(bytes, 0, frame, requireMask);
+
+    if (consumed <= 0)
+        return consumed;
+
+    payload = std::string(frame.payload);
+    return consumed == (long) bytes.size() ? consumed : -2;
+}
+
+// Every length around the 16 and 64 byte blocks, every key phase and a
+// misaligned start agree with masking byte by byte
+static TestRegistrar mask("websocket/mask", []
+    {
+        for (size_t size = 0; size <= 200; size++)
+        {
+            for (size_t offset = 0; offset < 4; offset++)
+            {
+                auto buffer = "x" + pattern(size);
+                websocket_mask((uint8_t*) buffer.data() + 1, size, key, offset);
+
+                CHECK(buffer.substr(1) == mask_reference(pattern(size), offset));
+            }
+        }
+
+        // Masking twice gives the text back
+        auto text = pattern(4096 + 7);
+        websocket_mask((uint8_t*) text.data(), text.size(), key, 2);
+        websocket_mask((uint8_t*) text.data(), text.size(), key, 2);
+
+        CHECK(text == pattern(4096 + 7));
+    });
+
+// 7, 16 and 64 bit lengths either side of where they switch, masked as
+// clients send them and unmasked as the server does
+static TestRegistrar lengths("websocket/lengths", []
+    {
+        for (size_t size : { 0, 1, 125, 126, 127, 65535, 65536, 100000 })
+        {
+            const auto payload = pattern(size);
+            const auto header  = size < 126 ? 2 : size <= 0xffff ? 4 : 10;
+
+            const auto masked   = encode_websocket_frame(WebSocketOpcode::binary, payload, key);
+            const auto unmasked = encode_websocket_frame(WebSocketOpcode::text, payload);
+
+            CHECK(masked.size() == header + 4 + size);
+            CHECK(unmasked.size() == header + size);
+
+            WebSocketFrame frame;
+            std::string parsed;
+
+            CHECK(parse(masked, frame, parsed) > 0);
+            CHECK(frame.fin && frame.opcode == WebSocketOpcode::binary && parsed == payload);
+
+            CHECK(parse(unmasked, frame, parsed, false) > 0);
+            CHECK(frame.fin && frame.opcode == WebSocketOpcode::text && parsed == payload);
+
+            // Short of a byte anywhere is incomplete, not malformed
+            for (size_t cut : { (size_t) 1, (size_t) header - 1, (size_t) header + 3, masked.size() - 1 })
+            {
+                auto partial = masked.substr(0, std::min(cut, masked.size() - 1));
+                CHECK(parse_websocket_frame(partial, 0, frame) == 0);
+            }
+        }
+
+        // Frames back to back, the second parsed at its offset
+        auto both = encode_websocket_frame(WebSocketOpcode::text, "one", key) + encode_websocket_frame(WebSocketOpcode::text, pattern(300), key);
+
+        WebSocketFrame frame;
+        const auto first = parse_websocket_frame(both, 0, frame);
+
+        CHECK(first == 9 && frame.payload == "one");
+        CHECK(parse_websocket_frame(both, (size_t) first, frame) == (long) both.size() - first && frame.payload == pattern(300));
+    });
+
+// A message split over frames: only the last has fin set, the rest are
+// continuations, control frames may come in between
+static TestRegistrar fragments("websocket/fragments", []
+    {
+        auto start = encode_websocket_frame(WebSocketOpcode::text, "hel", key);
+        auto ping  = encode_websocket_frame(WebSocketOpcode::ping, "are you there", key);
+        auto end   = encode_websocket_frame(WebSocketOpcode::continuation, "lo", key);
+
+        start[0] = (char) (start[0] & 0x7f);
+
+        WebSocketFrame frame;
+        std::string payload;
+
+        CHECK(parse(start, frame, payload) > 0);
+        CHECK(! frame.fin && frame.opcode == WebSocketOpcode::text && payload == "hel");
+
+        CHECK(parse(ping, frame, payload) > 0);
+        CHECK(frame.fin && frame.opcode == WebSocketOpcode::ping && payload == "are you there");
+
+        CHECK(parse(end, frame, payload) > 0);
+        CHECK(frame.fin && frame.opcode == WebSocketOpcode::continuation && payload == "lo");
+
+        for (auto opcode : { WebSocketOpcode::close, WebSocketOpcode::pong })
+        {
+            CHECK(parse(encode_websocket_frame(opcode, std::string(125, 'c'), key), frame, payload) > 0);
+            CHECK(frame.opcode == opcode && payload == std::string(125, 'c'));
+        }
+    });
+
+static TestRegistrar malformed("websocket/malformed", []
+    {
+        WebSocketFrame frame;
+        std::string payload;
+
+        // Clients must mask, the server must not
+        CHECK(parse(encode_websocket_frame(WebSocketOpcode::text, "hi"), frame, payload) == -1);
+        CHECK(parse(encode_websocket_frame(WebSocketOpcode::text, "hi", key), frame, payload, false) == -1);
+
+        // Reserved bits, for extensions never negotiated
+        for (uint8_t bit : { 0x40, 0x20, 0x10 })
+        {
+            auto frameBytes = encode_websocket_frame(WebSocketOpcode::text, "hi", key);
+            frameBytes[0]   = (char) (frameBytes[0] | bit);
+
+            CHECK(parse(frameBytes, frame, payload) == -1);
+        }
+
+        // Control frames can't be fragmented or longer than 125 bytes
+        auto fragmentedPing = encode_websocket_frame(WebSocketOpcode::ping, "x", key);
+        fragmentedPing[0]   = (char) (fragmentedPing[0] & 0x7f);
+
+        CHECK(parse(fragmentedPing, frame, payload) == -1);
+        CHECK(parse(encode_websocket_frame(WebSocketOpcode::close, std::string(126, 'c'), key), frame, payload) == -1);
+
+        // Turned down from the header alone, before the payload could arrive
+        std::string oversize = { (char) 0x82, (char) (0x80 | 127) };
+        const uint64_t length = maxWebSocketPayload + 1;
+
+        for (int shift = 56; shift >= 0; shift -= 8)
+            oversize += (char) (length >> shift);
+
+        oversize += std::string((const char*) key, 4);
+
+        CHECK(parse_websocket_frame(oversize, 0, frame) == -1);
+
+        std::string huge = { (char) 0x82, (char) (0x80 | 127), (char) 0x80, 0, 0, 0, 0, 0, 0, 0 };
+        CHECK(parse_websocket_frame(huge, 0, frame) == -1);
+
+        // The largest allowed is only waiting for its payload
+        std::string largest = { (char) 0x82, (char) (0x80 | 127) };
+
+        for (int shift = 56; shift >= 0; shift -= 8)
+            largest += (char) ((uint64_t) maxWebSocketPayload >> shift);
+
+        CHECK(parse_websocket_frame(largest, 0, frame) == 0);
+    });
+
+// The RFC 6455 handshake example
+static TestRegistrar handshake("websocket/handshake", []
+    {
+        CHECK(websocket_accept("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+    });
@@ -0,0 +1,262 @@
+#include "test.h"
+#include "workerpool.h"
+
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// A flag threads can wait on, for holding a worker busy
+struct Gate
+{
+    auto wait() const -> void
+    {
+        while (! open)
+            std::this_thread::sleep_for(100us);
+    }
+
+    std::atomic<bool> open = false;
+};
+
+// Occupies one of the pool's workers until released
+struct Blocker
+{
+    explicit Blocker(WorkerPool& pool)
+    {
+        pool.post([this] { running = true; release.wait(); done = true; });
+
+        while (! running)
+            std::this_thread::yield();
+    }
+
+    ~Blocker()
+    {
+        release.open = true;
+
+        while (! done)
+            std::this_thread::yield();
+    }
+
+    Gate release;
+    std::atomic<bool> running = false;
+    std::atomic<bool> done = false;
+};
+
+// Every index is visited exactly once, whatever the grain
+static TestRegistrar parallelFor("workerpool/parallel_for", []
+    {
+        WorkerPool pool{ 3 };
+
+        for (size_t grain : { 1, 7, 64, 1000, 5000 })
+        {
+            std::vector<std::atomic<int>> visits(1000);
+
+            pool.parallelFor(0, visits.size(), grain, [&visits] (size_t begin, size_t end)
+                {
+                    for (auto i = begin; i < end; i++)
+                        visits[i]++;
+                });
+
+            for (auto& count : visits)
+                CHECK(count == 1);
+        }
+
+        int calls = 0;
+        pool.parallelFor(5, 5, 1, [&calls] (size_t, size_t) { calls++; });
+        CHECK(calls == 0);
+    });
+
+// While chunks finish elsewhere the caller waits rather than picking up
+// the pool's other jobs, which could run for any length of time
+static TestRegistrar parallelForOwnWork("workerpool/parallel_for_own_work", []
+    {
+        WorkerPool pool{ 2 };
+        Blocker blocker(pool);
+
+        const auto caller = std::this_thread::get_id();
+        Gate workerChunk;
+        std::atomic<bool> otherRan = false;
+        std::atomic<bool> otherOnCaller = false;
+
+        pool.parallelFor(0, 4, 1, [&] (size_t, size_t)
+            {
+                if (std::this_thread::get_id() == caller)
+                {
+                    // Hold the caller until the free worker has a chunk of its own
+                    workerChunk.wait();
+                    return;
+                }
+
+                if (! workerChunk.open.exchange(true))
+                {
+                    // Queued behind the chunk on the only free worker
+                    pool.post([&] { otherOnCaller = std::this_thread::get_id() == caller; otherRan = true; });
+                    std::this_thread::sleep_for(20ms);
+                }
+            });
+
+        CHECK(! otherOnCaller);
+
+        while (! otherRan)
+            std::this_thread::yield();
+
+        CHECK(! otherOnCaller);
+    });
+
+// wait() runs the group's own queued jobs on the caller and leaves
+// unrelated ones to the pool
+static TestRegistrar groupOwnWork("workerpool/group_own_work", []
+    {
+        WorkerPool pool{ 1 };
+        std::atomic<bool> otherRan = false;
+
+        {
+            Blocker blocker(pool);
+
+            const auto caller = std::this_thread::get_id();
+            std::atomic<int> onCaller = 0;
+
+            TaskGroup group(pool);
+
+            for (int i = 0; i < 3; i++)
+                group.run([&] { onCaller += std::this_thread::get_id() == caller; });
+
+            // Newest in the queue, so the first job any helper would take
+            pool.post([&otherRan] { otherRan = true; });
+
+            group.wait();
+
+            CHECK(onCaller == 3);
+            CHECK(! otherRan);
+        }
+
+        while (! otherRan)
+            std::this_thread::yield();
+    });
+
+// The first error comes back from wait(), the rest of the jobs still run,
+// notify fires once the group is done
+static TestRegistrar groupErrors("workerpool/group_errors", []
+    {
+        WorkerPool pool{ 2 };
+        ManualExecutor home;
+
+        TaskGroup group(pool);
+        std::atomic<int> ran = 0;
+        bool notified = false;
+
+        for (int i = 0; i < 10; i++)
+            group.run([&ran, i]
+                {
+                    ran++;
+
+                    if (i % 4 == 0)
+                        throw std::runtime_error("failed");
+                });
+
+        group.notify(home, [&notified] { notified = true; });
+
+        bool threw = false;
+
+        try
+        {
+            group.wait();
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+
+        CHECK(threw);
+        CHECK(ran == 10);
+
+        // Reported once
+        group.wait();
+
+        home.poll();
+        CHECK(notified);
+
+        // Nothing outstanding, notify posts straight away
+        notified = false;
+        group.notify(home, [&notified] { notified = true; });
+        home.poll();
+        CHECK(notified);
+    });
+
+// Groups waited on from inside other groups' jobs finish even with every
+// worker busy waiting, and jobs added by running jobs are waited for too
+static TestRegistrar nested("workerpool/nested", []
+    {
+        WorkerPool pool{ 2 };
+        std::atomic<int> leaves = 0;
+
+        TaskGroup outer(pool);
+
+        for (int i = 0; i < 4; i++)
+            outer.run([&pool, &leaves]
+                {
+                    TaskGroup inner(pool);
+
+                    for (int j = 0; j < 8; j++)
+                        inner.run([&leaves] { leaves++; });
+
+                    inner.wait();
+                });
+
+        outer.wait();
+        CHECK(leaves == 32);
+
+        std::atomic<int> spawned = 0;
+        TaskGroup growing(pool);
+
+        growing.run([&]
+            {
+                for (int i = 0; i < 5; i++)
+                    growing.run([&spawned] { std::this_thread::sleep_for(1ms); spawned++; });
+            });
+
+        growing.wait();
+        CHECK(spawned == 5);
+    });
+
+// Lots of small jobs from several groups at once, all of them run once
+static TestRegistrar stress("workerpool/stress", []
+    {
+        WorkerPool pool{ 4 };
+
+        constexpr int groupCount = 4;
+        constexpr int jobsEach   = 5000;
+
+        std::vector<std::atomic<int>> sums(groupCount);
+        std::vector<std::thread> waiters;
+
+        for (int g = 0; g < groupCount; g++)
+            waiters.emplace_back([&pool, &sums, g]
+                {
+                    TaskGroup group(pool);
+
+                    for (int i = 1; i <= jobsEach; i++)
+                        group.run([&sums, g, i] { sums[g] += i; });
+
+                    group.wait();
+                });
+
+        std::vector<uint64_t> totals(1000);
+        pool.parallelFor(0, totals.size(), 16, [&totals] (size_t begin, size_t end)
+            {
+                for (auto i = begin; i < end; i++)
+                    totals[i] = i;
+            });
+
+        for (auto& waiter : waiters)
+            waiter.join();
+
+        for (auto& sum : sums)
+            CHECK(sum == jobsEach * (jobsEach + 1) / 2);
+
+        CHECK(std::accumulate(totals.begin(), totals.end(), uint64_t(0)) == 999 * 1000 / 2);
+    });
@@ -0,0 +1,242 @@
+#include "test.h"
+#include "zipmount.h"
+#include "tempfolder.h"
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <string>
+
+// Builds a zip in memory, entries stored or raw deflated
+struct ZipWriter
+{
+    auto add(const std::string& name, const std::string& content, bool deflate = false) -> void
+    {
+        auto data = deflate ? compress(content) : content;
+        const auto crc = (uint32_t) crc32(0, (const Bytef*) content.data(), (uInt) content.size());
+        const auto offset = (uint32_t) archive.size();
+
+        // 2024-05-01 12:00:00
+        const uint16_t time = 12 << 11;
+        const uint16_t date = (2024 - 1980) << 9 | 5 << 5 | 1;
+        const uint16_t method = deflate ? 8 : 0;
+
+        put32(archive, 0x04034b50);
+        put16(archive, 20);
+        put16(archive, 0);
+        put16(archive, method);
+        put16(archive, time);
+        put16(archive, date);
+        put32(archive, crc);
+        put32(archive, (uint32_t) data.size());
+        put32(archive, (uint32_t) content.size());
+        put16(archive, (uint16_t) name.size());
+        put16(archive, 0);
+        archive += name + data;
+
+        put32(directory, 0x02014b50);
+        put16(directory, 20);
+        put16(directory, 20);
+        put16(directory, 0);
+        put16(directory, method);
+        put16(directory, time);
+        put16(directory, date);
+        put32(directory, crc);
+        put32(directory, (uint32_t) data.size());
+        put32(directory, (uint32_t) content.size());
+        put16(directory, (uint16_t) name.size());
+        put16(directory, 0);
+        put16(directory, 0);
+        put16(directory, 0);
+        put16(directory, 0);
+        put32(directory, 0);
+        put32(directory, offset);
+        directory += name;
+
+        count++;
+    }
+
+    // The archive with its central directory and an end record claiming its
+    // entries, or as many as claimed
+    auto finish(uint64_t claimed = UINT64_MAX) const -> std::string
+    {
+        auto result = archive + directory;
+        const auto entries = (uint16_t) (claimed == UINT64_MAX ? count : claimed);
+
+        put32(result, 0x06054b50);
+        put16(result, 0);
+        put16(result, 0);
+        put16(result, entries);
+        put16(result, entries);
+        put32(result, (uint32_t) directory.size());
+        put32(result, (uint32_t) archive.size());
+        put16(result, 0);
+
+        return result;
+    }
+
+    // Same, with a zip64 end record and locator in front of the end record
+    auto finish64(uint64_t claimed) const -> std::string
+    {
+        auto result = archive + directory;
+        const auto end64 = result.size();
+
+        put32(result, 0x06064b50);
+        put64(result, 44);
+        put16(result, 45);
+        put16(result, 45);
+        put32(result, 0);
+        put32(result, 0);
+        put64(result, claimed);
+        put64(result, claimed);
+        put64(result, directory.size());
+        put64(result, archive.size());
+
+        put32(result, 0x07064b50);
+        put32(result, 0);
+        put64(result, end64);
+        put32(result, 1);
+
+        put32(result, 0x06054b50);
+        put16(result, 0);
+        put16(result, 0);
+        put16(result, 0xffff);
+        put16(result, 0xffff);
+        put32(result, 0xffffffff);
+        put32(result, 0xffffffff);
+        put16(result, 0);
+
+        return result;
+    }
+
+    static auto compress(const std::string& content) -> std::string
+    {
+        std::string out(compressBound((uLong) content.size()), '\0');
+
+        z_stream stream{};
+        deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+        stream.next_in   = (Bytef*) content.data();
+        stream.avail_in  = (uInt) content.size();
+        stream.next_out  = (Bytef*) out.data();
+        stream.avail_out = (uInt) out.size();
+
+        deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+
+        return out;
+    }
+
+    static auto put16(std::string& out, uint16_t value) -> void
+    {
+        out += (char) (value & 0xff);
+        out += (char) (value >> 8);
+    }
+
+    static auto put32(std::string& out, uint32_t value) -> void
+    {
+        put16(out, (uint16_t) value);
+        put16(out, (uint16_t) (value >> 16));
+    }
+
+    static auto put64(std::string& out, uint64_t value) -> void
+    {
+        put32(out, (uint32_t) value);
+        put32(out, (uint32_t) (value >> 32));
+    }
+
+    std::string archive;
+    std::string directory;
+    uint64_t count = 0;
+};
+
+static auto text(const std::optional<std::vector<uint8_t>>& data) -> std::string
+{
+    return data ? std::string(data->begin(), data->end()) : std::string();
+}
+
+// Stored entries come straight from the mapping, deflated ones are inflated
+// once and then served from the cache
+static TestRegistrar entries("zipmount/entries", []
+    {
+        const std::string script(4096, 'x');
+
+        ZipWriter zip;
+        zip.add("index.html", "<html></html>");
+        zip.add("js/", "");
+        zip.add("js/app.js", script, true);
+        zip.add("empty.txt", "", true);
+
+        TempFolder folder("lookingglass_test_zip");
+        folder.write("app.zip", zip.finish());
+
+        auto mount = ZipMount::open((folder.path / "app.zip").string());
+        CHECK(mount);
+
+        CHECK(mount->list().size() == 3);
+        CHECK(! mount->stat("js/"));
+        CHECK(! mount->stat("missing.js"));
+
+        const auto info = mount->stat("js/app.js");
+        CHECK(info && info->size == script.size());
+        CHECK(info->writeTime == 1714564800);
+
+        CHECK(text(mount->read("index.html")) == "<html></html>");
+        CHECK(text(mount->read("js/app.js")) == script);
+        CHECK(text(mount->read("js/app.js")) == script);
+        CHECK(mount->read("empty.txt") && mount->read("empty.txt")->empty());
+
+        const auto stats = mount->getStats();
+
+        CHECK(stats.stored == 1);
+        CHECK(stats.inflated == 2);
+        CHECK(stats.cacheHits == 2);
+        CHECK(stats.cacheBytes == script.size());
+
+        // A view keeps the archive mapped after the mount is gone
+        auto view = mount->view("index.html");
+        mount.reset();
+        CHECK(std::string_view((const char*) view->bytes.data(), view->bytes.size()) == "<html></html>");
+    });
+
+// Archives that aren't what they claim are turned down, not trusted
+static TestRegistrar corrupt("zipmount/corrupt", []
+    {
+        ZipWriter zip;
+        zip.add("index.html", "<html></html>");
+        zip.add("app.js", "app()");
+
+        TempFolder folder("lookingglass_test_zip");
+        const auto open = [&folder] (const std::string& bytes)
+        {
+            folder.write("app.zip", bytes);
+            return ZipMount::open((folder.path / "app.zip").string());
+        };
+
+        CHECK(open(zip.finish()));
+        CHECK(! open(""));
+        CHECK(! open("not a zip at all, just some text"));
+        CHECK(! open(zip.finish().substr(0, zip.archive.size() + 10)));
+
+        // More entries than the directory has
+        CHECK(! open(zip.finish(3)));
+
+        // A zip64 count no directory could hold fails, rather than reserving for it
+        CHECK(open(zip.finish64(2)));
+        CHECK(! open(zip.finish64(uint64_t(1) << 60)));
+
+        // Fewer is fine, the rest of the directory is ignored
+        auto first = open(zip.finish(1));
+        CHECK(first && first->list().size() == 1);
+
+        // A deflated entry that doesn't inflate to what the directory says reads as missing
+        ZipWriter deflated;
+        deflated.add("app.js", std::string(100, 'a'), true);
+        auto damaged = deflated.finish();
+        damaged[damaged.find("app.js") + 6 + 1] ^= 0x01;
+
+        auto mount = open(damaged);
+        CHECK(mount);
+        CHECK(! mount->read("app.js"));
+    });